@@ -31,7 +31,14 @@
 #include "cpprest/details/basic_types.h"
 #include "http/session/map_session.h"
 #include "http/oauth2/map_oauth2.h"
+#include "http/session/redis_session.h"
+#include "http/oauth2/redis_oauth2.h"
 #include "cache/shared_map_cache_driver.h"
+#include "cache/shared_memory_cache_driver.h"
+#include "cache/redis_cache_driver.h"
+#include "cache/near_cache_driver.h"
+#include "cache/compressed_cache_driver.h"
+#include "cache/cache_registry.h"
 #include "http/controller/browser_controller.h"
 #include "http/controller/oauth2_controller.h"
 #include "src/http/controller/user_controller.h"
@@ -46,11 +53,28 @@ std::vector<std::unique_ptr<granada::http::controller::Controller>> g_controller
 void on_initialize(const string_t& address)
 {
 
-  std::shared_ptr<granada::http::session::SessionFactory> session_factory(new granada::http::session::MapSessionFactory());
-
-  std::shared_ptr<granada::http::oauth2::OAuth2Factory> oauth2_factory(new granada::http::oauth2::MapOAuth2Factory());
-
-  std::shared_ptr<granada::cache::CacheHandler> cache_handler(new granada::cache::SharedMapCacheDriver());
+  std::shared_ptr<granada::http::session::SessionFactory> session_factory;
+  std::shared_ptr<granada::http::oauth2::OAuth2Factory> oauth2_factory;
+  std::shared_ptr<granada::cache::CacheHandler> cache_handler;
+  std::shared_ptr<granada::cache::CacheHandler> rate_limit_cache;
+
+  // get property "redis_cache_driver" from the server configuration file
+  // If this property equals "on" sessions, OAuth 2.0 entities and messages
+  // are stored in Redis, with a near cache if "near_cache_driver" is "on",
+  // otherwise they are stored in local caches. Rate limits are always read
+  // from the cache storing them, so they have no near cache. Namespaces mapped to a
+  // driver in "cache_registry_namespaces" use that driver instead.
+  if (granada::util::application::GetProperty(entity_keys::redis_cache_driver) == "on"){
+    session_factory.reset(new granada::http::session::RedisSessionFactory());
+    oauth2_factory.reset(new granada::http::oauth2::RedisOAuth2Factory());
+    cache_handler = granada::cache::CacheRegistry::Get("message:",[](){ return granada::cache::MakeNearCacheDriver(granada::cache::MakeCompressedCacheDriver(granada::util::memory::make_unique<granada::cache::RedisCacheDriver>())); });
+    rate_limit_cache = granada::cache::CacheRegistry::Get("rate:",[](){ return granada::util::memory::make_unique<granada::cache::RedisCacheDriver>(); });
+  }else{
+    session_factory.reset(new granada::http::session::MapSessionFactory());
+    oauth2_factory.reset(new granada::http::oauth2::MapOAuth2Factory());
+    cache_handler = granada::cache::CacheRegistry::Get("message:",[](){ return granada::cache::MakeCompressedCacheDriver(granada::cache::MakeLocalCacheDriver("message")); });
+    rate_limit_cache = granada::cache::CacheRegistry::Get("rate:",[](){ return granada::cache::MakeLocalCacheDriver("rate"); });
+  }
 
   ////
   // Browser Controller
@@ -99,7 +123,7 @@ void on_initialize(const string_t& address)
   uri_builder auth_uri(address);
   auth_uri.append_path(U("oauth2"));
   addr = auth_uri.to_uri().to_string();
-  std::unique_ptr<granada::http::controller::OAuth2Controller> auth_controller(new granada::http::controller::OAuth2Controller(addr,session_factory,oauth2_factory));
+  std::unique_ptr<granada::http::controller::OAuth2Controller> auth_controller(new granada::http::controller::OAuth2Controller(addr,session_factory,oauth2_factory,rate_limit_cache));
   auth_controller->open().wait();
   g_controllers.push_back(std::move(auth_controller));
   ucout << "Auth Controller: Initialized... Listening for requests at: " << addr << std::endl;
@@ -111,7 +135,7 @@ void on_initialize(const string_t& address)
   uri_builder message_uri(address);
   message_uri.append_path(U("message"));
   addr = message_uri.to_uri().to_string();
-  std::unique_ptr<granada::http::controller::MessageController> message_controller(new granada::http::controller::MessageController(addr,session_factory,cache_handler));
+  std::unique_ptr<granada::http::controller::MessageController> message_controller(new granada::http::controller::MessageController(addr,session_factory,cache_handler,rate_limit_cache));
   message_controller->open().wait();
   g_controllers.push_back(std::move(message_controller));
   ucout << "Message Controller: Initialized... Listening for requests at: " << addr << std::endl;
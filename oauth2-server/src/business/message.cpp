@@ -31,44 +31,125 @@
 
 namespace granada{
 
+  // windows of positions of the index read by List before returning
+  // a page shortened by deleted messages, with a cursor to continue.
+  static const std::size_t MESSAGE_LIST_WINDOWS = 8;
+
+  // key storing the version of the message indexes, written once
+  // the messages created before the indexes existed are indexed.
+  static const std::string MESSAGE_INDEX_VERSION_KEY = "message.index.version";
+  static const std::string MESSAGE_INDEX_VERSION = "1";
+
   Message::Message(std::shared_ptr<granada::cache::CacheHandler>& cache){
     cache_ = cache;
     n_generator_ = std::unique_ptr<utility::nonce_generator>(new utility::nonce_generator(16));
   }
 
-  void Message::Create(const std::string username, const std::string& message){
-	std::string message_id = utility::conversions::to_utf8string(n_generator_->generate());
-    if (cache_->Exists("message:" + username + ":" + message_id)){
-      Create(username,message);
-    }else{
-      cache_->Write("message:" + username + ":" + message_id, "key", message_id);
-      cache_->Write("message:" + username + ":" + message_id, "text", message);
-    }
+  std::string Message::Create(const std::string username, const std::string& message){
+    // the position is unique in the user's index, so the id ending
+    // with it is unique without checking that it is not in use.
+    const granada::cache::CacheKey index("message.index:", username);
+    const std::string position = std::to_string(cache_->Increment(index, "next", 1));
+    const std::string message_id = utility::conversions::to_utf8string(n_generator_->generate()) + position;
+
+    cache_->WriteMany(granada::cache::CacheKey("message:", username, message_id), {
+      { "key", message_id },
+      { "position", position },
+      { "text", message }
+    });
+
+    // the message is listed once it is in the index.
+    cache_->Write(index, position, message_id);
+    return message_id;
   }
 
   bool Message::Edit(const std::string username, const std::string& message_id, const std::string& message){
-    if (cache_->Exists("message:" + username + ":" + message_id)){
-      cache_->Write("message:" + username + ":" + message_id, "text", message);
+    const granada::cache::CacheKey hash("message:", username, message_id);
+    if (cache_->Exists(hash)){
+      cache_->Write(hash, "text", message);
       return true;
     }
     return false;
   }
 
   void Message::Delete(const std::string username, const std::string& message_id){
-    cache_->Destroy("message:" + username + ":" + message_id);
+    const granada::cache::CacheKey hash("message:", username, message_id);
+    const std::string position = cache_->Read(hash, "position");
+    if (!position.empty()){
+      cache_->Destroy(granada::cache::CacheKey("message.index:", username), position);
+    }
+    cache_->Destroy(hash);
   }
 
-  std::string Message::List(const std::string username){
+  std::string Message::List(const std::string username, const std::string& cursor, const std::size_t& limit, std::string& next_cursor){
+    // the cursor is the position of the newest message not listed yet,
+    // read before next_cursor is cleared as they may be the same string.
+    const granada::cache::CacheKey index("message.index:", username);
+    long long position = 0;
+    try{
+      position = std::stoll(cursor.empty() ? cache_->Read(index, "next") : cursor);
+    }catch(const std::logic_error e){}
+    next_cursor.clear();
+
+    // read the positions from the cursor down, until the page is full,
+    // positions of deleted messages are empty.
+    std::vector<std::string> message_ids;
+    for (std::size_t window = 0; window < MESSAGE_LIST_WINDOWS && position > 0 && message_ids.size() < limit; ++window){
+      std::vector<std::string> positions;
+      for (; position > 0 && positions.size() < limit - message_ids.size(); --position){
+        positions.push_back(std::to_string(position));
+      }
+      std::vector<std::string> values;
+      cache_->ReadMany(index, positions, values);
+      for (auto it = values.begin(); it != values.end(); ++it){
+        if (!it->empty()){
+          message_ids.push_back(*it);
+        }
+      }
+    }
+    if (position > 0){
+      next_cursor.assign(std::to_string(position));
+    }
+
     std::string message_list = "";
-    std::vector<std::string> keys;
-    cache_->Match("message:" + username + ":*", keys);
-    for (auto it = keys.begin(); it != keys.end(); ++it){
-      if (it != keys.begin()){
+    for (auto it = message_ids.begin(); it != message_ids.end(); ++it){
+      std::vector<std::string> values;
+      if (!cache_->ReadMany(granada::cache::CacheKey("message:", username, *it), { "key", "text" }, values)){
+        continue;
+      }
+      if (!message_list.empty()){
         message_list += ",";
       }
-      message_list = message_list + "{\"key\":\"" + cache_->Read(*it, "key") + "\",\"text\":\"" + cache_->Read(*it, "text") + "\"}";
+      message_list += "{\"key\":\"" + values[0] + "\",\"text\":\"" + values[1] + "\"}";
     }
     message_list = "[" + message_list + "]";
     return message_list;
   }
+
+  void Message::Index(std::shared_ptr<granada::cache::CacheHandler>& cache){
+    if (cache->Read(MESSAGE_INDEX_VERSION_KEY) == MESSAGE_INDEX_VERSION){
+      return;
+    }
+
+    // index the messages that have no position, the position is only set
+    // if the message still has none, so servers indexing at the same time
+    // do not index a message twice.
+    std::unique_ptr<granada::cache::CacheHandlerIterator> cache_iterator = cache->make_iterator("message:*");
+    while (cache_iterator->has_next()){
+      const std::string key = cache_iterator->next();
+      std::vector<std::string> values;
+      if (!cache->ReadMany(key, { "key", "position" }, values) || values[0].empty() || !values[1].empty()
+          || key.length() < values[0].length() + 9){
+        continue;
+      }
+      // message:<username>:<message id>
+      const std::string username = key.substr(8, key.length() - values[0].length() - 9);
+      const granada::cache::CacheKey index("message.index:", username);
+      const std::string position = std::to_string(cache->Increment(index, "next", 1));
+      if (cache->CompareAndSet(key, "position", "", position)){
+        cache->Write(index, position, values[0]);
+      }
+    }
+    cache->Write(MESSAGE_INDEX_VERSION_KEY, MESSAGE_INDEX_VERSION);
+  }
 }
@@ -39,6 +39,21 @@
 #include "cpprest/asyncrt_utils.h"
 
 namespace granada{
+
+  /**
+   * Messages of the users. Each message is stored in the hash
+   * message:<username>:<message id>, with its key, its text and its
+   * position in the index of the user's messages.
+   *
+   * The index of a user, the hash message.index:<username>, maps the
+   * position of each message, a number incremented with each message
+   * created, to its id, and keeps the last position given in the
+   * "next" field. Listing reads a page of positions of the index, so
+   * it takes the same time whatever the number of messages of the
+   * other users, and positions of deleted messages are skipped.
+   * Messages created before the index existed are added to it by
+   * Index, when the server starts.
+   */
   class Message{
     public:
 
@@ -47,13 +62,25 @@ namespace granada{
        */
       Message(std::shared_ptr<granada::cache::CacheHandler>& cache);
 
+      /**
+       * Adds the messages created before the indexes existed to the
+       * index of their user. Called once when the server starts, the
+       * version of the indexes stored in the cache once it is done
+       * makes the next calls return without reading the messages.
+       * @param cache Cache where the messages are stored.
+       */
+      static void Index(std::shared_ptr<granada::cache::CacheHandler>& cache);
+
+
       /**
        * Creates a new message associated with a user with
-       * given username.
+       * given username and adds it at the end of the user's index.
        * @param username
        * @param message  Text of the message.
+       * @return         Id (or key) of the message, a random string
+       *                 ending with the position of the message.
        */
-      void Create(const std::string username, const std::string& message);
+      std::string Create(const std::string username, const std::string& message);
 
 
       /**
@@ -69,7 +96,8 @@ namespace granada{
 
       /**
        * Deletes message with the given message id (or key) and
-       * related to a user with the given username.
+       * related to a user with the given username, and removes
+       * it from the user's index.
        * @param username
        * @param message_id
        */
@@ -77,11 +105,20 @@ namespace granada{
 
 
       /**
-       * Returns a list of user's message in form of a stringified json array.
+       * Returns a page of the user's messages, from the newest to the oldest,
+       * in form of a stringified json array.
+       * Example: [{"key":"rt5Yh3e9GqSw1Pa642","text":"Hello"}]
        * @param  username
-       * @return          Stringified json array containing the user's message.
+       * @param  cursor      Where the page starts, empty for the newest
+       *                     messages, or the next_cursor of the previous page.
+       *                     Messages created or deleted after a cursor was
+       *                     given do not change the pages that follow it.
+       * @param  limit       Maximum number of messages of the page.
+       * @param  next_cursor Set to the cursor of the next page,
+       *                     empty if there are no more messages.
+       * @return             Stringified json array containing the user's messages.
        */
-      std::string List(const std::string username);
+      std::string List(const std::string username, const std::string& cursor, const std::size_t& limit, std::string& next_cursor);
 
     private:
 
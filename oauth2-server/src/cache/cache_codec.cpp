@@ -0,0 +1,245 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Codecs compressing the values of the caches.
+  *
+  */
+
+#include "cache_codec.h"
+#include <cstring>
+#include <zlib.h>
+
+namespace granada{
+  namespace cache{
+
+    // LZ4 block format: minimum match length, the last bytes are
+    // always literals and no match starts in the last 12 bytes.
+    static const std::size_t LZ_MIN_MATCH = 4;
+    static const std::size_t LZ_LAST_LITERALS = 5;
+    static const std::size_t LZ_MATCH_LIMIT = 12;
+    static const std::size_t LZ_MAX_OFFSET = 65535;
+    static const int LZ_HASH_BITS = 12;
+    // bytes the decoder may write past a sequence, copying 8 bytes at a time.
+    static const std::size_t LZ_WILD_COPY = 16;
+
+
+    const CacheCodec::Type CacheCodec::FromName(const std::string& name){
+      if (name == "lz"){
+        return LZ;
+      }
+      if (name == "zlib"){
+        return ZLIB;
+      }
+      return NONE;
+    }
+
+
+    const bool CacheCodec::Compress(const Type& type, const std::string& value, std::string& compressed){
+      if (type == LZ){
+        LzCompress(value,compressed);
+        return true;
+      }
+      if (type == ZLIB){
+        uLongf size = compressBound(value.size());
+        const std::size_t offset = compressed.size();
+        compressed.resize(offset + size);
+        if (compress2((Bytef*)&compressed[offset], &size, (const Bytef*)value.data(), value.size(), Z_BEST_SPEED) != Z_OK){
+          compressed.resize(offset);
+          return false;
+        }
+        compressed.resize(offset + size);
+        return true;
+      }
+      return false;
+    }
+
+
+    const bool CacheCodec::Decompress(const Type& type, const char* data, const std::size_t& size, const std::size_t& length, std::string& value){
+      if (type == LZ){
+        return LzDecompress(data,size,length,value);
+      }
+      if (type == ZLIB){
+        value.resize(length);
+        uLongf value_length = length;
+        if (length > 0 && (uncompress((Bytef*)&value[0], &value_length, (const Bytef*)data, size) != Z_OK || value_length != length)){
+          value.clear();
+          return false;
+        }
+        return true;
+      }
+      return false;
+    }
+
+
+    // appends a length of 15 or more as in the LZ4
+    // format, as many 255 as needed and the rest.
+    static void LzLength(std::size_t length, std::string& compressed){
+      while (length >= 255){
+        compressed.push_back((char)255);
+        length -= 255;
+      }
+      compressed.push_back((char)length);
+    }
+
+
+    static void LzSequence(const char* literals, const std::size_t& literal_length, const std::size_t& offset, const std::size_t& match_length, std::string& compressed){
+      const std::size_t match_code = match_length >= LZ_MIN_MATCH ? match_length - LZ_MIN_MATCH : 0;
+      unsigned char token = (unsigned char)((literal_length < 15 ? literal_length : 15) << 4);
+      if (match_length > 0){
+        token |= (unsigned char)(match_code < 15 ? match_code : 15);
+      }
+      compressed.push_back((char)token);
+      if (literal_length >= 15){
+        LzLength(literal_length - 15, compressed);
+      }
+      compressed.append(literals, literal_length);
+      if (match_length > 0){
+        compressed.push_back((char)(offset & 0xFF));
+        compressed.push_back((char)(offset >> 8));
+        if (match_code >= 15){
+          LzLength(match_code - 15, compressed);
+        }
+      }
+    }
+
+
+    void CacheCodec::LzCompress(const std::string& value, std::string& compressed){
+      const char* data = value.data();
+      const std::size_t size = value.size();
+      std::size_t anchor = 0;
+      if (size > LZ_MATCH_LIMIT){
+        // last position of each hash of 4 bytes, plus one so 0 is empty.
+        unsigned int table[1 << LZ_HASH_BITS];
+        std::memset(table, 0, sizeof(table));
+        const std::size_t limit = size - LZ_MATCH_LIMIT;
+        std::size_t position = 0;
+        while (position < limit){
+          unsigned int sequence;
+          std::memcpy(&sequence, data + position, 4);
+          const unsigned int hash = (sequence * 2654435761U) >> (32 - LZ_HASH_BITS);
+          const std::size_t candidate = table[hash];
+          table[hash] = (unsigned int)position + 1;
+          if (candidate > 0 && position - (candidate - 1) <= LZ_MAX_OFFSET && std::memcmp(data + candidate - 1, data + position, 4) == 0){
+            std::size_t match = candidate - 1;
+
+            // extend the match forward, but not into the last literals.
+            std::size_t match_length = LZ_MIN_MATCH;
+            const std::size_t max_length = size - LZ_LAST_LITERALS - position;
+            while (match_length < max_length && data[match + match_length] == data[position + match_length]){
+              ++match_length;
+            }
+            // and backward over the pending literals.
+            while (position > anchor && match > 0 && data[match - 1] == data[position - 1]){
+              --match;
+              --position;
+              ++match_length;
+            }
+            LzSequence(data + anchor, position - anchor, position - match, match_length, compressed);
+            position += match_length;
+            anchor = position;
+          }else{
+            ++position;
+          }
+        }
+      }
+      // the rest as literals.
+      LzSequence(data + anchor, size - anchor, 0, 0, compressed);
+    }
+
+
+    const bool CacheCodec::LzDecompress(const char* data, const std::size_t& size, const std::size_t& length, std::string& value){
+      value.resize(length + LZ_WILD_COPY);
+      char* output = &value[0];
+      const unsigned char* input = (const unsigned char*)data;
+      std::size_t position = 0;
+      std::size_t written = 0;
+      while (position < size){
+        const unsigned char token = input[position++];
+
+        // literals.
+        std::size_t literal_length = token >> 4;
+        if (literal_length == 15){
+          unsigned char byte;
+          do{
+            if (position >= size){
+              return false;
+            }
+            byte = input[position++];
+            literal_length += byte;
+          }while (byte == 255);
+        }
+        if (literal_length > size - position || literal_length > length - written){
+          return false;
+        }
+        if (literal_length <= LZ_WILD_COPY && size - position >= LZ_WILD_COPY){
+          std::memcpy(output + written, data + position, LZ_WILD_COPY);
+        }else{
+          std::memcpy(output + written, data + position, literal_length);
+        }
+        written += literal_length;
+        position += literal_length;
+        if (position == size){
+          // the last sequence has no match.
+          break;
+        }
+
+        // match.
+        if (size - position < 2){
+          return false;
+        }
+        const std::size_t offset = input[position] | (input[position + 1] << 8);
+        position += 2;
+        std::size_t match_length = (token & 0x0F);
+        if (match_length == 15){
+          unsigned char byte;
+          do{
+            if (position >= size){
+              return false;
+            }
+            byte = input[position++];
+            match_length += byte;
+          }while (byte == 255);
+        }
+        match_length += LZ_MIN_MATCH;
+        if (offset == 0 || offset > written || match_length > length - written){
+          return false;
+        }
+        const char* from = output + written - offset;
+        if (offset >= 8){
+          // each 8 bytes copied are before the ones written.
+          for (std::size_t i = 0; i < match_length; i += 8){
+            std::memcpy(output + written + i, from + i, 8);
+          }
+        }else{
+          // the match overlaps the bytes it writes, repeating them.
+          for (std::size_t i = 0; i < match_length; ++i){
+            output[written + i] = from[i];
+          }
+        }
+        written += match_length;
+      }
+      value.resize(length);
+      return written == length;
+    }
+  }
+}
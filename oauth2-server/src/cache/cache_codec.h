@@ -0,0 +1,92 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Codecs compressing the values of the caches.
+  *
+  */
+
+#pragma once
+#include <string>
+
+namespace granada{
+  namespace cache{
+
+    /**
+     * Codecs compressing the values of the caches.
+     *
+     * "lz": LZ4 block format, values about 40% larger than with zlib
+     *       but compressed and decompressed several times faster.
+     * "zlib": deflate, smaller values at a higher CPU cost.
+     */
+    class CacheCodec{
+
+      public:
+
+        /**
+         * Codecs.
+         */
+        enum Type{
+          NONE,
+          LZ,
+          ZLIB
+        };
+
+
+        /**
+         * Returns the codec with the given name, NONE if unknown.
+         * @param name  "lz" or "zlib".
+         */
+        static const Type FromName(const std::string& name);
+
+
+        /**
+         * Compresses a value.
+         * @param type        Codec.
+         * @param value       Value to compress.
+         * @param compressed  String where the compressed value is appended.
+         * @return            True if the value could be compressed.
+         */
+        static const bool Compress(const Type& type, const std::string& value, std::string& compressed);
+
+
+        /**
+         * Decompresses a value.
+         * @param type          Codec.
+         * @param data          Compressed value.
+         * @param size          Size of the compressed value.
+         * @param length        Length of the value before it was compressed.
+         * @param value         String where the value is written.
+         * @return              True if the value could be decompressed,
+         *                      false if the data is not valid.
+         */
+        static const bool Decompress(const Type& type, const char* data, const std::size_t& size, const std::size_t& length, std::string& value);
+
+
+      private:
+
+        static void LzCompress(const std::string& value, std::string& compressed);
+
+        static const bool LzDecompress(const char* data, const std::size_t& size, const std::size_t& length, std::string& value);
+    };
+  }
+}
@@ -26,15 +26,90 @@
   *
   */
 #pragma once
+#include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
+#include "pplx/pplxtasks.h"
 #include "util/memory.h"
+#include "cache_key.h"
+#include "token_bucket.h"
 
 namespace granada{
   namespace cache{
 
+    /**
+     * Change of a key notified to the subscribers of a cache.
+     */
+    struct CacheEvent{
+
+      /**
+       * Kind of change.
+       * WRITE:   the key or one of its values has been written or removed.
+       * DESTROY: the key has been destroyed.
+       * EXPIRE:  the key has been removed by the cache, because its
+       *          time to live was over or to free memory.
+       * RENAME:  the key has been renamed, notified for the old
+       *          and for the new key.
+       */
+      enum Type{
+        WRITE,
+        DESTROY,
+        EXPIRE,
+        RENAME
+      };
+
+      /**
+       * Kind of change.
+       */
+      Type type;
+
+      /**
+       * Changed key.
+       */
+      std::string key;
+    };
+
+
+    /**
+     * Function called with the changes of the keys a subscriber
+     * is interested in.
+     */
+    typedef std::function<void(const granada::cache::CacheEvent& event)> CacheSubscriber;
+
+
+    /**
+     * Work done by the caches in a thread. Drivers add to the
+     * counters of the current thread, so the work of an operation
+     * is the difference of the counters before and after it.
+     */
+    struct CacheThreadCounters{
+
+      /**
+       * Nanoseconds spent waiting for the locks of the caches.
+       */
+      unsigned long long lock_wait_ns = 0;
+
+      /**
+       * Keys visited to find the keys matching an expression.
+       */
+      unsigned long long keys_scanned = 0;
+    };
+
+
+    /**
+     * Returns the counters of the current thread.
+     */
+    inline granada::cache::CacheThreadCounters& ThreadCounters(){
+      thread_local granada::cache::CacheThreadCounters counters;
+      return counters;
+    }
+
+
     /**
      * Interface. Iterates over cache keys.
      */
@@ -177,6 +252,41 @@ namespace granada{
         virtual const std::string Read(const std::string& hash, const std::string& key) = 0;
 
 
+        /**
+         * Fills a map with all the key-value pairs stored in a set.
+         * The keys of a set cannot be listed with the other operations,
+         * so by default it throws std::logic_error, drivers override it.
+         * @param  hash   Name of the set where the key-value pairs are stored.
+         * @param  values Map filled with the key-value pairs of the set.
+         * @return        True if the set exists, false if it does not.
+         */
+        virtual const bool ReadAll(const std::string& hash, std::map<std::string,std::string>& values){
+          throw std::logic_error("ReadAll is not supported by this cache");
+        };
+
+
+        /**
+         * Returns the values stored in a set and associated with the given keys
+         * with one operation, instead of one Read per key.
+         * By default the set is read with Exists and one Read per key.
+         * @param  hash   Name of the set where the key-value pairs are stored.
+         * @param  keys   Keys associated with the values.
+         * @param  values Vector filled with the value of each key, in the same
+         *                order, empty string if a key does not exist.
+         * @return        True if the set exists, false if it does not.
+         */
+        virtual const bool ReadMany(const std::string& hash, const std::vector<std::string>& keys, std::vector<std::string>& values){
+          values.clear();
+          if (!Exists(hash)){
+            return false;
+          }
+          for (auto it = keys.begin(); it != keys.end(); ++it){
+            values.push_back(Read(hash,*it));
+          }
+          return true;
+        };
+
+
         /**
          * Fills a vector of strings with the the keys that match an expression.
          * 
@@ -208,6 +318,19 @@ namespace granada{
         virtual void Write(const std::string& key,const std::string& value) = 0;
 
 
+        /**
+         * Sets a value in the cache associated with a given key.
+         * The value is moved into the cache when the driver supports it,
+         * by default it is copied.
+         * @param key   Key of the value.
+         * @param value Value.
+         */
+        virtual void Write(const std::string& key,std::string&& value){
+          const std::string& value_ref = value;
+          Write(key,value_ref);
+        };
+
+
         /**
          * Inserts or rewrite a key-value pair in a set with the given name.
          * If the set does not exist, it creates it.
@@ -218,6 +341,153 @@ namespace granada{
         virtual void Write(const std::string& hash,const std::string& key,const std::string& value) = 0;
 
 
+        /**
+         * Inserts or rewrite a key-value pair in a set with the given name.
+         * If the set does not exist, it creates it.
+         * The value is moved into the cache when the driver supports it,
+         * by default it is copied.
+         * @param hash  Name of the set.
+         * @param key   Key to identify the value inside the set.
+         * @param value Value
+         */
+        virtual void Write(const std::string& hash,const std::string& key,std::string&& value){
+          const std::string& value_ref = value;
+          Write(hash,key,value_ref);
+        };
+
+
+        /**
+         * Inserts or rewrite several key-value pairs in a set with the given name
+         * with one operation. If the set does not exist, it creates it.
+         * By default each pair is written with Write.
+         * @param hash    Name of the set.
+         * @param values  Key-value pairs.
+         */
+        virtual void WriteMany(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values){
+          for (auto it = values.begin(); it != values.end(); ++it){
+            Write(hash,it->first,it->second);
+          }
+        };
+
+
+        // Conditional writes. The check and the write are done as one
+        // atomic operation by each driver, so two threads or two processes
+        // creating the same key cannot both succeed. By default they are
+        // made of a read and a write, which is not atomic.
+
+
+        /**
+         * Sets a value associated with a given key only if the
+         * key does not exist.
+         * @param key   Key of the value.
+         * @param value Value.
+         * @return      True if the value has been written, false if
+         *              the key already exists.
+         */
+        virtual const bool WriteIfNotExists(const std::string& key,const std::string& value){
+          if (Exists(key)){
+            return false;
+          }
+          Write(key,value);
+          return true;
+        };
+
+
+        /**
+         * Inserts a key-value pair in a set only if the key does not
+         * exist in the set. If the set does not exist, it creates it.
+         * @param hash  Name of the set.
+         * @param key   Key to identify the value inside the set.
+         * @param value Value
+         * @return      True if the value has been written, false if
+         *              the key already exists in the set.
+         */
+        virtual const bool WriteIfNotExists(const std::string& hash,const std::string& key,const std::string& value){
+          if (Exists(hash,key)){
+            return false;
+          }
+          Write(hash,key,value);
+          return true;
+        };
+
+
+        /**
+         * Replaces the value of a key in a set only if its current
+         * value is the expected one. A key that does not exist has
+         * an empty value, as with Read.
+         * @param hash      Name of the set.
+         * @param key       Key to identify the value inside the set.
+         * @param expected  Expected current value.
+         * @param value     New value.
+         * @return          True if the value has been replaced, false
+         *                  if the current value is not the expected one.
+         */
+        virtual const bool CompareAndSet(const std::string& hash,const std::string& key,const std::string& expected,const std::string& value){
+          if (Read(hash,key) != expected){
+            return false;
+          }
+          Write(hash,key,value);
+          return true;
+        };
+
+
+        /**
+         * Adds a number to the integer value of a key. A key that does
+         * not exist counts as 0. A key holding a set is left as it is
+         * and 0 is returned, as Redis refuses to increment it.
+         * @param key       Key of the value.
+         * @param increment Number to add, may be negative.
+         * @return          Value after the increment.
+         */
+        virtual const long long Increment(const std::string& key,const long long& increment){
+          const long long value = ToInteger(Read(key)) + increment;
+          Write(key,std::to_string(value));
+          return value;
+        };
+
+
+        /**
+         * Adds a number to the integer value of a key in a set. A key
+         * that does not exist counts as 0. If the set does not exist,
+         * it creates it. A set name holding a plain value is left as
+         * it is and 0 is returned, as Redis refuses to increment it.
+         * @param hash      Name of the set.
+         * @param key       Key to identify the value inside the set.
+         * @param increment Number to add, may be negative.
+         * @return          Value after the increment.
+         */
+        virtual const long long Increment(const std::string& hash,const std::string& key,const long long& increment){
+          const long long value = ToInteger(Read(hash,key)) + increment;
+          Write(hash,key,std::to_string(value));
+          return value;
+        };
+
+
+        /**
+         * Subtracts a number from the integer value of a key. A key
+         * that does not exist counts as 0.
+         * @param key       Key of the value.
+         * @param decrement Number to subtract.
+         * @return          Value after the decrement.
+         */
+        const long long Decrement(const std::string& key,const long long& decrement){
+          return Increment(key,-decrement);
+        };
+
+
+        /**
+         * Subtracts a number from the integer value of a key in a set.
+         * A key that does not exist counts as 0.
+         * @param hash      Name of the set.
+         * @param key       Key to identify the value inside the set.
+         * @param decrement Number to subtract.
+         * @return          Value after the decrement.
+         */
+        const long long Decrement(const std::string& hash,const std::string& key,const long long& decrement){
+          return Increment(hash,key,-decrement);
+        };
+
+
         /**
          * Removes a key-value pair from the cache.
          * @param key
@@ -233,6 +503,26 @@ namespace granada{
         virtual void Destroy(const std::string& hash,const std::string& key) = 0;
 
 
+        /**
+         * Destroys all the keys matching an expression.
+         * By default the matching keys are destroyed one by one,
+         * drivers able to do it in one pass override it.
+         *
+         * @param expression  Expression, as in Match.
+         *                      Example:
+         *                          session:roles:GHs98Ev4GLkqw32g8:*
+         * @return            Number of keys destroyed.
+         */
+        virtual const std::size_t DestroyMatch(const std::string& expression){
+          std::vector<std::string> keys;
+          Match(expression,keys);
+          for (auto it = keys.begin(); it != keys.end(); ++it){
+            Destroy(*it);
+          }
+          return keys.size();
+        };
+
+
         /**
          * Renames a key if it does not already exists.
          * 
@@ -246,11 +536,476 @@ namespace granada{
         virtual bool Rename(const std::string& old_key, const std::string& new_key) = 0;
 
 
+        /**
+         * Returns true if the cache removes the keys by itself
+         * when their time to live is over, false if Expire
+         * is not supported.
+         * @return  True if keys can expire.
+         */
+        virtual const bool SupportsExpire(){
+          return false;
+        };
+
+
+        /**
+         * Sets the time to live of a key, once it is over the key
+         * and all its values are removed. Writing the key with
+         * Write(key,value) removes its time to live, writing a value
+         * of a set does not.
+         * By default keys never expire.
+         * 
+         * @param key     Key.
+         * @param seconds Seconds the key will live from now,
+         *                -1 to remove the time to live of the key.
+         * @return        True if the time to live was set, false if the
+         *                key does not exist or expiration is not supported.
+         */
+        virtual const bool Expire(const std::string& key, const long long& seconds){
+          return false;
+        };
+
+
+        /**
+         * Returns the remaining time to live of a key.
+         * 
+         * @param key Key.
+         * @return    Remaining seconds, -1 if the key exists but
+         *            does not expire, -2 if the key does not exist.
+         */
+        virtual const long long TTL(const std::string& key){
+          if (Exists(key)){
+            return -1;
+          }
+          return -2;
+        };
+
+
+        /**
+         * Sets a value in the cache associated with a given key
+         * and sets the time to live of the key.
+         * @param key     Key of the value.
+         * @param value   Value.
+         * @param seconds Seconds the key will live from now.
+         */
+        virtual void WriteWithTTL(const std::string& key,const std::string& value,const long long& seconds){
+          Write(key,value);
+          Expire(key,seconds);
+        };
+
+
+        /**
+         * Inserts or rewrite a key-value pair in a set with the given name
+         * and sets the time to live of the whole set.
+         * @param hash    Name of the set.
+         * @param key     Key to identify the value inside the set.
+         * @param value   Value
+         * @param seconds Seconds the set will live from now.
+         */
+        virtual void WriteWithTTL(const std::string& hash,const std::string& key,const std::string& value,const long long& seconds){
+          Write(hash,key,value);
+          Expire(hash,seconds);
+        };
+
+
+        /**
+         * Inserts or rewrite several key-value pairs in a set with the given name
+         * and sets the time to live of the whole set, with one operation.
+         * @param hash    Name of the set.
+         * @param values  Key-value pairs.
+         * @param seconds Seconds the set will live from now.
+         */
+        virtual void WriteManyWithTTL(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values,const long long& seconds){
+          WriteMany(hash,values);
+          Expire(hash,seconds);
+        };
+
+
+        /**
+         * Adds a number to the integer value of a key and sets its
+         * time to live if it has none, so a counter lives a fixed
+         * window from its first increment. Used to count operations
+         * in a time window.
+         * By default the key is incremented and then its time to live
+         * set, drivers able to do it in one step override it.
+         * @param key       Key of the value.
+         * @param increment Number to add, may be negative.
+         * @param seconds   Seconds the key will live from its first increment.
+         * @return          Value after the increment.
+         */
+        virtual const long long IncrementWithTTL(const std::string& key,const long long& increment,const long long& seconds){
+          const long long value = Increment(key,increment);
+          if (TTL(key) == -1){
+            Expire(key,seconds);
+          }
+          return value;
+        };
+
+
+        /**
+         * Subtracts a number from the integer value of a key and sets
+         * its time to live if it has none, as IncrementWithTTL.
+         * @param key       Key of the value.
+         * @param decrement Number to subtract.
+         * @param seconds   Seconds the key will live from its first decrement.
+         * @return          Value after the decrement.
+         */
+        const long long DecrementWithTTL(const std::string& key,const long long& decrement,const long long& seconds){
+          return IncrementWithTTL(key,-decrement,seconds);
+        };
+
+
+        /**
+         * Takes tokens from the token bucket stored in a key if it has
+         * enough of them, see TokenBucket. A bucket that does not
+         * exist is full, the key expires once the bucket is full
+         * again. Used to limit the rate of operations.
+         * By default the bucket is read and replaced with CompareAndSet
+         * until no other caller changed it in between, drivers able
+         * to do it in one step override it.
+         * @param key       Key of the bucket.
+         * @param tokens    Number of tokens to take.
+         * @param capacity  Maximum number of tokens of the bucket.
+         * @param rate      Tokens added to the bucket per second.
+         * @return          Number of tokens left, -1 if the bucket
+         *                  did not have enough tokens, then none is taken.
+         */
+        virtual const long long TakeTokens(const std::string& key,const long long& tokens,const long long& capacity,const double& rate){
+          const long long now = granada::cache::TokenBucket::Now();
+          long long seconds;
+          for (;;){
+            const std::string current = Read(key,granada::cache::TokenBucket::FIELD);
+            std::string state(current);
+            const long long left = granada::cache::TokenBucket::Take(state,tokens,capacity,rate,now,seconds);
+            if (left < 0){
+              return -1;
+            }
+            if (CompareAndSet(key,granada::cache::TokenBucket::FIELD,current,state)){
+              if (seconds > -1){
+                Expire(key,seconds);
+              }
+              return left;
+            }
+          }
+        };
+
+
         /**
          * Returns an iterator to iterate over keys with an expression.
          */
         virtual std::unique_ptr<granada::cache::CacheHandlerIterator> make_iterator(const std::string& expression) = 0;
-        
+
+
+        /**
+         * Calls the given function with the changes of the keys matching
+         * an expression. Functions are called in order from a thread of
+         * the cache, never while a lock of the cache is held, so they can
+         * use the cache. Slow functions delay the other subscribers.
+         * By default subscriptions are not supported.
+         *
+         * @param expression  Expression, as in Match.
+         *                      Example: session:roles:*
+         * @param subscriber  Function called with each change.
+         * @return            Identifier of the subscription, to pass to
+         *                    Unsubscribe, 0 if subscriptions are not supported.
+         */
+        virtual const std::size_t Subscribe(const std::string& expression, const granada::cache::CacheSubscriber& subscriber){
+          return 0;
+        };
+
+
+        /**
+         * Cancels a subscription. Once it returns the function
+         * of the subscription is not being called and will not be
+         * called again.
+         * @param subscription  Identifier returned by Subscribe.
+         */
+        virtual void Unsubscribe(const std::size_t& subscription){};
+
+
+        // Operations with keys made of a namespace and parts, see CacheKey.
+        // The key is rendered in a buffer of the thread and the operation
+        // with the rendered key is called, so building the key at the call
+        // site does not allocate a string for each call.
+
+
+        const bool Exists(const granada::cache::CacheKey& key){
+          granada::cache::CacheKeyBuffer buffer(key);
+          return Exists(buffer.str());
+        };
+
+
+        const bool Exists(const granada::cache::CacheKey& hash,const std::string& key){
+          granada::cache::CacheKeyBuffer buffer(hash);
+          return Exists(buffer.str(),key);
+        };
+
+
+        const std::string Read(const granada::cache::CacheKey& key){
+          granada::cache::CacheKeyBuffer buffer(key);
+          return Read(buffer.str());
+        };
+
+
+        const std::string Read(const granada::cache::CacheKey& hash,const std::string& key){
+          granada::cache::CacheKeyBuffer buffer(hash);
+          return Read(buffer.str(),key);
+        };
+
+
+        const bool ReadAll(const granada::cache::CacheKey& hash, std::map<std::string,std::string>& values){
+          granada::cache::CacheKeyBuffer buffer(hash);
+          return ReadAll(buffer.str(),values);
+        };
+
+
+        const bool ReadMany(const granada::cache::CacheKey& hash, const std::vector<std::string>& keys, std::vector<std::string>& values){
+          granada::cache::CacheKeyBuffer buffer(hash);
+          return ReadMany(buffer.str(),keys,values);
+        };
+
+
+        void Write(const granada::cache::CacheKey& key,const std::string& value){
+          granada::cache::CacheKeyBuffer buffer(key);
+          Write(buffer.str(),value);
+        };
+
+
+        void Write(const granada::cache::CacheKey& hash,const std::string& key,const std::string& value){
+          granada::cache::CacheKeyBuffer buffer(hash);
+          Write(buffer.str(),key,value);
+        };
+
+
+        void WriteMany(const granada::cache::CacheKey& hash,const std::vector<std::pair<std::string,std::string>>& values){
+          granada::cache::CacheKeyBuffer buffer(hash);
+          WriteMany(buffer.str(),values);
+        };
+
+
+        const bool WriteIfNotExists(const granada::cache::CacheKey& key,const std::string& value){
+          granada::cache::CacheKeyBuffer buffer(key);
+          return WriteIfNotExists(buffer.str(),value);
+        };
+
+
+        const bool WriteIfNotExists(const granada::cache::CacheKey& hash,const std::string& key,const std::string& value){
+          granada::cache::CacheKeyBuffer buffer(hash);
+          return WriteIfNotExists(buffer.str(),key,value);
+        };
+
+
+        const bool CompareAndSet(const granada::cache::CacheKey& hash,const std::string& key,const std::string& expected,const std::string& value){
+          granada::cache::CacheKeyBuffer buffer(hash);
+          return CompareAndSet(buffer.str(),key,expected,value);
+        };
+
+
+        const long long Increment(const granada::cache::CacheKey& hash,const std::string& key,const long long& increment){
+          granada::cache::CacheKeyBuffer buffer(hash);
+          return Increment(buffer.str(),key,increment);
+        };
+
+
+        void Destroy(const granada::cache::CacheKey& key){
+          granada::cache::CacheKeyBuffer buffer(key);
+          Destroy(buffer.str());
+        };
+
+
+        void Destroy(const granada::cache::CacheKey& hash,const std::string& key){
+          granada::cache::CacheKeyBuffer buffer(hash);
+          Destroy(buffer.str(),key);
+        };
+
+
+        const std::size_t DestroyMatch(const granada::cache::CacheKey& expression){
+          granada::cache::CacheKeyBuffer buffer(expression);
+          return DestroyMatch(buffer.str());
+        };
+
+
+        const bool Expire(const granada::cache::CacheKey& key, const long long& seconds){
+          granada::cache::CacheKeyBuffer buffer(key);
+          return Expire(buffer.str(),seconds);
+        };
+
+
+        void WriteWithTTL(const granada::cache::CacheKey& hash,const std::string& key,const std::string& value,const long long& seconds){
+          granada::cache::CacheKeyBuffer buffer(hash);
+          WriteWithTTL(buffer.str(),key,value,seconds);
+        };
+
+
+        void WriteManyWithTTL(const granada::cache::CacheKey& hash,const std::vector<std::pair<std::string,std::string>>& values,const long long& seconds){
+          granada::cache::CacheKeyBuffer buffer(hash);
+          WriteManyWithTTL(buffer.str(),values,seconds);
+        };
+
+
+        const long long IncrementWithTTL(const granada::cache::CacheKey& key,const long long& increment,const long long& seconds){
+          granada::cache::CacheKeyBuffer buffer(key);
+          return IncrementWithTTL(buffer.str(),increment,seconds);
+        };
+
+
+        const long long TakeTokens(const granada::cache::CacheKey& key,const long long& tokens,const long long& capacity,const double& rate){
+          granada::cache::CacheKeyBuffer buffer(key);
+          return TakeTokens(buffer.str(),tokens,capacity,rate);
+        };
+
+
+        std::unique_ptr<granada::cache::CacheHandlerIterator> make_iterator(const granada::cache::CacheKey& expression){
+          granada::cache::CacheKeyBuffer buffer(expression);
+          return make_iterator(buffer.str());
+        };
+
+
+        pplx::task<std::string> ReadAsync(const granada::cache::CacheKey& hash,const std::string& key){
+          granada::cache::CacheKeyBuffer buffer(hash);
+          return ReadAsync(buffer.str(),key);
+        };
+
+
+        pplx::task<std::vector<std::string>> ReadManyAsync(const granada::cache::CacheKey& hash,const std::vector<std::string>& keys){
+          granada::cache::CacheKeyBuffer buffer(hash);
+          return ReadManyAsync(buffer.str(),keys);
+        };
+
+
+        // Asynchronous versions of the cache operations, so the threads
+        // answering HTTP requests do not wait for a remote cache.
+        // By default the synchronous operation is run in a task of the
+        // pplx thread pool. Drivers that answer without waiting for I/O
+        // return an already completed task instead.
+        // The cache has to outlive the returned tasks.
+
+
+        /**
+         * Returns a task with true if the key exists, false if it does not.
+         * @param  key Key.
+         * @return     Task with the result of Exists.
+         */
+        virtual pplx::task<bool> ExistsAsync(const std::string& key){
+          return pplx::create_task([this,key]{
+            return (bool)Exists(key);
+          });
+        };
+
+
+        /**
+         * Returns a task with true if a key exists in a set with
+         * the given hash, false if it does not.
+         * @param  hash Name of the set of key-value.
+         * @param  key  Key of the value
+         * @return      Task with the result of Exists.
+         */
+        virtual pplx::task<bool> ExistsAsync(const std::string& hash,const std::string& key){
+          return pplx::create_task([this,hash,key]{
+            return (bool)Exists(hash,key);
+          });
+        };
+
+
+        /**
+         * Returns a task with the value associated with the given key.
+         * @param  key Key of the value.
+         * @return     Task with the value.
+         */
+        virtual pplx::task<std::string> ReadAsync(const std::string& key){
+          return pplx::create_task([this,key]{
+            return std::string(Read(key));
+          });
+        };
+
+
+        /**
+         * Returns a task with the value stored in a set and
+         * associated with the given key.
+         * @param  hash Name of the set where the key-value pairs are stored.
+         * @param  key  Key associated with the value.
+         * @return      Task with the value.
+         */
+        virtual pplx::task<std::string> ReadAsync(const std::string& hash,const std::string& key){
+          return pplx::create_task([this,hash,key]{
+            return std::string(Read(hash,key));
+          });
+        };
+
+
+        /**
+         * Returns a task with the values stored in a set and associated
+         * with the given keys, see ReadMany.
+         * @param  hash Name of the set where the key-value pairs are stored.
+         * @param  keys Keys associated with the values.
+         * @return      Task with the value of each key, in the same order,
+         *              empty vector if the set does not exist.
+         */
+        virtual pplx::task<std::vector<std::string>> ReadManyAsync(const std::string& hash,const std::vector<std::string>& keys){
+          return pplx::create_task([this,hash,keys]{
+            std::vector<std::string> values;
+            ReadMany(hash,keys,values);
+            return values;
+          });
+        };
+
+
+        /**
+         * Sets a value in the cache associated with a given key.
+         * @param  key   Key of the value.
+         * @param  value Value.
+         * @return       Task completed once the value is written.
+         */
+        virtual pplx::task<void> WriteAsync(const std::string& key,const std::string& value){
+          return pplx::create_task([this,key,value]{
+            Write(key,value);
+          });
+        };
+
+
+        /**
+         * Inserts or rewrite a key-value pair in a set with the given name.
+         * @param  hash  Name of the set.
+         * @param  key   Key to identify the value inside the set.
+         * @param  value Value
+         * @return       Task completed once the value is written.
+         */
+        virtual pplx::task<void> WriteAsync(const std::string& hash,const std::string& key,const std::string& value){
+          return pplx::create_task([this,hash,key,value]{
+            Write(hash,key,value);
+          });
+        };
+
+
+        /**
+         * Returns a task with the keys that match an expression.
+         * @param  expression Expression, example: session:value:*
+         * @return            Task with the keys matching the expression.
+         */
+        virtual pplx::task<std::vector<std::string>> MatchAsync(const std::string& expression){
+          return pplx::create_task([this,expression]{
+            std::vector<std::string> keys;
+            Match(expression,keys);
+            return keys;
+          });
+        };
+
+      protected:
+
+        /**
+         * Returns the integer of a value, 0 if it is empty
+         * or not an integer, used by the default Increment.
+         * @param  value Value.
+         * @return       Integer.
+         */
+        static const long long ToInteger(const std::string& value){
+          if (!value.empty()){
+            try{
+              return std::stoll(value);
+            }catch(const std::logic_error e){}
+          }
+          return 0;
+        };
+
     };
   }
 }
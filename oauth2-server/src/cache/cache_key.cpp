@@ -0,0 +1,120 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Keys of the caches made of a namespace and parts.
+  *
+  */
+
+#include "cache_key.h"
+
+namespace granada{
+  namespace cache{
+
+    // buffers of a thread lent to CacheKeyBuffer, deep enough for
+    // a driver rendering a key while a caller's key is in use.
+    static const std::size_t CACHE_KEY_BUFFERS = 4;
+
+    // buffers growing over this capacity, for an unusually long key,
+    // are released when given back.
+    static const std::size_t CACHE_KEY_BUFFER_CAPACITY = 1024;
+
+    struct CacheKeyBuffers{
+      std::string buffers[CACHE_KEY_BUFFERS];
+      std::size_t used = 0;
+    };
+
+    static CacheKeyBuffers& cache_key_buffers(){
+      thread_local CacheKeyBuffers buffers;
+      return buffers;
+    }
+
+
+    const std::size_t CacheKey::length() const {
+      std::size_t length = 0;
+      for (std::size_t i = 0; i < size_; ++i){
+        length += parts_[i].length();
+      }
+      // separators between the parts, not after the namespace.
+      return size_ > 2 ? length + size_ - 2 : length;
+    }
+
+
+    void CacheKey::AppendTo(std::string& key) const {
+      key.reserve(key.length() + length());
+      for (std::size_t i = 0; i < size_; ++i){
+        if (i > 1){
+          key.push_back(':');
+        }
+        key.append(parts_[i].data(), parts_[i].length());
+      }
+    }
+
+
+    const std::string CacheKey::str() const {
+      std::string key;
+      AppendTo(key);
+      return key;
+    }
+
+
+    const bool CacheKey::operator==(const std::string& key) const {
+      std::size_t position = 0;
+      for (std::size_t i = 0; i < size_; ++i){
+        if (i > 1){
+          if (position >= key.length() || key[position] != ':'){
+            return false;
+          }
+          ++position;
+        }
+        if (key.compare(position, parts_[i].length(), parts_[i].data(), parts_[i].length()) != 0){
+          return false;
+        }
+        position += parts_[i].length();
+      }
+      return position == key.length();
+    }
+
+
+    CacheKeyBuffer::CacheKeyBuffer(const granada::cache::CacheKey& key){
+      CacheKeyBuffers& buffers = cache_key_buffers();
+      pooled_ = buffers.used < CACHE_KEY_BUFFERS;
+      if (pooled_){
+        buffer_ = &buffers.buffers[buffers.used++];
+        buffer_->clear();
+      }else{
+        buffer_ = &own_;
+      }
+      key.AppendTo(*buffer_);
+    }
+
+
+    CacheKeyBuffer::~CacheKeyBuffer(){
+      if (pooled_){
+        if (buffer_->capacity() > CACHE_KEY_BUFFER_CAPACITY){
+          std::string().swap(*buffer_);
+        }
+        cache_key_buffers().used--;
+      }
+    }
+  }
+}
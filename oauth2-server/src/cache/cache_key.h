@@ -0,0 +1,210 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Keys of the caches made of a namespace and parts.
+  *
+  */
+
+#pragma once
+#include <cstring>
+#include <string>
+#include <utility>
+
+namespace granada{
+  namespace cache{
+
+    /**
+     * Key of a cache made of a namespace and parts, rendered as
+     * the namespace followed by the parts separated by ":".
+     * Example: CacheKey("session:roles:", token, role_name)
+     *          => session:roles:<token>:<role_name>
+     *
+     * The key only refers to its namespace and parts, nothing is
+     * copied or allocated when it is built. The strings given have
+     * to outlive the key, so temporary strings are not accepted.
+     * Caches render the key in a buffer of the thread, see
+     * CacheKeyBuffer, so no string is built for each call.
+     */
+    class CacheKey{
+
+      public:
+
+        /**
+         * Maximum number of parts after the namespace.
+         */
+        static const std::size_t MAX_PARTS = 6;
+
+
+        /**
+         * Namespace or part of a key, refers to a string
+         * that has to outlive the key.
+         */
+        class Part{
+
+          public:
+
+            Part(const std::string& part) : data_(part.data()), length_(part.length()){};
+
+            Part(const char* part) : data_(part), length_(std::strlen(part)){};
+
+            Part(std::string&& part) = delete;
+
+            Part(const std::string&& part) = delete;
+
+            Part() : data_(""), length_(0){};
+
+            const char* data() const {
+              return data_;
+            };
+
+            const std::size_t length() const {
+              return length_;
+            };
+
+          private:
+
+            const char* data_;
+            std::size_t length_;
+        };
+
+
+        /**
+         * Constructor, empty key.
+         */
+        CacheKey() : size_(0){};
+
+
+        /**
+         * Constructor
+         * @param name_space  Namespace, example: "message:"
+         * @param parts       Parts, strings or string literals.
+         */
+        template <typename... Parts>
+        explicit CacheKey(const Part& name_space, Parts&&... parts) : size_(1 + sizeof...(Parts)){
+          static_assert(sizeof...(Parts) <= MAX_PARTS, "too many parts in a cache key");
+          const Part list[] = { name_space, Part(std::forward<Parts>(parts))... };
+          for (std::size_t i = 0; i < size_; ++i){
+            parts_[i] = list[i];
+          }
+        };
+
+
+        /**
+         * Returns the length of the rendered key.
+         */
+        const std::size_t length() const;
+
+
+        /**
+         * Appends the rendered key to a string.
+         * @param key String.
+         */
+        void AppendTo(std::string& key) const;
+
+
+        /**
+         * Returns the rendered key.
+         */
+        const std::string str() const;
+
+
+        /**
+         * Returns true if the rendered key equals the given string,
+         * without rendering it.
+         * @param key String.
+         */
+        const bool operator==(const std::string& key) const;
+
+      private:
+
+        /**
+         * Namespace and parts.
+         */
+        Part parts_[MAX_PARTS + 1];
+
+
+        /**
+         * Number of used elements of parts_.
+         */
+        std::size_t size_;
+    };
+
+
+    /**
+     * A key rendered in one of the buffers of the current thread,
+     * valid while the CacheKeyBuffer exists. The buffers keep their
+     * memory, so once a thread has rendered keys as long, rendering
+     * a key does not allocate. Buffers are only lent in order, so
+     * keys can be rendered while other keys are in use.
+     */
+    class CacheKeyBuffer{
+
+      public:
+
+        /**
+         * Constructor
+         * @param key Key to render.
+         */
+        explicit CacheKeyBuffer(const granada::cache::CacheKey& key);
+
+
+        /**
+         * Destructor
+         * Gives the buffer back to the thread.
+         */
+        ~CacheKeyBuffer();
+
+
+        CacheKeyBuffer(const CacheKeyBuffer&) = delete;
+        CacheKeyBuffer& operator=(const CacheKeyBuffer&) = delete;
+
+
+        /**
+         * Returns the rendered key.
+         */
+        const std::string& str() const {
+          return *buffer_;
+        };
+
+      private:
+
+        /**
+         * Buffer of the thread, or own_ if all the
+         * buffers of the thread are in use.
+         */
+        std::string* buffer_;
+
+
+        /**
+         * Buffer used when the thread has none available.
+         */
+        std::string own_;
+
+
+        /**
+         * True if buffer_ is a buffer of the thread.
+         */
+        bool pooled_;
+    };
+  }
+}
@@ -0,0 +1,200 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Delivers the changes of the keys of a cache to its subscribers.
+  *
+  */
+
+#include "cache_notifier.h"
+#include <chrono>
+#include <exception>
+
+namespace granada{
+  namespace cache{
+
+    CacheNotifier::CacheNotifier(){
+      stub_.next.store(nullptr,std::memory_order_relaxed);
+      head_.store(&stub_,std::memory_order_relaxed);
+      tail_ = &stub_;
+      subscriptions_ = std::make_shared<const std::vector<Subscription>>();
+      subscriptions_count_.store(0,std::memory_order_relaxed);
+      waiting_.store(false,std::memory_order_relaxed);
+    }
+
+
+    CacheNotifier::~CacheNotifier(){
+      {
+        std::lock_guard<std::mutex> lg(mtx_);
+        stop_ = true;
+      }
+      cv_.notify_one();
+      if (thread_.joinable()){
+        thread_.join();
+      }
+      Node* node;
+      while ((node = Pop()) != nullptr){
+        delete node;
+      }
+    }
+
+
+    void CacheNotifier::Publish(const granada::cache::CacheEvent::Type& type, const std::string& key){
+      if (!Subscribed()){
+        return;
+      }
+      Node* node = new Node();
+      node->event.type = type;
+      node->event.key = key;
+      Push(node);
+
+      // the thread sets waiting_ before checking the queue for
+      // the last time, so either it sees the change or it is woken up.
+      if (waiting_.load()){
+        std::lock_guard<std::mutex> lg(mtx_);
+        cv_.notify_one();
+      }
+    }
+
+
+    const std::size_t CacheNotifier::Subscribe(const std::string& expression, const granada::cache::CacheSubscriber& subscriber){
+      std::call_once(thread_flag_,[this]{
+        thread_ = std::thread([this]{
+          Deliver();
+        });
+      });
+      std::lock_guard<std::mutex> lg(subscriptions_mtx_);
+      std::shared_ptr<std::vector<Subscription>> subscriptions = std::make_shared<std::vector<Subscription>>(*subscriptions_);
+      Subscription subscription;
+      subscription.id = ++last_subscription_;
+      subscription.pattern.set(expression);
+      subscription.subscriber = subscriber;
+      subscriptions->push_back(std::move(subscription));
+      subscriptions_count_.store(subscriptions->size());
+      subscriptions_ = subscriptions;
+      return last_subscription_;
+    }
+
+
+    void CacheNotifier::Unsubscribe(const std::size_t& subscription){
+      {
+        std::lock_guard<std::mutex> lg(subscriptions_mtx_);
+        std::shared_ptr<std::vector<Subscription>> subscriptions = std::make_shared<std::vector<Subscription>>();
+        for (auto it = subscriptions_->begin(); it != subscriptions_->end(); ++it){
+          if (it->id != subscription){
+            subscriptions->push_back(*it);
+          }
+        }
+        subscriptions_count_.store(subscriptions->size());
+        subscriptions_ = subscriptions;
+      }
+
+      // wait for the subscribers being called with the old subscriptions.
+      if (std::this_thread::get_id() != thread_.get_id()){
+        std::lock_guard<std::mutex> lg(delivery_mtx_);
+      }
+    }
+
+
+    void CacheNotifier::Push(Node* node){
+      node->next.store(nullptr,std::memory_order_relaxed);
+      Node* previous = head_.exchange(node);
+      previous->next.store(node,std::memory_order_release);
+    }
+
+
+    CacheNotifier::Node* CacheNotifier::Pop(){
+      Node* tail = tail_;
+      Node* next = tail->next.load(std::memory_order_acquire);
+      if (tail == &stub_){
+        if (next == nullptr){
+          return nullptr;
+        }
+        tail_ = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+      }
+      if (next != nullptr){
+        tail_ = next;
+        return tail;
+      }
+      if (tail != head_.load()){
+        // a producer has taken the head but not linked it yet.
+        return nullptr;
+      }
+
+      // tail is the last change, the stub is pushed
+      // behind it so it can be taken.
+      Push(&stub_);
+      next = tail->next.load(std::memory_order_acquire);
+      if (next != nullptr){
+        tail_ = next;
+        return tail;
+      }
+      return nullptr;
+    }
+
+
+    const bool CacheNotifier::Empty(){
+      return tail_ == &stub_ && head_.load() == &stub_;
+    }
+
+
+    void CacheNotifier::Deliver(){
+      std::unique_lock<std::mutex> lock(mtx_);
+      while (!stop_){
+        lock.unlock();
+        {
+          // the subscriptions are taken once delivery_mtx_ is held,
+          // so Unsubscribe waits for the ones still using them.
+          std::lock_guard<std::mutex> lg(delivery_mtx_);
+          std::shared_ptr<const std::vector<Subscription>> subscriptions;
+          {
+            std::lock_guard<std::mutex> lg2(subscriptions_mtx_);
+            subscriptions = subscriptions_;
+          }
+          Node* node;
+          while ((node = Pop()) != nullptr){
+            for (auto it = subscriptions->begin(); it != subscriptions->end(); ++it){
+              if (it->pattern.Match(node->event.key)){
+                try{
+                  it->subscriber(node->event);
+                }catch(const std::exception e){}
+              }
+            }
+            delete node;
+          }
+        }
+        lock.lock();
+        if (!stop_){
+          waiting_.store(true);
+          if (Empty()){
+            // a change being linked is not lost, its producer
+            // wakes the thread up or the wait times out.
+            cv_.wait_for(lock,std::chrono::milliseconds(100));
+          }
+          waiting_.store(false);
+        }
+      }
+    }
+  }
+}
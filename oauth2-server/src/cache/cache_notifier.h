@@ -0,0 +1,244 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Delivers the changes of the keys of a cache to its subscribers.
+  *
+  */
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cache_handler.h"
+#include "cache/key_pattern.h"
+
+namespace granada{
+  namespace cache{
+
+    /**
+     * Delivers the changes of the keys of a cache to its subscribers.
+     *
+     * Drivers Publish the changes while they hold their locks, Publish
+     * only adds the change to a lock-free queue and returns. A thread
+     * of the notifier takes the changes from the queue and calls the
+     * subscribers whose expression matches the key, in the order the
+     * changes were published. The thread is started by the first
+     * subscription, until then Publish does nothing.
+     */
+    class CacheNotifier{
+
+      public:
+
+        /**
+         * Constructor
+         */
+        CacheNotifier();
+
+
+        /**
+         * Destructor
+         * Stops the thread, changes not delivered yet are discarded.
+         */
+        virtual ~CacheNotifier();
+
+
+        /**
+         * Returns true if there is at least one subscription,
+         * drivers can use it to avoid building the changes.
+         */
+        const bool Subscribed() const {
+          return subscriptions_count_.load(std::memory_order_relaxed) > 0;
+        };
+
+
+        /**
+         * Queues a change to be delivered to the subscribers.
+         * Lock-free, can be called by any thread at the same time.
+         * @param type  Kind of change.
+         * @param key   Changed key.
+         */
+        void Publish(const granada::cache::CacheEvent::Type& type, const std::string& key);
+
+
+        /**
+         * Adds a subscription.
+         * @param expression  Expression of the keys, as in Match.
+         * @param subscriber  Function called with each change.
+         * @return            Identifier of the subscription.
+         */
+        const std::size_t Subscribe(const std::string& expression, const granada::cache::CacheSubscriber& subscriber);
+
+
+        /**
+         * Removes a subscription. Once it returns the function of the
+         * subscription is not being called, unless Unsubscribe is called
+         * from the function itself, and will not be called again.
+         * @param subscription  Identifier returned by Subscribe.
+         */
+        void Unsubscribe(const std::size_t& subscription);
+
+
+      private:
+
+        /**
+         * Change in the queue.
+         */
+        struct Node{
+          std::atomic<Node*> next;
+          granada::cache::CacheEvent event;
+        };
+
+
+        /**
+         * Subscriber and the expression of the keys it wants.
+         */
+        struct Subscription{
+          std::size_t id;
+          granada::cache::KeyPattern pattern;
+          granada::cache::CacheSubscriber subscriber;
+        };
+
+
+        /**
+         * Last change published. Producers exchange it with their
+         * change and then link the previous one to it.
+         */
+        std::atomic<Node*> head_;
+
+
+        /**
+         * Next change to deliver, only used by the thread.
+         */
+        Node* tail_;
+
+
+        /**
+         * Empty change, keeps the queue linked when all the
+         * changes have been taken.
+         */
+        Node stub_;
+
+
+        /**
+         * Subscriptions, replaced as a whole when one is added
+         * or removed, so the thread delivers with a copy of the
+         * pointer and without holding subscriptions_mtx_.
+         */
+        std::shared_ptr<const std::vector<Subscription>> subscriptions_;
+
+
+        /**
+         * Number of subscriptions.
+         */
+        std::atomic<std::size_t> subscriptions_count_;
+
+
+        /**
+         * Identifier of the last subscription.
+         */
+        std::size_t last_subscription_ = 0;
+
+
+        /**
+         * Protects subscriptions_ and last_subscription_.
+         */
+        std::mutex subscriptions_mtx_;
+
+
+        /**
+         * Held by the thread while it calls the subscribers,
+         * so Unsubscribe can wait for them to finish.
+         */
+        std::mutex delivery_mtx_;
+
+
+        /**
+         * Thread delivering the changes.
+         */
+        std::thread thread_;
+
+
+        /**
+         * Used to start the thread once.
+         */
+        std::once_flag thread_flag_;
+
+
+        /**
+         * True while the thread waits for changes,
+         * producers then wake it up.
+         */
+        std::atomic<bool> waiting_;
+
+
+        /**
+         * True to stop the thread.
+         */
+        bool stop_ = false;
+
+
+        /**
+         * Protects stop_, used to wait for changes.
+         */
+        std::mutex mtx_;
+
+
+        /**
+         * Notified when a change is published while the thread waits.
+         */
+        std::condition_variable cv_;
+
+
+        /**
+         * Links a change at the end of the queue.
+         * @param node  Change.
+         */
+        void Push(Node* node);
+
+
+        /**
+         * Takes the next change from the queue, only called by the thread.
+         * @return  Change, to delete by the caller, nullptr if the queue
+         *          is empty or a producer has not finished linking its change.
+         */
+        Node* Pop();
+
+
+        /**
+         * Returns true if there are no changes in the queue,
+         * only called by the thread.
+         */
+        const bool Empty();
+
+
+        /**
+         * Loop of the thread, delivers the changes until stop_ is true.
+         */
+        void Deliver();
+    };
+  }
+}
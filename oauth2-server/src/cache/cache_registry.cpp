@@ -0,0 +1,194 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Registry of the caches of the server by namespace.
+  *
+  */
+
+#include "cache_registry.h"
+#include <algorithm>
+#include "cpprest/json.h"
+#include "util/application.h"
+#include "util/memory.h"
+#include "defaults.h"
+#include "cache/shared_map_cache_driver.h"
+#include "cache/shared_memory_cache_driver.h"
+#include "cache/redis_cache_driver.h"
+#include "cache/near_cache_driver.h"
+#include "cache/instrumented_cache_driver.h"
+#include "cache/compressed_cache_driver.h"
+
+namespace granada{
+  namespace cache{
+
+    std::shared_ptr<granada::cache::CacheHandler> CacheRegistry::Get(const std::string& name_space, const std::function<std::unique_ptr<granada::cache::CacheHandler>()>& make_default){
+      Configuration& configuration = CacheRegistry::configuration();
+      for (auto it = configuration.namespaces.begin(); it != configuration.namespaces.end(); ++it){
+        if (name_space.compare(0, it->first.length(), it->first) == 0){
+          std::shared_ptr<granada::cache::CacheHandler> driver = Driver(it->second);
+          if (driver != nullptr){
+            return driver;
+          }
+          break;
+        }
+      }
+      return std::shared_ptr<granada::cache::CacheHandler>(make_default());
+    }
+
+
+    std::shared_ptr<granada::cache::CacheHandler> CacheRegistry::Driver(const std::string& name){
+      Configuration& configuration = CacheRegistry::configuration();
+      std::lock_guard<std::mutex> lg(configuration.mtx);
+      auto it = configuration.drivers.find(name);
+      if (it != configuration.drivers.end()){
+        return it->second;
+      }
+      auto settings_it = configuration.settings.find(name);
+      if (settings_it == configuration.settings.end()){
+        return nullptr;
+      }
+      std::shared_ptr<granada::cache::CacheHandler> driver(Make(name,settings_it->second));
+      configuration.drivers.insert(std::make_pair(name,driver));
+      return driver;
+    }
+
+
+    CacheRegistry::Configuration& CacheRegistry::configuration(){
+      static Configuration configuration;
+      static std::once_flag loaded;
+      std::call_once(loaded, [](){
+        // drivers by name, example: {"hot":{"driver":"shared_map","shards":64}}
+        const std::string& drivers_str = granada::util::application::GetProperty(entity_keys::cache_registry_drivers);
+        if (!drivers_str.empty()){
+          try{
+            web::json::value drivers_json = web::json::value::parse(utility::conversions::to_string_t(drivers_str));
+            for (auto it = drivers_json.as_object().cbegin(); it != drivers_json.as_object().cend(); ++it){
+              if (it->second.is_object()){
+                std::map<std::string,std::string>& settings = configuration.settings[utility::conversions::to_utf8string(it->first)];
+                for (auto it2 = it->second.as_object().cbegin(); it2 != it->second.as_object().cend(); ++it2){
+                  // numbers and objects are kept serialized, as in the properties.
+                  settings[utility::conversions::to_utf8string(it2->first)] = it2->second.is_string() ? utility::conversions::to_utf8string(it2->second.as_string()) : utility::conversions::to_utf8string(it2->second.serialize());
+                }
+              }
+            }
+          }catch(const web::json::json_exception e){}
+        }
+
+        // driver of each namespace, example: {"session:":"hot","oauth2.":"cold"}
+        const std::string& namespaces_str = granada::util::application::GetProperty(entity_keys::cache_registry_namespaces);
+        if (!namespaces_str.empty()){
+          try{
+            web::json::value namespaces_json = web::json::value::parse(utility::conversions::to_string_t(namespaces_str));
+            for (auto it = namespaces_json.as_object().cbegin(); it != namespaces_json.as_object().cend(); ++it){
+              if (it->second.is_string()){
+                configuration.namespaces.push_back(std::make_pair(utility::conversions::to_utf8string(it->first), utility::conversions::to_utf8string(it->second.as_string())));
+              }
+            }
+          }catch(const web::json::json_exception e){}
+          std::sort(configuration.namespaces.begin(), configuration.namespaces.end(), [](const std::pair<std::string,std::string>& a, const std::pair<std::string,std::string>& b){
+            return a.first.length() > b.first.length();
+          });
+        }
+      });
+      return configuration;
+    }
+
+
+    std::unique_ptr<granada::cache::CacheHandler> CacheRegistry::Make(const std::string& name, const std::map<std::string,std::string>& settings){
+      std::unique_ptr<granada::cache::CacheHandler> driver;
+      auto it = settings.find("driver");
+      const std::string type = it == settings.end() ? "shared_map" : it->second;
+
+      if (type == "shared_memory"){
+        std::string segment = Setting(settings, "segment", entity_keys::shared_memory_cache_driver_segment);
+        if (segment.empty()){
+          segment = default_strings::shared_memory_cache_driver_segment;
+        }
+        std::size_t size = default_numbers::shared_memory_cache_driver_size;
+        try{
+          size = std::stoull(Setting(settings, "size", entity_keys::shared_memory_cache_driver_size));
+        }catch(const std::logic_error e){}
+        int shards = default_numbers::shared_map_cache_driver_shards;
+        try{
+          shards = std::stoi(Setting(settings, "shards", entity_keys::shared_map_cache_driver_shards));
+        }catch(const std::logic_error e){}
+        driver = granada::util::memory::make_unique<granada::cache::SharedMemoryCacheDriver>(segment + "." + name, size, shards);
+      }else if (type == "redis"){
+        std::string address = Setting(settings, "address", entity_keys::redis_cache_driver_address);
+        if (address.empty()){
+          address = default_strings::redis_cache_redis_address;
+        }
+        unsigned short port = (unsigned short)std::stoi(default_strings::redis_cache_redis_port);
+        try{
+          port = (unsigned short)std::stoi(Setting(settings, "port", entity_keys::redis_cache_driver_port));
+        }catch(const std::logic_error e){}
+        int connections = default_numbers::redis_cache_driver_connections;
+        try{
+          connections = std::stoi(Setting(settings, "connections", entity_keys::redis_cache_driver_connections));
+        }catch(const std::logic_error e){}
+        driver = granada::util::memory::make_unique<granada::cache::RedisCacheDriver>(address, port, connections);
+      }else{
+        driver = granada::util::memory::make_unique<granada::cache::SharedMapCacheDriver>(name, settings);
+      }
+
+      // compressed before reaching the driver, the near cache keeps the values as read.
+      it = settings.find("compression");
+      if (it != settings.end()){
+        const granada::cache::CacheCodec::Type codec = granada::cache::CacheCodec::FromName(it->second);
+        if (codec != granada::cache::CacheCodec::NONE){
+          std::size_t threshold = default_numbers::compressed_cache_driver_threshold;
+          try{
+            threshold = std::stoull(Setting(settings, "compression_threshold", entity_keys::compressed_cache_driver_threshold));
+          }catch(const std::logic_error e){}
+          driver = granada::util::memory::make_unique<granada::cache::CompressedCacheDriver>(std::move(driver), std::map<std::string,granada::cache::CacheCodec::Type>{ { "", codec } }, threshold);
+        }
+      }
+
+      it = settings.find("near");
+      if (it != settings.end() && it->second == "on"){
+        std::size_t max_keys = default_numbers::near_cache_driver_max_keys;
+        try{
+          max_keys = std::stoull(Setting(settings, "near_max_keys", entity_keys::near_cache_driver_max_keys));
+        }catch(const std::logic_error e){}
+        std::unique_ptr<granada::cache::NearCacheDriver> near_driver = granada::util::memory::make_unique<granada::cache::NearCacheDriver>(std::move(driver), max_keys);
+        near_driver->SetNamespaces(Setting(settings, "near_namespaces", entity_keys::near_cache_driver_namespaces));
+        driver = std::move(near_driver);
+      }
+
+      it = settings.find("instrumented");
+      if (it != settings.end() && it->second == "on"){
+        driver = granada::util::memory::make_unique<granada::cache::InstrumentedCacheDriver>(std::move(driver));
+      }
+      return driver;
+    }
+
+
+    const std::string CacheRegistry::Setting(const std::map<std::string,std::string>& settings, const std::string& name, const std::string& property){
+      auto it = settings.find(name);
+      if (it != settings.end()){
+        return it->second;
+      }
+      return granada::util::application::GetProperty(property);
+    }
+  }
+}
@@ -0,0 +1,150 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Registry of the caches of the server by namespace.
+  *
+  */
+
+#pragma once
+#include <string>
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include "cache_handler.h"
+
+namespace granada{
+  namespace cache{
+
+    /**
+     * Caches of the server by namespace.
+     * Named cache drivers are configured with the "cache_registry_drivers"
+     * property of the server configuration file, each one with its own
+     * settings, and namespaces are mapped to them with the
+     * "cache_registry_namespaces" property, example:
+     *
+     *   cache_registry_drivers={"hot":{"driver":"shared_map","shards":64,"eviction":{"session:":"lru"}},"cold":{"driver":"shared_map","shards":4},"remote":{"driver":"redis","near":"on"}}
+     *   cache_registry_namespaces={"session:":"hot","oauth2.":"cold","message:":"remote"}
+     *
+     * Drivers:
+     *  - "shared_map" (default): SharedMapCacheDriver, the settings are the
+     *    "shared_map_cache_driver_" properties without that prefix, as
+     *    "shards", "max_bytes", "eviction", "allocator" or "persistence_directory".
+     *    Persisted in files named as the driver.
+     *  - "shared_memory": SharedMemoryCacheDriver, settings "segment", "size" and "shards".
+     *  - "redis": RedisCacheDriver, settings "address", "port" and "connections".
+     * With "near":"on" the driver is wrapped in a NearCacheDriver,
+     * with "near_max_keys" entries, keeping the keys of the namespaces
+     * of "near_namespaces" for the milliseconds given. With "compression":"lz" or "zlib" its
+     * values of at least "compression_threshold" bytes are compressed by
+     * a CompressedCacheDriver. With "instrumented":"on" its operations
+     * are measured by an InstrumentedCacheDriver, get it with Driver to
+     * read the measures.
+     * Settings not given are taken from the properties of the driver.
+     *
+     * A driver is created the first time one of its namespaces is
+     * requested and is shared by all its namespaces. The longest
+     * configured namespace that is a prefix of the requested one is used.
+     * Namespaces not mapped to a driver get their default cache.
+     */
+    class CacheRegistry{
+
+      public:
+
+        /**
+         * Returns the cache of a namespace.
+         * @param name_space    Namespace, as "session:" or "oauth2.client:".
+         * @param make_default  Returns the cache to use if the namespace is
+         *                      not mapped to a driver, not called otherwise.
+         * @return              Cache of the namespace.
+         */
+        static std::shared_ptr<granada::cache::CacheHandler> Get(const std::string& name_space, const std::function<std::unique_ptr<granada::cache::CacheHandler>()>& make_default);
+
+
+        /**
+         * Returns a configured driver by name, creating it if it
+         * has not been created yet.
+         * @param name  Name of the driver in "cache_registry_drivers".
+         * @return      Driver or nullptr if there is no driver with that name.
+         */
+        static std::shared_ptr<granada::cache::CacheHandler> Driver(const std::string& name);
+
+
+      private:
+
+        /**
+         * Drivers and namespaces read from the server configuration file.
+         */
+        struct Configuration{
+
+          /**
+           * Settings of each driver by driver name.
+           */
+          std::map<std::string,std::map<std::string,std::string>> settings;
+
+          /**
+           * Driver name of each namespace, longest namespaces first.
+           */
+          std::vector<std::pair<std::string,std::string>> namespaces;
+
+          /**
+           * Drivers already created by name.
+           */
+          std::map<std::string,std::shared_ptr<granada::cache::CacheHandler>> drivers;
+
+          /**
+           * Mutex for thread safety.
+           */
+          std::mutex mtx;
+        };
+
+
+        /**
+         * Returns the configuration, loaded the first time.
+         * A function local static, so it can be used
+         * while static caches are initialized.
+         */
+        static Configuration& configuration();
+
+
+        /**
+         * Creates a driver.
+         * @param name      Name of the driver.
+         * @param settings  Settings of the driver.
+         * @return          Driver.
+         */
+        static std::unique_ptr<granada::cache::CacheHandler> Make(const std::string& name, const std::map<std::string,std::string>& settings);
+
+
+        /**
+         * Returns the value of a setting or of
+         * the given property if it is not set.
+         * @param settings  Settings of a driver.
+         * @param name      Name of the setting.
+         * @param property  Name of the property.
+         */
+        static const std::string Setting(const std::map<std::string,std::string>& settings, const std::string& name, const std::string& property);
+    };
+  }
+}
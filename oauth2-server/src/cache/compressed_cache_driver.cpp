@@ -0,0 +1,289 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Cache in front of another cache compressing the large values
+  * of the configured namespaces.
+  *
+  */
+
+#include "compressed_cache_driver.h"
+#include <algorithm>
+#include "util/memory.h"
+
+namespace granada{
+  namespace cache{
+
+    // stored values starting with these two bytes are followed by the
+    // codec, the length of the value in 4 bytes, little endian, and
+    // the value compressed. A value starting with them is stored with
+    // the NONE codec, so it is not taken for a compressed value.
+    static const char COMPRESSED_MAGIC[] = { '\x00', '\xC5' };
+    static const std::size_t COMPRESSED_HEADER_SIZE = 7;
+
+
+    CompressedCacheDriver::CompressedCacheDriver(std::unique_ptr<granada::cache::CacheHandler>&& cache) : CompressedCacheDriver(std::move(cache),std::map<std::string,granada::cache::CacheCodec::Type>(),default_numbers::compressed_cache_driver_threshold){
+      // codec of each namespace, example: {"message:":"lz","oauth2.user:":"zlib"}
+      const std::string& namespaces_str = granada::util::application::GetProperty(entity_keys::compressed_cache_driver_namespaces);
+      if (!namespaces_str.empty()){
+        try{
+          web::json::value namespaces_json = web::json::value::parse(utility::conversions::to_string_t(namespaces_str));
+          for (auto it = namespaces_json.as_object().cbegin(); it != namespaces_json.as_object().cend(); ++it){
+            if (it->second.is_string()){
+              namespaces_.push_back(std::make_pair(utility::conversions::to_utf8string(it->first), granada::cache::CacheCodec::FromName(utility::conversions::to_utf8string(it->second.as_string()))));
+            }
+          }
+        }catch(const web::json::json_exception e){}
+        std::sort(namespaces_.begin(), namespaces_.end(), [](const std::pair<std::string,granada::cache::CacheCodec::Type>& a, const std::pair<std::string,granada::cache::CacheCodec::Type>& b){
+          return a.first.length() > b.first.length();
+        });
+      }
+
+      const std::string& threshold_str = granada::util::application::GetProperty(entity_keys::compressed_cache_driver_threshold);
+      if (!threshold_str.empty()){
+        try{
+          threshold_ = std::stoull(threshold_str);
+        }catch(const std::logic_error e){}
+      }
+    }
+
+
+    CompressedCacheDriver::CompressedCacheDriver(std::unique_ptr<granada::cache::CacheHandler>&& cache, const std::map<std::string,granada::cache::CacheCodec::Type>& namespaces, const std::size_t& threshold) : values_(0), compressed_(0), bytes_(0), compressed_bytes_(0){
+      cache_ = std::move(cache);
+      namespaces_.assign(namespaces.begin(), namespaces.end());
+      std::sort(namespaces_.begin(), namespaces_.end(), [](const std::pair<std::string,granada::cache::CacheCodec::Type>& a, const std::pair<std::string,granada::cache::CacheCodec::Type>& b){
+        return a.first.length() > b.first.length();
+      });
+      threshold_ = threshold;
+    }
+
+
+    const granada::cache::CompressedCacheStats CompressedCacheDriver::Stats(){
+      granada::cache::CompressedCacheStats stats;
+      stats.values = values_.load(std::memory_order_relaxed);
+      stats.compressed = compressed_.load(std::memory_order_relaxed);
+      stats.bytes = bytes_.load(std::memory_order_relaxed);
+      stats.compressed_bytes = compressed_bytes_.load(std::memory_order_relaxed);
+      return stats;
+    }
+
+
+    const std::string CompressedCacheDriver::Read(const std::string& key){
+      return Decode(cache_->Read(key));
+    }
+
+
+    const std::string CompressedCacheDriver::Read(const std::string& hash, const std::string& key){
+      return Decode(cache_->Read(hash,key));
+    }
+
+
+    const bool CompressedCacheDriver::ReadAll(const std::string& hash, std::map<std::string,std::string>& values){
+      const bool exists = cache_->ReadAll(hash,values);
+      for (auto it = values.begin(); it != values.end(); ++it){
+        if (it->second.compare(0, sizeof(COMPRESSED_MAGIC), COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC)) == 0){
+          it->second = Decode(it->second);
+        }
+      }
+      return exists;
+    }
+
+
+    const bool CompressedCacheDriver::ReadMany(const std::string& hash, const std::vector<std::string>& keys, std::vector<std::string>& values){
+      const bool exists = cache_->ReadMany(hash,keys,values);
+      for (auto it = values.begin(); it != values.end(); ++it){
+        if (it->compare(0, sizeof(COMPRESSED_MAGIC), COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC)) == 0){
+          *it = Decode(*it);
+        }
+      }
+      return exists;
+    }
+
+
+    void CompressedCacheDriver::Write(const std::string& key,const std::string& value){
+      cache_->Write(key,Encode(key,value));
+    }
+
+
+    void CompressedCacheDriver::Write(const std::string& hash,const std::string& key,const std::string& value){
+      cache_->Write(hash,key,Encode(hash,value));
+    }
+
+
+    void CompressedCacheDriver::WriteMany(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values){
+      cache_->WriteMany(hash,Encode(hash,values));
+    }
+
+
+    const bool CompressedCacheDriver::WriteIfNotExists(const std::string& key,const std::string& value){
+      return cache_->WriteIfNotExists(key,Encode(key,value));
+    }
+
+
+    const bool CompressedCacheDriver::WriteIfNotExists(const std::string& hash,const std::string& key,const std::string& value){
+      return cache_->WriteIfNotExists(hash,key,Encode(hash,value));
+    }
+
+
+    const bool CompressedCacheDriver::CompareAndSet(const std::string& hash,const std::string& key,const std::string& expected,const std::string& value){
+      // the codecs always give the same bytes for the same
+      // value, so the stored value is the encoded expected one.
+      return cache_->CompareAndSet(hash,key,Encode(hash,expected),Encode(hash,value));
+    }
+
+
+    void CompressedCacheDriver::WriteWithTTL(const std::string& key,const std::string& value,const long long& seconds){
+      cache_->WriteWithTTL(key,Encode(key,value),seconds);
+    }
+
+
+    void CompressedCacheDriver::WriteWithTTL(const std::string& hash,const std::string& key,const std::string& value,const long long& seconds){
+      cache_->WriteWithTTL(hash,key,Encode(hash,value),seconds);
+    }
+
+
+    void CompressedCacheDriver::WriteManyWithTTL(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values,const long long& seconds){
+      cache_->WriteManyWithTTL(hash,Encode(hash,values),seconds);
+    }
+
+
+    pplx::task<std::string> CompressedCacheDriver::ReadAsync(const std::string& key){
+      return cache_->ReadAsync(key).then([](const std::string& stored){
+        return std::string(Decode(stored));
+      });
+    }
+
+
+    pplx::task<std::string> CompressedCacheDriver::ReadAsync(const std::string& hash,const std::string& key){
+      return cache_->ReadAsync(hash,key).then([](const std::string& stored){
+        return std::string(Decode(stored));
+      });
+    }
+
+
+    pplx::task<std::vector<std::string>> CompressedCacheDriver::ReadManyAsync(const std::string& hash,const std::vector<std::string>& keys){
+      return cache_->ReadManyAsync(hash,keys).then([](std::vector<std::string> values){
+        for (auto it = values.begin(); it != values.end(); ++it){
+          *it = Decode(*it);
+        }
+        return values;
+      });
+    }
+
+
+    pplx::task<void> CompressedCacheDriver::WriteAsync(const std::string& key,const std::string& value){
+      return cache_->WriteAsync(key,Encode(key,value));
+    }
+
+
+    pplx::task<void> CompressedCacheDriver::WriteAsync(const std::string& hash,const std::string& key,const std::string& value){
+      return cache_->WriteAsync(hash,key,Encode(hash,value));
+    }
+
+
+    const std::string CompressedCacheDriver::Encode(const std::string& key, const std::string& value){
+      const bool magic = value.compare(0, sizeof(COMPRESSED_MAGIC), COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC)) == 0;
+      if (value.length() < threshold_ && !magic){
+        return value;
+      }
+      granada::cache::CacheCodec::Type codec = Codec(key);
+      if (codec == granada::cache::CacheCodec::NONE && !magic){
+        return value;
+      }
+
+      std::string stored(COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC));
+      stored.push_back((char)codec);
+      const unsigned long long length = value.length();
+      for (int i = 0; i < 4; ++i){
+        stored.push_back((char)((length >> (8 * i)) & 0xFF));
+      }
+      if (codec != granada::cache::CacheCodec::NONE){
+        values_.fetch_add(1, std::memory_order_relaxed);
+        if (value.length() >= threshold_ && length <= 0xFFFFFFFF && granada::cache::CacheCodec::Compress(codec, value, stored) && stored.length() < value.length()){
+          compressed_.fetch_add(1, std::memory_order_relaxed);
+          bytes_.fetch_add(value.length(), std::memory_order_relaxed);
+          compressed_bytes_.fetch_add(stored.length(), std::memory_order_relaxed);
+          return stored;
+        }
+        if (!magic){
+          // compressing does not make it smaller.
+          return value;
+        }
+        stored[sizeof(COMPRESSED_MAGIC)] = (char)granada::cache::CacheCodec::NONE;
+        stored.resize(COMPRESSED_HEADER_SIZE);
+      }
+      stored.append(value);
+      return stored;
+    }
+
+
+    const std::string CompressedCacheDriver::Decode(const std::string& stored){
+      if (stored.compare(0, sizeof(COMPRESSED_MAGIC), COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC)) != 0){
+        return stored;
+      }
+      if (stored.length() < COMPRESSED_HEADER_SIZE){
+        return std::string();
+      }
+      const granada::cache::CacheCodec::Type codec = (granada::cache::CacheCodec::Type)(unsigned char)stored[sizeof(COMPRESSED_MAGIC)];
+      if (codec == granada::cache::CacheCodec::NONE){
+        return stored.substr(COMPRESSED_HEADER_SIZE);
+      }
+      std::size_t length = 0;
+      for (int i = 0; i < 4; ++i){
+        length |= (std::size_t)(unsigned char)stored[sizeof(COMPRESSED_MAGIC) + 1 + i] << (8 * i);
+      }
+      std::string value;
+      if (!granada::cache::CacheCodec::Decompress(codec, stored.data() + COMPRESSED_HEADER_SIZE, stored.length() - COMPRESSED_HEADER_SIZE, length, value)){
+        return std::string();
+      }
+      return value;
+    }
+
+
+    const granada::cache::CacheCodec::Type CompressedCacheDriver::Codec(const std::string& key){
+      for (auto it = namespaces_.begin(); it != namespaces_.end(); ++it){
+        if (key.compare(0, it->first.length(), it->first) == 0){
+          return it->second;
+        }
+      }
+      return granada::cache::CacheCodec::NONE;
+    }
+
+
+    const std::vector<std::pair<std::string,std::string>> CompressedCacheDriver::Encode(const std::string& hash, const std::vector<std::pair<std::string,std::string>>& values){
+      std::vector<std::pair<std::string,std::string>> stored;
+      stored.reserve(values.size());
+      for (auto it = values.begin(); it != values.end(); ++it){
+        stored.push_back(std::make_pair(it->first, Encode(hash,it->second)));
+      }
+      return stored;
+    }
+
+
+    std::unique_ptr<granada::cache::CacheHandler> MakeCompressedCacheDriver(std::unique_ptr<granada::cache::CacheHandler>&& cache){
+      if (!granada::util::application::GetProperty(entity_keys::compressed_cache_driver_namespaces).empty()){
+        return granada::util::memory::make_unique<granada::cache::CompressedCacheDriver>(std::move(cache));
+      }
+      return std::move(cache);
+    }
+  }
+}
@@ -0,0 +1,348 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Cache in front of another cache compressing the large values
+  * of the configured namespaces.
+  *
+  * This code is multi-thread safe.
+  *
+  */
+
+#pragma once
+#include "cache_handler.h"
+#include "cache_codec.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "util/application.h"
+#include "defaults.h"
+
+namespace granada{
+  namespace cache{
+
+    /**
+     * Statistics of a compressed cache.
+     */
+    struct CompressedCacheStats{
+
+      /**
+       * Values written in a namespace with a codec.
+       */
+      std::size_t values = 0;
+
+      /**
+       * Values stored compressed.
+       */
+      std::size_t compressed = 0;
+
+      /**
+       * Bytes of the values stored compressed, before
+       * and after being compressed.
+       */
+      std::size_t bytes = 0;
+      std::size_t compressed_bytes = 0;
+    };
+
+
+    /**
+     * Cache in front of another cache compressing the values of
+     * the configured namespaces when they are written and
+     * decompressing them when they are read, so large values,
+     * like serialized user roles or long messages, take less
+     * memory in the cache they are stored in.
+     *
+     * Only the values with at least "compressed_cache_driver_threshold"
+     * bytes are compressed, and they are only stored compressed if they
+     * are smaller once compressed. The codec of a key is the one of the
+     * longest namespace it starts with, the namespace of a value in a
+     * set is the one of the set.
+     * Example:
+     *   compressed_cache_driver_namespaces={"message:":"lz","oauth2.user:":"zlib"}
+     *
+     * Compressed values start with a header, so values written before
+     * the compression was enabled, or in another namespace, are read
+     * as they are. Values, keys and expressions of the other operations
+     * are passed unchanged: Increment and TakeTokens are not compressed
+     * as their values are always below the threshold.
+     */
+    class CompressedCacheDriver : public CacheHandler{
+
+      public:
+
+        // operations with CacheKey keys of CacheHandler, otherwise
+        // hidden by the operations of the same name of this driver.
+        using CacheHandler::Exists;
+        using CacheHandler::Read;
+        using CacheHandler::ReadAll;
+        using CacheHandler::ReadMany;
+        using CacheHandler::Write;
+        using CacheHandler::WriteMany;
+        using CacheHandler::WriteIfNotExists;
+        using CacheHandler::CompareAndSet;
+        using CacheHandler::Increment;
+        using CacheHandler::Destroy;
+        using CacheHandler::DestroyMatch;
+        using CacheHandler::Expire;
+        using CacheHandler::WriteWithTTL;
+        using CacheHandler::WriteManyWithTTL;
+        using CacheHandler::IncrementWithTTL;
+        using CacheHandler::TakeTokens;
+        using CacheHandler::make_iterator;
+        using CacheHandler::ReadAsync;
+        using CacheHandler::ReadManyAsync;
+
+
+        /**
+         * Constructor
+         * Takes the codec of each namespace and the threshold
+         * from the server configuration file.
+         * @param cache Cache storing the values.
+         */
+        CompressedCacheDriver(std::unique_ptr<granada::cache::CacheHandler>&& cache);
+
+
+        /**
+         * Constructor
+         * @param cache       Cache storing the values.
+         * @param namespaces  Codec of each namespace, "" for all the keys.
+         * @param threshold   Minimum size in bytes of the values compressed.
+         */
+        CompressedCacheDriver(std::unique_ptr<granada::cache::CacheHandler>&& cache, const std::map<std::string,granada::cache::CacheCodec::Type>& namespaces, const std::size_t& threshold);
+
+
+        /**
+         * Returns the statistics of the compression.
+         */
+        const granada::cache::CompressedCacheStats Stats();
+
+
+        /**
+         * Returns the cache storing the values.
+         */
+        granada::cache::CacheHandler* cache(){
+          return cache_.get();
+        };
+
+
+        /**
+         * Operations of the cache, the values are compressed
+         * before being written and decompressed once read.
+         */
+        virtual const std::string Read(const std::string& key) override;
+        virtual const std::string Read(const std::string& hash, const std::string& key) override;
+        virtual const bool ReadAll(const std::string& hash, std::map<std::string,std::string>& values) override;
+        virtual const bool ReadMany(const std::string& hash, const std::vector<std::string>& keys, std::vector<std::string>& values) override;
+        virtual void Write(const std::string& key,const std::string& value) override;
+        virtual void Write(const std::string& hash,const std::string& key,const std::string& value) override;
+        virtual void WriteMany(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values) override;
+        virtual const bool WriteIfNotExists(const std::string& key,const std::string& value) override;
+        virtual const bool WriteIfNotExists(const std::string& hash,const std::string& key,const std::string& value) override;
+        virtual const bool CompareAndSet(const std::string& hash,const std::string& key,const std::string& expected,const std::string& value) override;
+        virtual void WriteWithTTL(const std::string& key,const std::string& value,const long long& seconds) override;
+        virtual void WriteWithTTL(const std::string& hash,const std::string& key,const std::string& value,const long long& seconds) override;
+        virtual void WriteManyWithTTL(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values,const long long& seconds) override;
+        virtual pplx::task<std::string> ReadAsync(const std::string& key) override;
+        virtual pplx::task<std::string> ReadAsync(const std::string& hash,const std::string& key) override;
+        virtual pplx::task<std::vector<std::string>> ReadManyAsync(const std::string& hash,const std::vector<std::string>& keys) override;
+        virtual pplx::task<void> WriteAsync(const std::string& key,const std::string& value) override;
+        virtual pplx::task<void> WriteAsync(const std::string& hash,const std::string& key,const std::string& value) override;
+
+
+        /**
+         * Operations passed to the cache storing the values.
+         */
+        virtual const bool Exists(const std::string& key) override {
+          return cache_->Exists(key);
+        };
+
+
+        virtual const bool Exists(const std::string& hash,const std::string& key) override {
+          return cache_->Exists(hash,key);
+        };
+
+
+        virtual const void Match(const std::string& expression, std::vector<std::string>& keys) override {
+          cache_->Match(expression,keys);
+        };
+
+
+        virtual const long long Increment(const std::string& key,const long long& increment) override {
+          return cache_->Increment(key,increment);
+        };
+
+
+        virtual const long long Increment(const std::string& hash,const std::string& key,const long long& increment) override {
+          return cache_->Increment(hash,key,increment);
+        };
+
+
+        virtual const long long IncrementWithTTL(const std::string& key,const long long& increment,const long long& seconds) override {
+          return cache_->IncrementWithTTL(key,increment,seconds);
+        };
+
+
+        virtual const long long TakeTokens(const std::string& key,const long long& tokens,const long long& capacity,const double& rate) override {
+          return cache_->TakeTokens(key,tokens,capacity,rate);
+        };
+
+
+        virtual void Destroy(const std::string& key) override {
+          cache_->Destroy(key);
+        };
+
+
+        virtual void Destroy(const std::string& hash,const std::string& key) override {
+          cache_->Destroy(hash,key);
+        };
+
+
+        virtual const std::size_t DestroyMatch(const std::string& expression) override {
+          return cache_->DestroyMatch(expression);
+        };
+
+
+        virtual bool Rename(const std::string& old_key, const std::string& new_key) override {
+          return cache_->Rename(old_key,new_key);
+        };
+
+
+        virtual const bool SupportsExpire() override {
+          return cache_->SupportsExpire();
+        };
+
+
+        virtual const bool Expire(const std::string& key, const long long& seconds) override {
+          return cache_->Expire(key,seconds);
+        };
+
+
+        virtual const long long TTL(const std::string& key) override {
+          return cache_->TTL(key);
+        };
+
+
+        virtual std::unique_ptr<granada::cache::CacheHandlerIterator> make_iterator(const std::string& expression) override {
+          return cache_->make_iterator(expression);
+        };
+
+
+        virtual const std::size_t Subscribe(const std::string& expression, const granada::cache::CacheSubscriber& subscriber) override {
+          return cache_->Subscribe(expression,subscriber);
+        };
+
+
+        virtual void Unsubscribe(const std::size_t& subscription) override {
+          cache_->Unsubscribe(subscription);
+        };
+
+
+        virtual pplx::task<bool> ExistsAsync(const std::string& key) override {
+          return cache_->ExistsAsync(key);
+        };
+
+
+        virtual pplx::task<bool> ExistsAsync(const std::string& hash,const std::string& key) override {
+          return cache_->ExistsAsync(hash,key);
+        };
+
+
+        virtual pplx::task<std::vector<std::string>> MatchAsync(const std::string& expression) override {
+          return cache_->MatchAsync(expression);
+        };
+
+
+        /**
+         * Returns the value to store for a value of a key or set.
+         * @param key   Key or hash of the value.
+         * @param value Value.
+         * @return      Value compressed with the codec of the
+         *              namespace, or value if it is not compressed.
+         */
+        const std::string Encode(const std::string& key, const std::string& value);
+
+
+        /**
+         * Returns the value of a stored value.
+         * @param stored  Value stored by the cache.
+         * @return        Value decompressed, stored if it is not
+         *                compressed, empty if it can not be decompressed.
+         */
+        static const std::string Decode(const std::string& stored);
+
+
+      protected:
+
+        /**
+         * Cache storing the values.
+         */
+        std::unique_ptr<granada::cache::CacheHandler> cache_;
+
+
+        /**
+         * Codec of each namespace, longest namespaces first.
+         */
+        std::vector<std::pair<std::string,granada::cache::CacheCodec::Type>> namespaces_;
+
+
+        /**
+         * Minimum size in bytes of the values compressed.
+         */
+        std::size_t threshold_;
+
+
+        /**
+         * Statistics, counted without synchronizing the threads.
+         */
+        std::atomic<std::size_t> values_;
+        std::atomic<std::size_t> compressed_;
+        std::atomic<std::size_t> bytes_;
+        std::atomic<std::size_t> compressed_bytes_;
+
+
+        /**
+         * Returns the codec of the namespace of a key or hash,
+         * NONE if its values are not compressed.
+         */
+        const granada::cache::CacheCodec::Type Codec(const std::string& key);
+
+
+        /**
+         * Returns the key-value pairs to store for the given pairs of a set.
+         */
+        const std::vector<std::pair<std::string,std::string>> Encode(const std::string& hash, const std::vector<std::pair<std::string,std::string>>& values);
+    };
+
+
+    /**
+     * Puts a compressed cache in front of the given cache if the
+     * compressed_cache_driver_namespaces property is set, otherwise
+     * returns the given cache.
+     * @param cache Cache.
+     * @return      Cache to use.
+     */
+    std::unique_ptr<granada::cache::CacheHandler> MakeCompressedCacheDriver(std::unique_ptr<granada::cache::CacheHandler>&& cache);
+  }
+}
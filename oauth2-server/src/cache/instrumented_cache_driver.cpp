@@ -0,0 +1,538 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Cache in front of another cache measuring its operations.
+  *
+  */
+
+#include "instrumented_cache_driver.h"
+#include <algorithm>
+#include "cpprest/json.h"
+
+namespace granada{
+  namespace cache{
+
+    // buckets of each power of two, 8 = 2^3.
+    static const int SUB_BUCKET_BITS = 3;
+    static const std::size_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+
+    // values up to 2^40 nanoseconds, about 18 minutes,
+    // higher values are counted in the last bucket.
+    static const int MAX_BITS = 40;
+    static const std::size_t BUCKETS = (MAX_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+
+    void CacheHistogram::Record(const unsigned long long& value){
+      if (buckets_.empty()){
+        buckets_.resize(BUCKETS);
+      }
+      ++buckets_[Bucket(value)];
+      ++count_;
+      sum_ += value;
+      if (value > max_){
+        max_ = value;
+      }
+    }
+
+
+    void CacheHistogram::Merge(const CacheHistogram& histogram){
+      if (histogram.buckets_.empty()){
+        return;
+      }
+      if (buckets_.empty()){
+        buckets_.resize(BUCKETS);
+      }
+      for (std::size_t i = 0; i < BUCKETS; ++i){
+        buckets_[i] += histogram.buckets_[i];
+      }
+      count_ += histogram.count_;
+      sum_ += histogram.sum_;
+      max_ = std::max(max_,histogram.max_);
+    }
+
+
+    const unsigned long long CacheHistogram::Percentile(const double& percentile) const {
+      if (count_ == 0){
+        return 0;
+      }
+      unsigned long long rank = (unsigned long long)(percentile / 100 * count_ + 0.5);
+      if (rank < 1){
+        rank = 1;
+      }
+      unsigned long long seen = 0;
+      for (std::size_t i = 0; i < BUCKETS; ++i){
+        seen += buckets_[i];
+        if (seen >= rank){
+          // the last bucket also has the values out of range.
+          return i == BUCKETS - 1 ? max_ : std::min(Highest(i),max_);
+        }
+      }
+      return max_;
+    }
+
+
+    const std::size_t CacheHistogram::Bucket(const unsigned long long& value){
+      if (value < SUB_BUCKETS){
+        return value;
+      }
+      // position of the highest bit set.
+      int bits = 0;
+      unsigned long long v = value;
+      for (int shift = 32; shift > 0; shift >>= 1){
+        if (v >> shift){
+          v >>= shift;
+          bits += shift;
+        }
+      }
+      if (bits > MAX_BITS){
+        return BUCKETS - 1;
+      }
+      // the power of two and the next SUB_BUCKET_BITS bits.
+      const std::size_t sub_bucket = (value >> (bits - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+      return (bits - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub_bucket;
+    }
+
+
+    const unsigned long long CacheHistogram::Highest(const std::size_t& bucket){
+      if (bucket < SUB_BUCKETS){
+        return bucket;
+      }
+      const int bits = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+      const unsigned long long sub_bucket = bucket % SUB_BUCKETS;
+      const int shift = bits - SUB_BUCKET_BITS;
+      return ((SUB_BUCKETS + sub_bucket + 1) << shift) - 1;
+    }
+
+
+
+
+
+    void InstrumentedOperationStats::Merge(const InstrumentedOperationStats& stats){
+      count += stats.count;
+      hits += stats.hits;
+      misses += stats.misses;
+      lock_wait_ns += stats.lock_wait_ns;
+      keys_scanned += stats.keys_scanned;
+      latency.Merge(stats.latency);
+    }
+
+
+
+
+
+    std::atomic<unsigned long long> InstrumentedCacheDriver::last_id_(0);
+
+
+    InstrumentedCacheDriver::InstrumentedCacheDriver(std::unique_ptr<granada::cache::CacheHandler>&& cache) : InstrumentedCacheDriver(std::move(cache),std::vector<std::string>()){
+      // namespaces of the keys, example: ["session:roles:","session:value:"]
+      const std::string& namespaces_str = granada::util::application::GetProperty(entity_keys::instrumented_cache_driver_namespaces);
+      if (!namespaces_str.empty()){
+        try{
+          web::json::value namespaces_json = web::json::value::parse(utility::conversions::to_string_t(namespaces_str));
+          if (namespaces_json.is_array()){
+            for (auto it = namespaces_json.as_array().cbegin(); it != namespaces_json.as_array().cend(); ++it){
+              if (it->is_string()){
+                namespaces_.push_back(utility::conversions::to_utf8string(it->as_string()));
+              }
+            }
+          }
+        }catch(const web::json::json_exception e){}
+        std::sort(namespaces_.begin(), namespaces_.end(), [](const std::string& a, const std::string& b){
+          return a.length() > b.length();
+        });
+      }
+    }
+
+
+    InstrumentedCacheDriver::InstrumentedCacheDriver(std::unique_ptr<granada::cache::CacheHandler>&& cache, const std::vector<std::string>& namespaces){
+      cache_ = std::move(cache);
+      namespaces_ = namespaces;
+      std::sort(namespaces_.begin(), namespaces_.end(), [](const std::string& a, const std::string& b){
+        return a.length() > b.length();
+      });
+      id_ = ++last_id_;
+    }
+
+
+    const granada::cache::InstrumentedCacheStats InstrumentedCacheDriver::Stats(){
+      granada::cache::InstrumentedCacheStats stats;
+      std::lock_guard<std::mutex> lg(threads_mtx_);
+      for (auto it = threads_.begin(); it != threads_.end(); ++it){
+        std::lock_guard<std::mutex> lg2((*it)->mtx);
+        for (auto it2 = (*it)->namespaces.begin(); it2 != (*it)->namespaces.end(); ++it2){
+          std::map<std::string,granada::cache::InstrumentedOperationStats>& operations = stats.namespaces[it2->first];
+          for (std::size_t i = 0; i < it2->second.size(); ++i){
+            if (it2->second[i].count > 0){
+              operations[OperationName((Operation)i)].Merge(it2->second[i]);
+            }
+          }
+        }
+      }
+      return stats;
+    }
+
+
+    const std::string InstrumentedCacheDriver::Json(){
+      const granada::cache::InstrumentedCacheStats stats = Stats();
+      web::json::value json = web::json::value::object();
+      for (auto it = stats.namespaces.begin(); it != stats.namespaces.end(); ++it){
+        web::json::value operations = web::json::value::object();
+        for (auto it2 = it->second.begin(); it2 != it->second.end(); ++it2){
+          const granada::cache::InstrumentedOperationStats& operation_stats = it2->second;
+          web::json::value latency = web::json::value::object();
+          latency[U("mean")] = web::json::value::number(operation_stats.latency.mean());
+          latency[U("p50")] = web::json::value::number((double)operation_stats.latency.Percentile(50));
+          latency[U("p90")] = web::json::value::number((double)operation_stats.latency.Percentile(90));
+          latency[U("p99")] = web::json::value::number((double)operation_stats.latency.Percentile(99));
+          latency[U("p999")] = web::json::value::number((double)operation_stats.latency.Percentile(99.9));
+          latency[U("max")] = web::json::value::number((double)operation_stats.latency.max());
+          web::json::value operation = web::json::value::object();
+          operation[U("count")] = web::json::value::number((double)operation_stats.count);
+          operation[U("hits")] = web::json::value::number((double)operation_stats.hits);
+          operation[U("misses")] = web::json::value::number((double)operation_stats.misses);
+          operation[U("lock_wait_ns")] = web::json::value::number((double)operation_stats.lock_wait_ns);
+          operation[U("keys_scanned")] = web::json::value::number((double)operation_stats.keys_scanned);
+          operation[U("latency_ns")] = latency;
+          operations[utility::conversions::to_string_t(it2->first)] = operation;
+        }
+        json[utility::conversions::to_string_t(it->first)] = operations;
+      }
+      return utility::conversions::to_utf8string(json.serialize());
+    }
+
+
+    const std::string InstrumentedCacheDriver::OperationName(const Operation& operation){
+      switch (operation){
+        case EXISTS: return "exists";
+        case READ: return "read";
+        case READ_ALL: return "read_all";
+        case READ_MANY: return "read_many";
+        case MATCH: return "match";
+        case WRITE: return "write";
+        case WRITE_MANY: return "write_many";
+        case WRITE_IF_NOT_EXISTS: return "write_if_not_exists";
+        case COMPARE_AND_SET: return "compare_and_set";
+        case INCREMENT: return "increment";
+        case TAKE_TOKENS: return "take_tokens";
+        case DESTROY: return "destroy";
+        case DESTROY_MATCH: return "destroy_match";
+        case RENAME: return "rename";
+        case EXPIRE: return "expire";
+        case TIME_TO_LIVE: return "ttl";
+        default: return "";
+      }
+    }
+
+
+    const bool InstrumentedCacheDriver::Exists(const std::string& key){
+      const Measure measure = Start();
+      const bool exists = cache_->Exists(key);
+      Finish(EXISTS,key,measure,exists ? 1 : 0);
+      return exists;
+    }
+
+
+    const bool InstrumentedCacheDriver::Exists(const std::string& hash,const std::string& key){
+      const Measure measure = Start();
+      const bool exists = cache_->Exists(hash,key);
+      Finish(EXISTS,hash,measure,exists ? 1 : 0);
+      return exists;
+    }
+
+
+    const std::string InstrumentedCacheDriver::Read(const std::string& key){
+      const Measure measure = Start();
+      const std::string value = cache_->Read(key);
+      Finish(READ,key,measure,value.empty() ? 0 : 1);
+      return value;
+    }
+
+
+    const std::string InstrumentedCacheDriver::Read(const std::string& hash, const std::string& key){
+      const Measure measure = Start();
+      const std::string value = cache_->Read(hash,key);
+      Finish(READ,hash,measure,value.empty() ? 0 : 1);
+      return value;
+    }
+
+
+    const bool InstrumentedCacheDriver::ReadAll(const std::string& hash, std::map<std::string,std::string>& values){
+      const Measure measure = Start();
+      const bool exists = cache_->ReadAll(hash,values);
+      Finish(READ_ALL,hash,measure,exists ? 1 : 0);
+      return exists;
+    }
+
+
+    const bool InstrumentedCacheDriver::ReadMany(const std::string& hash, const std::vector<std::string>& keys, std::vector<std::string>& values){
+      const Measure measure = Start();
+      const bool exists = cache_->ReadMany(hash,keys,values);
+      Finish(READ_MANY,hash,measure,exists ? 1 : 0);
+      return exists;
+    }
+
+
+    const void InstrumentedCacheDriver::Match(const std::string& expression, std::vector<std::string>& keys){
+      const Measure measure = Start();
+      cache_->Match(expression,keys);
+      Finish(MATCH,expression,measure,-1);
+    }
+
+
+    void InstrumentedCacheDriver::Write(const std::string& key,const std::string& value){
+      const Measure measure = Start();
+      cache_->Write(key,value);
+      Finish(WRITE,key,measure,-1);
+    }
+
+
+    void InstrumentedCacheDriver::Write(const std::string& key,std::string&& value){
+      const Measure measure = Start();
+      cache_->Write(key,std::move(value));
+      Finish(WRITE,key,measure,-1);
+    }
+
+
+    void InstrumentedCacheDriver::Write(const std::string& hash,const std::string& key,const std::string& value){
+      const Measure measure = Start();
+      cache_->Write(hash,key,value);
+      Finish(WRITE,hash,measure,-1);
+    }
+
+
+    void InstrumentedCacheDriver::Write(const std::string& hash,const std::string& key,std::string&& value){
+      const Measure measure = Start();
+      cache_->Write(hash,key,std::move(value));
+      Finish(WRITE,hash,measure,-1);
+    }
+
+
+    void InstrumentedCacheDriver::WriteMany(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values){
+      const Measure measure = Start();
+      cache_->WriteMany(hash,values);
+      Finish(WRITE_MANY,hash,measure,-1);
+    }
+
+
+    const bool InstrumentedCacheDriver::WriteIfNotExists(const std::string& key,const std::string& value){
+      const Measure measure = Start();
+      const bool written = cache_->WriteIfNotExists(key,value);
+      Finish(WRITE_IF_NOT_EXISTS,key,measure,-1);
+      return written;
+    }
+
+
+    const bool InstrumentedCacheDriver::WriteIfNotExists(const std::string& hash,const std::string& key,const std::string& value){
+      const Measure measure = Start();
+      const bool written = cache_->WriteIfNotExists(hash,key,value);
+      Finish(WRITE_IF_NOT_EXISTS,hash,measure,-1);
+      return written;
+    }
+
+
+    const bool InstrumentedCacheDriver::CompareAndSet(const std::string& hash,const std::string& key,const std::string& expected,const std::string& value){
+      const Measure measure = Start();
+      const bool written = cache_->CompareAndSet(hash,key,expected,value);
+      Finish(COMPARE_AND_SET,hash,measure,-1);
+      return written;
+    }
+
+
+    const long long InstrumentedCacheDriver::Increment(const std::string& key,const long long& increment){
+      const Measure measure = Start();
+      const long long value = cache_->Increment(key,increment);
+      Finish(INCREMENT,key,measure,-1);
+      return value;
+    }
+
+
+    const long long InstrumentedCacheDriver::Increment(const std::string& hash,const std::string& key,const long long& increment){
+      const Measure measure = Start();
+      const long long value = cache_->Increment(hash,key,increment);
+      Finish(INCREMENT,hash,measure,-1);
+      return value;
+    }
+
+
+    const long long InstrumentedCacheDriver::IncrementWithTTL(const std::string& key,const long long& increment,const long long& seconds){
+      const Measure measure = Start();
+      const long long value = cache_->IncrementWithTTL(key,increment,seconds);
+      Finish(INCREMENT,key,measure,-1);
+      return value;
+    }
+
+
+    const long long InstrumentedCacheDriver::TakeTokens(const std::string& key,const long long& tokens,const long long& capacity,const double& rate){
+      const Measure measure = Start();
+      const long long left = cache_->TakeTokens(key,tokens,capacity,rate);
+      Finish(TAKE_TOKENS,key,measure,left > -1 ? 1 : 0);
+      return left;
+    }
+
+
+    void InstrumentedCacheDriver::Destroy(const std::string& key){
+      const Measure measure = Start();
+      cache_->Destroy(key);
+      Finish(key.find('*') == std::string::npos ? DESTROY : DESTROY_MATCH,key,measure,-1);
+    }
+
+
+    void InstrumentedCacheDriver::Destroy(const std::string& hash,const std::string& key){
+      const Measure measure = Start();
+      cache_->Destroy(hash,key);
+      Finish(DESTROY,hash,measure,-1);
+    }
+
+
+    const std::size_t InstrumentedCacheDriver::DestroyMatch(const std::string& expression){
+      const Measure measure = Start();
+      const std::size_t destroyed = cache_->DestroyMatch(expression);
+      Finish(DESTROY_MATCH,expression,measure,-1);
+      return destroyed;
+    }
+
+
+    bool InstrumentedCacheDriver::Rename(const std::string& old_key, const std::string& new_key){
+      const Measure measure = Start();
+      const bool renamed = cache_->Rename(old_key,new_key);
+      Finish(RENAME,old_key,measure,-1);
+      return renamed;
+    }
+
+
+    const bool InstrumentedCacheDriver::Expire(const std::string& key, const long long& seconds){
+      const Measure measure = Start();
+      const bool expire = cache_->Expire(key,seconds);
+      Finish(EXPIRE,key,measure,-1);
+      return expire;
+    }
+
+
+    const long long InstrumentedCacheDriver::TTL(const std::string& key){
+      const Measure measure = Start();
+      const long long ttl = cache_->TTL(key);
+      Finish(TIME_TO_LIVE,key,measure,-1);
+      return ttl;
+    }
+
+
+    void InstrumentedCacheDriver::WriteWithTTL(const std::string& key,const std::string& value,const long long& seconds){
+      const Measure measure = Start();
+      cache_->WriteWithTTL(key,value,seconds);
+      Finish(WRITE,key,measure,-1);
+    }
+
+
+    void InstrumentedCacheDriver::WriteWithTTL(const std::string& hash,const std::string& key,const std::string& value,const long long& seconds){
+      const Measure measure = Start();
+      cache_->WriteWithTTL(hash,key,value,seconds);
+      Finish(WRITE,hash,measure,-1);
+    }
+
+
+    void InstrumentedCacheDriver::WriteManyWithTTL(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values,const long long& seconds){
+      const Measure measure = Start();
+      cache_->WriteManyWithTTL(hash,values,seconds);
+      Finish(WRITE_MANY,hash,measure,-1);
+    }
+
+
+    const InstrumentedCacheDriver::Measure InstrumentedCacheDriver::Start(){
+      const granada::cache::CacheThreadCounters& counters = granada::cache::ThreadCounters();
+      Measure measure;
+      measure.lock_wait_ns = counters.lock_wait_ns;
+      measure.keys_scanned = counters.keys_scanned;
+      measure.start = std::chrono::steady_clock::now();
+      return measure;
+    }
+
+
+    void InstrumentedCacheDriver::Finish(const Operation& operation, const std::string& key, const Measure& measure, const int& hit){
+      const unsigned long long latency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - measure.start).count();
+      const granada::cache::CacheThreadCounters& counters = granada::cache::ThreadCounters();
+      ThreadStats* stats = thread_stats();
+      const std::size_t length = Namespace(key);
+      std::lock_guard<std::mutex> lg(stats->mtx);
+
+      // threads usually use the same namespace several times in a row.
+      if (stats->last == nullptr || stats->last_namespace.length() != length || key.compare(0, length, stats->last_namespace) != 0){
+        stats->last_namespace.assign(key, 0, length);
+        stats->last = &stats->namespaces[stats->last_namespace];
+        if (stats->last->empty()){
+          stats->last->resize(OPERATIONS);
+        }
+      }
+      granada::cache::InstrumentedOperationStats& operation_stats = (*stats->last)[operation];
+      ++operation_stats.count;
+      if (hit == 1){
+        ++operation_stats.hits;
+      }else if (hit == 0){
+        ++operation_stats.misses;
+      }
+      operation_stats.lock_wait_ns += counters.lock_wait_ns - measure.lock_wait_ns;
+      operation_stats.keys_scanned += counters.keys_scanned - measure.keys_scanned;
+      operation_stats.latency.Record(latency);
+    }
+
+
+    InstrumentedCacheDriver::ThreadStats* InstrumentedCacheDriver::thread_stats(){
+      // measures of the current thread by cache identifier, identifiers
+      // are never reused so the entry of a destroyed cache is never found.
+      thread_local std::unordered_map<unsigned long long,ThreadStats*> thread_stats;
+      thread_local unsigned long long last_id = 0;
+      thread_local ThreadStats* last_stats = nullptr;
+      if (last_id == id_){
+        return last_stats;
+      }
+      auto it = thread_stats.find(id_);
+      if (it == thread_stats.end()){
+        std::lock_guard<std::mutex> lg(threads_mtx_);
+        threads_.push_back(granada::util::memory::make_unique<ThreadStats>());
+        it = thread_stats.insert(std::make_pair(id_,threads_.back().get())).first;
+      }
+      last_id = id_;
+      last_stats = it->second;
+      return last_stats;
+    }
+
+
+    const std::size_t InstrumentedCacheDriver::Namespace(const std::string& key){
+      for (auto it = namespaces_.begin(); it != namespaces_.end(); ++it){
+        if (key.compare(0, it->length(), *it) == 0){
+          return it->length();
+        }
+      }
+      // the key up to its first ":", not after
+      // the first "*" of an expression.
+      for (std::size_t i = 0; i < key.length(); ++i){
+        if (key[i] == ':'){
+          return i + 1;
+        }
+        if (key[i] == '*'){
+          break;
+        }
+      }
+      return 0;
+    }
+  }
+}
@@ -0,0 +1,454 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Cache in front of another cache measuring its operations.
+  *
+  * This code is multi-thread safe.
+  *
+  */
+
+#pragma once
+#include "cache_handler.h"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "util/application.h"
+#include "defaults.h"
+
+namespace granada{
+  namespace cache{
+
+    /**
+     * Histogram of values, latencies in nanoseconds, with buckets
+     * growing with the values: each power of two is split in
+     * 8 buckets, so a percentile is at most 12.5% higher than the
+     * recorded value it stands for, whatever the magnitude.
+     */
+    class CacheHistogram{
+
+      public:
+
+        /**
+         * Adds a value.
+         * @param value Value.
+         */
+        void Record(const unsigned long long& value);
+
+
+        /**
+         * Adds the values of another histogram.
+         * @param histogram Histogram.
+         */
+        void Merge(const CacheHistogram& histogram);
+
+
+        /**
+         * Returns the highest value of the bucket containing the
+         * given percentile, 0 if there are no values.
+         * @param percentile  Percentile, from 0 to 100. Example: 99.9
+         */
+        const unsigned long long Percentile(const double& percentile) const;
+
+
+        /**
+         * Returns the number of values.
+         */
+        const unsigned long long count() const {
+          return count_;
+        };
+
+
+        /**
+         * Returns the highest value.
+         */
+        const unsigned long long max() const {
+          return max_;
+        };
+
+
+        /**
+         * Returns the mean of the values, 0 if there are no values.
+         */
+        const double mean() const {
+          return count_ == 0 ? 0 : (double)sum_ / count_;
+        };
+
+
+      private:
+
+        /**
+         * Number of values of each bucket, empty until
+         * the first value is recorded.
+         */
+        std::vector<unsigned long long> buckets_;
+
+
+        /**
+         * Number, sum and highest of the values.
+         */
+        unsigned long long count_ = 0;
+        unsigned long long sum_ = 0;
+        unsigned long long max_ = 0;
+
+
+        /**
+         * Returns the bucket of a value.
+         */
+        static const std::size_t Bucket(const unsigned long long& value);
+
+
+        /**
+         * Returns the highest value of a bucket.
+         */
+        static const unsigned long long Highest(const std::size_t& bucket);
+    };
+
+
+    /**
+     * Measures of an operation of the keys of a namespace.
+     */
+    struct InstrumentedOperationStats{
+
+      /**
+       * Number of calls.
+       */
+      unsigned long long count = 0;
+
+      /**
+       * Calls of Exists and Read finding the key, or the value,
+       * and calls of TakeTokens taking the tokens.
+       */
+      unsigned long long hits = 0;
+
+      /**
+       * Calls of Exists and Read not finding the key, or the value,
+       * and calls of TakeTokens refused.
+       */
+      unsigned long long misses = 0;
+
+      /**
+       * Nanoseconds waiting for the locks of the cache.
+       */
+      unsigned long long lock_wait_ns = 0;
+
+      /**
+       * Keys visited to find the keys matching the expressions.
+       */
+      unsigned long long keys_scanned = 0;
+
+      /**
+       * Latency of the calls in nanoseconds.
+       */
+      granada::cache::CacheHistogram latency;
+
+
+      /**
+       * Adds the measures of other calls.
+       */
+      void Merge(const InstrumentedOperationStats& stats);
+    };
+
+
+    /**
+     * Measures of the operations of an instrumented cache.
+     */
+    struct InstrumentedCacheStats{
+
+      /**
+       * Measures by namespace and by operation name.
+       * Example: stats.namespaces["session:"]["read"].hits
+       */
+      std::map<std::string,std::map<std::string,granada::cache::InstrumentedOperationStats>> namespaces;
+    };
+
+
+    /**
+     * Cache in front of another cache measuring its operations by
+     * operation and by namespace of the keys: calls, hits and misses of
+     * Exists and Read, latency histograms, time waiting for the locks of
+     * the cache and keys scanned by Match.
+     *
+     * Each thread records in its own counters, so threads never wait for
+     * each other, the counters of all the threads are added when the
+     * measures are requested with Stats or Json.
+     *
+     * The namespace of a key is the longest of the namespaces given that
+     * the key starts with, or of the "instrumented_cache_driver_namespaces"
+     * property, or the key up to its first ":" if none match.
+     * Example: instrumented_cache_driver_namespaces=["session:roles:","session:value:"]
+     *
+     * Asynchronous operations run the measured operations in a task.
+     */
+    class InstrumentedCacheDriver : public CacheHandler{
+
+      public:
+
+        // operations with CacheKey keys of CacheHandler, otherwise
+        // hidden by the operations of the same name of this driver.
+        using CacheHandler::Exists;
+        using CacheHandler::Read;
+        using CacheHandler::ReadAll;
+        using CacheHandler::ReadMany;
+        using CacheHandler::Write;
+        using CacheHandler::WriteMany;
+        using CacheHandler::WriteIfNotExists;
+        using CacheHandler::CompareAndSet;
+        using CacheHandler::Increment;
+        using CacheHandler::Destroy;
+        using CacheHandler::DestroyMatch;
+        using CacheHandler::Expire;
+        using CacheHandler::WriteWithTTL;
+        using CacheHandler::WriteManyWithTTL;
+        using CacheHandler::IncrementWithTTL;
+        using CacheHandler::TakeTokens;
+        using CacheHandler::make_iterator;
+        using CacheHandler::ReadAsync;
+        using CacheHandler::ReadManyAsync;
+
+
+        /**
+         * Operations measured.
+         */
+        enum Operation{
+          EXISTS,
+          READ,
+          READ_ALL,
+          READ_MANY,
+          MATCH,
+          WRITE,
+          WRITE_MANY,
+          WRITE_IF_NOT_EXISTS,
+          COMPARE_AND_SET,
+          INCREMENT,
+          TAKE_TOKENS,
+          DESTROY,
+          DESTROY_MATCH,
+          RENAME,
+          EXPIRE,
+          TIME_TO_LIVE,
+          OPERATIONS
+        };
+
+
+        /**
+         * Constructor
+         * Takes the namespaces from the server configuration file.
+         * @param cache Cache to measure.
+         */
+        InstrumentedCacheDriver(std::unique_ptr<granada::cache::CacheHandler>&& cache);
+
+
+        /**
+         * Constructor
+         * @param cache       Cache to measure.
+         * @param namespaces  Namespaces of the keys.
+         */
+        InstrumentedCacheDriver(std::unique_ptr<granada::cache::CacheHandler>&& cache, const std::vector<std::string>& namespaces);
+
+
+        /**
+         * Returns the measures of all the threads.
+         */
+        const granada::cache::InstrumentedCacheStats Stats();
+
+
+        /**
+         * Returns the measures of all the threads as JSON, example:
+         * {"session:":{"read":{"count":120,"hits":118,"misses":2,
+         * "lock_wait_ns":3400,"keys_scanned":0,"latency_ns":{"mean":812.5,
+         * "p50":767,"p90":1151,"p99":2559,"p999":4607,"max":4410}}}}
+         * Operations never called are not included.
+         */
+        const std::string Json();
+
+
+        /**
+         * Returns the name of an operation, as in Stats and Json.
+         * @param operation Operation.
+         */
+        static const std::string OperationName(const Operation& operation);
+
+
+        /**
+         * Returns the cache being measured.
+         */
+        granada::cache::CacheHandler* cache(){
+          return cache_.get();
+        };
+
+
+        /**
+         * Operations of the cache, measured and passed
+         * to the cache being measured.
+         */
+        virtual const bool Exists(const std::string& key) override;
+        virtual const bool Exists(const std::string& hash,const std::string& key) override;
+        virtual const std::string Read(const std::string& key) override;
+        virtual const std::string Read(const std::string& hash, const std::string& key) override;
+        virtual const bool ReadAll(const std::string& hash, std::map<std::string,std::string>& values) override;
+        virtual const bool ReadMany(const std::string& hash, const std::vector<std::string>& keys, std::vector<std::string>& values) override;
+        virtual const void Match(const std::string& expression, std::vector<std::string>& keys) override;
+        virtual void Write(const std::string& key,const std::string& value) override;
+        virtual void Write(const std::string& key,std::string&& value) override;
+        virtual void Write(const std::string& hash,const std::string& key,const std::string& value) override;
+        virtual void Write(const std::string& hash,const std::string& key,std::string&& value) override;
+        virtual void WriteMany(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values) override;
+        virtual const bool WriteIfNotExists(const std::string& key,const std::string& value) override;
+        virtual const bool WriteIfNotExists(const std::string& hash,const std::string& key,const std::string& value) override;
+        virtual const bool CompareAndSet(const std::string& hash,const std::string& key,const std::string& expected,const std::string& value) override;
+        virtual const long long Increment(const std::string& key,const long long& increment) override;
+        virtual const long long Increment(const std::string& hash,const std::string& key,const long long& increment) override;
+        virtual const long long IncrementWithTTL(const std::string& key,const long long& increment,const long long& seconds) override;
+        virtual const long long TakeTokens(const std::string& key,const long long& tokens,const long long& capacity,const double& rate) override;
+        virtual void Destroy(const std::string& key) override;
+        virtual void Destroy(const std::string& hash,const std::string& key) override;
+        virtual const std::size_t DestroyMatch(const std::string& expression) override;
+        virtual bool Rename(const std::string& old_key, const std::string& new_key) override;
+        virtual const bool Expire(const std::string& key, const long long& seconds) override;
+        virtual const long long TTL(const std::string& key) override;
+        virtual void WriteWithTTL(const std::string& key,const std::string& value,const long long& seconds) override;
+        virtual void WriteWithTTL(const std::string& hash,const std::string& key,const std::string& value,const long long& seconds) override;
+        virtual void WriteManyWithTTL(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values,const long long& seconds) override;
+
+
+        virtual const bool SupportsExpire() override {
+          return cache_->SupportsExpire();
+        };
+
+
+        virtual std::unique_ptr<granada::cache::CacheHandlerIterator> make_iterator(const std::string& expression) override {
+          return cache_->make_iterator(expression);
+        };
+
+
+        virtual const std::size_t Subscribe(const std::string& expression, const granada::cache::CacheSubscriber& subscriber) override {
+          return cache_->Subscribe(expression,subscriber);
+        };
+
+
+        virtual void Unsubscribe(const std::size_t& subscription) override {
+          cache_->Unsubscribe(subscription);
+        };
+
+
+      protected:
+
+        /**
+         * Start of a measured call.
+         */
+        struct Measure{
+          std::chrono::steady_clock::time_point start;
+          unsigned long long lock_wait_ns;
+          unsigned long long keys_scanned;
+        };
+
+
+        /**
+         * Measures recorded by a thread, by namespace and operation.
+         * Its mutex is only shared with the threads requesting the
+         * measures, so it is almost never contended.
+         */
+        struct ThreadStats{
+          std::mutex mtx;
+          std::unordered_map<std::string,std::vector<granada::cache::InstrumentedOperationStats>> namespaces;
+
+          // namespace of the last call and its measures.
+          std::string last_namespace;
+          std::vector<granada::cache::InstrumentedOperationStats>* last = nullptr;
+        };
+
+
+        /**
+         * Cache being measured.
+         */
+        std::unique_ptr<granada::cache::CacheHandler> cache_;
+
+
+        /**
+         * Namespaces of the keys, longest first.
+         */
+        std::vector<std::string> namespaces_;
+
+
+        /**
+         * Identifier of the cache, used by the threads
+         * to find their measures.
+         */
+        unsigned long long id_;
+
+
+        /**
+         * Measures of each thread that used the cache.
+         */
+        std::vector<std::unique_ptr<ThreadStats>> threads_;
+
+
+        /**
+         * Protects threads_.
+         */
+        std::mutex threads_mtx_;
+
+
+        /**
+         * Last identifier given to a cache.
+         */
+        static std::atomic<unsigned long long> last_id_;
+
+
+        /**
+         * Starts measuring a call.
+         */
+        const Measure Start();
+
+
+        /**
+         * Records a call.
+         * @param operation Operation.
+         * @param key       Key, hash or expression.
+         * @param measure   Returned by Start before the call.
+         * @param hit       1 if the key was found, 0 if it was
+         *                  not found, -1 if it does not apply.
+         */
+        void Finish(const Operation& operation, const std::string& key, const Measure& measure, const int& hit);
+
+
+        /**
+         * Returns the measures of the current thread,
+         * created the first time.
+         */
+        ThreadStats* thread_stats();
+
+
+        /**
+         * Returns the length of the namespace of a key or expression,
+         * the namespace being the beginning of the key.
+         */
+        const std::size_t Namespace(const std::string& key);
+    };
+  }
+}
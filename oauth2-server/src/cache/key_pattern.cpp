@@ -0,0 +1,111 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  */
+
+#include "cache/key_pattern.h"
+
+namespace granada{
+  namespace cache{
+
+    void KeyPattern::set(const std::string& expression){
+      segments_.clear();
+      min_length_ = 0;
+      std::size_t start = 0;
+      std::size_t found;
+      while ((found = expression.find('*', start)) != std::string::npos){
+        segments_.push_back(expression.substr(start, found - start));
+        start = found + 1;
+      }
+      segments_.push_back(expression.substr(start));
+
+      for (auto it = segments_.begin(); it != segments_.end(); ++it){
+        min_length_ += it->length();
+      }
+
+      // classify the pattern so the most common forms
+      // do not need the generic algorithm.
+      if (segments_.size() == 1){
+        kind_ = EXACT;
+      }else if (min_length_ == 0){
+        kind_ = ANY;
+      }else if (segments_.size() == 2 && segments_.back().empty()){
+        kind_ = PREFIX;
+      }else if (segments_.size() == 2 && segments_.front().empty()){
+        kind_ = SUFFIX;
+      }else if (segments_.size() == 3 && segments_.front().empty() && segments_.back().empty()){
+        kind_ = CONTAINS;
+      }else{
+        kind_ = GENERIC;
+      }
+    }
+
+
+    const bool KeyPattern::Match(const std::string& key) const {
+      if (key.length() < min_length_){
+        return false;
+      }
+      switch (kind_){
+        case EXACT:
+          return key == segments_.front();
+        case ANY:
+          return true;
+        case PREFIX:
+          return key.compare(0, segments_.front().length(), segments_.front()) == 0;
+        case SUFFIX:
+          return key.compare(key.length() - segments_.back().length(), segments_.back().length(), segments_.back()) == 0;
+        case CONTAINS:
+          return key.find(segments_[1]) != std::string::npos;
+        default:
+          break;
+      }
+
+      // generic pattern: the first segment has to be at the beginning of the key,
+      // the last one at the end, the segments in between are searched from
+      // left to right, taking the first occurrence of each one.
+      const std::string& first = segments_.front();
+      const std::string& last = segments_.back();
+      if (key.compare(0, first.length(), first) != 0){
+        return false;
+      }
+      if (key.compare(key.length() - last.length(), last.length(), last) != 0){
+        return false;
+      }
+      std::size_t position = first.length();
+      const std::size_t end = key.length() - last.length();
+      for (std::size_t i = 1; i + 1 < segments_.size(); ++i){
+        const std::string& segment = segments_[i];
+        if (segment.empty()){
+          continue;
+        }
+        std::size_t found = key.find(segment, position);
+        if (found == std::string::npos || found + segment.length() > end){
+          return false;
+        }
+        position = found + segment.length();
+      }
+      return true;
+    }
+
+  }
+}
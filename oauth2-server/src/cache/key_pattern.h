@@ -0,0 +1,141 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Glob pattern used to match cache keys, compiled once and
+  * used to test as many keys as needed.
+  *
+  */
+
+#pragma once
+#include <string>
+#include <vector>
+
+namespace granada{
+  namespace cache{
+
+    /**
+     * Glob pattern used to match cache keys.
+     * "*" matches any sequence of characters, including an empty one,
+     * all other characters, "." included, only match themselves.
+     *
+     * Example:
+     *
+     *     session:value:*
+     *     => matches all the keys starting with "session:value:"
+     *
+     *     *:value:*
+     *     => matches all the keys containing ":value:"
+     *
+     * Patterns of the form "prefix*", "*suffix", "*contains*" and
+     * patterns without "*" are matched without scanning the pattern.
+     */
+    class KeyPattern{
+
+      public:
+
+        /**
+         * Form of the pattern.
+         */
+        enum Kind{
+          EXACT,
+          PREFIX,
+          SUFFIX,
+          CONTAINS,
+          ANY,
+          GENERIC
+        };
+
+
+        /**
+         * Constructor
+         */
+        KeyPattern(){};
+
+
+        /**
+         * Constructor
+         * @param expression  Glob pattern. Example: session:value:*
+         */
+        KeyPattern(const std::string& expression){
+          set(expression);
+        };
+
+
+        /**
+         * Compiles the given glob pattern.
+         * @param expression  Glob pattern. Example: session:value:*
+         */
+        void set(const std::string& expression);
+
+
+        /**
+         * Returns true if the given key matches the pattern.
+         * @param  key  Key to test.
+         * @return      True if the key matches the pattern, false if not.
+         */
+        const bool Match(const std::string& key) const;
+
+
+        /**
+         * Returns the form of the pattern.
+         * @return  Form of the pattern.
+         */
+        const Kind kind() const {
+          return kind_;
+        };
+
+
+        /**
+         * Returns the literal characters of the pattern
+         * before the first "*". All the keys matching the pattern
+         * start with this prefix.
+         * @return  Literal prefix of the pattern.
+         */
+        const std::string& prefix() const {
+          return segments_.front();
+        };
+
+
+      private:
+
+        /**
+         * Form of the pattern.
+         */
+        Kind kind_ = EXACT;
+
+
+        /**
+         * Literal parts of the pattern, split by "*".
+         * Example: "a*b**c" => "a", "b", "", "c"
+         * There is always at least one segment.
+         */
+        std::vector<std::string> segments_ = std::vector<std::string>(1);
+
+
+        /**
+         * Minimum length a key must have to match the pattern.
+         */
+        std::size_t min_length_ = 0;
+    };
+  }
+}
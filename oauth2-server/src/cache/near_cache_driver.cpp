@@ -0,0 +1,459 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Cache in front of another cache, usually a remote one.
+  *
+  */
+
+#include "near_cache_driver.h"
+#include <chrono>
+#include "cpprest/json.h"
+#include "cache/key_pattern.h"
+
+namespace granada{
+  namespace cache{
+
+    // keys whose invalidation is remembered for the reads in flight,
+    // over this number they are forgotten and all those reads dropped.
+    static const std::size_t NEAR_CACHE_INVALIDATIONS = 4096;
+
+
+    NearCacheDriver::NearCacheDriver(std::unique_ptr<granada::cache::CacheHandler>&& cache) : NearCacheDriver(std::move(cache),default_numbers::near_cache_driver_max_keys){
+      const std::string& max_keys_str = granada::util::application::GetProperty(entity_keys::near_cache_driver_max_keys);
+      if (!max_keys_str.empty()){
+        try{
+          max_keys_ = std::stoull(max_keys_str);
+        }catch(const std::logic_error e){}
+      }
+
+      // staleness in milliseconds by namespace, example: {"session:roles:":1000,"oauth2.client:":60000}
+      SetNamespaces(granada::util::application::GetProperty(entity_keys::near_cache_driver_namespaces));
+    }
+
+
+    NearCacheDriver::NearCacheDriver(std::unique_ptr<granada::cache::CacheHandler>&& cache, const std::size_t& max_keys){
+      cache_ = std::move(cache);
+      max_keys_ = max_keys;
+    }
+
+
+    NearCacheDriver::~NearCacheDriver(){
+      std::lock_guard<std::mutex> lg(subscriptions_mtx_);
+      for (auto it = subscriptions_.begin(); it != subscriptions_.end(); ++it){
+        if (it->second != 0){
+          cache_->Unsubscribe(it->second);
+        }
+      }
+    }
+
+
+    void NearCacheDriver::SetStaleness(const std::string& name_space, const long long& staleness){
+      {
+        // changes made by other processes invalidate the keys at once,
+        // subscribe before the keys are kept.
+        std::lock_guard<std::mutex> lg(subscriptions_mtx_);
+        auto it = subscriptions_.find(name_space);
+        if (staleness > 0 && it == subscriptions_.end()){
+          subscriptions_[name_space] = cache_->Subscribe(name_space + "*",[this](const granada::cache::CacheEvent& event){
+            Invalidate(event.key);
+          });
+        }else if (staleness < 1 && it != subscriptions_.end()){
+          if (it->second != 0){
+            cache_->Unsubscribe(it->second);
+          }
+          subscriptions_.erase(it);
+        }
+      }
+      std::lock_guard<std::mutex> lg(mtx_);
+      for (auto it = staleness_.begin(); it != staleness_.end(); ++it){
+        if (it->first == name_space){
+          it->second = staleness;
+          return;
+        }
+      }
+      // keep the longest namespaces first, so the most specific one is found first.
+      auto it = staleness_.begin();
+      while (it != staleness_.end() && it->first.length() >= name_space.length()){
+        ++it;
+      }
+      staleness_.insert(it,std::make_pair(name_space,staleness));
+    }
+
+
+    void NearCacheDriver::SetNamespaces(const std::string& namespaces){
+      if (!namespaces.empty()){
+        try{
+          web::json::value namespaces_json = web::json::value::parse(utility::conversions::to_string_t(namespaces));
+          for (auto it = namespaces_json.as_object().cbegin(); it != namespaces_json.as_object().cend(); ++it){
+            if (it->second.is_number()){
+              SetStaleness(utility::conversions::to_utf8string(it->first), it->second.as_number().to_int64());
+            }
+          }
+        }catch(const web::json::json_exception e){}
+      }
+    }
+
+
+    void NearCacheDriver::Invalidate(const std::string& key){
+      std::lock_guard<std::mutex> lg(mtx_);
+      epoch_++;
+      if (key.find('*') == std::string::npos){
+        // only keys that can be kept may have reads to drop.
+        if (NamespaceStaleness(key) > 0){
+          if (invalidated_.size() >= NEAR_CACHE_INVALIDATIONS){
+            invalidated_.clear();
+            floor_epoch_ = epoch_;
+          }
+          invalidated_[key] = epoch_;
+        }
+        auto it = entries_.find(key);
+        if (it != entries_.end()){
+          Erase(it);
+          stats_.invalidations++;
+        }
+        return;
+      }
+      invalidated_.clear();
+      floor_epoch_ = epoch_;
+      const granada::cache::KeyPattern pattern(key);
+      for (auto it = entries_.begin(); it != entries_.end();){
+        if (pattern.Match(it->first)){
+          lru_.erase(it->second.lru);
+          it = entries_.erase(it);
+          stats_.invalidations++;
+        }else{
+          ++it;
+        }
+      }
+    }
+
+
+    void NearCacheDriver::Clear(){
+      std::lock_guard<std::mutex> lg(mtx_);
+      epoch_++;
+      invalidated_.clear();
+      floor_epoch_ = epoch_;
+      stats_.invalidations += entries_.size();
+      entries_.clear();
+      lru_.clear();
+    }
+
+
+    const NearCacheStats NearCacheDriver::Stats(){
+      std::lock_guard<std::mutex> lg(mtx_);
+      granada::cache::NearCacheStats stats = stats_;
+      stats.keys = entries_.size();
+      stats.max_keys = max_keys_;
+      return stats;
+    }
+
+
+    const bool NearCacheDriver::Exists(const std::string& key){
+      const long long staleness = Staleness(key);
+      if (staleness < 1){
+        return cache_->Exists(key);
+      }
+      bool exists = false;
+      if (Hit(key,granada::cache::NearCacheEntry::EXISTS,[&exists](granada::cache::NearCacheEntry& entry){
+        exists = entry.exists;
+      })){
+        return exists;
+      }
+      const unsigned long long epoch = Epoch();
+      exists = cache_->Exists(key);
+      Fill(key,staleness,epoch,granada::cache::NearCacheEntry::EXISTS,[&exists](granada::cache::NearCacheEntry& entry){
+        entry.exists = exists;
+      });
+      return exists;
+    }
+
+
+    const bool NearCacheDriver::Exists(const std::string& hash,const std::string& key){
+      bool exists = false;
+      Values(hash,[&key,&exists](const bool& values_exist, const std::map<std::string,std::string>& values){
+        exists = values.find(key) != values.end();
+      });
+      return exists;
+    }
+
+
+    const std::string NearCacheDriver::Read(const std::string& key){
+      const long long staleness = Staleness(key);
+      if (staleness < 1){
+        return cache_->Read(key);
+      }
+      std::string value;
+      if (Hit(key,granada::cache::NearCacheEntry::VALUE,[&value](granada::cache::NearCacheEntry& entry){
+        value = entry.value;
+      })){
+        return value;
+      }
+      const unsigned long long epoch = Epoch();
+      value = cache_->Read(key);
+      Fill(key,staleness,epoch,granada::cache::NearCacheEntry::VALUE,[&value](granada::cache::NearCacheEntry& entry){
+        entry.value = value;
+      });
+      return value;
+    }
+
+
+    const std::string NearCacheDriver::Read(const std::string& hash,const std::string& key){
+      std::string value;
+      Values(hash,[&key,&value](const bool& values_exist, const std::map<std::string,std::string>& values){
+        auto it = values.find(key);
+        if (it != values.end()){
+          value = it->second;
+        }
+      });
+      return value;
+    }
+
+
+    const bool NearCacheDriver::ReadAll(const std::string& hash, std::map<std::string,std::string>& values){
+      bool exists = false;
+      Values(hash,[&values,&exists](const bool& values_exist, const std::map<std::string,std::string>& entry_values){
+        exists = values_exist;
+        values = entry_values;
+      });
+      return exists;
+    }
+
+
+    const bool NearCacheDriver::ReadMany(const std::string& hash, const std::vector<std::string>& keys, std::vector<std::string>& values){
+      bool exists = false;
+      values.clear();
+      Values(hash,[&keys,&values,&exists](const bool& values_exist, const std::map<std::string,std::string>& entry_values){
+        exists = values_exist;
+        if (exists){
+          values.reserve(keys.size());
+          for (auto it = keys.begin(); it != keys.end(); ++it){
+            auto value = entry_values.find(*it);
+            if (value == entry_values.end()){
+              values.push_back(std::string());
+            }else{
+              values.push_back(value->second);
+            }
+          }
+        }
+      });
+      return exists;
+    }
+
+
+    void NearCacheDriver::Write(const std::string& key,const std::string& value){
+      cache_->Write(key,value);
+      Invalidate(key);
+    }
+
+
+    void NearCacheDriver::Write(const std::string& hash,const std::string& key,const std::string& value){
+      cache_->Write(hash,key,value);
+      Invalidate(hash);
+    }
+
+
+    void NearCacheDriver::WriteMany(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values){
+      cache_->WriteMany(hash,values);
+      Invalidate(hash);
+    }
+
+
+    const bool NearCacheDriver::WriteIfNotExists(const std::string& key,const std::string& value){
+      const bool written = cache_->WriteIfNotExists(key,value);
+      Invalidate(key);
+      return written;
+    }
+
+
+    const bool NearCacheDriver::WriteIfNotExists(const std::string& hash,const std::string& key,const std::string& value){
+      const bool written = cache_->WriteIfNotExists(hash,key,value);
+      Invalidate(hash);
+      return written;
+    }
+
+
+    const bool NearCacheDriver::CompareAndSet(const std::string& hash,const std::string& key,const std::string& expected,const std::string& value){
+      const bool written = cache_->CompareAndSet(hash,key,expected,value);
+      Invalidate(hash);
+      return written;
+    }
+
+
+    const long long NearCacheDriver::Increment(const std::string& key,const long long& increment){
+      const long long result = cache_->Increment(key,increment);
+      Invalidate(key);
+      return result;
+    }
+
+
+    const long long NearCacheDriver::Increment(const std::string& hash,const std::string& key,const long long& increment){
+      const long long result = cache_->Increment(hash,key,increment);
+      Invalidate(hash);
+      return result;
+    }
+
+
+    const long long NearCacheDriver::IncrementWithTTL(const std::string& key,const long long& increment,const long long& seconds){
+      const long long result = cache_->IncrementWithTTL(key,increment,seconds);
+      Invalidate(key);
+      return result;
+    }
+
+
+    const long long NearCacheDriver::TakeTokens(const std::string& key,const long long& tokens,const long long& capacity,const double& rate){
+      const long long result = cache_->TakeTokens(key,tokens,capacity,rate);
+      Invalidate(key);
+      return result;
+    }
+
+
+    void NearCacheDriver::Destroy(const std::string& key){
+      cache_->Destroy(key);
+      Invalidate(key);
+    }
+
+
+    void NearCacheDriver::Destroy(const std::string& hash,const std::string& key){
+      cache_->Destroy(hash,key);
+      Invalidate(hash);
+    }
+
+
+    const std::size_t NearCacheDriver::DestroyMatch(const std::string& expression){
+      const std::size_t destroyed = cache_->DestroyMatch(expression);
+      Invalidate(expression);
+      return destroyed;
+    }
+
+
+    bool NearCacheDriver::Rename(const std::string& old_key, const std::string& new_key){
+      const bool renamed = cache_->Rename(old_key,new_key);
+      Invalidate(old_key);
+      Invalidate(new_key);
+      return renamed;
+    }
+
+
+    const bool NearCacheDriver::Expire(const std::string& key, const long long& seconds){
+      const bool expire = cache_->Expire(key,seconds);
+      Invalidate(key);
+      return expire;
+    }
+
+
+    void NearCacheDriver::WriteWithTTL(const std::string& key,const std::string& value,const long long& seconds){
+      cache_->WriteWithTTL(key,value,seconds);
+      Invalidate(key);
+    }
+
+
+    void NearCacheDriver::WriteWithTTL(const std::string& hash,const std::string& key,const std::string& value,const long long& seconds){
+      cache_->WriteWithTTL(hash,key,value,seconds);
+      Invalidate(hash);
+    }
+
+
+    void NearCacheDriver::WriteManyWithTTL(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values,const long long& seconds){
+      cache_->WriteManyWithTTL(hash,values,seconds);
+      Invalidate(hash);
+    }
+
+
+    pplx::task<bool> NearCacheDriver::ExistsAsync(const std::string& hash,const std::string& key){
+      bool exists = false;
+      if (Staleness(hash) > 0 && Hit(hash,granada::cache::NearCacheEntry::VALUES,[&key,&exists](granada::cache::NearCacheEntry& entry){
+        exists = entry.values.find(key) != entry.values.end();
+      })){
+        return pplx::task_from_result(exists);
+      }
+      return CacheHandler::ExistsAsync(hash,key);
+    }
+
+
+    pplx::task<std::string> NearCacheDriver::ReadAsync(const std::string& hash,const std::string& key){
+      std::string value;
+      if (Staleness(hash) > 0 && Hit(hash,granada::cache::NearCacheEntry::VALUES,[&key,&value](granada::cache::NearCacheEntry& entry){
+        auto it = entry.values.find(key);
+        if (it != entry.values.end()){
+          value = it->second;
+        }
+      })){
+        return pplx::task_from_result(value);
+      }
+      return CacheHandler::ReadAsync(hash,key);
+    }
+
+
+    pplx::task<std::vector<std::string>> NearCacheDriver::ReadManyAsync(const std::string& hash,const std::vector<std::string>& keys){
+      if (Staleness(hash) > 0){
+        std::vector<std::string> values;
+        if (Hit(hash,granada::cache::NearCacheEntry::VALUES,[&keys,&values](granada::cache::NearCacheEntry& entry){
+          if (entry.values_exist){
+            for (auto it = keys.begin(); it != keys.end(); ++it){
+              auto value = entry.values.find(*it);
+              values.push_back(value == entry.values.end() ? std::string() : value->second);
+            }
+          }
+        })){
+          return pplx::task_from_result(values);
+        }
+      }
+      return CacheHandler::ReadManyAsync(hash,keys);
+    }
+
+
+    const long long NearCacheDriver::Staleness(const std::string& key){
+      std::lock_guard<std::mutex> lg(mtx_);
+      return NamespaceStaleness(key);
+    }
+
+
+    const long long NearCacheDriver::NamespaceStaleness(const std::string& key){
+      for (auto it = staleness_.begin(); it != staleness_.end(); ++it){
+        if (key.compare(0,it->first.length(),it->first) == 0){
+          return it->second;
+        }
+      }
+      return 0;
+    }
+
+
+    const long long NearCacheDriver::Now(){
+      return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+
+    void NearCacheDriver::Erase(std::unordered_map<std::string,granada::cache::NearCacheEntry>::iterator it){
+      lru_.erase(it->second.lru);
+      entries_.erase(it);
+    }
+
+
+    std::unique_ptr<granada::cache::CacheHandler> MakeNearCacheDriver(std::unique_ptr<granada::cache::CacheHandler>&& cache){
+      if (granada::util::application::GetProperty(entity_keys::near_cache_driver) == "on"){
+        return granada::util::memory::make_unique<granada::cache::NearCacheDriver>(std::move(cache));
+      }
+      return std::move(cache);
+    }
+  }
+}
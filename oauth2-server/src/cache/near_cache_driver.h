@@ -0,0 +1,778 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Cache in front of another cache, usually a remote one.
+  * Keys of the configured namespaces are kept in a small
+  * in-process cache for a bounded time after being read,
+  * so repeated reads of data that rarely changes, like session
+  * roles, do not reach the remote cache.
+  *
+  * Writes go to the remote cache and invalidate the key in the
+  * near cache of this process. Other processes see the change
+  * once the key is stale in their near cache or when they
+  * are told to Invalidate it. If the remote cache supports
+  * subscriptions, keys are invalidated as soon as the remote
+  * cache notifies that they changed.
+  *
+  * This code is multi-thread safe.
+  *
+  */
+
+#pragma once
+#include "cache_handler.h"
+#include <string>
+#include <list>
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "util/application.h"
+#include "defaults.h"
+
+namespace granada{
+  namespace cache{
+
+    /**
+     * Values of a key kept in the near cache. Each part is
+     * loaded by the operation that needs it.
+     */
+    struct NearCacheEntry{
+
+      /**
+       * Parts of the entry loaded, combination of EXISTS, VALUE and VALUES.
+       */
+      enum Part{
+        EXISTS = 1,
+        VALUE = 2,
+        VALUES = 4
+      };
+      int loaded = 0;
+
+
+      /**
+       * Result of Exists(key).
+       */
+      bool exists = false;
+
+
+      /**
+       * Result of Read(key).
+       */
+      std::string value;
+
+
+      /**
+       * Result of ReadAll(hash).
+       */
+      bool values_exist = false;
+      std::map<std::string,std::string> values;
+
+
+      /**
+       * Time in milliseconds of the steady clock after which
+       * the entry is stale.
+       */
+      long long deadline = 0;
+
+
+      /**
+       * Position of the key in the least recently used list.
+       */
+      std::list<std::string>::iterator lru;
+    };
+
+
+    /**
+     * Statistics of a near cache.
+     */
+    struct NearCacheStats{
+
+      /**
+       * Number of keys in the near cache.
+       */
+      std::size_t keys = 0;
+
+      /**
+       * Maximum number of keys.
+       */
+      std::size_t max_keys = 0;
+
+      /**
+       * Reads answered by the near cache.
+       */
+      std::size_t hits = 0;
+
+      /**
+       * Reads of a cached namespace that reached the remote cache.
+       */
+      std::size_t misses = 0;
+
+      /**
+       * Keys removed to keep the near cache under max_keys.
+       */
+      std::size_t evictions = 0;
+
+      /**
+       * Keys removed because they were written or invalidated.
+       */
+      std::size_t invalidations = 0;
+    };
+
+
+    class NearCacheDriver : public CacheHandler{
+
+      public:
+
+        // operations with CacheKey keys of CacheHandler, otherwise
+        // hidden by the operations of the same name of this driver.
+        using CacheHandler::Exists;
+        using CacheHandler::Read;
+        using CacheHandler::ReadAll;
+        using CacheHandler::ReadMany;
+        using CacheHandler::Write;
+        using CacheHandler::WriteMany;
+        using CacheHandler::WriteIfNotExists;
+        using CacheHandler::CompareAndSet;
+        using CacheHandler::Increment;
+        using CacheHandler::Destroy;
+        using CacheHandler::DestroyMatch;
+        using CacheHandler::Expire;
+        using CacheHandler::WriteWithTTL;
+        using CacheHandler::WriteManyWithTTL;
+        using CacheHandler::IncrementWithTTL;
+        using CacheHandler::TakeTokens;
+        using CacheHandler::make_iterator;
+        using CacheHandler::ReadAsync;
+        using CacheHandler::ReadManyAsync;
+
+
+        /**
+         * Constructor
+         * Takes the maximum number of keys and the staleness of each
+         * namespace from the server configuration file.
+         * @param cache Cache the near cache is in front of.
+         */
+        NearCacheDriver(std::unique_ptr<granada::cache::CacheHandler>&& cache);
+
+
+        /**
+         * Constructor
+         * @param cache     Cache the near cache is in front of.
+         * @param max_keys  Maximum number of keys in the near cache.
+         */
+        NearCacheDriver(std::unique_ptr<granada::cache::CacheHandler>&& cache, const std::size_t& max_keys);
+
+
+        /**
+         * Destructor
+         * Cancels the subscriptions to the remote cache.
+         */
+        virtual ~NearCacheDriver();
+
+
+        /**
+         * Keeps the keys starting with the given namespace for the given
+         * time after they are read. The most specific namespace of a key
+         * is used, keys of namespaces without staleness are not kept.
+         * Subscribes to the changes of the keys of the namespace made
+         * by other processes.
+         * @param name_space  Namespace, example: session:roles:
+         * @param staleness   Milliseconds a value can be served after
+         *                    it has been read, 0 to not keep the keys.
+         */
+        void SetStaleness(const std::string& name_space, const long long& staleness);
+
+
+        /**
+         * Sets the staleness of several namespaces.
+         * @param namespaces  JSON object with the staleness in milliseconds
+         *                    by namespace, example: {"session:roles:":1000}
+         *                    Ignored if it is not valid.
+         */
+        void SetNamespaces(const std::string& namespaces);
+
+
+        /**
+         * Removes a key from the near cache, so the next read
+         * gets it from the remote cache. Used when another process
+         * tells that the key has changed.
+         * @param key Key or hash, may contain "*".
+         */
+        void Invalidate(const std::string& key);
+
+
+        /**
+         * Removes all the keys from the near cache.
+         */
+        void Clear();
+
+
+        /**
+         * Returns the statistics of the near cache.
+         */
+        const NearCacheStats Stats();
+
+
+        /**
+         * Returns true if the value with the given key exists,
+         * false if it does not.
+         * @param  key Key of the value.
+         * @return     True if the value exists, false if it does not.
+         */
+        virtual const bool Exists(const std::string& key) override;
+
+
+        /**
+         * Returns true if a key exists in a set with the given hash,
+         * false if it does not.
+         * @param  hash Name of the set of key-value.
+         * @param  key  Key of the value
+         * @return      True if the key exists, false if it does not.
+         */
+        virtual const bool Exists(const std::string& hash,const std::string& key) override;
+
+
+        /**
+         * Returns the value associated with the given key.
+         * @param  key Key of the value.
+         * @return     Value.
+         */
+        virtual const std::string Read(const std::string& key) override;
+
+
+        /**
+         * Returns the value stored in a set and associated with the given key.
+         * @param  hash Name of the set where the key-value pairs are stored.
+         * @param  key  Key associated with the value.
+         * @return      Value.
+         */
+        virtual const std::string Read(const std::string& hash,const std::string& key) override;
+
+
+        /**
+         * Fills a map with all the key-value pairs of a set.
+         * @param  hash   Name of the set.
+         * @param  values Map to fill with the key-value pairs.
+         * @return        True if the set exists, false if it does not.
+         */
+        virtual const bool ReadAll(const std::string& hash, std::map<std::string,std::string>& values) override;
+
+
+        /**
+         * Fills a vector with the values of the given keys of a set.
+         * @param  hash   Name of the set.
+         * @param  keys   Keys associated with the values.
+         * @param  values Vector to fill with the values, in the same order as the keys.
+         * @return        True if the set exists, false if it does not.
+         */
+        virtual const bool ReadMany(const std::string& hash, const std::vector<std::string>& keys, std::vector<std::string>& values) override;
+
+
+        /**
+         * Fills a vector with keys of the remote cache that match
+         * a given expression.
+         * @param expression  Expression used to match keys.
+         * @param keys        Vector to fill with the matching keys.
+         */
+        virtual const void Match(const std::string& expression, std::vector<std::string>& keys) override {
+          cache_->Match(expression,keys);
+        };
+
+
+        /**
+         * Sets a value in the cache associated with a given key.
+         * @param key   Key of the value.
+         * @param value Value.
+         */
+        virtual void Write(const std::string& key,const std::string& value) override;
+
+
+        /**
+         * Inserts or rewrite a key-value pair in a set with the given name.
+         * @param hash  Name of the set.
+         * @param key   Key to identify the value inside the set.
+         * @param value Value
+         */
+        virtual void Write(const std::string& hash,const std::string& key,const std::string& value) override;
+
+
+        /**
+         * Inserts or rewrite several key-value pairs in a set with the given name.
+         * @param hash    Name of the set.
+         * @param values  Key-value pairs.
+         */
+        virtual void WriteMany(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values) override;
+
+
+        /**
+         * Sets a value in the remote cache only if the key does not exist.
+         * @param key   Key of the value.
+         * @param value Value.
+         * @return      True if the value has been written.
+         */
+        virtual const bool WriteIfNotExists(const std::string& key,const std::string& value) override;
+
+
+        /**
+         * Inserts a key-value pair in a set of the remote cache only
+         * if the key does not exist in the set.
+         * @param hash  Name of the set.
+         * @param key   Key to identify the value inside the set.
+         * @param value Value
+         * @return      True if the value has been written.
+         */
+        virtual const bool WriteIfNotExists(const std::string& hash,const std::string& key,const std::string& value) override;
+
+
+        /**
+         * Replaces the value of a key in a set of the remote cache
+         * only if its current value is the expected one.
+         * @param hash      Name of the set.
+         * @param key       Key to identify the value inside the set.
+         * @param expected  Expected current value.
+         * @param value     New value.
+         * @return          True if the value has been replaced.
+         */
+        virtual const bool CompareAndSet(const std::string& hash,const std::string& key,const std::string& expected,const std::string& value) override;
+
+
+        /**
+         * Adds a number to the integer value of a key of the remote cache.
+         * @param key       Key of the value.
+         * @param increment Number to add, may be negative.
+         * @return          Value after the increment.
+         */
+        virtual const long long Increment(const std::string& key,const long long& increment) override;
+
+
+        /**
+         * Adds a number to the integer value of a key in a set of the remote cache.
+         * @param hash      Name of the set.
+         * @param key       Key to identify the value inside the set.
+         * @param increment Number to add, may be negative.
+         * @return          Value after the increment.
+         */
+        virtual const long long Increment(const std::string& hash,const std::string& key,const long long& increment) override;
+
+
+        /**
+         * Increments a value in the remote cache, sets its time to live
+         * if it has none and removes the key from the local cache.
+         * @param key       Key of the value.
+         * @param increment Number to add, may be negative.
+         * @param seconds   Seconds the key will live from its first increment.
+         * @return          Value after the increment.
+         */
+        virtual const long long IncrementWithTTL(const std::string& key,const long long& increment,const long long& seconds) override;
+
+
+        /**
+         * Takes tokens from a token bucket of the remote cache
+         * and removes the key from the local cache.
+         * @param key       Key of the bucket.
+         * @param tokens    Number of tokens to take.
+         * @param capacity  Maximum number of tokens of the bucket.
+         * @param rate      Tokens added to the bucket per second.
+         * @return          Number of tokens left, -1 if the bucket
+         *                  did not have enough tokens.
+         */
+        virtual const long long TakeTokens(const std::string& key,const long long& tokens,const long long& capacity,const double& rate) override;
+
+
+        /**
+         * Destroys the value associated with the given key, the key may
+         * contain "*".
+         * @param key Key of the value.
+         */
+        virtual void Destroy(const std::string& key) override;
+
+
+        /**
+         * Destroys a key-value pair stored in a set.
+         * @param hash Name of the set.
+         * @param key  Key to identify the value inside the set.
+         */
+        virtual void Destroy(const std::string& hash,const std::string& key) override;
+
+
+        /**
+         * Destroys the keys matching an expression in the far cache
+         * and invalidates them in the near cache.
+         * @param expression  Expression, as in Match.
+         * @return            Number of keys destroyed.
+         */
+        virtual const std::size_t DestroyMatch(const std::string& expression) override;
+
+
+        /**
+         * Changes the name of a key, see CacheHandler::Rename.
+         * @param old_key Name of the key to change.
+         * @param new_key New name of the key.
+         * @return        True if the key has been renamed.
+         */
+        virtual bool Rename(const std::string& old_key, const std::string& new_key) override;
+
+
+        /**
+         * Returns true if the remote cache supports expiration.
+         */
+        virtual const bool SupportsExpire() override {
+          return cache_->SupportsExpire();
+        };
+
+
+        /**
+         * Sets the time to live of a key in the remote cache.
+         * @param key     Key.
+         * @param seconds Seconds the key will live from now, -1 to remove it.
+         * @return        True if the time to live was set.
+         */
+        virtual const bool Expire(const std::string& key, const long long& seconds) override;
+
+
+        /**
+         * Returns the remaining time to live of a key in the remote cache.
+         * @param key Key.
+         * @return    Remaining seconds, -1 if the key does not expire,
+         *            -2 if the key does not exist.
+         */
+        virtual const long long TTL(const std::string& key) override {
+          return cache_->TTL(key);
+        };
+
+
+        /**
+         * Sets a value and the time to live of its key.
+         * @param key     Key of the value.
+         * @param value   Value.
+         * @param seconds Seconds the key will live from now.
+         */
+        virtual void WriteWithTTL(const std::string& key,const std::string& value,const long long& seconds) override;
+
+
+        /**
+         * Inserts or rewrite a key-value pair in a set and sets
+         * the time to live of the set.
+         * @param hash    Name of the set.
+         * @param key     Key to identify the value inside the set.
+         * @param value   Value
+         * @param seconds Seconds the set will live from now.
+         */
+        virtual void WriteWithTTL(const std::string& hash,const std::string& key,const std::string& value,const long long& seconds) override;
+
+
+        /**
+         * Inserts or rewrite several key-value pairs in a set and sets
+         * the time to live of the set.
+         * @param hash    Name of the set.
+         * @param values  Key-value pairs.
+         * @param seconds Seconds the set will live from now.
+         */
+        virtual void WriteManyWithTTL(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values,const long long& seconds) override;
+
+
+        /**
+         * Returns an iterator over the keys of the remote cache.
+         * @param expression  Expression used to match keys.
+         */
+        virtual std::unique_ptr<granada::cache::CacheHandlerIterator> make_iterator(const std::string& expression) override {
+          return cache_->make_iterator(expression);
+        };
+
+
+        /**
+         * Subscribes to the changes of the remote cache.
+         */
+        virtual const std::size_t Subscribe(const std::string& expression, const granada::cache::CacheSubscriber& subscriber) override {
+          return cache_->Subscribe(expression,subscriber);
+        };
+
+
+        /**
+         * Cancels a subscription to the remote cache.
+         */
+        virtual void Unsubscribe(const std::size_t& subscription) override {
+          cache_->Unsubscribe(subscription);
+        };
+
+
+        /**
+         * Returns a completed task if the set is in the near cache,
+         * otherwise reads it from the remote cache in a task.
+         */
+        virtual pplx::task<bool> ExistsAsync(const std::string& hash,const std::string& key) override;
+
+
+        /**
+         * Returns a completed task if the set is in the near cache,
+         * otherwise reads it from the remote cache in a task.
+         */
+        virtual pplx::task<std::string> ReadAsync(const std::string& hash,const std::string& key) override;
+
+
+        /**
+         * Returns a completed task if the set is in the near cache,
+         * otherwise reads it from the remote cache in a task.
+         */
+        virtual pplx::task<std::vector<std::string>> ReadManyAsync(const std::string& hash,const std::vector<std::string>& keys) override;
+
+
+      protected:
+
+        /**
+         * Cache the near cache is in front of.
+         */
+        std::unique_ptr<granada::cache::CacheHandler> cache_;
+
+
+        /**
+         * Mutex protecting the entries, the list and the statistics.
+         * Never held while the remote cache is called.
+         */
+        std::mutex mtx_;
+
+
+        /**
+         * Keys kept in the near cache.
+         */
+        std::unordered_map<std::string,granada::cache::NearCacheEntry> entries_;
+
+
+        /**
+         * Keys from the most recently used to the least recently used.
+         */
+        std::list<std::string> lru_;
+
+
+        /**
+         * Maximum number of keys.
+         */
+        std::size_t max_keys_;
+
+
+        /**
+         * Staleness in milliseconds by namespace,
+         * most specific namespaces first.
+         */
+        std::vector<std::pair<std::string,long long>> staleness_;
+
+
+        /**
+         * Incremented on each invalidation. A value read from the
+         * remote cache is only kept if its key has not been invalidated
+         * while it was being read, so a value older than a local
+         * write is never kept.
+         */
+        unsigned long long epoch_ = 0;
+
+
+        /**
+         * Epoch of the last invalidation of the recently invalidated
+         * keys of the cached namespaces. Cleared when it grows too big,
+         * then floor_epoch_ takes its place.
+         */
+        std::unordered_map<std::string,unsigned long long> invalidated_;
+
+
+        /**
+         * Reads started before this epoch are not kept, set when
+         * invalidated_ is cleared and by expressions and Clear, which
+         * may invalidate any key.
+         */
+        unsigned long long floor_epoch_ = 0;
+
+
+        /**
+         * Statistics.
+         */
+        granada::cache::NearCacheStats stats_;
+
+
+        /**
+         * Subscriptions invalidating the keys changed in the
+         * remote cache, by namespace with staleness. The identifier
+         * is 0 if the remote cache does not support it.
+         */
+        std::map<std::string,std::size_t> subscriptions_;
+
+
+        /**
+         * Mutex for subscriptions_, mtx_ is never held while
+         * subscribing as the subscribers lock it.
+         */
+        std::mutex subscriptions_mtx_;
+
+
+        /**
+         * Returns the staleness of the namespace of a key,
+         * 0 if the key is not kept.
+         * @param key Key or hash.
+         */
+        const long long Staleness(const std::string& key);
+
+
+        /**
+         * Returns the staleness of the namespace of a key,
+         * mtx_ has to be locked.
+         * @param key Key or hash.
+         */
+        const long long NamespaceStaleness(const std::string& key);
+
+
+        /**
+         * Returns the time of the steady clock in milliseconds.
+         */
+        static const long long Now();
+
+
+        /**
+         * Looks for a part of an entry in the near cache, if it
+         * is there and not stale calls read with the entry.
+         * @param key   Key or hash.
+         * @param part  Part of the entry needed.
+         * @param read  Function receiving the entry.
+         * @return      True if the entry has been read, false if it
+         *              has to be read from the remote cache.
+         */
+        template <typename Function>
+        bool Hit(const std::string& key, const int& part, Function read){
+          std::lock_guard<std::mutex> lg(mtx_);
+          auto it = entries_.find(key);
+          if (it == entries_.end() || (it->second.loaded & part) == 0){
+            stats_.misses++;
+            return false;
+          }
+          if (it->second.deadline <= Now()){
+            Erase(it);
+            stats_.misses++;
+            return false;
+          }
+          lru_.splice(lru_.begin(),lru_,it->second.lru);
+          read(it->second);
+          stats_.hits++;
+          return true;
+        };
+
+
+        /**
+         * Stores a part of an entry read from the remote cache, unless
+         * the key has been invalidated since the read started.
+         * @param key       Key or hash.
+         * @param staleness Milliseconds the entry can be served.
+         * @param epoch     Epoch when the read started.
+         * @param part      Part of the entry written.
+         * @param write     Function filling the part of the entry.
+         */
+        template <typename Function>
+        void Fill(const std::string& key, const long long& staleness, const unsigned long long& epoch, const int& part, Function write){
+          std::lock_guard<std::mutex> lg(mtx_);
+          if (epoch < floor_epoch_){
+            return;
+          }
+          auto invalidated = invalidated_.find(key);
+          if (invalidated != invalidated_.end() && invalidated->second > epoch){
+            return;
+          }
+          auto it = entries_.find(key);
+          if (it == entries_.end()){
+            while (!lru_.empty() && entries_.size() >= max_keys_){
+              Erase(entries_.find(lru_.back()));
+              stats_.evictions++;
+            }
+            if (max_keys_ == 0){
+              return;
+            }
+            it = entries_.emplace(key,granada::cache::NearCacheEntry()).first;
+            lru_.push_front(key);
+            it->second.lru = lru_.begin();
+            it->second.deadline = Now() + staleness;
+          }else{
+            lru_.splice(lru_.begin(),lru_,it->second.lru);
+            if (it->second.deadline <= Now()){
+              // stale parts are dropped, the new part starts a new period.
+              it->second.loaded = 0;
+              it->second.value.clear();
+              it->second.values.clear();
+              it->second.deadline = Now() + staleness;
+            }
+          }
+          write(it->second);
+          it->second.loaded |= part;
+        };
+
+
+        /**
+         * Returns the current epoch.
+         */
+        const unsigned long long Epoch(){
+          std::lock_guard<std::mutex> lg(mtx_);
+          return epoch_;
+        };
+
+
+        /**
+         * Removes an entry, mtx_ has to be locked.
+         */
+        void Erase(std::unordered_map<std::string,granada::cache::NearCacheEntry>::iterator it);
+
+
+        /**
+         * Reads a set from the near cache or from the remote cache.
+         * @param hash      Name of the set.
+         * @param read      Function receiving the existence of the set and its values.
+         */
+        template <typename Function>
+        void Values(const std::string& hash, Function read){
+          const long long staleness = Staleness(hash);
+          if (staleness > 0){
+            if (Hit(hash,granada::cache::NearCacheEntry::VALUES,[&read](granada::cache::NearCacheEntry& entry){
+              read(entry.values_exist,entry.values);
+            })){
+              return;
+            }
+          }
+          const unsigned long long epoch = Epoch();
+          std::map<std::string,std::string> values;
+          const bool exists = cache_->ReadAll(hash,values);
+          read(exists,values);
+          if (staleness > 0){
+            Fill(hash,staleness,epoch,granada::cache::NearCacheEntry::VALUES,[&exists,&values](granada::cache::NearCacheEntry& entry){
+              entry.values_exist = exists;
+              entry.values.swap(values);
+            });
+          }
+        };
+    };
+
+
+    /**
+     * Puts a near cache in front of the given cache if the
+     * near_cache_driver property is "on", otherwise returns
+     * the given cache.
+     * @param cache Cache, usually a remote one.
+     * @return      Cache to use.
+     */
+    std::unique_ptr<granada::cache::CacheHandler> MakeNearCacheDriver(std::unique_ptr<granada::cache::CacheHandler>&& cache);
+  }
+}
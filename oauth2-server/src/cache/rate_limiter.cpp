@@ -0,0 +1,79 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Limits of the rate of operations by scope, stored in token buckets of a cache.
+  *
+  */
+
+#include "rate_limiter.h"
+
+namespace granada{
+  namespace cache{
+
+    RateLimiter::RateLimiter(const std::string& name, const std::string& property, const std::shared_ptr<granada::cache::CacheHandler>& cache) : RateLimiter(name,std::map<std::string,granada::cache::RateLimit>(),cache){
+      const std::string& limits_str = granada::util::application::GetProperty(property);
+      if (!limits_str.empty() && cache_ != nullptr){
+        try{
+          web::json::value limits_json = web::json::value::parse(utility::conversions::to_string_t(limits_str));
+          for (auto it = limits_json.as_object().cbegin(); it != limits_json.as_object().cend(); ++it){
+            if (it->second.is_object() && it->second.has_field(U("capacity")) && it->second.has_field(U("rate"))){
+              granada::cache::RateLimit limit;
+              limit.capacity = it->second.at(U("capacity")).as_number().to_int64();
+              limit.rate = it->second.at(U("rate")).as_number().to_double();
+              if (limit.capacity > 0 && limit.rate > 0){
+                limits_[utility::conversions::to_utf8string(it->first)] = limit;
+              }
+            }
+          }
+        }catch(const web::json::json_exception e){}
+      }
+    }
+
+
+    RateLimiter::RateLimiter(const std::string& name, const std::map<std::string,granada::cache::RateLimit>& limits, const std::shared_ptr<granada::cache::CacheHandler>& cache) : name_(name), cache_(cache){
+      if (cache_ != nullptr){
+        for (auto it = limits.begin(); it != limits.end(); ++it){
+          if (it->second.capacity > 0 && it->second.rate > 0){
+            limits_.insert(*it);
+          }
+        }
+      }
+    }
+
+
+    const bool RateLimiter::Limits(const std::string& scope) const {
+      return limits_.find(scope) != limits_.end();
+    }
+
+
+    const bool RateLimiter::Take(const std::string& scope, const std::string& id){
+      auto it = limits_.find(scope);
+      if (it == limits_.end() || id.empty()){
+        return true;
+      }
+      const granada::cache::CacheKey key(cache_namespaces::rate_limit, name_, scope, id);
+      return cache_->TakeTokens(key,1,it->second.capacity,it->second.rate) > -1;
+    }
+
+  }
+}
@@ -0,0 +1,135 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Limits of the rate of operations by scope, stored in token buckets of a cache.
+  *
+  */
+
+#pragma once
+#include "cache_handler.h"
+#include <map>
+#include <memory>
+#include <string>
+#include "cpprest/json.h"
+#include "util/application.h"
+#include "defaults.h"
+
+namespace granada{
+  namespace cache{
+
+    /**
+     * Limit of a scope: a bucket of capacity tokens refilled
+     * at rate tokens per second.
+     */
+    struct RateLimit{
+
+      /**
+       * Maximum number of tokens of a bucket,
+       * the number of operations allowed at once.
+       */
+      long long capacity = 0;
+
+      /**
+       * Tokens added to a bucket per second.
+       */
+      double rate = 0;
+
+    };
+
+
+    /**
+     * Limits the rate of operations of a kind, by scope and identifier,
+     * for example the password attempts by user and by client. Each
+     * identifier of a limited scope has a token bucket stored in the
+     * cache, see CacheHandler::TakeTokens, with the key
+     * rate:<name>:<scope>:<identifier>. Processes sharing the cache
+     * share the limits.
+     */
+    class RateLimiter{
+
+      public:
+
+        /**
+         * Constructor
+         * Takes the limits of the scopes from a property of the server
+         * configuration file, no scope is limited if it is not set.
+         * Example: {"user":{"capacity":5,"rate":0.05},"client":{"capacity":100,"rate":5}}
+         * @param name      Name of the operations limited.
+         * @param property  Name of the property with the limits.
+         * @param cache     Cache storing the buckets, nullptr for no limits.
+         */
+        RateLimiter(const std::string& name, const std::string& property, const std::shared_ptr<granada::cache::CacheHandler>& cache);
+
+
+        /**
+         * Constructor
+         * @param name      Name of the operations limited.
+         * @param limits    Limits by scope.
+         * @param cache     Cache storing the buckets, nullptr for no limits.
+         */
+        RateLimiter(const std::string& name, const std::map<std::string,granada::cache::RateLimit>& limits, const std::shared_ptr<granada::cache::CacheHandler>& cache);
+
+
+        /**
+         * Returns true if the operations of a scope are limited.
+         * @param scope Scope, example: "user".
+         * @return      True if the scope is limited.
+         */
+        const bool Limits(const std::string& scope) const;
+
+
+        /**
+         * Takes a token from the bucket of an identifier in a scope.
+         * Operations of scopes not limited and of empty identifiers
+         * are always allowed.
+         * @param scope Scope, example: "user".
+         * @param id    Identifier in the scope, example: the username.
+         * @return      True if the operation is allowed, false if
+         *              the bucket is empty.
+         */
+        const bool Take(const std::string& scope, const std::string& id);
+
+
+      private:
+
+        /**
+         * Name of the operations limited, part of the keys of the buckets.
+         */
+        std::string name_;
+
+
+        /**
+         * Limits by scope, scopes with a capacity or a rate
+         * lower or equal to 0 are not kept.
+         */
+        std::map<std::string,granada::cache::RateLimit> limits_;
+
+
+        /**
+         * Cache storing the buckets.
+         */
+        std::shared_ptr<granada::cache::CacheHandler> cache_;
+
+    };
+  }
+}
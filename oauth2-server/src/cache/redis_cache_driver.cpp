@@ -0,0 +1,585 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Manages the cache storing key-value pairs in a Redis server.
+  *
+  */
+
+#include "redis_cache_driver.h"
+#include <chrono>
+
+namespace granada{
+  namespace cache{
+
+    // channel of the keyevent notifications of database 0,
+    // followed by the name of the event.
+    static const std::string KEYEVENT_CHANNEL = "__keyevent@0__:";
+
+    // events of the commands used by the driver and the change they are.
+    static const std::vector<std::pair<std::string,granada::cache::CacheEvent::Type>> KEYEVENTS = {
+      {"set", granada::cache::CacheEvent::WRITE},
+      {"incrby", granada::cache::CacheEvent::WRITE},
+      {"hset", granada::cache::CacheEvent::WRITE},
+      {"hincrby", granada::cache::CacheEvent::WRITE},
+      {"hdel", granada::cache::CacheEvent::WRITE},
+      {"del", granada::cache::CacheEvent::DESTROY},
+      {"expired", granada::cache::CacheEvent::EXPIRE},
+      {"evicted", granada::cache::CacheEvent::EXPIRE},
+      {"rename_from", granada::cache::CacheEvent::RENAME},
+      {"rename_to", granada::cache::CacheEvent::RENAME}
+    };
+
+    RedisIterator::RedisIterator(const std::string& expression, RedisCacheDriver* cache){
+      cache_ = cache;
+      set(expression);
+    }
+
+
+    void RedisIterator::set(const std::string& expression){
+      expression_ = expression;
+      cursor_ = "0";
+      started_ = false;
+      keys_.clear();
+    }
+
+
+    const bool RedisIterator::has_next(){
+      if (keys_.empty()){
+        Fetch();
+      }
+      return !keys_.empty();
+    }
+
+
+    const std::string RedisIterator::next(){
+      if (has_next()){
+        const std::string value(std::move(keys_.front()));
+        keys_.pop_front();
+        return value;
+      }
+      return std::string();
+    }
+
+
+    void RedisIterator::Fetch(){
+      while (keys_.empty() && (!started_ || cursor_ != "0")){
+        started_ = true;
+        cache_->Scan(cursor_,expression_,keys_);
+      }
+    }
+
+
+
+
+
+    RedisConnectionPool::RedisConnectionPool(const std::string& address, const unsigned short& port, const std::size_t& size){
+      boost::system::error_code ec;
+      boost::asio::ip::address ip = boost::asio::ip::address::from_string(address,ec);
+      if (ec){
+        ip = boost::asio::ip::address::from_string(default_strings::redis_cache_redis_address);
+      }
+      endpoint_ = boost::asio::ip::tcp::endpoint(ip,port);
+      size_ = size < 1 ? 1 : size;
+    }
+
+
+    std::unique_ptr<RedisConnection> RedisConnectionPool::Acquire(){
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        if (idle_.empty() && open_ >= size_){
+          // all the connections are in use, the time waited
+          // for one is counted as lock wait of the thread.
+          const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+          cv_.wait(lock,[this]{
+            return !idle_.empty() || open_ < size_;
+          });
+          granada::cache::ThreadCounters().lock_wait_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        }
+        if (!idle_.empty()){
+          std::unique_ptr<RedisConnection> connection = std::move(idle_.back());
+          idle_.pop_back();
+          return connection;
+        }
+        ++open_;
+      }
+
+      // connect without holding the lock.
+      std::unique_ptr<RedisConnection> connection = granada::util::memory::make_unique<RedisConnection>();
+      boost::system::error_code ec;
+      connection->client.connect(endpoint_,ec);
+      if (ec){
+        Release(std::move(connection),true);
+        return nullptr;
+      }
+      return connection;
+    }
+
+
+    void RedisConnectionPool::Release(std::unique_ptr<RedisConnection> connection, const bool& broken){
+      {
+        std::lock_guard<std::mutex> lg(mtx_);
+        if (broken){
+          --open_;
+        }else{
+          idle_.push_back(std::move(connection));
+        }
+      }
+      cv_.notify_one();
+    }
+
+
+
+
+
+    RedisCacheDriver::RedisCacheDriver(){
+      std::string address = granada::util::application::GetProperty(entity_keys::redis_cache_driver_address);
+      if (address.empty()){
+        address = default_strings::redis_cache_redis_address;
+      }
+
+      unsigned short port = (unsigned short)std::stoi(default_strings::redis_cache_redis_port);
+      const std::string& port_str = granada::util::application::GetProperty(entity_keys::redis_cache_driver_port);
+      if (!port_str.empty()){
+        try{
+          port = (unsigned short)std::stoi(port_str);
+        }catch(const std::logic_error e){}
+      }
+
+      int connections = default_numbers::redis_cache_driver_connections;
+      const std::string& connections_str = granada::util::application::GetProperty(entity_keys::redis_cache_driver_connections);
+      if (!connections_str.empty()){
+        try{
+          connections = std::stoi(connections_str);
+        }catch(const std::logic_error e){
+          connections = default_numbers::redis_cache_driver_connections;
+        }
+      }
+
+      pool_ = granada::util::memory::make_unique<RedisConnectionPool>(address,port,connections);
+    }
+
+
+    RedisCacheDriver::RedisCacheDriver(const std::string& address, const unsigned short& port, const std::size_t& connections){
+      pool_ = granada::util::memory::make_unique<RedisConnectionPool>(address,port,connections);
+    }
+
+
+    RedisCacheDriver::~RedisCacheDriver(){
+      if (subscription_ != nullptr){
+        subscription_->io_service.stop();
+        if (subscription_->thread.joinable()){
+          subscription_->thread.join();
+        }
+      }
+    }
+
+
+    const std::size_t RedisCacheDriver::Subscribe(const std::string& expression, const granada::cache::CacheSubscriber& subscriber){
+      std::call_once(subscription_flag_,[this]{
+        Listen();
+      });
+      return notifier_.Subscribe(expression,subscriber);
+    }
+
+
+    void RedisCacheDriver::Listen(){
+      subscription_ = granada::util::memory::make_unique<RedisSubscription>();
+      RedisSubscription* subscription = subscription_.get();
+      subscription->client.connect(pool_->endpoint(),[this,subscription](boost::system::error_code ec){
+        if (ec){
+          return;
+        }
+        for (auto it = KEYEVENTS.begin(); it != KEYEVENTS.end(); ++it){
+          const granada::cache::CacheEvent::Type type = it->second;
+          // the message of a keyevent notification is the key.
+          subscription->client.subscribe(KEYEVENT_CHANNEL + it->first,[this,type](std::vector<char> message){
+            notifier_.Publish(type,std::string(message.begin(),message.end()));
+          });
+        }
+      });
+      subscription->thread = std::thread([subscription]{
+        subscription->io_service.run();
+      });
+    }
+
+
+    const bool RedisCacheDriver::Exists(const std::string& key){
+      const redisclient::RedisValue result = Command("EXISTS",{key});
+      return result.isInt() && result.toInt() > 0;
+    }
+
+
+    const bool RedisCacheDriver::Exists(const std::string& hash,const std::string& key){
+      const redisclient::RedisValue result = Command("HEXISTS",{hash,key});
+      return result.isInt() && result.toInt() > 0;
+    }
+
+
+    const std::string RedisCacheDriver::Read(const std::string& key){
+      const redisclient::RedisValue result = Command("GET",{key});
+      if (result.isString()){
+        return result.toString();
+      }
+      return std::string();
+    }
+
+
+    const std::string RedisCacheDriver::Read(const std::string& hash, const std::string& key){
+      const redisclient::RedisValue result = Command("HGET",{hash,key});
+      if (result.isString()){
+        return result.toString();
+      }
+      return std::string();
+    }
+
+
+    const bool RedisCacheDriver::ReadAll(const std::string& hash, std::map<std::string,std::string>& values){
+      values.clear();
+      const redisclient::RedisValue result = Command("HGETALL",{hash});
+      if (result.isArray()){
+        // reply alternates keys and values.
+        const std::vector<redisclient::RedisValue> reply = result.toArray();
+        for (std::size_t i = 0; i + 1 < reply.size(); i += 2){
+          values[reply[i].toString()] = reply[i+1].toString();
+        }
+      }
+      return !values.empty();
+    }
+
+
+    const bool RedisCacheDriver::ReadMany(const std::string& hash, const std::vector<std::string>& keys, std::vector<std::string>& values){
+      values.clear();
+      if (keys.empty()){
+        return Exists(hash);
+      }
+      std::deque<redisclient::RedisBuffer> args;
+      args.push_back(hash);
+      args.insert(args.end(),keys.begin(),keys.end());
+      const redisclient::RedisValue result = Pipeline([&](redisclient::Pipeline& pipeline){
+        pipeline.command("EXISTS",{hash})
+                .command("HMGET",args);
+      });
+      if (!result.isArray() || result.toArray().size() != 2){
+        return false;
+      }
+      const std::vector<redisclient::RedisValue> reply = result.toArray();
+      if (!reply[0].isInt() || reply[0].toInt() == 0){
+        return false;
+      }
+      const std::vector<redisclient::RedisValue> found = reply[1].toArray();
+      values.reserve(keys.size());
+      for (auto it = found.begin(); it != found.end(); ++it){
+        values.push_back(it->isString() ? it->toString() : std::string());
+      }
+      values.resize(keys.size());
+      return true;
+    }
+
+
+    void RedisCacheDriver::Write(const std::string& key,const std::string& value){
+      Command("SET",{key,value});
+    }
+
+
+    void RedisCacheDriver::Write(const std::string& hash,const std::string& key,const std::string& value){
+      Command("HSET",{hash,key,value});
+    }
+
+
+    const bool RedisCacheDriver::WriteIfNotExists(const std::string& key,const std::string& value){
+      const redisclient::RedisValue result = Command("SETNX",{key,value});
+      return result.isInt() && result.toInt() > 0;
+    }
+
+
+    const bool RedisCacheDriver::WriteIfNotExists(const std::string& hash,const std::string& key,const std::string& value){
+      const redisclient::RedisValue result = Command("HSETNX",{hash,key,value});
+      return result.isInt() && result.toInt() > 0;
+    }
+
+
+    const bool RedisCacheDriver::CompareAndSet(const std::string& hash,const std::string& key,const std::string& expected,const std::string& value){
+      // HGET returns false if the key does not exist.
+      static const std::string script =
+        "if (redis.call('HGET',KEYS[1],ARGV[1]) or '') == ARGV[2] then "
+        "redis.call('HSET',KEYS[1],ARGV[1],ARGV[3]) return 1 end return 0";
+      const redisclient::RedisValue result = Command("EVAL",{script,"1",hash,key,expected,value});
+      return result.isInt() && result.toInt() > 0;
+    }
+
+
+    const long long RedisCacheDriver::Increment(const std::string& key,const long long& increment){
+      const redisclient::RedisValue result = Command("INCRBY",{key,std::to_string(increment)});
+      if (result.isInt()){
+        return result.toInt();
+      }
+      return 0;
+    }
+
+
+    const long long RedisCacheDriver::Increment(const std::string& hash,const std::string& key,const long long& increment){
+      const redisclient::RedisValue result = Command("HINCRBY",{hash,key,std::to_string(increment)});
+      if (result.isInt()){
+        return result.toInt();
+      }
+      return 0;
+    }
+
+
+    const long long RedisCacheDriver::IncrementWithTTL(const std::string& key,const long long& increment,const long long& seconds){
+      static const std::string script =
+        "local value = redis.call('INCRBY',KEYS[1],ARGV[1]) "
+        "if redis.call('TTL',KEYS[1]) == -1 then redis.call('EXPIRE',KEYS[1],ARGV[2]) end "
+        "return value";
+      const redisclient::RedisValue result = Command("EVAL",{script,"1",key,std::to_string(increment),std::to_string(seconds)});
+      if (result.isInt()){
+        return result.toInt();
+      }
+      return 0;
+    }
+
+
+    const long long RedisCacheDriver::TakeTokens(const std::string& key,const long long& tokens,const long long& capacity,const double& rate){
+      // same computation as TokenBucket::Take, levels in millitokens.
+      static const std::string script =
+        "local full = tonumber(ARGV[2]) * 1000 "
+        "local rate = tonumber(ARGV[3]) "
+        "local now = tonumber(ARGV[4]) "
+        "local level, time = full, now "
+        "local state = redis.call('HGET',KEYS[1],ARGV[5]) "
+        "if state then "
+          "local l, t = string.match(state,'^(%-?%d+) (%-?%d+)$') "
+          "if l then "
+            "level, time = tonumber(l), tonumber(t) "
+            "if now > time then level = level + math.floor((now - time) * rate) time = now end "
+            "if level > full then level = full end "
+          "end "
+        "end "
+        "local take = tonumber(ARGV[1]) * 1000 "
+        "if level < take then return -1 end "
+        "level = level - take "
+        "redis.call('HSET',KEYS[1],ARGV[5],string.format('%d %d',level,time)) "
+        "if rate > 0 then redis.call('EXPIRE',KEYS[1],math.ceil((full - level) / (rate * 1000)) + 1) end "
+        "return math.floor(level / 1000)";
+      const redisclient::RedisValue result = Command("EVAL",{script,"1",key,std::to_string(tokens),std::to_string(capacity),std::to_string(rate),std::to_string(granada::cache::TokenBucket::Now()),granada::cache::TokenBucket::FIELD});
+      if (result.isInt()){
+        return result.toInt();
+      }
+      return -1;
+    }
+
+
+    void RedisCacheDriver::Destroy(const std::string& key){
+      if (key.find("*") != std::string::npos){
+        DestroyMatch(key);
+      }else{
+        Command("DEL",{key});
+      }
+    }
+
+
+    void RedisCacheDriver::Destroy(const std::string& hash,const std::string& key){
+      Command("HDEL",{hash,key});
+    }
+
+
+    const std::size_t RedisCacheDriver::DestroyMatch(const std::string& expression){
+      // remove each SCAN batch with one DEL,
+      // DEL replies the number of keys removed.
+      std::size_t destroyed = 0;
+      std::string cursor = "0";
+      std::deque<std::string> keys;
+      do{
+        keys.clear();
+        Scan(cursor,expression,keys);
+        if (!keys.empty()){
+          std::deque<redisclient::RedisBuffer> args(keys.begin(),keys.end());
+          const redisclient::RedisValue result = Command("DEL",std::move(args));
+          if (result.isInt()){
+            destroyed += (std::size_t)result.toInt();
+          }
+        }
+      }while(cursor != "0");
+      return destroyed;
+    }
+
+
+    bool RedisCacheDriver::Rename(const std::string& old_key, const std::string& new_key){
+      // RENAMENX replies an error if old_key does not exist.
+      const redisclient::RedisValue result = Command("RENAMENX",{old_key,new_key});
+      return result.isInt() && result.toInt() == 1;
+    }
+
+
+    const bool RedisCacheDriver::Expire(const std::string& key, const long long& seconds){
+      if (seconds < 0){
+        // PERSIST replies 0 if the key has no time to live.
+        return Exists(key) && Command("PERSIST",{key}).isOk();
+      }
+      const redisclient::RedisValue result = Command("EXPIRE",{key,std::to_string(seconds)});
+      return result.isInt() && result.toInt() == 1;
+    }
+
+
+    const long long RedisCacheDriver::TTL(const std::string& key){
+      const redisclient::RedisValue result = Command("TTL",{key});
+      if (result.isInt()){
+        return result.toInt();
+      }
+      return -2;
+    }
+
+
+    void RedisCacheDriver::WriteWithTTL(const std::string& key,const std::string& value,const long long& seconds){
+      if (seconds < 0){
+        Write(key,value);
+      }else if (seconds == 0){
+        Destroy(key);
+      }else{
+        Command("SET",{key,value,"EX",std::to_string(seconds)});
+      }
+    }
+
+
+    void RedisCacheDriver::WriteWithTTL(const std::string& hash,const std::string& key,const std::string& value,const long long& seconds){
+      if (seconds < 0){
+        Write(hash,key,value);
+        return;
+      }
+      const std::string seconds_str = std::to_string(seconds);
+      Pipeline([&](redisclient::Pipeline& pipeline){
+        pipeline.command("MULTI",{})
+                .command("HSET",{hash,key,value})
+                .command("EXPIRE",{hash,seconds_str})
+                .command("EXEC",{});
+      });
+    }
+
+
+    void RedisCacheDriver::WriteMany(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values){
+      if (values.empty()){
+        return;
+      }
+      Command("HSET",Fields(hash,values));
+    }
+
+
+    void RedisCacheDriver::WriteManyWithTTL(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values,const long long& seconds){
+      if (seconds < 0){
+        WriteMany(hash,values);
+        Command("PERSIST",{hash});
+        return;
+      }
+      const std::deque<redisclient::RedisBuffer> args = Fields(hash,values);
+      const std::string seconds_str = std::to_string(seconds);
+      Pipeline([&](redisclient::Pipeline& pipeline){
+        pipeline.command("MULTI",{})
+                .command("HSET",args)
+                .command("EXPIRE",{hash,seconds_str})
+                .command("EXEC",{});
+      });
+    }
+
+
+    void RedisCacheDriver::Scan(std::string& cursor, const std::string& pattern, std::deque<std::string>& keys){
+      const redisclient::RedisValue result = Command("SCAN",{cursor,"MATCH",Pattern(pattern),"COUNT",std::to_string(default_numbers::redis_cache_driver_scan_count)});
+      if (!result.isArray() || result.toArray().size() != 2){
+        // server not reachable, end the iteration.
+        cursor = "0";
+        return;
+      }
+      const std::vector<redisclient::RedisValue> reply = result.toArray();
+      cursor = reply[0].toString();
+      const std::vector<redisclient::RedisValue> found = reply[1].toArray();
+      for (auto it = found.begin(); it != found.end(); ++it){
+        keys.push_back(it->toString());
+      }
+    }
+
+
+    redisclient::RedisValue RedisCacheDriver::Command(const std::string& command, std::deque<redisclient::RedisBuffer> args){
+      for (int attempt = 0; attempt < 2; ++attempt){
+        std::unique_ptr<RedisConnection> connection = pool_->Acquire();
+        if (connection == nullptr){
+          break;
+        }
+        boost::system::error_code ec;
+        redisclient::RedisValue result = connection->client.command(command,args,ec);
+        const bool broken = (bool)ec;
+        pool_->Release(std::move(connection),broken);
+        if (!broken){
+          return result;
+        }
+      }
+      return redisclient::RedisValue(std::vector<char>(),redisclient::RedisValue::ErrorTag());
+    }
+
+
+    redisclient::RedisValue RedisCacheDriver::Pipeline(const std::function<void(redisclient::Pipeline&)>& commands){
+      for (int attempt = 0; attempt < 2; ++attempt){
+        std::unique_ptr<RedisConnection> connection = pool_->Acquire();
+        if (connection == nullptr){
+          break;
+        }
+        bool broken = false;
+        redisclient::RedisValue result;
+        try{
+          redisclient::Pipeline pipeline = connection->client.pipelined();
+          commands(pipeline);
+          result = pipeline.finish();
+        }catch(const boost::system::system_error e){
+          broken = true;
+        }
+        pool_->Release(std::move(connection),broken);
+        if (!broken){
+          return result;
+        }
+      }
+      return redisclient::RedisValue(std::vector<char>(),redisclient::RedisValue::ErrorTag());
+    }
+
+
+    std::deque<redisclient::RedisBuffer> RedisCacheDriver::Fields(const std::string& hash, const std::vector<std::pair<std::string,std::string>>& values){
+      std::deque<redisclient::RedisBuffer> args;
+      args.push_back(hash);
+      for (auto it = values.begin(); it != values.end(); ++it){
+        args.push_back(it->first);
+        args.push_back(it->second);
+      }
+      return args;
+    }
+
+
+    std::string RedisCacheDriver::Pattern(const std::string& expression){
+      std::string pattern;
+      pattern.reserve(expression.size());
+      for (auto it = expression.begin(); it != expression.end(); ++it){
+        if (*it == '?' || *it == '[' || *it == ']' || *it == '\\'){
+          pattern += '\\';
+        }
+        pattern += *it;
+      }
+      return pattern;
+    }
+  }
+}
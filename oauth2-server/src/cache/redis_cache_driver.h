@@ -0,0 +1,682 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Manages the cache storing key-value pairs in a Redis server.
+  * Values written with Write(key,value) are Redis strings,
+  * sets written with Write(hash,key,value) are Redis hashes.
+  *
+  * Uses redisclient (https://github.com/nekipelov/redisclient)
+  * synchronous clients, one per connection. Connections are
+  * pooled so concurrent threads do not share a client.
+  *
+  * This code is multi-thread safe.
+  *
+  */
+
+#pragma once
+#include "cache_handler.h"
+#include <string>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <thread>
+#include "redisclient/redissyncclient.h"
+#include "redisclient/redisasyncclient.h"
+#include "cache/cache_notifier.h"
+#include "util/application.h"
+#include "defaults.h"
+
+namespace granada{
+  namespace cache{
+
+    class RedisCacheDriver;
+
+    /**
+     * Tool for iterate over cache keys with a given pattern,
+     * uses Redis SCAN so keys are retrieved in batches.
+     * As with SCAN, a key may be returned more than once.
+     */
+    class RedisIterator : public CacheHandlerIterator{
+
+      public:
+
+        /**
+         * Constructor
+         */
+        RedisIterator(){};
+
+
+        /**
+         * Constructor
+         * @param   expression  Expression to search keys.
+         *                      Example: session:value:*
+         * @param   cache       Cache containing the keys.
+         */
+        RedisIterator(const std::string& expression, RedisCacheDriver* cache);
+
+
+        /**
+         * Destructor
+         */
+        virtual ~RedisIterator(){};
+
+
+        /**
+         * Set the iterator, useful to reuse it.
+         * @param expression Filter pattern/expression.
+         */
+        virtual void set(const std::string& expression) override;
+
+
+        /**
+         * Return true if there is another key matching the pattern,
+         * false if there is not.
+         * @return True | False
+         */
+        virtual const bool has_next();
+
+
+        /**
+         * Return the next key found with the given pattern.
+         * @return found Key
+         */
+        virtual const std::string next();
+
+
+      protected:
+
+        /**
+         * Cache containing the keys to iterate.
+         */
+        RedisCacheDriver* cache_;
+
+
+        /**
+         * SCAN cursor, "0" when the iteration is over.
+         */
+        std::string cursor_;
+
+
+        /**
+         * True if SCAN has been called at least once.
+         */
+        bool started_ = false;
+
+
+        /**
+         * Found keys of the current batch not returned yet.
+         */
+        std::deque<std::string> keys_;
+
+
+        /**
+         * Calls SCAN until a key is found or the
+         * iteration is over.
+         */
+        void Fetch();
+    };
+
+
+    /**
+     * Connection to the Redis server.
+     */
+    struct RedisConnection{
+
+      RedisConnection() : client(io_service){};
+
+      boost::asio::io_service io_service;
+      redisclient::RedisSyncClient client;
+    };
+
+
+    /**
+     * Connection to the Redis server receiving the keyspace
+     * notifications, run by its own thread.
+     */
+    struct RedisSubscription{
+
+      RedisSubscription() : client(io_service){};
+
+      boost::asio::io_service io_service;
+      redisclient::RedisAsyncClient client;
+      std::thread thread;
+    };
+
+
+    /**
+     * Pool of connections to a Redis server. Connections are
+     * opened when needed, up to the size of the pool, threads
+     * wait for a free connection once all are in use.
+     */
+    class RedisConnectionPool{
+
+      public:
+
+        /**
+         * Constructor
+         * @param address Address of the Redis server.
+         * @param port    Port of the Redis server.
+         * @param size    Maximum number of connections.
+         */
+        RedisConnectionPool(const std::string& address, const unsigned short& port, const std::size_t& size);
+
+
+        /**
+         * Returns a connected connection, waiting for one if all
+         * are in use. Returns nullptr if the connection could not be
+         * opened.
+         * @return  Connection, to give back with Release.
+         */
+        std::unique_ptr<RedisConnection> Acquire();
+
+
+        /**
+         * Gives back a connection obtained with Acquire.
+         * @param connection  Connection.
+         * @param broken      True if the connection failed, it is
+         *                    closed instead of reused.
+         */
+        void Release(std::unique_ptr<RedisConnection> connection, const bool& broken);
+
+
+        /**
+         * Returns the address and port of the Redis server.
+         */
+        const boost::asio::ip::tcp::endpoint& endpoint() const {
+          return endpoint_;
+        };
+
+
+      private:
+
+        /**
+         * Redis server address and port.
+         */
+        boost::asio::ip::tcp::endpoint endpoint_;
+
+
+        /**
+         * Maximum number of connections.
+         */
+        std::size_t size_;
+
+
+        /**
+         * Number of open connections, idle or in use.
+         */
+        std::size_t open_ = 0;
+
+
+        /**
+         * Connections not in use.
+         */
+        std::vector<std::unique_ptr<RedisConnection>> idle_;
+
+
+        /**
+         * Protects open_ and idle_.
+         */
+        std::mutex mtx_;
+
+
+        /**
+         * Notified when a connection is released.
+         */
+        std::condition_variable cv_;
+    };
+
+
+    /**
+     * Manages the cache storing key-value pairs in a Redis server.
+     * The address and port of the server are taken from the
+     * "redis_cache_driver_address" and "redis_cache_driver_port"
+     * properties, the size of the connection pool from
+     * "redis_cache_driver_connections".
+     *
+     * Commands that are sent together are pipelined, they are
+     * written in one go and their replies read afterwards.
+     */
+    class RedisCacheDriver : public CacheHandler
+    {
+
+      public:
+
+        // operations with CacheKey keys of CacheHandler, otherwise
+        // hidden by the operations of the same name of this driver.
+        using CacheHandler::Exists;
+        using CacheHandler::Read;
+        using CacheHandler::ReadAll;
+        using CacheHandler::ReadMany;
+        using CacheHandler::Write;
+        using CacheHandler::WriteMany;
+        using CacheHandler::WriteIfNotExists;
+        using CacheHandler::CompareAndSet;
+        using CacheHandler::Increment;
+        using CacheHandler::Destroy;
+        using CacheHandler::DestroyMatch;
+        using CacheHandler::Expire;
+        using CacheHandler::WriteWithTTL;
+        using CacheHandler::WriteManyWithTTL;
+        using CacheHandler::IncrementWithTTL;
+        using CacheHandler::TakeTokens;
+        using CacheHandler::make_iterator;
+        using CacheHandler::ReadAsync;
+        using CacheHandler::ReadManyAsync;
+
+
+        /**
+         * Constructor
+         */
+        RedisCacheDriver();
+
+
+        /**
+         * Constructor
+         * @param address     Address of the Redis server.
+         * @param port        Port of the Redis server.
+         * @param connections Maximum number of connections.
+         */
+        RedisCacheDriver(const std::string& address, const unsigned short& port, const std::size_t& connections);
+
+
+        /**
+         * Destructor
+         * Closes the connection receiving the keyspace notifications.
+         */
+        virtual ~RedisCacheDriver();
+
+
+        /**
+         * Returns true if key exists, false if it does not.
+         * @param  key Key.
+         * @return     True if key exists, false if it does not.
+         */
+        virtual const bool Exists(const std::string& key) override;
+
+
+        /**
+         * Checks if a key exist in a set with given hash.
+         * @param  hash Name of the set of key-value.
+         * @param  key  Key of the value
+         * @return      True if exist, false if it does not.
+         */
+        virtual const bool Exists(const std::string& hash,const std::string& key) override;
+
+
+        /**
+         * Returns value from the cache.
+         * @param  key Key of the value.
+         * @return     Value
+         */
+        virtual const std::string Read(const std::string& key) override;
+
+
+        /**
+         * Returns the value stored in a set and associated with the given key.
+         * @param  hash Name of the set where the key-value pairs are stored.
+         * @param  key  Key associated with the value.
+         * @return      Value.
+         */
+        virtual const std::string Read(const std::string& hash, const std::string& key) override;
+
+
+        /**
+         * Fills a map with all the key-value pairs of a set, uses HGETALL.
+         * @param  hash   Name of the set.
+         * @param  values Map filled with the key-value pairs.
+         * @return        True if the set exists, false if it does not.
+         */
+        virtual const bool ReadAll(const std::string& hash, std::map<std::string,std::string>& values) override;
+
+
+        /**
+         * Returns the values of several keys of a set, EXISTS and
+         * HMGET are pipelined.
+         * @param  hash   Name of the set.
+         * @param  keys   Keys associated with the values.
+         * @param  values Vector filled with the value of each key.
+         * @return        True if the set exists, false if it does not.
+         */
+        virtual const bool ReadMany(const std::string& hash, const std::vector<std::string>& keys, std::vector<std::string>& values) override;
+
+
+        /**
+         * Sets a value in the cache associated with a given key.
+         * @param key   Key of the value.
+         * @param value Value.
+         */
+        virtual void Write(const std::string& key,const std::string& value) override;
+
+
+        /**
+         * Inserts or rewrite a key-value pair in a set with the given name.
+         * If the set does not exist, it creates it.
+         * @param hash  Name of the set.
+         * @param key   Key to identify the value inside the set.
+         * @param value Value
+         */
+        virtual void Write(const std::string& hash,const std::string& key,const std::string& value) override;
+
+
+        /**
+         * Inserts or rewrite several key-value pairs in a set
+         * with one HSET.
+         * @param hash    Name of the set.
+         * @param values  Key-value pairs.
+         */
+        virtual void WriteMany(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values) override;
+
+
+        /**
+         * Sets a value only if the key does not exist, with SETNX.
+         * @param key   Key of the value.
+         * @param value Value.
+         * @return      True if the value has been written.
+         */
+        virtual const bool WriteIfNotExists(const std::string& key,const std::string& value) override;
+
+
+        /**
+         * Inserts a key-value pair in a hash only if the key does
+         * not exist in the hash, with HSETNX.
+         * @param hash  Name of the hash.
+         * @param key   Key to identify the value inside the hash.
+         * @param value Value
+         * @return      True if the value has been written.
+         */
+        virtual const bool WriteIfNotExists(const std::string& hash,const std::string& key,const std::string& value) override;
+
+
+        /**
+         * Replaces the value of a key in a hash only if its current
+         * value is the expected one. Redis has no command for it so
+         * a script compares and sets the value, scripts run atomically.
+         * @param hash      Name of the hash.
+         * @param key       Key to identify the value inside the hash.
+         * @param expected  Expected current value, empty if the key does not exist.
+         * @param value     New value.
+         * @return          True if the value has been replaced.
+         */
+        virtual const bool CompareAndSet(const std::string& hash,const std::string& key,const std::string& expected,const std::string& value) override;
+
+
+        /**
+         * Adds a number to the integer value of a key, with INCRBY.
+         * @param key       Key of the value.
+         * @param increment Number to add, may be negative.
+         * @return          Value after the increment, 0 if Redis refuses
+         *                  it because the value is not an integer.
+         */
+        virtual const long long Increment(const std::string& key,const long long& increment) override;
+
+
+        /**
+         * Adds a number to the integer value of a key in a hash, with HINCRBY.
+         * @param hash      Name of the hash.
+         * @param key       Key to identify the value inside the hash.
+         * @param increment Number to add, may be negative.
+         * @return          Value after the increment, 0 if Redis refuses
+         *                  it because the value is not an integer.
+         */
+        virtual const long long Increment(const std::string& hash,const std::string& key,const long long& increment) override;
+
+
+        /**
+         * Adds a number to the integer value of a key and sets its
+         * time to live if it has none, in one script.
+         * @param key       Key of the value.
+         * @param increment Number to add, may be negative.
+         * @param seconds   Seconds the key will live from its first increment.
+         * @return          Value after the increment, 0 if Redis refuses
+         *                  it because the value is not an integer.
+         */
+        virtual const long long IncrementWithTTL(const std::string& key,const long long& increment,const long long& seconds) override;
+
+
+        /**
+         * Takes tokens from the token bucket stored in a hash if it has
+         * enough of them, in one script running the computation of
+         * TokenBucket. The time is the one of the calling server.
+         * @param key       Key of the bucket.
+         * @param tokens    Number of tokens to take.
+         * @param capacity  Maximum number of tokens of the bucket.
+         * @param rate      Tokens added to the bucket per second.
+         * @return          Number of tokens left, -1 if the bucket
+         *                  did not have enough tokens.
+         */
+        virtual const long long TakeTokens(const std::string& key,const long long& tokens,const long long& capacity,const double& rate) override;
+
+
+        /**
+         * Removes a key-value pair from the cache.
+         * @param key Key, can contain "*" to remove all the keys matching it.
+         */
+        virtual void Destroy(const std::string& key) override;
+
+
+        /**
+         * Destroys a key-value pair stored in a set.
+         * @param hash Name of the set where the key-value pair is stored.
+         * @param key  Key associated with the value.
+         */
+        virtual void Destroy(const std::string& hash,const std::string& key) override;
+
+
+        /**
+         * Destroys all the keys matching an expression, removing each
+         * SCAN batch with one DEL. Keys written while scanning may
+         * survive, Redis has no atomic pattern delete.
+         * @param expression  Expression, as in Match.
+         * @return            Number of keys destroyed.
+         */
+        virtual const std::size_t DestroyMatch(const std::string& expression) override;
+
+
+        /**
+         * Renames a key if the new key does not already exist, uses RENAMENX.
+         * @param old_key Old key to rename.
+         * @param new_key New key.
+         * @return        True if the key could be renamed, false if not.
+         */
+        virtual bool Rename(const std::string& old_key, const std::string& new_key) override;
+
+
+        /**
+         * Keys can expire.
+         * @return  True.
+         */
+        virtual const bool SupportsExpire() override {
+          return true;
+        };
+
+
+        /**
+         * Sets the time to live of a key, uses EXPIRE or PERSIST.
+         * @param key     Key.
+         * @param seconds Seconds the key will live from now,
+         *                -1 to remove the time to live of the key.
+         * @return        True if the time to live was set, false if the
+         *                key does not exist.
+         */
+        virtual const bool Expire(const std::string& key, const long long& seconds) override;
+
+
+        /**
+         * Returns the remaining time to live of a key.
+         * @param key Key.
+         * @return    Remaining seconds, -1 if the key exists but
+         *            does not expire, -2 if the key does not exist.
+         */
+        virtual const long long TTL(const std::string& key) override;
+
+
+        /**
+         * Sets a value and the time to live of the key with SET EX.
+         * @param key     Key of the value.
+         * @param value   Value.
+         * @param seconds Seconds the key will live from now.
+         */
+        virtual void WriteWithTTL(const std::string& key,const std::string& value,const long long& seconds) override;
+
+
+        /**
+         * Sets a value of a set and the time to live of the set,
+         * HSET and EXPIRE are pipelined in a MULTI/EXEC transaction.
+         * @param hash    Name of the set.
+         * @param key     Key to identify the value inside the set.
+         * @param value   Value
+         * @param seconds Seconds the set will live from now.
+         */
+        virtual void WriteWithTTL(const std::string& hash,const std::string& key,const std::string& value,const long long& seconds) override;
+
+
+        /**
+         * Sets several values of a set and the time to live of the set,
+         * HSET and EXPIRE are pipelined in a MULTI/EXEC transaction.
+         * @param hash    Name of the set.
+         * @param values  Key-value pairs.
+         * @param seconds Seconds the set will live from now.
+         */
+        virtual void WriteManyWithTTL(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values,const long long& seconds) override;
+
+
+        /**
+         * Returns an iterator to iterate over keys with an expression.
+         */
+        virtual std::unique_ptr<granada::cache::CacheHandlerIterator> make_iterator(const std::string& expression) override {
+          return granada::util::memory::make_unique<granada::cache::RedisIterator>(expression,this);
+        };
+
+
+        /**
+         * Calls the given function with the changes of the keys matching
+         * an expression, received from the keyevent notifications of
+         * the Redis server, so changes made by other processes are
+         * notified too. The server has to publish them, with
+         * notify-keyspace-events set to at least "E$ghxe" in redis.conf.
+         * The first subscription opens a connection to receive them,
+         * changes made while it is down are not notified.
+         *
+         * @param expression  Expression, example: session:roles:*
+         * @param subscriber  Function called with each change.
+         * @return            Identifier of the subscription.
+         */
+        virtual const std::size_t Subscribe(const std::string& expression, const granada::cache::CacheSubscriber& subscriber) override;
+
+
+        /**
+         * Cancels a subscription.
+         * @param subscription  Identifier returned by Subscribe.
+         */
+        virtual void Unsubscribe(const std::size_t& subscription) override {
+          notifier_.Unsubscribe(subscription);
+        };
+
+
+        /**
+         * Calls SCAN once.
+         * @param cursor  SCAN cursor, "0" to start, updated with
+         *                the cursor returned by Redis.
+         * @param pattern Glob pattern, only "*" is special.
+         * @param keys    Deque where found keys are added.
+         */
+        void Scan(std::string& cursor, const std::string& pattern, std::deque<std::string>& keys);
+
+
+        /**
+         * Sends a command and returns its reply. If the connection
+         * fails the command is sent again once with a new connection.
+         * @param  command  Command, example: HGET.
+         * @param  args     Arguments of the command.
+         * @return          Reply, error reply if the server could not be reached.
+         */
+        redisclient::RedisValue Command(const std::string& command, std::deque<redisclient::RedisBuffer> args);
+
+
+        /**
+         * Sends several commands pipelined and returns their replies.
+         * If the connection fails the commands are sent again once
+         * with a new connection, so they have to be idempotent.
+         * @param  commands Adds the commands to the given pipeline.
+         * @return          Array with the reply of each command, error
+         *                  reply if the server could not be reached.
+         */
+        redisclient::RedisValue Pipeline(const std::function<void(redisclient::Pipeline&)>& commands);
+
+
+      protected:
+
+        /**
+         * Pool of connections to the Redis server.
+         */
+        std::unique_ptr<RedisConnectionPool> pool_;
+
+
+        /**
+         * Escapes the Redis glob special characters other than "*",
+         * so patterns match like in the other cache drivers.
+         * @param  expression Expression, example: session:value:*
+         * @return            Redis glob pattern.
+         */
+        static std::string Pattern(const std::string& expression);
+
+
+        /**
+         * Returns the arguments of an HSET setting several fields.
+         * @param  hash   Name of the set.
+         * @param  values Key-value pairs.
+         * @return        Arguments: hash key1 value1 key2 value2...
+         */
+        static std::deque<redisclient::RedisBuffer> Fields(const std::string& hash, const std::vector<std::pair<std::string,std::string>>& values);
+
+
+        /**
+         * Delivers the changes of the keys to the subscribers.
+         */
+        granada::cache::CacheNotifier notifier_;
+
+
+        /**
+         * Connection receiving the keyspace notifications,
+         * nullptr until the first subscription.
+         */
+        std::unique_ptr<RedisSubscription> subscription_;
+
+
+        /**
+         * Used to open the subscription connection only once.
+         */
+        std::once_flag subscription_flag_;
+
+
+        /**
+         * Opens the connection receiving the keyspace notifications
+         * and subscribes to the events of the cache operations.
+         */
+        void Listen();
+    };
+  }
+}
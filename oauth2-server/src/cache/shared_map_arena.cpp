@@ -0,0 +1,137 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Slab allocator of the containers of a shared map cache driver shard.
+  *
+  */
+
+#include "shared_map_arena.h"
+#include "defaults.h"
+
+namespace granada{
+  namespace cache{
+
+    const std::size_t SharedMapArena::ALIGNMENT;
+    const std::size_t SharedMapArena::MAX_BLOCK_BYTES;
+
+
+    SharedMapArena::SharedMapArena() : SharedMapArena(default_numbers::shared_map_cache_driver_slab_bytes){}
+
+
+    SharedMapArena::SharedMapArena(const std::size_t& slab_bytes){
+      slab_bytes_ = slab_bytes < MAX_BLOCK_BYTES ? MAX_BLOCK_BYTES : slab_bytes;
+
+      // classes every 16 bytes up to 256 bytes, then four
+      // classes between each power of two.
+      std::size_t block_bytes = ALIGNMENT;
+      while (block_bytes <= MAX_BLOCK_BYTES){
+        SizeClass size_class;
+        size_class.block_bytes = block_bytes;
+        classes_.push_back(size_class);
+        if (block_bytes < 256){
+          block_bytes += ALIGNMENT;
+        }else{
+          std::size_t power = 256;
+          while (power * 2 <= block_bytes){
+            power *= 2;
+          }
+          block_bytes += power / 4;
+        }
+      }
+
+      class_index_.resize(MAX_BLOCK_BYTES / ALIGNMENT + 1);
+      std::size_t index = 0;
+      for (std::size_t units = 0; units < class_index_.size(); ++units){
+        while (classes_[index].block_bytes < units * ALIGNMENT){
+          ++index;
+        }
+        class_index_[units] = (unsigned char)index;
+      }
+    }
+
+
+    SharedMapArena::~SharedMapArena(){
+      for (auto it = slabs_.begin(); it != slabs_.end(); ++it){
+        ::operator delete(*it);
+      }
+    }
+
+
+    void* SharedMapArena::Allocate(const std::size_t& bytes){
+      allocated_bytes_ += bytes;
+      if (bytes > MAX_BLOCK_BYTES){
+        large_bytes_ += bytes;
+        return ::operator new(bytes);
+      }
+      SizeClass& size_class = this->size_class(bytes);
+      if (size_class.free == nullptr){
+        Grow(size_class);
+      }
+      void* block = size_class.free;
+      size_class.free = *static_cast<void**>(block);
+      ++size_class.used;
+      return block;
+    }
+
+
+    void SharedMapArena::Deallocate(void* block, const std::size_t& bytes){
+      allocated_bytes_ -= bytes;
+      if (bytes > MAX_BLOCK_BYTES){
+        large_bytes_ -= bytes;
+        ::operator delete(block);
+        return;
+      }
+      SizeClass& size_class = this->size_class(bytes);
+      *static_cast<void**>(block) = size_class.free;
+      size_class.free = block;
+      --size_class.used;
+    }
+
+
+    const SharedMapArenaStats SharedMapArena::Stats() const {
+      SharedMapArenaStats stats;
+      stats.allocated_bytes = allocated_bytes_;
+      stats.slabs = slabs_.size();
+      stats.reserved_bytes = slabs_.size() * slab_bytes_ + large_bytes_;
+      for (auto it = classes_.begin(); it != classes_.end(); ++it){
+        stats.slab_blocks += it->blocks;
+        stats.used_slab_blocks += it->used;
+      }
+      return stats;
+    }
+
+
+    void SharedMapArena::Grow(SizeClass& size_class){
+      char* slab = static_cast<char*>(::operator new(slab_bytes_));
+      slabs_.push_back(slab);
+      const std::size_t blocks = slab_bytes_ / size_class.block_bytes;
+      for (std::size_t i = blocks; i > 0; --i){
+        void* block = slab + (i - 1) * size_class.block_bytes;
+        *static_cast<void**>(block) = size_class.free;
+        size_class.free = block;
+      }
+      size_class.blocks += blocks;
+    }
+
+  }
+}
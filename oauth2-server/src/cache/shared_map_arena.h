@@ -0,0 +1,287 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Slab allocator of the containers of a shared map cache driver shard.
+  *
+  */
+
+#pragma once
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace granada{
+  namespace cache{
+
+    /**
+     * Counters of the memory of an arena.
+     */
+    struct SharedMapArenaStats{
+
+      /**
+       * Bytes allocated by the containers and not released.
+       */
+      std::size_t allocated_bytes = 0;
+
+      /**
+       * Bytes taken from the heap: the slabs and the
+       * blocks too big for the slabs.
+       */
+      std::size_t reserved_bytes = 0;
+
+      /**
+       * Number of slabs.
+       */
+      std::size_t slabs = 0;
+
+      /**
+       * Number of blocks of the slabs.
+       */
+      std::size_t slab_blocks = 0;
+
+      /**
+       * Number of blocks of the slabs in use.
+       */
+      std::size_t used_slab_blocks = 0;
+    };
+
+
+    /**
+     * Memory of the containers of a shard.
+     * Allocations are rounded up to a size class and served from slabs
+     * of blocks of that size. A released block goes to the free list of
+     * its class and is reused by the next allocation of the class, so
+     * the churn of keys reuses the same slabs instead of fragmenting the
+     * heap, and the memory of a long running cache stays flat.
+     * Slabs are only released when the arena is destroyed.
+     * Blocks bigger than the biggest size class are taken from the heap.
+     *
+     * Not thread safe, used under the lock of its shard.
+     */
+    class SharedMapArena{
+
+      public:
+
+        /**
+         * Constructor
+         * Uses slabs of default_numbers::shared_map_cache_driver_slab_bytes.
+         */
+        SharedMapArena();
+
+
+        /**
+         * Constructor
+         * @param slab_bytes  Size of the slabs in bytes.
+         */
+        SharedMapArena(const std::size_t& slab_bytes);
+
+
+        /**
+         * Destructor
+         * Releases the slabs, the blocks must have been released before.
+         */
+        virtual ~SharedMapArena();
+
+
+        /**
+         * Returns a block of at least the given number of bytes.
+         * @param bytes Bytes.
+         * @return      Block, aligned as operator new.
+         */
+        void* Allocate(const std::size_t& bytes);
+
+
+        /**
+         * Releases a block.
+         * @param block Block returned by Allocate.
+         * @param bytes Bytes requested when the block was allocated.
+         */
+        void Deallocate(void* block, const std::size_t& bytes);
+
+
+        /**
+         * Returns the counters of the arena.
+         */
+        const SharedMapArenaStats Stats() const;
+
+
+      private:
+
+        SharedMapArena(const SharedMapArena&) = delete;
+        SharedMapArena& operator=(const SharedMapArena&) = delete;
+
+
+        /**
+         * Blocks of the same size.
+         */
+        struct SizeClass{
+
+          /**
+           * Size of the blocks.
+           */
+          std::size_t block_bytes;
+
+          /**
+           * First free block, each free block stores a
+           * pointer to the next one.
+           */
+          void* free = nullptr;
+
+          /**
+           * Number of blocks and number of blocks in use.
+           */
+          std::size_t blocks = 0;
+          std::size_t used = 0;
+        };
+
+
+        /**
+         * Granularity of the size classes and biggest size
+         * class, bigger blocks are taken from the heap.
+         */
+        static const std::size_t ALIGNMENT = 16;
+        static const std::size_t MAX_BLOCK_BYTES = 1024;
+
+
+        /**
+         * Size of the slabs.
+         */
+        std::size_t slab_bytes_;
+
+
+        /**
+         * Size classes, from the smallest to the biggest.
+         */
+        std::vector<SizeClass> classes_;
+
+
+        /**
+         * Index of the size class of each
+         * number of ALIGNMENT units.
+         */
+        std::vector<unsigned char> class_index_;
+
+
+        /**
+         * Slabs taken from the heap.
+         */
+        std::vector<void*> slabs_;
+
+
+        /**
+         * Bytes allocated and not released.
+         */
+        std::size_t allocated_bytes_ = 0;
+
+
+        /**
+         * Bytes of the blocks taken from the heap.
+         */
+        std::size_t large_bytes_ = 0;
+
+
+        /**
+         * Returns the size class of an allocation.
+         * @param bytes Bytes, not bigger than MAX_BLOCK_BYTES.
+         */
+        SizeClass& size_class(const std::size_t& bytes){
+          return classes_[class_index_[(bytes + ALIGNMENT - 1) / ALIGNMENT]];
+        };
+
+
+        /**
+         * Takes a new slab from the heap and adds its
+         * blocks to the free list of a size class.
+         * @param size_class Size class.
+         */
+        void Grow(SizeClass& size_class);
+    };
+
+
+    /**
+     * Standard allocator taking the memory from an arena, or
+     * from the heap if it has no arena. Containers of a shard
+     * are constructed with an allocator of the arena of the shard.
+     */
+    template <class T>
+    class SharedMapAllocator{
+
+      public:
+
+        typedef T value_type;
+
+
+        SharedMapAllocator() : arena_(nullptr){};
+
+
+        SharedMapAllocator(SharedMapArena* arena) : arena_(arena){};
+
+
+        template <class U>
+        SharedMapAllocator(const SharedMapAllocator<U>& other) : arena_(other.arena()){};
+
+
+        T* allocate(std::size_t n){
+          if (arena_ == nullptr){
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+          }
+          return static_cast<T*>(arena_->Allocate(n * sizeof(T)));
+        };
+
+
+        void deallocate(T* p, std::size_t n){
+          if (arena_ == nullptr){
+            ::operator delete(p);
+          }else{
+            arena_->Deallocate(p, n * sizeof(T));
+          }
+        };
+
+
+        /**
+         * Returns the arena of the allocator, nullptr if it uses the heap.
+         */
+        SharedMapArena* arena() const {
+          return arena_;
+        };
+
+
+      private:
+
+        SharedMapArena* arena_;
+    };
+
+
+    template <class T, class U>
+    bool operator==(const SharedMapAllocator<T>& a, const SharedMapAllocator<U>& b){
+      return a.arena() == b.arena();
+    }
+
+
+    template <class T, class U>
+    bool operator!=(const SharedMapAllocator<T>& a, const SharedMapAllocator<U>& b){
+      return a.arena() != b.arena();
+    }
+
+  }
+}
@@ -25,49 +25,219 @@
   */
 
 #include "cache/shared_map_cache_driver.h"
+#include "cpprest/json.h"
 
 namespace granada{
   namespace cache{
 
+    // field of the records storing the value of a plain key.
+    static const std::string VALUE_FIELD = "__";
+
+
     SharedMapIterator::SharedMapIterator(const std::string& expression, SharedMapCacheDriver* cache){
       cache_ = cache;
       set(expression);
     }
 
 
+    SharedMapIterator::SharedMapIterator(const std::string& expression, SharedMapCacheDriver* cache, const std::size_t& batch_size){
+      cache_ = cache;
+      if (batch_size > 0){
+        batch_size_ = batch_size;
+      }
+      set(expression);
+    }
+
+
     void SharedMapIterator::set(const std::string& expression){
       expression_ = expression;
-      std::deque<std::pair<std::string,std::string>> values;
-      values.push_back(std::make_pair("*",".*"));
-      granada::util::string::replace(expression_,values,"","");
-      cache_->Keys(expression_,keys_);
-      it_ = keys_.begin();
+      pattern_.set(expression_);
+      shard_ = 0;
+      cursor_.clear();
+      started_ = false;
+      keys_.clear();
     }
 
 
     const bool SharedMapIterator::has_next(){
-      return it_ != keys_.end();
+      if (keys_.empty()){
+        Fetch();
+      }
+      return !keys_.empty();
     }
 
 
     const std::string SharedMapIterator::next(){
-      if (it_ != keys_.end()){
-        const std::string value(*it_);
-        ++it_;
+      if (has_next()){
+        const std::string value(std::move(keys_.front()));
+        keys_.pop_front();
         return value;
       }
       return std::string();
     }
 
 
-    SharedMapCacheDriver::SharedMapCacheDriver(){
-      data_.reset(new std::unordered_map<std::string,std::map<std::string,std::string>>());
+    void SharedMapIterator::Fetch(){
+      while (keys_.empty() && shard_ < cache_->shards()){
+        if (cache_->Scan(shard_,pattern_,started_,cursor_,batch_size_,keys_)){
+          // shard finished, continue with the next one.
+          ++shard_;
+          cursor_.clear();
+          started_ = false;
+        }
+      }
+    }
+
+
+    SharedMapCacheDriver::SharedMapCacheDriver() : SharedMapCacheDriver(std::string(),std::map<std::string,std::string>()){}
+
+
+    SharedMapCacheDriver::SharedMapCacheDriver(const std::string& name) : SharedMapCacheDriver(name,std::map<std::string,std::string>()){}
+
+
+    SharedMapCacheDriver::SharedMapCacheDriver(const std::string& name, const std::map<std::string,std::string>& settings){
+      settings_ = settings;
+
+      int shards = default_numbers::shared_map_cache_driver_shards;
+      const std::string& shards_str = Property(entity_keys::shared_map_cache_driver_shards);
+      if (!shards_str.empty()){
+        try{
+          shards = std::stoi(shards_str);
+        }catch(const std::logic_error e){
+          shards = default_numbers::shared_map_cache_driver_shards;
+        }
+      }
+      slab_allocator_ = Property(entity_keys::shared_map_cache_driver_allocator) == entity_keys::shared_map_cache_driver_allocator_slab;
+      CreateShards(shards);
+
+      const std::string& expire_frequency_str = Property(entity_keys::shared_map_cache_driver_expire_frequency);
+      if (!expire_frequency_str.empty()){
+        try{
+          expire_frequency_ = std::stoi(expire_frequency_str);
+        }catch(const std::logic_error e){
+          expire_frequency_ = default_numbers::shared_map_cache_driver_expire_frequency;
+        }
+      }
+
+      // eviction policies by namespace, example: {"session:":"lru","message:":"arc"}
+      const std::string& eviction_str = Property(entity_keys::shared_map_cache_driver_eviction);
+      if (!eviction_str.empty()){
+        try{
+          web::json::value eviction_json = web::json::value::parse(utility::conversions::to_string_t(eviction_str));
+          for (auto it = eviction_json.as_object().cbegin(); it != eviction_json.as_object().cend(); ++it){
+            if (it->second.is_string()){
+              SetEvictionPolicy(utility::conversions::to_utf8string(it->first), utility::conversions::to_utf8string(it->second.as_string()));
+            }
+          }
+        }catch(const web::json::json_exception e){}
+      }
+
+      const std::string& max_bytes_str = Property(entity_keys::shared_map_cache_driver_max_bytes);
+      if (!max_bytes_str.empty()){
+        try{
+          SetMaxBytes(std::stoull(max_bytes_str));
+        }catch(const std::logic_error e){}
+      }
+
+      const std::string& directory = Property(entity_keys::shared_map_cache_driver_persistence_directory);
+      if (!directory.empty() && !name.empty()){
+        const bool sync_always = Property(entity_keys::shared_map_cache_driver_persistence_sync) == entity_keys::shared_map_cache_driver_sync_always;
+
+        int sync_frequency = default_numbers::shared_map_cache_driver_persistence_sync_frequency;
+        const std::string& sync_frequency_str = Property(entity_keys::shared_map_cache_driver_persistence_sync_frequency);
+        if (!sync_frequency_str.empty()){
+          try{
+            sync_frequency = std::stoi(sync_frequency_str);
+          }catch(const std::logic_error e){
+            sync_frequency = default_numbers::shared_map_cache_driver_persistence_sync_frequency;
+          }
+        }
+
+        std::size_t snapshot_bytes = default_numbers::shared_map_cache_driver_persistence_snapshot_bytes;
+        const std::string& snapshot_bytes_str = Property(entity_keys::shared_map_cache_driver_persistence_snapshot_bytes);
+        if (!snapshot_bytes_str.empty()){
+          try{
+            snapshot_bytes = std::stoull(snapshot_bytes_str);
+          }catch(const std::logic_error e){
+            snapshot_bytes = default_numbers::shared_map_cache_driver_persistence_snapshot_bytes;
+          }
+        }
+
+        // recover before setting persistence_, so nothing is logged while replaying.
+        std::unique_ptr<SharedMapPersistence> persistence = granada::util::memory::make_unique<SharedMapPersistence>(directory + "/" + name, sync_always, sync_frequency, snapshot_bytes);
+        persistence->Recover(shards_.size(), [this](const std::string& key){
+          return shard_index(key);
+        }, [this](const SharedMapPersistence::Record& record){
+          Apply(record);
+        });
+        persistence_ = std::move(persistence);
+        persistence_->Start([this](const std::function<void(const std::string&)>& write){
+          Dump(write);
+        });
+      }
+    }
+
+
+    SharedMapCacheDriver::SharedMapCacheDriver(const int& shards){
+      CreateShards(shards);
+    }
+
+
+    SharedMapCacheDriver::SharedMapCacheDriver(const int& shards, const bool& slab_allocator){
+      slab_allocator_ = slab_allocator;
+      CreateShards(shards);
+    }
+
+
+    SharedMapCacheDriver::~SharedMapCacheDriver(){
+      // sync the log before the shards are destroyed.
+      persistence_.reset();
+
+      {
+        std::lock_guard<std::mutex> lg(expiration_mtx_);
+        expiration_stop_ = true;
+      }
+      expiration_cv_.notify_all();
+      if (expiration_thread_.joinable()){
+        expiration_thread_.join();
+      }
+    }
+
+
+    const std::string SharedMapCacheDriver::Property(const std::string& property){
+      // settings are named as the properties without "shared_map_cache_driver_".
+      static const std::string prefix = "shared_map_cache_driver_";
+      if (!settings_.empty() && property.compare(0, prefix.length(), prefix) == 0){
+        auto it = settings_.find(property.substr(prefix.length()));
+        if (it != settings_.end()){
+          return it->second;
+        }
+      }
+      return granada::util::application::GetProperty(property);
+    }
+
+
+    void SharedMapCacheDriver::CreateShards(int shards){
+      if (shards < 1){
+        shards = 1;
+      }
+      shards_.clear();
+      for (int i = 0; i < shards; ++i){
+        std::unique_ptr<SharedMapArena> arena;
+        if (slab_allocator_){
+          arena = granada::util::memory::make_unique<SharedMapArena>();
+        }
+        shards_.push_back(granada::util::memory::make_unique<SharedMapShard>(std::move(arena)));
+      }
     }
 
 
     const bool SharedMapCacheDriver::Exists(const std::string& key){
-      std::lock_guard<std::mutex> lg(mtx_);
-      if (data_->find(key) != data_->end()){
+      SharedMapShard& shard = this->shard(key);
+      std::shared_lock<SharedMapMutex> sl(shard.mtx);
+      auto it = shard.data.find(key);
+      if (it != shard.data.end() && !Expired(shard,&it->first)){
+        Touch(it->second);
         return true;
       }
       return false;
@@ -75,10 +245,12 @@ namespace granada{
 
 
     const bool SharedMapCacheDriver::Exists(const std::string& hash,const std::string& key){
-      std::lock_guard<std::mutex> lg(mtx_);
-      auto it = data_->find(hash);
-      if (it != data_->end()){
-        const std::map<std::string,std::string>& properties = it->second;
+      SharedMapShard& shard = this->shard(hash);
+      std::shared_lock<SharedMapMutex> sl(shard.mtx);
+      auto it = shard.data.find(hash);
+      if (it != shard.data.end() && !Expired(shard,&it->first)){
+        Touch(it->second);
+        const SharedMapFields& properties = it->second.values;
         auto it2 = properties.find(key);
         if(it2 != properties.end()){
           return true;
@@ -89,24 +261,24 @@ namespace granada{
 
 
     const std::string SharedMapCacheDriver::Read(const std::string& key){
-      std::lock_guard<std::mutex> lg(mtx_);
-      auto it = data_->find(key);
-      if (it != data_->end()){
-        const std::map<std::string,std::string>& properties = it->second;
-        auto it2 = properties.find("__");
-        if(it2 != properties.end()){
-          return it2->second;
-        }
+      SharedMapShard& shard = this->shard(key);
+      std::shared_lock<SharedMapMutex> sl(shard.mtx);
+      auto it = shard.data.find(key);
+      if (it != shard.data.end() && !Expired(shard,&it->first)){
+        Touch(it->second);
+        return it->second.value;
       }
       return std::string();
     }
 
 
     const std::string SharedMapCacheDriver::Read(const std::string& hash,const std::string& key){
-      std::lock_guard<std::mutex> lg(mtx_);
-      auto it = data_->find(hash);
-      if (it != data_->end()){
-        std::map<std::string,std::string> properties = it->second;
+      SharedMapShard& shard = this->shard(hash);
+      std::shared_lock<SharedMapMutex> sl(shard.mtx);
+      auto it = shard.data.find(hash);
+      if (it != shard.data.end() && !Expired(shard,&it->first)){
+        Touch(it->second);
+        const SharedMapFields& properties = it->second.values;
         auto it2 = properties.find(key);
         if(it2 != properties.end()){
           return it2->second;
@@ -116,92 +288,1236 @@ namespace granada{
     }
 
 
+    const bool SharedMapCacheDriver::ReadAll(const std::string& hash, std::map<std::string,std::string>& values){
+      values.clear();
+      SharedMapShard& shard = this->shard(hash);
+      std::shared_lock<SharedMapMutex> sl(shard.mtx);
+      auto it = shard.data.find(hash);
+      if (it != shard.data.end() && !Expired(shard,&it->first)){
+        Touch(it->second);
+        values.insert(it->second.values.begin(),it->second.values.end());
+        return true;
+      }
+      return false;
+    }
+
+
+    const bool SharedMapCacheDriver::ReadMany(const std::string& hash, const std::vector<std::string>& keys, std::vector<std::string>& values){
+      values.clear();
+      SharedMapShard& shard = this->shard(hash);
+      std::shared_lock<SharedMapMutex> sl(shard.mtx);
+      auto it = shard.data.find(hash);
+      if (it != shard.data.end() && !Expired(shard,&it->first)){
+        Touch(it->second);
+        const SharedMapFields& properties = it->second.values;
+        values.reserve(keys.size());
+        for (auto it2 = keys.begin(); it2 != keys.end(); ++it2){
+          auto it3 = properties.find(*it2);
+          if (it3 != properties.end()){
+            values.push_back(it3->second);
+          }else{
+            values.push_back(std::string());
+          }
+        }
+        return true;
+      }
+      return false;
+    }
+
+
     void SharedMapCacheDriver::Write(const std::string& key,const std::string& value){
-      std::lock_guard<std::mutex> lg(mtx_);
-      auto it = data_->find(key);
-      if (it == data_->end()){
-        std::map<std::string,std::string> properties;
-        properties["__"] = value;
-        (*data_)[key] = properties;
-      }else{
-        std::map<std::string,std::string> properties = it->second;
-        properties["__"] = value;
-        (*data_)[key] = properties;
+      SharedMapShard& shard = this->shard(key);
+      unsigned long long sequence = 0;
+      {
+        std::lock_guard<SharedMapMutex> lg(shard.mtx);
+        RemoveExpired(shard,default_numbers::shared_map_cache_driver_expire_count);
+        SharedMapEntry& entry = Emplace(shard,key);
+        std::string& stored = Value(shard,entry);
+        stored = value;
+        Account(shard,entry,stored.size());
+        const bool expired = RemoveExpiration(shard,entry.key);
+        if (persistence_ != nullptr){
+          std::string records;
+          SharedMapPersistence::EncodePut(records,key,VALUE_FIELD,stored);
+          if (expired){
+            SharedMapPersistence::EncodeExpire(records,key,-1);
+          }
+          sequence = Log(records);
+        }
+        notifier_.Publish(granada::cache::CacheEvent::WRITE,key);
+        Evict(shard,&entry);
+      }
+      Sync(sequence);
+    }
+
+
+    void SharedMapCacheDriver::Write(const std::string& key,std::string&& value){
+      SharedMapShard& shard = this->shard(key);
+      unsigned long long sequence = 0;
+      {
+        std::lock_guard<SharedMapMutex> lg(shard.mtx);
+        RemoveExpired(shard,default_numbers::shared_map_cache_driver_expire_count);
+        SharedMapEntry& entry = Emplace(shard,key);
+        std::string& stored = Value(shard,entry);
+        stored = std::move(value);
+        Account(shard,entry,stored.size());
+        const bool expired = RemoveExpiration(shard,entry.key);
+        if (persistence_ != nullptr){
+          std::string records;
+          SharedMapPersistence::EncodePut(records,key,VALUE_FIELD,stored);
+          if (expired){
+            SharedMapPersistence::EncodeExpire(records,key,-1);
+          }
+          sequence = Log(records);
+        }
+        notifier_.Publish(granada::cache::CacheEvent::WRITE,key);
+        Evict(shard,&entry);
       }
+      Sync(sequence);
     }
 
 
     void SharedMapCacheDriver::Write(const std::string& hash,const std::string& key,const std::string& value){
-      std::lock_guard<std::mutex> lg(mtx_);
-      auto it = data_->find(hash);
-      if (it == data_->end()){
-        std::map<std::string,std::string> properties;
-        properties[key] = value;
-        (*data_)[hash] = properties;
-      }else{
-        std::map<std::string,std::string> properties = it->second;
-        properties[key] = value;
-        (*data_)[hash] = properties;
+      SharedMapShard& shard = this->shard(hash);
+      unsigned long long sequence = 0;
+      {
+        std::lock_guard<SharedMapMutex> lg(shard.mtx);
+        RemoveExpired(shard,default_numbers::shared_map_cache_driver_expire_count);
+        SharedMapEntry& entry = Emplace(shard,hash);
+        std::string& stored = Field(shard,entry,key);
+        stored = value;
+        Account(shard,entry,stored.size());
+        if (persistence_ != nullptr){
+          std::string records;
+          SharedMapPersistence::EncodePut(records,hash,key,stored);
+          sequence = Log(records);
+        }
+        notifier_.Publish(granada::cache::CacheEvent::WRITE,hash);
+        Evict(shard,&entry);
+      }
+      Sync(sequence);
+    }
+
+
+    void SharedMapCacheDriver::Write(const std::string& hash,const std::string& key,std::string&& value){
+      SharedMapShard& shard = this->shard(hash);
+      unsigned long long sequence = 0;
+      {
+        std::lock_guard<SharedMapMutex> lg(shard.mtx);
+        RemoveExpired(shard,default_numbers::shared_map_cache_driver_expire_count);
+        SharedMapEntry& entry = Emplace(shard,hash);
+        std::string& stored = Field(shard,entry,key);
+        stored = std::move(value);
+        Account(shard,entry,stored.size());
+        if (persistence_ != nullptr){
+          std::string records;
+          SharedMapPersistence::EncodePut(records,hash,key,stored);
+          sequence = Log(records);
+        }
+        notifier_.Publish(granada::cache::CacheEvent::WRITE,hash);
+        Evict(shard,&entry);
       }
+      Sync(sequence);
     }
-    
+
 
     void SharedMapCacheDriver::Destroy(const std::string& key){
       std::size_t found = key.find("*");
       if (found!=std::string::npos){
-        std::vector<std::string> keys;
-        Match(key,keys);
-        for (auto it = keys.begin(); it != keys.end(); ++it){
-          std::lock_guard<std::mutex> lg(mtx_);
-          data_->erase(*it);
-        }
+        DestroyMatch(key);
       }else{
-        std::lock_guard<std::mutex> lg(mtx_);
-        data_->erase(key);
+        SharedMapShard& shard = this->shard(key);
+        unsigned long long sequence = 0;
+        {
+          std::lock_guard<SharedMapMutex> lg(shard.mtx);
+          auto it = shard.data.find(key);
+          if (it != shard.data.end()){
+            notifier_.Publish(Expired(shard,&it->first) ? granada::cache::CacheEvent::EXPIRE : granada::cache::CacheEvent::DESTROY,key);
+            Erase(shard,it);
+            if (persistence_ != nullptr){
+              std::string records;
+              SharedMapPersistence::EncodeDestroy(records,key);
+              sequence = Log(records);
+            }
+          }
+        }
+        Sync(sequence);
       }
     }
 
 
     void SharedMapCacheDriver::Destroy(const std::string& hash,const std::string& key){
-      std::lock_guard<std::mutex> lg(mtx_);
-      auto it = data_->find(hash);
-      if (it != data_->end()){
-        std::map<std::string,std::string> properties = it->second;
-        properties.erase(key);
-        (*data_)[hash] = properties;
+      SharedMapShard& shard = this->shard(hash);
+      unsigned long long sequence = 0;
+      {
+        std::lock_guard<SharedMapMutex> lg(shard.mtx);
+        auto it = shard.data.find(hash);
+        if (it != shard.data.end()){
+          if (Expired(shard,&it->first)){
+            notifier_.Publish(granada::cache::CacheEvent::EXPIRE,hash);
+            Erase(shard,it);
+          }else{
+            EraseField(shard,it->second,key);
+            notifier_.Publish(granada::cache::CacheEvent::WRITE,hash);
+            if (persistence_ != nullptr){
+              std::string records;
+              SharedMapPersistence::EncodeDestroyField(records,hash,key);
+              sequence = Log(records);
+            }
+          }
+        }
       }
+      Sync(sequence);
+    }
+
+
+    const std::size_t SharedMapCacheDriver::DestroyMatch(const std::string& expression){
+      const granada::cache::KeyPattern pattern(expression);
+      std::size_t destroyed = 0;
+      unsigned long long sequence = 0;
+      std::string records;
+      // keys matching the expression can be in any shard, they are
+      // swept one shard at a time so the other shards are still usable.
+      for (auto it = shards_.begin(); it != shards_.end(); ++it){
+        std::lock_guard<SharedMapMutex> lg((*it)->mtx);
+        records.clear();
+        destroyed += DestroyShard(*(*it),pattern,records);
+        const unsigned long long shard_sequence = Log(records);
+        if (shard_sequence > 0){
+          sequence = shard_sequence;
+        }
+      }
+      Sync(sequence);
+      return destroyed;
     }
 
 
     bool SharedMapCacheDriver::Rename(const std::string& old_key, const std::string& new_key){
-      std::lock_guard<std::mutex> lg(mtx_);
-      auto it = data_->find(old_key);
-      if (it != data_->end()) {
+      SharedMapShard& old_shard = shard(old_key);
+      SharedMapShard& new_shard = shard(new_key);
+
+      // lock both shards without risk of deadlock,
+      // they can be the same shard.
+      std::unique_lock<SharedMapMutex> old_lock(old_shard.mtx, std::defer_lock);
+      std::unique_lock<SharedMapMutex> new_lock(new_shard.mtx, std::defer_lock);
+      if (&old_shard == &new_shard){
+        old_lock.lock();
+      }else{
+        std::lock(old_lock, new_lock);
+      }
+
+      // an expired key is as if it did not exist.
+      auto new_it = new_shard.data.find(new_key);
+      if (new_it != new_shard.data.end() && Expired(new_shard,&new_it->first)){
+        notifier_.Publish(granada::cache::CacheEvent::EXPIRE,new_key);
+        Erase(new_shard,new_it);
+        new_it = new_shard.data.end();
+      }
+      auto it = old_shard.data.find(old_key);
+      if (it != old_shard.data.end() && !Expired(old_shard,&it->first) && new_it == new_shard.data.end()) {
         // insert new key and value
-        std::map<std::string,std::string> properties;
-        (*data_)[new_key] = properties;
+        SharedMapEntry& entry = Emplace(new_shard,new_key);
 
-        // swap
-        std::swap((*data_)[new_key], it->second);
+        // inserting may have rehashed the shard, the
+        // iterator of the old key is found again.
+        if (&old_shard == &new_shard){
+          it = old_shard.data.find(old_key);
+        }
+
+        // swap, the bytes of the values go with them. Fields are
+        // copied between shards, each shard has its own arena.
+        if (&old_shard == &new_shard){
+          entry.values.swap(it->second.values);
+        }else{
+          entry.values = it->second.values;
+        }
+        entry.value.swap(it->second.value);
+        entry.plain = it->second.plain;
+        Account(new_shard,entry,(long long)(it->second.bytes - KeyBytes(old_key)));
+
+        // the time to live goes with the values.
+        auto expiration_it = old_shard.expirations.find(&it->first);
+        if (expiration_it != old_shard.expirations.end()){
+          SetExpiration(new_shard,entry.key,expiration_it->second);
+        }
+
+        // logged as a copy and a removal, so each record
+        // only affects one key.
+        unsigned long long sequence = 0;
+        if (persistence_ != nullptr){
+          std::string records;
+          SharedMapPersistence::EncodeCreate(records,new_key);
+          if (entry.plain){
+            SharedMapPersistence::EncodePut(records,new_key,VALUE_FIELD,entry.value);
+          }
+          for (auto it2 = entry.values.begin(); it2 != entry.values.end(); ++it2){
+            SharedMapPersistence::EncodePut(records,new_key,it2->first,it2->second);
+          }
+          const long long deadline = Deadline(new_shard,entry.key);
+          if (deadline > -1){
+            SharedMapPersistence::EncodeExpire(records,new_key,deadline);
+          }
+          SharedMapPersistence::EncodeDestroy(records,old_key);
+          sequence = Log(records);
+        }
 
         // erase old entry
-        data_->erase(it);
+        Erase(old_shard,it);
+        notifier_.Publish(granada::cache::CacheEvent::RENAME,old_key);
+        notifier_.Publish(granada::cache::CacheEvent::RENAME,new_key);
+        Evict(new_shard,&entry);
+
+        if (new_lock.owns_lock()){
+          new_lock.unlock();
+        }
+        old_lock.unlock();
+        Sync(sequence);
         return true;
       }
       return false;
     }
 
 
+    const bool SharedMapCacheDriver::Expire(const std::string& key, const long long& seconds){
+      SharedMapShard& shard = this->shard(key);
+      unsigned long long sequence = 0;
+      {
+        std::lock_guard<SharedMapMutex> lg(shard.mtx);
+        auto it = shard.data.find(key);
+        if (it == shard.data.end() || Expired(shard,&it->first)){
+          return false;
+        }
+        if (seconds < 0){
+          RemoveExpiration(shard,&it->first);
+        }else{
+          SetExpiration(shard,&it->first,std::chrono::steady_clock::now() + std::chrono::seconds(seconds));
+          StartExpirationThread();
+        }
+        if (persistence_ != nullptr){
+          std::string records;
+          SharedMapPersistence::EncodeExpire(records,key,Deadline(shard,&it->first));
+          sequence = Log(records);
+        }
+      }
+      Sync(sequence);
+      return true;
+    }
+
+
+    const long long SharedMapCacheDriver::TTL(const std::string& key){
+      SharedMapShard& shard = this->shard(key);
+      std::shared_lock<SharedMapMutex> sl(shard.mtx);
+      auto it = shard.data.find(key);
+      if (it == shard.data.end() || Expired(shard,&it->first)){
+        return -2;
+      }
+      auto expiration_it = shard.expirations.find(&it->first);
+      if (expiration_it == shard.expirations.end()){
+        return -1;
+      }
+      // round up, a key about to expire still has 1 second.
+      const std::chrono::steady_clock::duration remaining = expiration_it->second - std::chrono::steady_clock::now();
+      return std::chrono::duration_cast<std::chrono::seconds>(remaining + std::chrono::seconds(1) - std::chrono::steady_clock::duration(1)).count();
+    }
+
+
+    void SharedMapCacheDriver::WriteWithTTL(const std::string& key,const std::string& value,const long long& seconds){
+      SharedMapShard& shard = this->shard(key);
+      unsigned long long sequence = 0;
+      {
+        std::lock_guard<SharedMapMutex> lg(shard.mtx);
+        RemoveExpired(shard,default_numbers::shared_map_cache_driver_expire_count);
+        SharedMapEntry& entry = Emplace(shard,key);
+        std::string& stored = Value(shard,entry);
+        stored = value;
+        Account(shard,entry,stored.size());
+        if (seconds < 0){
+          RemoveExpiration(shard,entry.key);
+        }else{
+          SetExpiration(shard,entry.key,std::chrono::steady_clock::now() + std::chrono::seconds(seconds));
+          StartExpirationThread();
+        }
+        if (persistence_ != nullptr){
+          std::string records;
+          SharedMapPersistence::EncodePut(records,key,VALUE_FIELD,stored);
+          SharedMapPersistence::EncodeExpire(records,key,Deadline(shard,entry.key));
+          sequence = Log(records);
+        }
+        notifier_.Publish(granada::cache::CacheEvent::WRITE,key);
+        Evict(shard,&entry);
+      }
+      Sync(sequence);
+    }
+
+
+    void SharedMapCacheDriver::WriteWithTTL(const std::string& hash,const std::string& key,const std::string& value,const long long& seconds){
+      SharedMapShard& shard = this->shard(hash);
+      unsigned long long sequence = 0;
+      {
+        std::lock_guard<SharedMapMutex> lg(shard.mtx);
+        RemoveExpired(shard,default_numbers::shared_map_cache_driver_expire_count);
+        SharedMapEntry& entry = Emplace(shard,hash);
+        std::string& stored = Field(shard,entry,key);
+        stored = value;
+        Account(shard,entry,stored.size());
+        if (seconds < 0){
+          RemoveExpiration(shard,entry.key);
+        }else{
+          SetExpiration(shard,entry.key,std::chrono::steady_clock::now() + std::chrono::seconds(seconds));
+          StartExpirationThread();
+        }
+        if (persistence_ != nullptr){
+          std::string records;
+          SharedMapPersistence::EncodePut(records,hash,key,stored);
+          SharedMapPersistence::EncodeExpire(records,hash,Deadline(shard,entry.key));
+          sequence = Log(records);
+        }
+        notifier_.Publish(granada::cache::CacheEvent::WRITE,hash);
+        Evict(shard,&entry);
+      }
+      Sync(sequence);
+    }
+
+
+    void SharedMapCacheDriver::WriteMany(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values){
+      WriteFields(hash,values,false,-1);
+    }
+
+
+    void SharedMapCacheDriver::WriteManyWithTTL(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values,const long long& seconds){
+      WriteFields(hash,values,true,seconds);
+    }
+
+
+    void SharedMapCacheDriver::WriteFields(const std::string& hash, const std::vector<std::pair<std::string,std::string>>& values, const bool& expire, const long long& seconds){
+      SharedMapShard& shard = this->shard(hash);
+      unsigned long long sequence = 0;
+      {
+        std::lock_guard<SharedMapMutex> lg(shard.mtx);
+        RemoveExpired(shard,default_numbers::shared_map_cache_driver_expire_count);
+        SharedMapEntry& entry = Emplace(shard,hash);
+        std::string records;
+        if (!entry.plain){
+          entry.values.reserve(entry.values.size() + values.size());
+        }
+        for (auto it = values.begin(); it != values.end(); ++it){
+          std::string& stored = Field(shard,entry,it->first);
+          stored = it->second;
+          Account(shard,entry,stored.size());
+          if (persistence_ != nullptr){
+            SharedMapPersistence::EncodePut(records,hash,it->first,stored);
+          }
+        }
+        if (expire){
+          if (seconds < 0){
+            RemoveExpiration(shard,entry.key);
+          }else{
+            SetExpiration(shard,entry.key,std::chrono::steady_clock::now() + std::chrono::seconds(seconds));
+            StartExpirationThread();
+          }
+          if (persistence_ != nullptr){
+            SharedMapPersistence::EncodeExpire(records,hash,Deadline(shard,entry.key));
+          }
+        }
+        sequence = Log(records);
+        notifier_.Publish(granada::cache::CacheEvent::WRITE,hash);
+        Evict(shard,&entry);
+      }
+      Sync(sequence);
+    }
+
+
+    const bool SharedMapCacheDriver::WriteIfNotExists(const std::string& key,const std::string& value){
+      return WriteFieldIf(key,nullptr,[](const bool& exists, const std::string* current){
+        return !exists;
+      },[&value](std::string& stored){
+        stored = value;
+      });
+    }
+
+
+    const bool SharedMapCacheDriver::WriteIfNotExists(const std::string& hash,const std::string& key,const std::string& value){
+      return WriteFieldIf(hash,&key,[](const bool& exists, const std::string* current){
+        return current == nullptr;
+      },[&value](std::string& stored){
+        stored = value;
+      });
+    }
+
+
+    const bool SharedMapCacheDriver::CompareAndSet(const std::string& hash,const std::string& key,const std::string& expected,const std::string& value){
+      return WriteFieldIf(hash,&key,[&expected](const bool& exists, const std::string* current){
+        if (current == nullptr){
+          return expected.empty();
+        }
+        return *current == expected;
+      },[&value](std::string& stored){
+        stored = value;
+      });
+    }
+
+
+    const long long SharedMapCacheDriver::Increment(const std::string& key,const long long& increment){
+      long long result = 0;
+      WriteFieldIf(key,nullptr,[](const bool& exists, const std::string* current){
+        return true;
+      },[&increment,&result](std::string& stored){
+        result = Add(stored,increment);
+        stored = std::to_string(result);
+      });
+      return result;
+    }
+
+
+    const long long SharedMapCacheDriver::Increment(const std::string& hash,const std::string& key,const long long& increment){
+      long long result = 0;
+      WriteFieldIf(hash,&key,[](const bool& exists, const std::string* current){
+        return true;
+      },[&increment,&result](std::string& stored){
+        result = Add(stored,increment);
+        stored = std::to_string(result);
+      });
+      return result;
+    }
+
+
+    const long long SharedMapCacheDriver::IncrementWithTTL(const std::string& key,const long long& increment,const long long& seconds){
+      long long result = 0;
+      WriteFieldIf(key,nullptr,[](const bool& exists, const std::string* current){
+        return true;
+      },[&increment,&result](std::string& stored){
+        result = Add(stored,increment);
+        stored = std::to_string(result);
+      },&seconds,true);
+      return result;
+    }
+
+
+    const long long SharedMapCacheDriver::TakeTokens(const std::string& key,const long long& tokens,const long long& capacity,const double& rate){
+      const long long now = granada::cache::TokenBucket::Now();
+      long long left = -1;
+      long long seconds = -1;
+      std::string state;
+      WriteFieldIf(key,&granada::cache::TokenBucket::FIELD,[&](const bool& exists, const std::string* current){
+        if (current != nullptr){
+          state.assign(*current);
+        }
+        left = granada::cache::TokenBucket::Take(state,tokens,capacity,rate,now,seconds);
+        return left > -1;
+      },[&state](std::string& stored){
+        stored.swap(state);
+      },&seconds);
+      return left;
+    }
+
+
+    const bool SharedMapCacheDriver::WriteFieldIf(const std::string& key, const std::string* field, const std::function<bool(const bool& exists, const std::string* current)>& condition, const std::function<void(std::string& stored)>& update, const long long* seconds, const bool& keep){
+      SharedMapShard& shard = this->shard(key);
+      unsigned long long sequence = 0;
+      {
+        std::lock_guard<SharedMapMutex> lg(shard.mtx);
+        RemoveExpired(shard,default_numbers::shared_map_cache_driver_expire_count);
+        auto it = shard.data.find(key);
+        const bool exists = it != shard.data.end() && !Expired(shard,&it->first);
+        // a key holding a value of the other kind, plain or map, is
+        // left as it is, as Redis refuses the operation.
+        if (exists && it->second.plain != (field == nullptr)){
+          return false;
+        }
+        const std::string* current = nullptr;
+        if (exists){
+          if (field == nullptr){
+            if (it->second.plain){
+              current = &it->second.value;
+            }
+          }else{
+            auto it2 = it->second.values.find(*field);
+            if (it2 != it->second.values.end()){
+              current = &it2->second;
+            }
+          }
+        }
+        if (!condition(exists,current)){
+          return false;
+        }
+        SharedMapEntry& entry = Emplace(shard,key);
+        std::string& stored = field == nullptr ? Value(shard,entry) : Field(shard,entry,*field);
+        update(stored);
+        Account(shard,entry,stored.size());
+        const bool expire = seconds != nullptr && *seconds > -1 && (!keep || shard.expirations.find(entry.key) == shard.expirations.end());
+        if (expire){
+          SetExpiration(shard,entry.key,std::chrono::steady_clock::now() + std::chrono::seconds(*seconds));
+          StartExpirationThread();
+        }
+        if (persistence_ != nullptr){
+          std::string records;
+          SharedMapPersistence::EncodePut(records,key,field == nullptr ? VALUE_FIELD : *field,stored);
+          if (expire){
+            SharedMapPersistence::EncodeExpire(records,key,Deadline(shard,entry.key));
+          }
+          sequence = Log(records);
+        }
+        notifier_.Publish(granada::cache::CacheEvent::WRITE,key);
+        Evict(shard,&entry);
+      }
+      Sync(sequence);
+      return true;
+    }
+
+
+    const long long SharedMapCacheDriver::Add(const std::string& value, const long long& increment){
+      long long number = 0;
+      if (!value.empty()){
+        try{
+          number = std::stoll(value);
+        }catch(const std::logic_error e){}
+      }
+      return number + increment;
+    }
+
+
+    const std::size_t SharedMapCacheDriver::RemoveExpired(const std::size_t& count){
+      std::size_t removed = 0;
+      for (auto it = shards_.begin(); it != shards_.end(); ++it){
+        SharedMapShard& shard = *(*it);
+        std::size_t shard_removed;
+        do{
+          // release the lock between batches so writers are not blocked
+          // while a big number of keys expire at once.
+          std::lock_guard<SharedMapMutex> lg(shard.mtx);
+          shard_removed = RemoveExpired(shard,count);
+          removed += shard_removed;
+        }while(shard_removed > 0 && shard_removed == count);
+      }
+      return removed;
+    }
+
+
+    void SharedMapCacheDriver::SetMaxBytes(const std::size_t& max_bytes){
+      max_bytes_ = max_bytes;
+      std::size_t shard_max_bytes = 0;
+      if (max_bytes_ > 0){
+        shard_max_bytes = max_bytes_ / shards_.size();
+        if (shard_max_bytes < 1){
+          shard_max_bytes = 1;
+        }
+      }
+      for (auto it = shards_.begin(); it != shards_.end(); ++it){
+        SharedMapShard& shard = *(*it);
+        std::lock_guard<SharedMapMutex> lg(shard.mtx);
+        shard.max_bytes = shard_max_bytes;
+        Evict(shard,nullptr);
+      }
+    }
+
+
+    void SharedMapCacheDriver::SetEvictionPolicy(const std::string& name_space, const std::string& policy){
+      SharedMapEntry::Pool pool = SharedMapEntry::PINNED;
+      if (policy == entity_keys::cache_eviction_lru){
+        pool = SharedMapEntry::LRU;
+      }else if (policy == entity_keys::cache_eviction_arc){
+        pool = SharedMapEntry::ARC_RECENT;
+      }
+
+      if (name_space == "*"){
+        default_eviction_policy_ = pool;
+        return;
+      }
+
+      // keep the longest namespaces first, so the most specific one is found first.
+      for (auto it = eviction_policies_.begin(); it != eviction_policies_.end(); ++it){
+        if (it->first == name_space){
+          it->second = pool;
+          return;
+        }
+      }
+      auto it = eviction_policies_.begin();
+      while (it != eviction_policies_.end() && it->first.length() >= name_space.length()){
+        ++it;
+      }
+      eviction_policies_.insert(it,std::make_pair(name_space,pool));
+    }
+
+
+    const SharedMapCacheStats SharedMapCacheDriver::Stats(){
+      SharedMapCacheStats stats;
+      stats.max_bytes = max_bytes_;
+      std::size_t slab_blocks = 0;
+      std::size_t used_slab_blocks = 0;
+      for (auto it = shards_.begin(); it != shards_.end(); ++it){
+        SharedMapShard& shard = *(*it);
+        std::shared_lock<SharedMapMutex> sl(shard.mtx);
+        stats.lock_waits += shard.mtx.waits.load(std::memory_order_relaxed);
+        stats.lock_wait_ns += shard.mtx.wait_ns.load(std::memory_order_relaxed);
+        stats.keys += shard.data.size();
+        stats.bytes += shard.bytes;
+        stats.lru_evictions += shard.lru_evictions;
+        stats.arc_evictions += shard.arc_evictions;
+        stats.expired += shard.expired;
+        if (shard.arena != nullptr){
+          const SharedMapArenaStats arena_stats = shard.arena->Stats();
+          stats.allocated_bytes += arena_stats.allocated_bytes;
+          stats.reserved_bytes += arena_stats.reserved_bytes;
+          stats.slabs += arena_stats.slabs;
+          slab_blocks += arena_stats.slab_blocks;
+          used_slab_blocks += arena_stats.used_slab_blocks;
+        }
+      }
+      if (stats.reserved_bytes > 0){
+        stats.fragmentation = 1 - (double)stats.allocated_bytes / stats.reserved_bytes;
+      }
+      if (slab_blocks > 0){
+        stats.slab_occupancy = (double)used_slab_blocks / slab_blocks;
+      }
+      return stats;
+    }
+
+
     void SharedMapCacheDriver::Keys(const std::string& expression, std::vector<std::string>& keys){
       keys.clear();
-      std::lock_guard<std::mutex> lg(mtx_);
-      for(auto it = data_->begin(); it != data_->end(); ++it) {
-        const std::string& key = it->first;
-        if (std::regex_match(key, std::regex(expression))){
-          keys.push_back(it->first);
+      const granada::cache::KeyPattern pattern(expression);
+      std::vector<const std::string*> shard_keys;
+      for (auto it = shards_.begin(); it != shards_.end(); ++it){
+        SharedMapShard& shard = *(*it);
+        std::shared_lock<SharedMapMutex> sl(shard.mtx);
+        MatchShard(shard,pattern,shard_keys);
+        for (auto it2 = shard_keys.begin(); it2 != shard_keys.end(); ++it2){
+          keys.push_back(*(*it2));
+        }
+      }
+    }
+
+
+    const bool SharedMapCacheDriver::Scan(const std::size_t& shard, const granada::cache::KeyPattern& pattern, bool& started, std::string& cursor, const std::size_t& count, std::deque<std::string>& keys){
+      SharedMapShard& current_shard = *shards_[shard];
+      std::shared_lock<SharedMapMutex> sl(current_shard.mtx);
+      const std::string& prefix = pattern.prefix();
+
+      // continue after the last visited key, but never
+      // before the first key that could have the prefix.
+      auto it = current_shard.index.lower_bound(&prefix);
+      if (started && cursor >= prefix){
+        it = current_shard.index.upper_bound(&cursor);
+      }
+
+      std::size_t visited = 0;
+      for (; it != current_shard.index.end() && visited < count; ++it){
+        const std::string& key = *(*it);
+        if (key.compare(0, prefix.length(), prefix) != 0){
+          // keys are in order, no more keys with the prefix.
+          granada::cache::ThreadCounters().keys_scanned += visited;
+          return true;
+        }
+        if (pattern.Match(key) && !Expired(current_shard,&key)){
+          keys.push_back(key);
+        }
+        cursor.assign(key);
+        started = true;
+        ++visited;
+      }
+      granada::cache::ThreadCounters().keys_scanned += visited;
+      return it == current_shard.index.end();
+    }
+
+
+    SharedMapEntry& SharedMapCacheDriver::Emplace(SharedMapShard& shard, const std::string& key){
+      auto it = shard.data.find(key);
+      if (it == shard.data.end()){
+        it = shard.data.emplace(std::piecewise_construct,std::forward_as_tuple(key),std::forward_as_tuple(shard.arena.get())).first;
+        SharedMapEntry& entry = it->second;
+        entry.key = &it->first;
+        shard.index.insert(entry.key);
+
+        entry.bytes = KeyBytes(key);
+        shard.bytes += entry.bytes;
+        Attach(shard,entry);
+      }else{
+        SharedMapEntry& entry = it->second;
+        if (Expired(shard,entry.key)){
+          // the key starts again from scratch.
+          notifier_.Publish(granada::cache::CacheEvent::EXPIRE,key);
+          Account(shard,entry,-(long long)(entry.bytes - KeyBytes(key)));
+          entry.values.clear();
+          std::string().swap(entry.value);
+          entry.plain = false;
+          RemoveExpiration(shard,entry.key);
+        }else{
+          Touch(entry);
+        }
+      }
+      return it->second;
+    }
+
+
+    void SharedMapCacheDriver::Erase(SharedMapShard& shard, SharedMapData::iterator it){
+      SharedMapEntry& entry = it->second;
+      Detach(shard,entry);
+      shard.bytes -= entry.bytes;
+      RemoveExpiration(shard,&it->first);
+      shard.index.erase(&it->first);
+      shard.data.erase(it);
+    }
+
+
+    void SharedMapCacheDriver::EraseField(SharedMapShard& shard, SharedMapEntry& entry, const std::string& field){
+      auto it = entry.values.find(field);
+      if (it != entry.values.end()){
+        Account(shard,entry,-(long long)(FieldBytes(it->first) + it->second.size()));
+        entry.values.erase(it);
+      }
+    }
+
+
+    std::string& SharedMapCacheDriver::Field(SharedMapShard& shard, SharedMapEntry& entry, const std::string& field){
+      if (entry.plain){
+        // the key becomes a map, its value is removed.
+        Account(shard,entry,-(long long)entry.value.size());
+        std::string().swap(entry.value);
+        entry.plain = false;
+      }
+      auto it = entry.values.find(field);
+      if (it == entry.values.end()){
+        it = entry.values.emplace(field,std::string()).first;
+
+        Account(shard,entry,FieldBytes(field));
+      }else{
+        Account(shard,entry,-(long long)it->second.size());
+      }
+      return it->second;
+    }
+
+
+    std::string& SharedMapCacheDriver::Value(SharedMapShard& shard, SharedMapEntry& entry){
+      if (entry.plain){
+        Account(shard,entry,-(long long)entry.value.size());
+      }else{
+        // the key becomes plain, its fields are removed.
+        for (auto it = entry.values.begin(); it != entry.values.end(); ++it){
+          Account(shard,entry,-(long long)(FieldBytes(it->first) + it->second.size()));
+        }
+        entry.values.clear();
+        entry.plain = true;
+      }
+      return entry.value;
+    }
+
+
+    void SharedMapCacheDriver::Account(SharedMapShard& shard, SharedMapEntry& entry, const long long& bytes){
+      entry.bytes += bytes;
+      shard.bytes += bytes;
+      if (entry.pool == SharedMapEntry::LRU){
+        shard.lru_bytes += bytes;
+      }else if (entry.pool == SharedMapEntry::ARC_RECENT){
+        shard.arc_recent_bytes += bytes;
+      }else if (entry.pool == SharedMapEntry::ARC_FREQUENT){
+        shard.arc_frequent_bytes += bytes;
+      }
+    }
+
+
+    void SharedMapCacheDriver::Attach(SharedMapShard& shard, SharedMapEntry& entry){
+      entry.pool = Policy(*entry.key);
+      if (entry.pool == SharedMapEntry::LRU){
+        // new entries are placed just behind the hand,
+        // so they are the last ones to be visited.
+        entry.position = shard.lru.insert(shard.lru.end(),&entry);
+        shard.lru_bytes += entry.bytes;
+      }else if (entry.pool == SharedMapEntry::ARC_RECENT){
+        auto ghost_it = shard.arc_ghosts.find(*entry.key);
+        if (ghost_it != shard.arc_ghosts.end()){
+          // the key was evicted recently, adapt the target size of the
+          // recent CLOCK in favour of the CLOCK it was evicted from.
+          const std::size_t resident = shard.arc_recent.size() + shard.arc_frequent.size();
+          const std::size_t average_bytes = resident > 0 ? (shard.arc_recent_bytes + shard.arc_frequent_bytes) / resident : entry.bytes;
+          if (ghost_it->second.frequent){
+            const std::size_t ratio = std::max<std::size_t>(1, shard.arc_recent_ghosts.size() / std::max<std::size_t>(1, shard.arc_frequent_ghosts.size()));
+            const std::size_t delta = ratio * average_bytes;
+            shard.arc_target = shard.arc_target > delta ? shard.arc_target - delta : 0;
+            shard.arc_frequent_ghosts.erase(ghost_it->second.position);
+          }else{
+            const std::size_t ratio = std::max<std::size_t>(1, shard.arc_frequent_ghosts.size() / std::max<std::size_t>(1, shard.arc_recent_ghosts.size()));
+            shard.arc_target = std::min(shard.arc_target + ratio * average_bytes, shard.max_bytes);
+            shard.arc_recent_ghosts.erase(ghost_it->second.position);
+          }
+          shard.arc_ghosts.erase(ghost_it);
+          entry.pool = SharedMapEntry::ARC_FREQUENT;
+          entry.position = shard.arc_frequent.insert(shard.arc_frequent.end(),&entry);
+          shard.arc_frequent_bytes += entry.bytes;
+        }else{
+          entry.position = shard.arc_recent.insert(shard.arc_recent.end(),&entry);
+          shard.arc_recent_bytes += entry.bytes;
         }
       }
     }
 
+
+    void SharedMapCacheDriver::Detach(SharedMapShard& shard, SharedMapEntry& entry){
+      if (entry.pool == SharedMapEntry::LRU){
+        shard.lru.erase(entry.position);
+        shard.lru_bytes -= entry.bytes;
+      }else if (entry.pool == SharedMapEntry::ARC_RECENT){
+        shard.arc_recent.erase(entry.position);
+        shard.arc_recent_bytes -= entry.bytes;
+      }else if (entry.pool == SharedMapEntry::ARC_FREQUENT){
+        shard.arc_frequent.erase(entry.position);
+        shard.arc_frequent_bytes -= entry.bytes;
+      }
+      entry.pool = SharedMapEntry::PINNED;
+    }
+
+
+    void SharedMapCacheDriver::Evict(SharedMapShard& shard, const SharedMapEntry* keep){
+      while (shard.max_bytes > 0 && shard.bytes > shard.max_bytes){
+        // evict from the pool using more memory.
+        SharedMapEntry* victim = nullptr;
+        const std::size_t arc_bytes = shard.arc_recent_bytes + shard.arc_frequent_bytes;
+        if (shard.lru_bytes >= arc_bytes){
+          victim = LruVictim(shard,keep);
+          if (victim == nullptr){
+            victim = ArcVictim(shard,keep);
+          }
+        }else{
+          victim = ArcVictim(shard,keep);
+          if (victim == nullptr){
+            victim = LruVictim(shard,keep);
+          }
+        }
+        if (victim == nullptr){
+          // only pinned keys left.
+          return;
+        }
+        if (victim->pool == SharedMapEntry::LRU){
+          ++shard.lru_evictions;
+        }else{
+          ++shard.arc_evictions;
+        }
+        if (persistence_ != nullptr){
+          std::string records;
+          SharedMapPersistence::EncodeDestroy(records,*victim->key);
+          Log(records);
+        }
+        notifier_.Publish(granada::cache::CacheEvent::EXPIRE,*victim->key);
+        Erase(shard,shard.data.find(*victim->key));
+      }
+    }
+
+
+    SharedMapEntry* SharedMapCacheDriver::LruVictim(SharedMapShard& shard, const SharedMapEntry* keep){
+      // two turns of the hand are enough, the first one clears all the references.
+      std::size_t turns = shard.lru.size() * 2 + 1;
+      while (!shard.lru.empty() && turns-- > 0){
+        SharedMapEntry* entry = shard.lru.front();
+        if (entry == keep || entry->referenced.exchange(false, std::memory_order_relaxed)){
+          // second chance, move it behind the hand.
+          shard.lru.splice(shard.lru.end(),shard.lru,shard.lru.begin());
+        }else{
+          return entry;
+        }
+      }
+      return nullptr;
+    }
+
+
+    SharedMapEntry* SharedMapCacheDriver::ArcVictim(SharedMapShard& shard, const SharedMapEntry* keep){
+      std::size_t turns = (shard.arc_recent.size() + shard.arc_frequent.size()) * 2 + 2;
+      while ((!shard.arc_recent.empty() || !shard.arc_frequent.empty()) && turns-- > 0){
+        const bool from_recent = !shard.arc_recent.empty() && (shard.arc_recent_bytes >= std::max<std::size_t>(1, shard.arc_target) || shard.arc_frequent.empty());
+        SharedMapClock& clock = from_recent ? shard.arc_recent : shard.arc_frequent;
+        SharedMapEntry* entry = clock.front();
+        if (entry == keep || entry->referenced.exchange(false, std::memory_order_relaxed)){
+          // used since it was inserted, move it behind the hand of the frequent CLOCK.
+          if (from_recent){
+            shard.arc_recent_bytes -= entry->bytes;
+            shard.arc_frequent_bytes += entry->bytes;
+            entry->pool = SharedMapEntry::ARC_FREQUENT;
+          }
+          shard.arc_frequent.splice(shard.arc_frequent.end(),clock,clock.begin());
+        }else{
+          // remember the victim as a ghost, keeping at most as
+          // many ghosts as resident entries.
+          SharedMapKeyList& ghosts = from_recent ? shard.arc_recent_ghosts : shard.arc_frequent_ghosts;
+          auto ghost_it = shard.arc_ghosts.find(*entry->key);
+          if (ghost_it != shard.arc_ghosts.end()){
+            (ghost_it->second.frequent ? shard.arc_frequent_ghosts : shard.arc_recent_ghosts).erase(ghost_it->second.position);
+          }else{
+            ghost_it = shard.arc_ghosts.emplace(*entry->key,SharedMapGhost()).first;
+          }
+          ghost_it->second.frequent = !from_recent;
+          ghost_it->second.position = ghosts.insert(ghosts.begin(),&ghost_it->first);
+          const std::size_t resident = shard.arc_recent.size() + shard.arc_frequent.size();
+          while (shard.arc_ghosts.size() > resident){
+            SharedMapKeyList& oldest = shard.arc_recent_ghosts.size() >= shard.arc_frequent_ghosts.size() ? shard.arc_recent_ghosts : shard.arc_frequent_ghosts;
+            const std::string* ghost_key = oldest.back();
+            oldest.pop_back();
+            shard.arc_ghosts.erase(*ghost_key);
+          }
+          return entry;
+        }
+      }
+      return nullptr;
+    }
+
+
+    void SharedMapCacheDriver::Apply(const SharedMapPersistence::Record& record){
+      SharedMapShard& shard = this->shard(record.key);
+      std::lock_guard<SharedMapMutex> lg(shard.mtx);
+      if (record.operation == SharedMapPersistence::PUT){
+        SharedMapEntry& entry = Emplace(shard,record.key);
+        std::string& stored = record.field == VALUE_FIELD ? Value(shard,entry) : Field(shard,entry,record.field);
+        stored = record.value;
+        Account(shard,entry,stored.size());
+        Evict(shard,&entry);
+      }else if (record.operation == SharedMapPersistence::CREATE){
+        Emplace(shard,record.key);
+      }else{
+        auto it = shard.data.find(record.key);
+        if (it == shard.data.end()){
+          return;
+        }
+        if (record.operation == SharedMapPersistence::DESTROY){
+          Erase(shard,it);
+        }else if (record.operation == SharedMapPersistence::DESTROY_FIELD){
+          EraseField(shard,it->second,record.field);
+        }else if (record.operation == SharedMapPersistence::EXPIRE){
+          if (record.deadline < 0){
+            RemoveExpiration(shard,&it->first);
+          }else{
+            const long long now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            if (record.deadline <= now){
+              Erase(shard,it);
+            }else{
+              SetExpiration(shard,&it->first,std::chrono::steady_clock::now() + std::chrono::milliseconds(record.deadline - now));
+              StartExpirationThread();
+            }
+          }
+        }
+      }
+    }
+
+
+    void SharedMapCacheDriver::Dump(const std::function<void(const std::string&)>& write){
+      std::string records;
+      for (auto it = shards_.begin(); it != shards_.end(); ++it){
+        SharedMapShard& shard = *(*it);
+        records.clear();
+        {
+          std::shared_lock<SharedMapMutex> sl(shard.mtx);
+          for (auto it2 = shard.data.begin(); it2 != shard.data.end(); ++it2){
+            if (Expired(shard,&it2->first)){
+              continue;
+            }
+            const SharedMapFields& values = it2->second.values;
+            if (it2->second.plain){
+              SharedMapPersistence::EncodePut(records,it2->first,VALUE_FIELD,it2->second.value);
+            }else if (values.empty()){
+              SharedMapPersistence::EncodeCreate(records,it2->first);
+            }
+            for (auto it3 = values.begin(); it3 != values.end(); ++it3){
+              SharedMapPersistence::EncodePut(records,it2->first,it3->first,it3->second);
+            }
+            const long long deadline = Deadline(shard,&it2->first);
+            if (deadline > -1){
+              SharedMapPersistence::EncodeExpire(records,it2->first,deadline);
+            }
+          }
+        }
+        write(records);
+      }
+    }
+
+
+    const long long SharedMapCacheDriver::Deadline(SharedMapShard& shard, const std::string* key){
+      if (!shard.expirations.empty()){
+        auto it = shard.expirations.find(key);
+        if (it != shard.expirations.end()){
+          const std::chrono::steady_clock::duration remaining = it->second - std::chrono::steady_clock::now();
+          return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch() + remaining).count();
+        }
+      }
+      return -1;
+    }
+
+
+    const std::size_t SharedMapCacheDriver::KeyBytes(const std::string& key){
+      // key, entry, hash table node and index node.
+      return key.size() + sizeof(std::string) + sizeof(SharedMapEntry) + sizeof(void*) * 6;
+    }
+
+
+    const std::size_t SharedMapCacheDriver::FieldBytes(const std::string& field){
+      // field and empty value, stored in the vector of the entry.
+      return field.size() + sizeof(SharedMapFields::value_type);
+    }
+
+
+    const SharedMapEntry::Pool SharedMapCacheDriver::Policy(const std::string& key){
+      for (auto it = eviction_policies_.begin(); it != eviction_policies_.end(); ++it){
+        if (key.compare(0, it->first.length(), it->first) == 0){
+          return it->second;
+        }
+      }
+      return default_eviction_policy_;
+    }
+
+
+    void SharedMapCacheDriver::MatchShard(SharedMapShard& shard, const granada::cache::KeyPattern& pattern, std::vector<const std::string*>& keys){
+      keys.clear();
+      const std::string& prefix = pattern.prefix();
+      std::size_t scanned = 0;
+      if (pattern.kind() == granada::cache::KeyPattern::EXACT){
+        ++scanned;
+        auto it = shard.data.find(prefix);
+        if (it != shard.data.end() && !Expired(shard,&it->first)){
+          keys.push_back(&it->first);
+        }
+      }else if (prefix.empty()){
+        // no prefix, all the keys have to be tested.
+        scanned += shard.data.size();
+        for (auto it = shard.data.begin(); it != shard.data.end(); ++it){
+          if (pattern.Match(it->first) && !Expired(shard,&it->first)){
+            keys.push_back(&it->first);
+          }
+        }
+      }else{
+        // only visit the keys starting with the prefix,
+        // they are contiguous in the index.
+        for (auto it = shard.index.lower_bound(&prefix); it != shard.index.end(); ++it){
+          const std::string& key = *(*it);
+          if (key.compare(0, prefix.length(), prefix) != 0){
+            break;
+          }
+          ++scanned;
+          if (pattern.Match(key) && !Expired(shard,&key)){
+            keys.push_back(&key);
+          }
+        }
+      }
+      granada::cache::ThreadCounters().keys_scanned += scanned;
+    }
+
+
+    std::size_t SharedMapCacheDriver::DestroyShard(SharedMapShard& shard, const granada::cache::KeyPattern& pattern, std::string& records){
+      std::size_t destroyed = 0;
+      const std::string& prefix = pattern.prefix();
+      if (pattern.kind() == granada::cache::KeyPattern::EXACT){
+        auto it = shard.data.find(prefix);
+        if (it != shard.data.end()){
+          if (Expired(shard,&it->first)){
+            notifier_.Publish(granada::cache::CacheEvent::EXPIRE,it->first);
+          }else{
+            notifier_.Publish(granada::cache::CacheEvent::DESTROY,it->first);
+          }
+          ++destroyed;
+          if (persistence_ != nullptr){
+            SharedMapPersistence::EncodeDestroy(records,it->first);
+          }
+          Erase(shard,it);
+        }
+      }else if (prefix.empty()){
+        // no prefix, all the keys have to be tested.
+        for (auto it = shard.data.begin(); it != shard.data.end();){
+          auto erased = it++;
+          if (pattern.Match(erased->first)){
+            if (Expired(shard,&erased->first)){
+              notifier_.Publish(granada::cache::CacheEvent::EXPIRE,erased->first);
+            }else{
+              notifier_.Publish(granada::cache::CacheEvent::DESTROY,erased->first);
+            }
+            ++destroyed;
+            if (persistence_ != nullptr){
+              SharedMapPersistence::EncodeDestroy(records,erased->first);
+            }
+            Erase(shard,erased);
+          }
+        }
+      }else{
+        // only visit the keys starting with the prefix,
+        // they are contiguous in the index.
+        for (auto it = shard.index.lower_bound(&prefix); it != shard.index.end();){
+          const std::string& key = *(*it++);
+          if (key.compare(0, prefix.length(), prefix) != 0){
+            break;
+          }
+          if (pattern.Match(key)){
+            if (Expired(shard,&key)){
+              notifier_.Publish(granada::cache::CacheEvent::EXPIRE,key);
+            }else{
+              notifier_.Publish(granada::cache::CacheEvent::DESTROY,key);
+            }
+            ++destroyed;
+            if (persistence_ != nullptr){
+              SharedMapPersistence::EncodeDestroy(records,key);
+            }
+            Erase(shard,shard.data.find(key));
+          }
+        }
+      }
+      return destroyed;
+    }
+
+
+    const bool SharedMapCacheDriver::Expired(SharedMapShard& shard, const std::string* key){
+      if (shard.expirations.empty()){
+        return false;
+      }
+      auto it = shard.expirations.find(key);
+      return it != shard.expirations.end() && it->second <= std::chrono::steady_clock::now();
+    }
+
+
+    void SharedMapCacheDriver::SetExpiration(SharedMapShard& shard, const std::string* key, const std::chrono::steady_clock::time_point& time){
+      RemoveExpiration(shard,key);
+      shard.expirations.emplace(key,time);
+      shard.expiration_queue.emplace(time,key);
+    }
+
+
+    const bool SharedMapCacheDriver::RemoveExpiration(SharedMapShard& shard, const std::string* key){
+      if (shard.expirations.empty()){
+        return false;
+      }
+      auto it = shard.expirations.find(key);
+      if (it != shard.expirations.end()){
+        shard.expiration_queue.erase(std::make_pair(it->second,key));
+        shard.expirations.erase(it);
+        return true;
+      }
+      return false;
+    }
+
+
+    const std::size_t SharedMapCacheDriver::RemoveExpired(SharedMapShard& shard, const std::size_t& count){
+      std::size_t removed = 0;
+      if (!shard.expiration_queue.empty()){
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        while (removed < count && !shard.expiration_queue.empty() && shard.expiration_queue.begin()->first <= now){
+          notifier_.Publish(granada::cache::CacheEvent::EXPIRE,*(shard.expiration_queue.begin()->second));
+          Erase(shard,shard.data.find(*(shard.expiration_queue.begin()->second)));
+          ++removed;
+        }
+        shard.expired += removed;
+      }
+      return removed;
+    }
+
+
+    void SharedMapCacheDriver::StartExpirationThread(){
+      if (expire_frequency_ > -1){
+        std::call_once(expiration_thread_flag_,[this]{
+          expiration_thread_ = std::thread([this]{
+            std::unique_lock<std::mutex> lock(expiration_mtx_);
+            while (!expiration_stop_){
+              expiration_cv_.wait_for(lock,std::chrono::milliseconds(expire_frequency_));
+              if (!expiration_stop_){
+                lock.unlock();
+                RemoveExpired(default_numbers::shared_map_cache_driver_expire_count);
+                lock.lock();
+              }
+            }
+          });
+        });
+      }
+    }
+
   }
 }
@@ -30,18 +30,37 @@
   * 								|_ key1 => value3
   * 							 	|_ key2 => value4
   *
+  * Keys are distributed in shards by key hash, each shard
+  * has its own unordered map and its own mutex.
+  *
   * This code is multi-thread safe.
   *
   */
 
 #pragma once
 #include "cache_handler.h"
-#include <regex>
 #include <string>
 #include <deque>
+#include <list>
+#include <atomic>
 #include <unordered_map>
 #include <map>
+#include <algorithm>
+#include <set>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <shared_mutex>
 #include "util/string.h"
+#include "util/application.h"
+#include "defaults.h"
+#include "cache/key_pattern.h"
+#include "cache/shared_map_persistence.h"
+#include "cache/shared_map_arena.h"
+#include "cache/cache_notifier.h"
 
 namespace granada{
   namespace cache{
@@ -51,6 +70,18 @@ namespace granada{
 
     /**
      * Tool for iterate over cache keys with a given pattern.
+     * Keys are not copied all at once, like with a Redis SCAN they are
+     * retrieved in batches, each batch is read under the lock of one shard,
+     * so memory used by the iterator is bounded by the batch size.
+     *
+     * Keys are visited shard by shard, in the order of the shard index.
+     * The position in the shard is the last visited key, so:
+     *  - a key matching the pattern and present during the whole
+     *    iteration is returned exactly once.
+     *  - a key added or removed during the iteration may or may not
+     *    be returned.
+     *  - a key renamed during the iteration may be returned with its
+     *    old name, its new name, both or none.
      */
     class SharedMapIterator : public CacheHandlerIterator{
 
@@ -81,6 +112,16 @@ namespace granada{
         SharedMapIterator(const std::string& expression, SharedMapCacheDriver* cache);
 
 
+        /**
+         * Constructor.
+         * @param expression    Expression used to match keys.
+         * @param cache         Pointer to the cache where to search the keys.
+         * @param batch_size    Maximum number of keys visited each time
+         *                      a shard is locked.
+         */
+        SharedMapIterator(const std::string& expression, SharedMapCacheDriver* cache, const std::size_t& batch_size);
+
+
         /**
          * Destructor
          */
@@ -120,16 +161,543 @@ namespace granada{
 
 
         /**
-         * Vector for storing found keys.
+         * Compiled expression.
+         */
+        granada::cache::KeyPattern pattern_;
+
+
+        /**
+         * Maximum number of keys visited each time a shard is locked.
+         */
+        std::size_t batch_size_ = default_numbers::shared_map_cache_driver_scan_count;
+
+
+        /**
+         * Number of the shard being iterated.
+         */
+        std::size_t shard_ = 0;
+
+
+        /**
+         * Last key visited in the shard being iterated.
+         */
+        std::string cursor_;
+
+
+        /**
+         * True if cursor_ contains the last visited key, false
+         * if no key of the shard has been visited yet.
+         */
+        bool started_ = false;
+
+
+        /**
+         * Found keys of the current batch not returned yet.
+         */
+        std::deque<std::string> keys_;
+
+
+        /**
+         * Retrieves batches until a key is found or
+         * there are no more keys to visit.
+         */
+        void Fetch();
+
+    };
+
+
+    /**
+     * Orders pointers to keys by the value of the keys.
+     */
+    struct SharedMapKeyLess{
+      bool operator()(const std::string* a, const std::string* b) const {
+        return *a < *b;
+      }
+    };
+
+
+    /**
+     * Fields of a map and their values, stored in a vector ordered by
+     * field. Maps stored in the cache have a few small fields, a
+     * binary search over contiguous pairs is faster than a tree and
+     * only needs one allocation; short fields and values are kept
+     * inside the strings themselves.
+     */
+    class SharedMapFields{
+
+      public:
+
+        typedef std::pair<std::string,std::string> value_type;
+        typedef std::vector<value_type,SharedMapAllocator<value_type>> vector_type;
+        typedef vector_type::iterator iterator;
+        typedef vector_type::const_iterator const_iterator;
+
+
+        /**
+         * Constructor
+         * @param arena Arena the fields are allocated in,
+         *              nullptr to allocate them in the heap.
+         */
+        SharedMapFields(SharedMapArena* arena = nullptr) : fields_(SharedMapAllocator<value_type>(arena)){};
+
+        iterator begin(){ return fields_.begin(); };
+        iterator end(){ return fields_.end(); };
+        const_iterator begin() const { return fields_.begin(); };
+        const_iterator end() const { return fields_.end(); };
+        const bool empty() const { return fields_.empty(); };
+        const std::size_t size() const { return fields_.size(); };
+
+
+        /**
+         * Returns the position of a field or end() if it is not found.
+         * @param field Field.
+         */
+        iterator find(const std::string& field){
+          iterator it = lower_bound(field);
+          if (it != fields_.end() && it->first == field){
+            return it;
+          }
+          return fields_.end();
+        };
+
+
+        const_iterator find(const std::string& field) const {
+          return const_cast<SharedMapFields*>(this)->find(field);
+        };
+
+
+        /**
+         * Inserts a field if it does not exist.
+         * @param field Field.
+         * @param value Value of the field.
+         * @return      Position of the field and true if it has been inserted.
+         */
+        std::pair<iterator,bool> emplace(const std::string& field, std::string&& value){
+          iterator it = lower_bound(field);
+          if (it != fields_.end() && it->first == field){
+            return std::make_pair(it,false);
+          }
+          return std::make_pair(fields_.emplace(it,field,std::move(value)),true);
+        };
+
+
+        /**
+         * Removes the field at the given position.
+         */
+        void erase(iterator it){
+          fields_.erase(it);
+        };
+
+
+        /**
+         * Reserves room for the given number of fields, so writing
+         * several fields at once only allocates once.
+         */
+        void reserve(const std::size_t& size){
+          fields_.reserve(size);
+        };
+
+
+        /**
+         * Removes all the fields and releases their memory.
+         */
+        void clear(){
+          vector_type(fields_.get_allocator()).swap(fields_);
+        };
+
+
+        /**
+         * Swaps the fields of two maps allocated in the same arena.
+         */
+        void swap(SharedMapFields& other){
+          fields_.swap(other.fields_);
+        };
+
+
+      private:
+
+        /**
+         * Pairs of field and value, ordered by field.
+         */
+        vector_type fields_;
+
+
+        iterator lower_bound(const std::string& field){
+          return std::lower_bound(fields_.begin(), fields_.end(), field, [](const value_type& pair, const std::string& field){
+            return pair.first < field;
+          });
+        };
+    };
+
+
+    struct SharedMapEntry;
+
+
+    /**
+     * CLOCK of entries and list of keys of a shard,
+     * allocated in the arena of the shard.
+     */
+    typedef std::list<SharedMapEntry*,SharedMapAllocator<SharedMapEntry*>> SharedMapClock;
+    typedef std::list<const std::string*,SharedMapAllocator<const std::string*>> SharedMapKeyList;
+
+
+    /**
+     * Values of a key and the information needed to
+     * account its memory and to evict it.
+     * A key written with Write(key,value) is plain: its value is
+     * stored in value and it has no fields. A key written with
+     * Write(hash,key,value) is a map: its values are stored by field.
+     * Writing a key of the other kind replaces its content.
+     */
+    struct SharedMapEntry{
+
+      /**
+       * Eviction pools an entry can belong to.
+       * PINNED entries are never evicted, LRU entries are in the
+       * CLOCK of the shard, ARC entries are in one of the two
+       * CLOCKs of the CAR (Clock with Adaptive Replacement) of the shard.
+       */
+      enum Pool{ PINNED, LRU, ARC_RECENT, ARC_FREQUENT };
+
+      /**
+       * Constructor
+       * @param arena Arena of the shard of the entry, nullptr if
+       *              the shard allocates in the heap.
+       */
+      SharedMapEntry(SharedMapArena* arena) : values(arena), referenced(false){};
+
+      /**
+       * Values of the key by field.
+       */
+      SharedMapFields values;
+
+      /**
+       * Value of a plain key.
+       */
+      std::string value;
+
+      /**
+       * True if the key is plain.
+       */
+      bool plain = false;
+
+      /**
+       * Pointer to the key, stored in the shard.
+       */
+      const std::string* key = nullptr;
+
+      /**
+       * Bytes used by the key, its fields and its values.
+       */
+      std::size_t bytes = 0;
+
+      /**
+       * Pool the entry belongs to.
+       */
+      Pool pool = PINNED;
+
+      /**
+       * Position of the entry in the CLOCK of its pool.
+       */
+      SharedMapClock::iterator position;
+
+      /**
+       * Set by readers when the entry is used, cleared when the hand of
+       * the CLOCK passes over it. Atomic so readers can set it with
+       * the shared lock of the shard.
+       */
+      std::atomic_bool referenced;
+    };
+
+
+    /**
+     * Key recently evicted from a CAR, remembered to adapt
+     * the target size of its recent CLOCK.
+     */
+    struct SharedMapGhost{
+
+      /**
+       * True if the key was evicted from the frequent CLOCK.
+       */
+      bool frequent;
+
+      /**
+       * Position of the ghost in its ghost list.
+       */
+      SharedMapKeyList::iterator position;
+    };
+
+
+    /**
+     * Counters of a shared map cache driver.
+     */
+    struct SharedMapCacheStats{
+
+      /**
+       * Number of keys.
+       */
+      std::size_t keys = 0;
+
+      /**
+       * Bytes used by keys, fields and values.
+       */
+      std::size_t bytes = 0;
+
+      /**
+       * Memory budget in bytes, 0 if unlimited.
+       */
+      std::size_t max_bytes = 0;
+
+      /**
+       * Number of keys evicted from the LRU pools.
+       */
+      std::size_t lru_evictions = 0;
+
+      /**
+       * Number of keys evicted from the ARC pools.
+       */
+      std::size_t arc_evictions = 0;
+
+      /**
+       * Number of expired keys removed.
+       */
+      std::size_t expired = 0;
+
+      /**
+       * Bytes allocated by the containers of the shards
+       * in their arenas, 0 if they do not use arenas.
+       */
+      std::size_t allocated_bytes = 0;
+
+      /**
+       * Bytes taken from the heap by the arenas.
+       */
+      std::size_t reserved_bytes = 0;
+
+      /**
+       * Part of the reserved bytes not allocated, from 0 to 1.
+       */
+      double fragmentation = 0;
+
+      /**
+       * Number of slabs of the arenas.
+       */
+      std::size_t slabs = 0;
+
+      /**
+       * Part of the blocks of the slabs in use, from 0 to 1.
+       */
+      double slab_occupancy = 0;
+
+      /**
+       * Number of times a thread had to wait for the mutex of a shard.
+       */
+      unsigned long long lock_waits = 0;
+
+      /**
+       * Nanoseconds threads waited for the mutexes of the shards.
+       */
+      unsigned long long lock_wait_ns = 0;
+    };
+
+
+    /**
+     * Containers of a shard, allocated in the arena of the shard.
+     */
+    typedef std::unordered_map<std::string,SharedMapEntry,std::hash<std::string>,std::equal_to<std::string>,SharedMapAllocator<std::pair<const std::string,SharedMapEntry>>> SharedMapData;
+    typedef std::set<const std::string*,SharedMapKeyLess,SharedMapAllocator<const std::string*>> SharedMapIndex;
+    typedef std::unordered_map<const std::string*,std::chrono::steady_clock::time_point,std::hash<const std::string*>,std::equal_to<const std::string*>,SharedMapAllocator<std::pair<const std::string* const,std::chrono::steady_clock::time_point>>> SharedMapExpirations;
+    typedef std::set<std::pair<std::chrono::steady_clock::time_point,const std::string*>,std::less<std::pair<std::chrono::steady_clock::time_point,const std::string*>>,SharedMapAllocator<std::pair<std::chrono::steady_clock::time_point,const std::string*>>> SharedMapExpirationQueue;
+    typedef std::unordered_map<std::string,SharedMapGhost,std::hash<std::string>,std::equal_to<std::string>,SharedMapAllocator<std::pair<const std::string,SharedMapGhost>>> SharedMapGhosts;
+
+
+    /**
+     * Mutex of a shard. Counts the times a thread had to wait for it
+     * and for how long, a lock obtained at the first try costs the
+     * same as with the std::shared_timed_mutex it wraps.
+     */
+    class SharedMapMutex{
+
+      public:
+
+        void lock(){
+          if (!mtx_.try_lock()){
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            mtx_.lock();
+            Waited(start);
+          }
+        };
+
+        bool try_lock(){
+          return mtx_.try_lock();
+        };
+
+        void unlock(){
+          mtx_.unlock();
+        };
+
+        void lock_shared(){
+          if (!mtx_.try_lock_shared()){
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            mtx_.lock_shared();
+            Waited(start);
+          }
+        };
+
+        bool try_lock_shared(){
+          return mtx_.try_lock_shared();
+        };
+
+        void unlock_shared(){
+          mtx_.unlock_shared();
+        };
+
+
+        /**
+         * Number of locks that had to wait.
+         */
+        std::atomic<unsigned long long> waits{0};
+
+
+        /**
+         * Nanoseconds waited.
          */
-        std::vector<std::string> keys_;
+        std::atomic<unsigned long long> wait_ns{0};
+
+
+      private:
+
+        std::shared_timed_mutex mtx_;
 
 
         /**
-         * Iterator.
+         * Adds the time waited since start to the counters of
+         * the mutex and of the thread.
          */
-        std::vector<std::string>::iterator it_;
+        void Waited(const std::chrono::steady_clock::time_point& start){
+          const unsigned long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+          waits.fetch_add(1,std::memory_order_relaxed);
+          wait_ns.fetch_add(ns,std::memory_order_relaxed);
+          granada::cache::ThreadCounters().lock_wait_ns += ns;
+        };
+    };
+
+
+    /**
+     * Part of the cache data protected by its own mutex.
+     * A key always belongs to the same shard.
+     * Readers share the mutex, so concurrent reads never block
+     * each other, writers lock it exclusively.
+     */
+    struct SharedMapShard{
+
+      /**
+       * Constructor
+       * @param shard_arena Arena of the containers of the shard,
+       *                    nullptr to allocate them in the heap.
+       */
+      SharedMapShard(std::unique_ptr<SharedMapArena>&& shard_arena)
+        : arena(std::move(shard_arena)),
+          data(SharedMapAllocator<char>(arena.get())),
+          index(SharedMapKeyLess(),SharedMapAllocator<char>(arena.get())),
+          expirations(SharedMapAllocator<char>(arena.get())),
+          expiration_queue(SharedMapExpirationQueue::key_compare(),SharedMapAllocator<char>(arena.get())),
+          lru(SharedMapAllocator<char>(arena.get())),
+          arc_recent(SharedMapAllocator<char>(arena.get())),
+          arc_frequent(SharedMapAllocator<char>(arena.get())),
+          arc_recent_ghosts(SharedMapAllocator<char>(arena.get())),
+          arc_frequent_ghosts(SharedMapAllocator<char>(arena.get())),
+          arc_ghosts(SharedMapAllocator<char>(arena.get())){};
+
+      /**
+       * Arena of the containers of the shard, nullptr if they
+       * are allocated in the heap. Declared first, so it is
+       * destroyed after the containers.
+       */
+      std::unique_ptr<SharedMapArena> arena;
+
+      /**
+       * Values of the shard by key.
+       */
+      SharedMapData data;
+
+      /**
+       * Keys of data in order, used to iterate over the keys
+       * starting with a prefix without scanning all the keys.
+       * Points to the keys stored in data, which do not move
+       * when data is rehashed.
+       */
+      SharedMapIndex index;
+
+      /**
+       * Time when each key with a time to live expires.
+       * Keys without time to live are not included.
+       */
+      SharedMapExpirations expirations;
+
+      /**
+       * Keys with a time to live ordered by expiration time,
+       * the first one is the next key to expire.
+       */
+      SharedMapExpirationQueue expiration_queue;
+
+      /**
+       * Bytes used by the entries of the shard.
+       */
+      std::size_t bytes = 0;
+
+      /**
+       * Memory budget of the shard in bytes, 0 if unlimited.
+       */
+      std::size_t max_bytes = 0;
+
+      /**
+       * CLOCK of the LRU entries, the hand is at the front.
+       */
+      SharedMapClock lru;
+
+      /**
+       * Bytes used by the LRU entries.
+       */
+      std::size_t lru_bytes = 0;
+
+      /**
+       * CLOCKs of the ARC entries seen once and seen more than
+       * once since they were inserted, the hands are at the front.
+       */
+      SharedMapClock arc_recent;
+      SharedMapClock arc_frequent;
+
+      /**
+       * Bytes used by the entries of arc_recent and arc_frequent.
+       */
+      std::size_t arc_recent_bytes = 0;
+      std::size_t arc_frequent_bytes = 0;
 
+      /**
+       * Target bytes of arc_recent, adapted with the ghost hits.
+       */
+      std::size_t arc_target = 0;
+
+      /**
+       * Keys recently evicted from arc_recent and arc_frequent,
+       * most recent at the front.
+       */
+      SharedMapKeyList arc_recent_ghosts;
+      SharedMapKeyList arc_frequent_ghosts;
+      SharedMapGhosts arc_ghosts;
+
+      /**
+       * Counters.
+       */
+      std::size_t lru_evictions = 0;
+      std::size_t arc_evictions = 0;
+      std::size_t expired = 0;
+
+      /**
+       * Mutex for thread safety.
+       */
+      SharedMapMutex mtx;
     };
 
 
@@ -143,22 +711,116 @@ namespace granada{
      *                 |_ key1 => value3
      *                 |_ key2 => value4
      *
+     * Keys are distributed in N shards selected by key hash, so
+     * operations on keys of different shards do not block each other.
+     * Each shard keeps an ordered index of its keys, so expressions
+     * starting with a prefix, as "session:value:*", only visit the
+     * keys with that prefix.
+     * Exists, Read and Keys only take a shared lock on the shard,
+     * Write, Destroy and Rename take it exclusively.
+     * The number of shards is taken from the "shared_map_cache_driver_shards"
+     * property of the server configuration file.
+     *
+     * Keys can have a time to live. Expired keys are invisible to readers
+     * as soon as their time is over, they are removed from memory by the
+     * writers of the shard and by a background thread started with the
+     * first call to Expire, which runs every
+     * "shared_map_cache_driver_expire_frequency" milliseconds.
+     *
+     * The memory used by keys, fields and values is accounted. When the
+     * "shared_map_cache_driver_max_bytes" budget is exceeded, keys are
+     * evicted following the policy of their namespace, given in the
+     * "shared_map_cache_driver_eviction" property, example:
+     *   {"session:":"lru","message:":"arc"}
+     * Keys of namespaces without policy are pinned and never evicted.
+     * LRU is approximated with a CLOCK and ARC with a CAR, so readers
+     * only set a reference bit and keep sharing the lock.
+     *
+     * Caches constructed with a name can be persisted with an
+     * append-only log and snapshots, see SharedMapPersistence.
+     *
      * This code is multi-thread safe.
      */
     class SharedMapCacheDriver : public CacheHandler
     {
       public:
 
+        // operations with CacheKey keys of CacheHandler, otherwise
+        // hidden by the operations of the same name of this driver.
+        using CacheHandler::Exists;
+        using CacheHandler::Read;
+        using CacheHandler::ReadAll;
+        using CacheHandler::ReadMany;
+        using CacheHandler::Write;
+        using CacheHandler::WriteMany;
+        using CacheHandler::WriteIfNotExists;
+        using CacheHandler::CompareAndSet;
+        using CacheHandler::Increment;
+        using CacheHandler::Destroy;
+        using CacheHandler::DestroyMatch;
+        using CacheHandler::Expire;
+        using CacheHandler::WriteWithTTL;
+        using CacheHandler::WriteManyWithTTL;
+        using CacheHandler::IncrementWithTTL;
+        using CacheHandler::TakeTokens;
+        using CacheHandler::make_iterator;
+        using CacheHandler::ReadAsync;
+        using CacheHandler::ReadManyAsync;
+
+
         /**
          * Constructor
+         * Number of shards is taken from the server configuration file.
          */
         SharedMapCacheDriver();
 
 
+        /**
+         * Constructor
+         * @param shards  Number of shards, each shard has its own mutex.
+         */
+        SharedMapCacheDriver(const int& shards);
+
+
+        /**
+         * Constructor
+         * @param shards          Number of shards, each shard has its own mutex.
+         * @param slab_allocator  True to allocate the containers of each shard
+         *                        in a slab arena of the shard instead of the heap.
+         */
+        SharedMapCacheDriver(const int& shards, const bool& slab_allocator);
+
+
+        /**
+         * Constructor
+         * Same as the default constructor, and if the
+         * "shared_map_cache_driver_persistence_directory" property is set,
+         * the cache is loaded from and persisted in the files of that
+         * directory starting with the given name.
+         * @param name  Name of the cache, unique per directory,
+         *              example: "session".
+         */
+        SharedMapCacheDriver(const std::string& name);
+
+
+        /**
+         * Constructor
+         * Same as the constructor with a name, with settings taking
+         * precedence over the properties of the server configuration file.
+         * Settings are named as the properties without the
+         * "shared_map_cache_driver_" prefix, example:
+         * {"shards":"64","max_bytes":"268435456","eviction":"{\"session:\":\"lru\"}"}
+         * @param name      Name of the cache, unique per directory.
+         * @param settings  Settings by name.
+         */
+        SharedMapCacheDriver(const std::string& name, const std::map<std::string,std::string>& settings);
+
+
         /**
          * Destructor
+         * Stops the thread removing the expired keys.
          */
-        virtual ~SharedMapCacheDriver(){};
+        virtual ~SharedMapCacheDriver();
 
 
         /**
@@ -195,6 +857,27 @@ namespace granada{
         virtual const std::string Read(const std::string& hash,const std::string& key);
 
 
+        /**
+         * Fills a map with all the key-value pairs of a map, locking
+         * its shard once.
+         * @param  hash   Name of the map.
+         * @param  values Map filled with the key-value pairs.
+         * @return        True if the map exists, false if it does not.
+         */
+        virtual const bool ReadAll(const std::string& hash, std::map<std::string,std::string>& values) override;
+
+
+        /**
+         * Returns the values of several keys of a map, locking
+         * its shard once.
+         * @param  hash   Name of the map.
+         * @param  keys   Keys to identify the values.
+         * @param  values Vector filled with the value of each key.
+         * @return        True if the map exists, false if it does not.
+         */
+        virtual const bool ReadMany(const std::string& hash, const std::vector<std::string>& keys, std::vector<std::string>& values) override;
+
+
         /**
          * Set a value in the cache associated with a given key.
          * @param key   Key of the value.
@@ -203,6 +886,15 @@ namespace granada{
         virtual void Write(const std::string& key,const std::string& value);
 
 
+        /**
+         * Set a value in the cache associated with a given key.
+         * The value is moved into the cache.
+         * @param key   Key of the value.
+         * @param value Value.
+         */
+        virtual void Write(const std::string& key,std::string&& value);
+
+
         /**
          * Inserts or rewrite a key-value pair in a map with the given name.
          * If the set does not exist, it creates it.
@@ -214,35 +906,260 @@ namespace granada{
 
 
         /**
-         * Destroys a set of key-value pairs with the given name.
-         * @param hash Name of the unordered map containing the key-value pairs
+         * Inserts or rewrite a key-value pair in a map with the given name.
+         * If the set does not exist, it creates it.
+         * The value is moved into the cache.
+         * @param  hash Name of the map.
+         * @param  key  Key to identify the value.
+         * @param       Value.
          */
-        virtual void Destroy(const std::string& key);
+        virtual void Write(const std::string& hash,const std::string& key,std::string&& value);
 
 
         /**
-         * Destroys a key value pair of a given set.
-         * @param hash Name of the unordered map containing the key-value pair to destroy.
-         * @param key  Key associated with the value to destroy.
+         * Inserts or rewrite several key-value pairs in a map with the
+         * given name, locking its shard once.
+         * @param hash    Name of the map.
+         * @param values  Key-value pairs.
          */
-        virtual void Destroy(const std::string& hash,const std::string& key);
+        virtual void WriteMany(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values) override;
 
 
         /**
-         * Renames a key if it does not already exists.
-         * 
-         * @param old_key Old key to rename.
-         * @param new_key New key.
-         * 
-         * @return        True if the key could be renamed, false if not, for
-         *                example it will return false if the new key already existed.
-         */
+         * Sets a value only if the key does not exist,
+         * checked and written under the lock of its shard.
+         * @param key   Key of the value.
+         * @param value Value.
+         * @return      True if the value has been written.
+         */
+        virtual const bool WriteIfNotExists(const std::string& key,const std::string& value) override;
+
+
+        /**
+         * Inserts a key-value pair in a map only if the key does not
+         * exist in the map, checked and written under the lock of its shard.
+         * @param hash  Name of the map.
+         * @param key   Key to identify the value inside the map.
+         * @param value Value
+         * @return      True if the value has been written.
+         */
+        virtual const bool WriteIfNotExists(const std::string& hash,const std::string& key,const std::string& value) override;
+
+
+        /**
+         * Replaces the value of a key in a map only if its current
+         * value is the expected one.
+         * @param hash      Name of the map.
+         * @param key       Key to identify the value inside the map.
+         * @param expected  Expected current value, empty if the key does not exist.
+         * @param value     New value.
+         * @return          True if the value has been replaced.
+         */
+        virtual const bool CompareAndSet(const std::string& hash,const std::string& key,const std::string& expected,const std::string& value) override;
+
+
+        /**
+         * Adds a number to the integer value of a key,
+         * a value that is not an integer counts as 0.
+         * @param key       Key of the value.
+         * @param increment Number to add, may be negative.
+         * @return          Value after the increment.
+         */
+        virtual const long long Increment(const std::string& key,const long long& increment) override;
+
+
+        /**
+         * Adds a number to the integer value of a key in a map,
+         * a value that is not an integer counts as 0.
+         * @param hash      Name of the map.
+         * @param key       Key to identify the value inside the map.
+         * @param increment Number to add, may be negative.
+         * @return          Value after the increment.
+         */
+        virtual const long long Increment(const std::string& hash,const std::string& key,const long long& increment) override;
+
+
+        /**
+         * Adds a number to the integer value of a key and sets its
+         * time to live if it has none, in one step.
+         * @param key       Key of the value.
+         * @param increment Number to add, may be negative.
+         * @param seconds   Seconds the key will live from its first increment.
+         * @return          Value after the increment.
+         */
+        virtual const long long IncrementWithTTL(const std::string& key,const long long& increment,const long long& seconds) override;
+
+
+        /**
+         * Takes tokens from the token bucket stored in a key if it has
+         * enough of them, the bucket is read and replaced under the lock
+         * of its shard.
+         * @param key       Key of the bucket.
+         * @param tokens    Number of tokens to take.
+         * @param capacity  Maximum number of tokens of the bucket.
+         * @param rate      Tokens added to the bucket per second.
+         * @return          Number of tokens left, -1 if the bucket
+         *                  did not have enough tokens.
+         */
+        virtual const long long TakeTokens(const std::string& key,const long long& tokens,const long long& capacity,const double& rate) override;
+
+
+        /**
+         * Returns the integer in a value plus an increment,
+         * a value that is not an integer counts as 0.
+         * Used by the local drivers to increment values.
+         * @param value     Value.
+         * @param increment Number to add.
+         */
+        static const long long Add(const std::string& value, const long long& increment);
+
+
+        /**
+         * Destroys a set of key-value pairs with the given name.
+         * @param hash Name of the unordered map containing the key-value pairs
+         */
+        virtual void Destroy(const std::string& key);
+
+
+        /**
+         * Destroys a key value pair of a given set.
+         * @param hash Name of the unordered map containing the key-value pair to destroy.
+         * @param key  Key associated with the value to destroy.
+         */
+        virtual void Destroy(const std::string& hash,const std::string& key);
+
+
+        /**
+         * Destroys all the keys matching an expression in one pass.
+         * The shards are swept one at a time, only the shard being swept
+         * is locked, so the sweep is not atomic: while it runs, other
+         * threads see the matching keys of the shards not swept yet, and
+         * a matching key written in a shard already swept is kept.
+         * The removals of each shard are logged as one batch.
+         * @param expression  Expression, as in Match.
+         * @return            Number of keys destroyed, matching keys
+         *                    already expired included.
+         */
+        virtual const std::size_t DestroyMatch(const std::string& expression) override;
+
+
+        /**
+         * Renames a key if it does not already exists.
+         * Old key and new key may belong to different shards, in that
+         * case both shards are locked.
+         * 
+         * @param old_key Old key to rename.
+         * @param new_key New key.
+         * 
+         * @return        True if the key could be renamed, false if not, for
+         *                example it will return false if the new key already existed.
+         */
         virtual bool Rename(const std::string& old_key, const std::string& new_key);
 
 
+        /**
+         * Returns true, keys can expire.
+         * @return  True.
+         */
+        virtual const bool SupportsExpire(){
+          return true;
+        };
+
+
+        /**
+         * Sets the time to live of a key.
+         * @param key     Key.
+         * @param seconds Seconds the key will live from now,
+         *                -1 to remove the time to live of the key.
+         * @return        True if the time to live was set, false if the
+         *                key does not exist.
+         */
+        virtual const bool Expire(const std::string& key, const long long& seconds);
+
+
+        /**
+         * Returns the remaining time to live of a key.
+         * @param key Key.
+         * @return    Remaining seconds, -1 if the key exists but
+         *            does not expire, -2 if the key does not exist.
+         */
+        virtual const long long TTL(const std::string& key);
+
+
+        /**
+         * Sets a value in the cache associated with a given key
+         * and its time to live in one step.
+         * @param key     Key of the value.
+         * @param value   Value.
+         * @param seconds Seconds the key will live from now.
+         */
+        virtual void WriteWithTTL(const std::string& key,const std::string& value,const long long& seconds);
+
+
+        /**
+         * Inserts or rewrite a key-value pair in a map with the given name
+         * and sets the time to live of the map in one step.
+         * @param hash    Name of the map.
+         * @param key     Key to identify the value.
+         * @param value   Value.
+         * @param seconds Seconds the map will live from now.
+         */
+        virtual void WriteWithTTL(const std::string& hash,const std::string& key,const std::string& value,const long long& seconds);
+
+
+        /**
+         * Inserts or rewrite several key-value pairs in a map with the
+         * given name and sets the time to live of the map in one step.
+         * @param hash    Name of the map.
+         * @param values  Key-value pairs.
+         * @param seconds Seconds the map will live from now.
+         */
+        virtual void WriteManyWithTTL(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values,const long long& seconds) override;
+
+
+        /**
+         * Removes the expired keys of all the shards from memory.
+         * Each shard is locked for at most count keys at a time.
+         * Called periodically by the expiration thread.
+         * @param count Maximum number of keys removed each time a shard is locked.
+         * @return      Number of removed keys.
+         */
+        const std::size_t RemoveExpired(const std::size_t& count);
+
+
+        /**
+         * Sets the memory budget of the cache, split between the shards.
+         * Keys are evicted on the next writes if the budget is exceeded.
+         * @param max_bytes Maximum bytes used by keys, fields and values,
+         *                  0 for unlimited.
+         */
+        void SetMaxBytes(const std::size_t& max_bytes);
+
+
+        /**
+         * Sets the eviction policy of the keys starting with the given
+         * namespace. Only applies to keys inserted after the call, so
+         * it should be called before using the cache.
+         * @param name_space  Namespace, example: "session:",
+         *                    "*" to set the policy of the keys without namespace policy.
+         * @param policy      "lru", "arc" or "none" for pinned keys.
+         */
+        void SetEvictionPolicy(const std::string& name_space, const std::string& policy);
+
+
+        /**
+         * Returns the counters of the cache.
+         * @return  Counters summed over all the shards.
+         */
+        const SharedMapCacheStats Stats();
+
+
         /**
          * Fills a vector with keys of the cache that match
-         * a given expression.
+         * a given expression. Shards are scanned one after
+         * the other, each one under its own lock.
+         * The expression is a glob pattern, it is compiled once
+         * and "*" is the only special character.
          * 
          * @param expression  Expression used to match keys.
          *                    
@@ -261,6 +1178,34 @@ namespace granada{
         void Keys(const std::string& expression, std::vector<std::string>& keys);
 
 
+        /**
+         * Visits a batch of keys of a shard in order, starting after
+         * the given cursor, and adds the ones matching the pattern
+         * to the given deque. The shard is locked only during the call.
+         *
+         * @param shard     Number of the shard.
+         * @param pattern   Compiled pattern.
+         * @param started   True if cursor contains the last visited key,
+         *                  false to start at the beginning of the shard.
+         *                  Set to true if a key is visited.
+         * @param cursor    Last visited key, updated with the last key
+         *                  visited by this call.
+         * @param count     Maximum number of keys to visit.
+         * @param keys      Deque where matching keys are added.
+         * @return          True if there are no more keys to visit in the shard.
+         */
+        const bool Scan(const std::size_t& shard, const granada::cache::KeyPattern& pattern, bool& started, std::string& cursor, const std::size_t& count, std::deque<std::string>& keys);
+
+
+        /**
+         * Returns the number of shards.
+         * @return  Number of shards.
+         */
+        const std::size_t shards(){
+          return shards_.size();
+        };
+
+
         /**
          * Returns an iterator to iterate over keys with an expression.
          * @param   Expression to be use to iterate over keys that match this expression.
@@ -272,17 +1217,537 @@ namespace granada{
         };
 
 
+        /**
+         * Calls the given function with the changes of the keys matching
+         * an expression. Changes are published while the shard is locked,
+         * in the order they are made, and delivered by the thread of the
+         * notifier. Expired keys are notified when they are removed, by
+         * the expiration thread or by the next write in their shard,
+         * evicted keys are notified as expired.
+         *
+         * @param expression  Expression, example: session:roles:*
+         * @param subscriber  Function called with each change.
+         * @return            Identifier of the subscription.
+         */
+        virtual const std::size_t Subscribe(const std::string& expression, const granada::cache::CacheSubscriber& subscriber) override {
+          return notifier_.Subscribe(expression,subscriber);
+        };
+
+
+        /**
+         * Cancels a subscription.
+         * @param subscription  Identifier returned by Subscribe.
+         */
+        virtual void Unsubscribe(const std::size_t& subscription) override {
+          notifier_.Unsubscribe(subscription);
+        };
+
+
+        /**
+         * Returns a completed task with the result of Exists,
+         * the shards are in memory so there is no I/O to wait for.
+         */
+        virtual pplx::task<bool> ExistsAsync(const std::string& key) override {
+          return pplx::task_from_result((bool)Exists(key));
+        };
+
+
+        /**
+         * Returns a completed task with the result of Exists.
+         */
+        virtual pplx::task<bool> ExistsAsync(const std::string& hash,const std::string& key) override {
+          return pplx::task_from_result((bool)Exists(hash,key));
+        };
+
+
+        /**
+         * Returns a completed task with the result of Read.
+         */
+        virtual pplx::task<std::string> ReadAsync(const std::string& key) override {
+          return pplx::task_from_result(std::string(Read(key)));
+        };
+
+
+        /**
+         * Returns a completed task with the result of Read.
+         */
+        virtual pplx::task<std::string> ReadAsync(const std::string& hash,const std::string& key) override {
+          return pplx::task_from_result(std::string(Read(hash,key)));
+        };
+
+
+        /**
+         * Returns a completed task with the result of ReadMany.
+         */
+        virtual pplx::task<std::vector<std::string>> ReadManyAsync(const std::string& hash,const std::vector<std::string>& keys) override {
+          std::vector<std::string> values;
+          ReadMany(hash,keys,values);
+          return pplx::task_from_result(values);
+        };
+
+
+        /**
+         * Writes the value and returns a completed task.
+         */
+        virtual pplx::task<void> WriteAsync(const std::string& key,const std::string& value) override {
+          Write(key,value);
+          return pplx::task_from_result();
+        };
+
+
+        /**
+         * Writes the value and returns a completed task.
+         */
+        virtual pplx::task<void> WriteAsync(const std::string& hash,const std::string& key,const std::string& value) override {
+          Write(hash,key,value);
+          return pplx::task_from_result();
+        };
+
+
+        /**
+         * Returns a completed task with the result of Match.
+         */
+        virtual pplx::task<std::vector<std::string>> MatchAsync(const std::string& expression) override {
+          std::vector<std::string> keys;
+          Match(expression,keys);
+          return pplx::task_from_result(keys);
+        };
+
+
       protected:
 
         /**
-         * Map where all data is stored.
+         * Shards where all data is stored.
          */
-        std::unique_ptr<std::unordered_map<std::string,std::map<std::string,std::string>>> data_;
+        std::vector<std::unique_ptr<SharedMapShard>> shards_;
+
+
+        /**
+         * True if the containers of each shard are allocated in a slab
+         * arena of the shard. Taken from the "shared_map_cache_driver_allocator"
+         * property, "slab" to use the arenas.
+         */
+        bool slab_allocator_ = false;
+
+
+        /**
+         * Settings of the instance, taking precedence over the properties.
+         */
+        std::map<std::string,std::string> settings_;
+
+
+        /**
+         * Returns the value of a setting of the instance if it is set,
+         * otherwise the value of the property.
+         * @param property  Name of the property, as "shared_map_cache_driver_shards".
+         * @return          Value of the setting or of the property.
+         */
+        const std::string Property(const std::string& property);
+
+
+        /**
+         * Log and snapshots of the cache, nullptr if the
+         * cache is not persisted.
+         */
+        std::unique_ptr<SharedMapPersistence> persistence_;
+
+
+        /**
+         * Appends records to the log if the cache is persisted.
+         * @param records Encoded records.
+         * @return        Sequence number to pass to Sync, 0 if
+         *                the cache is not persisted.
+         */
+        const unsigned long long Log(const std::string& records){
+          if (persistence_ != nullptr && !records.empty()){
+            return persistence_->Append(records);
+          }
+          return 0;
+        };
+
+
+        /**
+         * Waits until the logged records are on disk, if the cache is
+         * persisted and configured to sync always. Shard must not be locked.
+         * @param sequence  Sequence number returned by Log.
+         */
+        void Sync(const unsigned long long& sequence){
+          if (sequence > 0){
+            persistence_->Sync(sequence);
+          }
+        };
+
+
+        /**
+         * Applies a record of the log or the snapshot.
+         * @param record  Record.
+         */
+        void Apply(const SharedMapPersistence::Record& record);
+
+
+        /**
+         * Writes all the keys of the cache as records,
+         * one shard at a time.
+         * @param write Function called with the records of each shard.
+         */
+        void Dump(const std::function<void(const std::string&)>& write);
+
+
+        /**
+         * Returns the time when a key expires in milliseconds since epoch.
+         * Shard has to be locked.
+         * @param shard Shard the key belongs to.
+         * @param key   Pointer to the key stored in the shard.
+         * @return      Milliseconds since epoch, -1 if the key does not expire.
+         */
+        const long long Deadline(SharedMapShard& shard, const std::string* key);
+
+
+        /**
+         * Returns the shard the given key belongs to.
+         * @param  key  Key.
+         * @return      Shard containing the key.
+         */
+        SharedMapShard& shard(const std::string& key){
+          return *shards_[shard_index(key)];
+        };
+
+
+        /**
+         * Returns the number of the shard the given key belongs to.
+         * @param  key  Key.
+         * @return      Number of the shard containing the key.
+         */
+        const std::size_t shard_index(const std::string& key){
+          return std::hash<std::string>()(key) % shards_.size();
+        };
+
+
+        /**
+         * Returns the entry of a key of a shard, inserting the key
+         * in the shard, in its index and in its eviction pool if it does not exist.
+         * Shard has to be locked exclusively.
+         * @param shard Shard the key belongs to.
+         * @param key   Key.
+         * @return      Values of the key.
+         */
+        SharedMapEntry& Emplace(SharedMapShard& shard, const std::string& key);
+
+
+        /**
+         * Removes a key from a shard and from its index.
+         * Shard has to be locked exclusively.
+         * @param shard Shard the key belongs to.
+         * @param it    Iterator pointing to the key to remove.
+         */
+        void Erase(SharedMapShard& shard, SharedMapData::iterator it);
+
+
+        /**
+         * Inserts or rewrite several key-value pairs in a map,
+         * used by WriteMany and WriteManyWithTTL.
+         * @param hash    Name of the map.
+         * @param values  Key-value pairs.
+         * @param expire  True to set the time to live of the map.
+         * @param seconds Seconds the map will live from now,
+         *                -1 to remove its time to live.
+         */
+        void WriteFields(const std::string& hash, const std::vector<std::pair<std::string,std::string>>& values, const bool& expire, const long long& seconds);
+
+
+        /**
+         * Writes a field of a key if a condition is met, the condition
+         * is checked and the field written under the lock of the shard.
+         * Nothing is written if the key holds a value of the other kind:
+         * a map when field is nullptr, a plain value otherwise.
+         * @param key       Key or name of the map.
+         * @param field     Field, nullptr for the value of a plain key.
+         * @param condition Called with true if the key exists and the current
+         *                  value of the field or nullptr if it does not exist,
+         *                  returns true to write the field.
+         * @param update    Called with the stored value to change it.
+         * @param seconds   Seconds the key will live from now, read after
+         *                  update so update can set it. nullptr or negative
+         *                  to keep the time to live of the key.
+         * @param keep      True to only set the time to live if the key has none.
+         * @return          True if the field has been written.
+         */
+        const bool WriteFieldIf(const std::string& key, const std::string* field, const std::function<bool(const bool& exists, const std::string* current)>& condition, const std::function<void(std::string& stored)>& update, const long long* seconds = nullptr, const bool& keep = false);
+
+
+        /**
+         * Removes a field of an entry if it exists.
+         * Shard has to be locked exclusively.
+         * @param shard Shard the entry belongs to.
+         * @param entry Entry.
+         * @param field Field.
+         */
+        void EraseField(SharedMapShard& shard, SharedMapEntry& entry, const std::string& field);
+
+
+        /**
+         * Returns the value of a field of an entry, inserting it if it
+         * does not exist, to be assigned by the caller. The bytes of the
+         * previous value are discounted, Account has to be called with the
+         * new value.
+         * Shard has to be locked exclusively.
+         * @param shard Shard the entry belongs to.
+         * @param entry Entry.
+         * @param field Field.
+         * @return      Value of the field.
+         */
+        std::string& Field(SharedMapShard& shard, SharedMapEntry& entry, const std::string& field);
+
+
+        /**
+         * Returns the value of a plain entry to be assigned by the caller,
+         * the fields of the entry are removed if it was a map. The bytes of
+         * the previous value are discounted, Account has to be called with
+         * the new value.
+         * Shard has to be locked exclusively.
+         * @param shard Shard the entry belongs to.
+         * @param entry Entry.
+         * @return      Value of the entry.
+         */
+        std::string& Value(SharedMapShard& shard, SharedMapEntry& entry);
+
+
+        /**
+         * Adds bytes to an entry, to its pool and to its shard,
+         * negative to discount them.
+         * Shard has to be locked exclusively.
+         * @param shard Shard the entry belongs to.
+         * @param entry Entry.
+         * @param bytes Bytes to add.
+         */
+        void Account(SharedMapShard& shard, SharedMapEntry& entry, const long long& bytes);
+
+
+        /**
+         * Inserts a new entry in the eviction pool of its namespace.
+         * Shard has to be locked exclusively.
+         * @param shard Shard the entry belongs to.
+         * @param entry Entry.
+         */
+        void Attach(SharedMapShard& shard, SharedMapEntry& entry);
+
+
+        /**
+         * Removes an entry from its eviction pool.
+         * Shard has to be locked exclusively.
+         * @param shard Shard the entry belongs to.
+         * @param entry Entry.
+         */
+        void Detach(SharedMapShard& shard, SharedMapEntry& entry);
+
+
+        /**
+         * Evicts entries until the shard is within its budget or there
+         * is nothing left to evict.
+         * Shard has to be locked exclusively.
+         * @param shard Shard.
+         * @param keep  Entry that must not be evicted, the one just written.
+         */
+        void Evict(SharedMapShard& shard, const SharedMapEntry* keep);
+
+
+        /**
+         * Returns the next victim of the LRU CLOCK of a shard.
+         * @param shard Shard.
+         * @param keep  Entry that must not be evicted.
+         * @return      Entry to evict or nullptr if there is none.
+         */
+        SharedMapEntry* LruVictim(SharedMapShard& shard, const SharedMapEntry* keep);
+
+
+        /**
+         * Returns the next victim of the CAR of a shard, remembering
+         * it as a ghost.
+         * @param shard Shard.
+         * @param keep  Entry that must not be evicted.
+         * @return      Entry to evict or nullptr if there is none.
+         */
+        SharedMapEntry* ArcVictim(SharedMapShard& shard, const SharedMapEntry* keep);
+
+
+        /**
+         * Marks an entry as used. The reference bit is only written
+         * if it is not set, so frequent readers do not keep
+         * invalidating the cache line of the entry.
+         * Shard has to be locked, shared or exclusively.
+         * @param entry Entry.
+         */
+        void Touch(SharedMapEntry& entry){
+          if (!entry.referenced.load(std::memory_order_relaxed)){
+            entry.referenced.store(true, std::memory_order_relaxed);
+          }
+        };
+
+
+        /**
+         * Returns the bytes accounted for a key without fields.
+         * @param key Key.
+         * @return    Bytes of the key and of the structures storing it.
+         */
+        const std::size_t KeyBytes(const std::string& key);
+
+
+        /**
+         * Returns the bytes accounted for a field with an empty value.
+         * @param field Field.
+         * @return      Bytes of the field and of the structures storing it.
+         */
+        const std::size_t FieldBytes(const std::string& field);
+
+
+        /**
+         * Returns the eviction policy of a key.
+         * @param key Key.
+         * @return    Pool where the key has to be inserted.
+         */
+        const SharedMapEntry::Pool Policy(const std::string& key);
+
+
+        /**
+         * Eviction policies by namespace, longest namespace first.
+         */
+        std::vector<std::pair<std::string,SharedMapEntry::Pool>> eviction_policies_;
+
+
+        /**
+         * Eviction policy of the keys without namespace policy.
+         */
+        SharedMapEntry::Pool default_eviction_policy_ = SharedMapEntry::PINNED;
+
+
+        /**
+         * Memory budget of the cache, 0 if unlimited.
+         */
+        std::size_t max_bytes_ = 0;
+
+
+        /**
+         * Fills a vector with pointers to the keys of a shard
+         * matching the given pattern. If the pattern has a prefix
+         * only the keys of the index with that prefix are visited.
+         * Pointers are valid while the shard stays locked.
+         * @param shard   Shard to search in.
+         * @param pattern Compiled pattern.
+         * @param keys    Vector to fill with pointers to the matching keys.
+         */
+        void MatchShard(SharedMapShard& shard, const granada::cache::KeyPattern& pattern, std::vector<const std::string*>& keys);
+
+
+        /**
+         * Erases the keys of a locked shard matching the given pattern
+         * while visiting them, as MatchShard does. Matching keys already
+         * expired are erased and counted too.
+         * @param shard   Shard to erase from.
+         * @param pattern Compiled pattern.
+         * @param records Records to append the removals to if the cache is persisted.
+         * @return        Number of keys erased.
+         */
+        std::size_t DestroyShard(SharedMapShard& shard, const granada::cache::KeyPattern& pattern, std::string& records);
+
+
+        /**
+         * Creates the given number of empty shards.
+         * @param shards Number of shards, if lower than 1 one shard is created.
+         */
+        void CreateShards(int shards);
+
+
+        /**
+         * Returns true if the given key of a shard has a time to live
+         * and it is over. Shard has to be locked.
+         * @param shard Shard the key belongs to.
+         * @param key   Pointer to the key stored in the shard.
+         * @return      True if the key is expired.
+         */
+        const bool Expired(SharedMapShard& shard, const std::string* key);
+
+
+        /**
+         * Sets the time when a key of a shard expires.
+         * Shard has to be locked exclusively.
+         * @param shard Shard the key belongs to.
+         * @param key   Pointer to the key stored in the shard.
+         * @param time  Time when the key expires.
+         */
+        void SetExpiration(SharedMapShard& shard, const std::string* key, const std::chrono::steady_clock::time_point& time);
+
+
+        /**
+         * Removes the time to live of a key of a shard if it has one.
+         * Shard has to be locked exclusively.
+         * @param shard Shard the key belongs to.
+         * @param key   Pointer to the key stored in the shard.
+         * @return      True if the key had a time to live.
+         */
+        const bool RemoveExpiration(SharedMapShard& shard, const std::string* key);
+
+
+        /**
+         * Removes up to count expired keys of a shard.
+         * Shard has to be locked exclusively.
+         * @param shard Shard.
+         * @param count Maximum number of keys to remove.
+         * @return      Number of removed keys.
+         */
+        const std::size_t RemoveExpired(SharedMapShard& shard, const std::size_t& count);
+
+
+        /**
+         * Starts the thread removing expired keys, only once.
+         */
+        void StartExpirationThread();
+
+
+        /**
+         * Frequency in milliseconds the expired keys are removed
+         * by the expiration thread, -1 to only remove them when
+         * writing in their shard.
+         */
+        int expire_frequency_ = default_numbers::shared_map_cache_driver_expire_frequency;
+
+
+        /**
+         * Used to start the expiration thread only once.
+         */
+        std::once_flag expiration_thread_flag_;
+
+
+        /**
+         * Thread removing the expired keys.
+         */
+        std::thread expiration_thread_;
+
+
+        /**
+         * Mutex used to wait between two removals of expired keys
+         * and to stop the expiration thread.
+         */
+        std::mutex expiration_mtx_;
+
+
+        /**
+         * Notified when the driver is destroyed.
+         */
+        std::condition_variable expiration_cv_;
+
+
+        /**
+         * True when the expiration thread has to stop.
+         */
+        bool expiration_stop_ = false;
+
 
         /**
-         * Mutex for thread safety.
+         * Delivers the changes of the keys to the subscribers.
+         * Declared last so its thread is stopped before
+         * the shards are destroyed.
          */
-        std::mutex mtx_;
+        granada::cache::CacheNotifier notifier_;
 
 
     };
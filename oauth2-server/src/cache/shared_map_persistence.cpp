@@ -0,0 +1,455 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Append-only log and snapshots of a shared map cache driver.
+  *
+  */
+
+#include "cache/shared_map_persistence.h"
+#include <fstream>
+#include <atomic>
+#ifdef _WIN32
+  #include <windows.h>
+  #include <io.h>
+#else
+  #include <unistd.h>
+#endif
+
+namespace granada{
+  namespace cache{
+
+    /**
+     * Magic numbers and version of the files.
+     */
+    static const char LOG_MAGIC[] = "GSMA";
+    static const char SNAPSHOT_MAGIC[] = "GSMS";
+    static const unsigned int FILE_VERSION = 1;
+
+
+    /**
+     * Appends an unsigned integer of n bytes, little endian.
+     */
+    static inline void EncodeNumber(std::string& buffer, unsigned long long number, const int& bytes){
+      for (int i = 0; i < bytes; ++i){
+        buffer.push_back((char)(number & 0xff));
+        number >>= 8;
+      }
+    }
+
+
+    /**
+     * Reads an unsigned integer of n bytes, little endian.
+     */
+    static inline unsigned long long DecodeNumber(const char* data, const int& bytes){
+      unsigned long long number = 0;
+      for (int i = bytes - 1; i >= 0; --i){
+        number = (number << 8) | (unsigned char)data[i];
+      }
+      return number;
+    }
+
+
+    /**
+     * Appends a string preceded by its length.
+     */
+    static inline void EncodeString(std::string& buffer, const std::string& str){
+      EncodeNumber(buffer, str.size(), 4);
+      buffer.append(str);
+    }
+
+
+    /**
+     * Reads a string preceded by its length, returns false
+     * if it goes beyond the end.
+     */
+    static inline bool DecodeString(const char*& data, const char* end, std::string& str){
+      if (end - data < 4){
+        return false;
+      }
+      const std::size_t size = (std::size_t)DecodeNumber(data, 4);
+      data += 4;
+      if ((std::size_t)(end - data) < size){
+        return false;
+      }
+      str.assign(data, size);
+      data += size;
+      return true;
+    }
+
+
+    /**
+     * FNV-1a checksum of the payload of a record.
+     */
+    static inline unsigned int Checksum(const char* data, const std::size_t& size){
+      unsigned int hash = 2166136261u;
+      for (std::size_t i = 0; i < size; ++i){
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+      }
+      return hash;
+    }
+
+
+    /**
+     * Appends a record: payload length, checksum and payload.
+     * The payload is encoded by the given function.
+     */
+    template <typename Encoder>
+    static inline void EncodeRecord(std::string& records, const SharedMapPersistence::Operation& operation, Encoder encode){
+      const std::size_t header = records.size();
+      records.append(8, '\0');
+      records.push_back((char)operation);
+      encode(records);
+      const std::size_t size = records.size() - header - 8;
+      std::string prefix;
+      EncodeNumber(prefix, size, 4);
+      EncodeNumber(prefix, Checksum(records.data() + header + 8, size), 4);
+      records.replace(header, 8, prefix);
+    }
+
+
+    /**
+     * Flushes a file and writes it to disk.
+     */
+    static inline void SyncFile(std::FILE* file){
+      std::fflush(file);
+      #ifdef _WIN32
+        _commit(_fileno(file));
+      #else
+        fsync(fileno(file));
+      #endif
+    }
+
+
+    /**
+     * Renames a file replacing the destination if it exists.
+     */
+    static inline void ReplaceFile(const std::string& from, const std::string& to){
+      #ifdef _WIN32
+        MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+      #else
+        std::rename(from.c_str(), to.c_str());
+      #endif
+    }
+
+
+    /**
+     * Returns the content of a file, false if it does not exist.
+     */
+    static inline bool ReadFile(const std::string& path, std::string& content){
+      std::ifstream ifs(path, std::ios::in | std::ios::binary);
+      if (!ifs.good()){
+        return false;
+      }
+      content.assign((std::istreambuf_iterator<char>(ifs)),(std::istreambuf_iterator<char>()));
+      return true;
+    }
+
+
+    void SharedMapPersistence::EncodePut(std::string& records, const std::string& key, const std::string& field, const std::string& value){
+      EncodeRecord(records, PUT, [&](std::string& buffer){
+        EncodeString(buffer, key);
+        EncodeString(buffer, field);
+        EncodeString(buffer, value);
+      });
+    }
+
+
+    void SharedMapPersistence::EncodeDestroy(std::string& records, const std::string& key){
+      EncodeRecord(records, DESTROY, [&](std::string& buffer){
+        EncodeString(buffer, key);
+      });
+    }
+
+
+    void SharedMapPersistence::EncodeDestroyField(std::string& records, const std::string& key, const std::string& field){
+      EncodeRecord(records, DESTROY_FIELD, [&](std::string& buffer){
+        EncodeString(buffer, key);
+        EncodeString(buffer, field);
+      });
+    }
+
+
+    void SharedMapPersistence::EncodeExpire(std::string& records, const std::string& key, const long long& deadline){
+      EncodeRecord(records, EXPIRE, [&](std::string& buffer){
+        EncodeString(buffer, key);
+        EncodeNumber(buffer, (unsigned long long)deadline, 8);
+      });
+    }
+
+
+    void SharedMapPersistence::EncodeCreate(std::string& records, const std::string& key){
+      EncodeRecord(records, CREATE, [&](std::string& buffer){
+        EncodeString(buffer, key);
+      });
+    }
+
+
+    SharedMapPersistence::SharedMapPersistence(const std::string& path, const bool& sync_always, const int& sync_frequency, const std::size_t& snapshot_bytes){
+      path_ = path;
+      sync_always_ = sync_always;
+      sync_frequency_ = sync_frequency;
+      snapshot_bytes_ = snapshot_bytes;
+      compacting_ = false;
+    }
+
+
+    SharedMapPersistence::~SharedMapPersistence(){
+      {
+        std::lock_guard<std::mutex> lg(mtx_);
+        stop_ = true;
+      }
+      append_cv_.notify_all();
+      sync_cv_.notify_all();
+      if (log_thread_.joinable()){
+        log_thread_.join();
+      }
+      if (compaction_thread_.joinable()){
+        compaction_thread_.join();
+      }
+      std::lock_guard<std::mutex> lg(file_mtx_);
+      Flush();
+      if (file_ != nullptr){
+        std::fclose(file_);
+        file_ = nullptr;
+      }
+    }
+
+
+    void SharedMapPersistence::Recover(const std::size_t& partitions, const std::function<std::size_t(const std::string&)>& partition, const std::function<void(const Record&)>& apply){
+      std::string content;
+
+      // snapshot, its header contains the first generation of the log to replay.
+      if (ReadFile(path_ + ".snapshot", content) && content.size() >= 16 && content.compare(0, 4, SNAPSHOT_MAGIC) == 0){
+        first_generation_ = DecodeNumber(content.data() + 8, 8);
+        Replay(content.data() + 16, content.size() - 16, partitions, partition, apply);
+      }
+
+      // logs of the following generations.
+      generation_ = first_generation_;
+      while (ReadFile(LogPath(generation_), content)){
+        if (content.size() >= 8 && content.compare(0, 4, LOG_MAGIC) == 0){
+          Replay(content.data() + 8, content.size() - 8, partitions, partition, apply);
+        }
+        ++generation_;
+      }
+    }
+
+
+    void SharedMapPersistence::Start(const std::function<void(const std::function<void(const std::string&)>&)>& dump){
+      dump_ = dump;
+      {
+        std::lock_guard<std::mutex> lg(file_mtx_);
+        Open(generation_);
+      }
+      log_thread_ = std::thread([this]{
+        std::unique_lock<std::mutex> lock(mtx_);
+        while (true){
+          if (sync_always_){
+            append_cv_.wait(lock, [this]{ return stop_ || !buffer_.empty(); });
+          }else{
+            append_cv_.wait_for(lock, std::chrono::milliseconds(sync_frequency_), [this]{ return stop_; });
+          }
+          const bool stop = stop_;
+          lock.unlock();
+          {
+            std::lock_guard<std::mutex> lg(file_mtx_);
+            Flush();
+            if (!stop && snapshot_bytes_ > 0 && file_bytes_ >= snapshot_bytes_ && !compacting_){
+              compacting_ = true;
+              if (compaction_thread_.joinable()){
+                compaction_thread_.join();
+              }
+              compaction_thread_ = std::thread([this]{
+                Compact();
+                compacting_ = false;
+              });
+            }
+          }
+          lock.lock();
+          if (stop){
+            break;
+          }
+        }
+      });
+    }
+
+
+    const unsigned long long SharedMapPersistence::Append(const std::string& records){
+      std::lock_guard<std::mutex> lg(mtx_);
+      buffer_.append(records);
+      appended_ += records.size();
+      if (sync_always_){
+        append_cv_.notify_one();
+      }
+      return appended_;
+    }
+
+
+    void SharedMapPersistence::Sync(const unsigned long long& sequence){
+      if (sync_always_){
+        std::unique_lock<std::mutex> lock(mtx_);
+        sync_cv_.wait(lock, [this,&sequence]{ return stop_ || synced_ >= sequence; });
+      }
+    }
+
+
+    void SharedMapPersistence::Compact(){
+      // new records go to the log of a new generation,
+      // the snapshot includes all the previous generations.
+      unsigned long long generation;
+      {
+        std::lock_guard<std::mutex> lg(file_mtx_);
+        Flush();
+        if (file_ != nullptr){
+          std::fclose(file_);
+          file_ = nullptr;
+        }
+        Open(++generation_);
+        generation = generation_;
+      }
+
+      const std::string snapshot_path = path_ + ".snapshot";
+      const std::string tmp_path = snapshot_path + ".tmp";
+      std::FILE* file = std::fopen(tmp_path.c_str(), "wb");
+      if (file == nullptr){
+        return;
+      }
+      std::string header(SNAPSHOT_MAGIC, 4);
+      EncodeNumber(header, FILE_VERSION, 4);
+      EncodeNumber(header, generation, 8);
+      std::fwrite(header.data(), 1, header.size(), file);
+      dump_([file](const std::string& records){
+        std::fwrite(records.data(), 1, records.size(), file);
+      });
+      SyncFile(file);
+      std::fclose(file);
+      ReplaceFile(tmp_path, snapshot_path);
+
+      // logs included in the snapshot are not needed anymore.
+      for (unsigned long long i = first_generation_; i < generation; ++i){
+        std::remove(LogPath(i).c_str());
+      }
+      first_generation_ = generation;
+    }
+
+
+    void SharedMapPersistence::Flush(){
+      std::string records;
+      unsigned long long target;
+      {
+        std::lock_guard<std::mutex> lg(mtx_);
+        records.swap(buffer_);
+        target = appended_;
+      }
+      if (!records.empty() && file_ != nullptr){
+        std::fwrite(records.data(), 1, records.size(), file_);
+        file_bytes_ += records.size();
+        SyncFile(file_);
+      }
+      {
+        std::lock_guard<std::mutex> lg(mtx_);
+        synced_ = target;
+      }
+      sync_cv_.notify_all();
+    }
+
+
+    void SharedMapPersistence::Open(const unsigned long long& generation){
+      file_ = std::fopen(LogPath(generation).c_str(), "ab");
+      file_bytes_ = 0;
+      if (file_ != nullptr){
+        std::string header(LOG_MAGIC, 4);
+        EncodeNumber(header, FILE_VERSION, 4);
+        std::fwrite(header.data(), 1, header.size(), file_);
+        SyncFile(file_);
+      }
+    }
+
+
+    const std::string SharedMapPersistence::LogPath(const unsigned long long& generation){
+      return path_ + "." + std::to_string(generation) + ".aof";
+    }
+
+
+    void SharedMapPersistence::Replay(const char* data, const std::size_t& size, const std::size_t& partitions, const std::function<std::size_t(const std::string&)>& partition, const std::function<void(const Record&)>& apply){
+      // each thread applies in order the records of the keys of its partitions.
+      std::size_t threads = std::thread::hardware_concurrency();
+      if (threads < 1){
+        threads = 1;
+      }
+      if (threads > partitions){
+        threads = partitions;
+      }
+
+      // find the valid records, a crash may have left an incomplete
+      // record at the end, and give each one to the thread of its key.
+      std::vector<std::vector<std::size_t>> offsets(threads);
+      std::string key;
+      std::size_t offset = 0;
+      while (size - offset >= 8){
+        const std::size_t payload_size = (std::size_t)DecodeNumber(data + offset, 4);
+        if (payload_size == 0 || size - offset - 8 < payload_size || DecodeNumber(data + offset + 4, 4) != Checksum(data + offset + 8, payload_size)){
+          break;
+        }
+        const char* record_data = data + offset + 9;
+        if (DecodeString(record_data, data + offset + 8 + payload_size, key)){
+          offsets[partition(key) % threads].push_back(offset);
+        }
+        offset += 8 + payload_size;
+      }
+
+      std::vector<std::thread> workers;
+      for (std::size_t t = 0; t < threads; ++t){
+        workers.push_back(std::thread([&,t]{
+          Record record;
+          for (auto it = offsets[t].begin(); it != offsets[t].end(); ++it){
+            const char* record_data = data + *it + 8;
+            const char* record_end = record_data + (std::size_t)DecodeNumber(data + *it, 4);
+            record.operation = (Operation)(unsigned char)*record_data++;
+            DecodeString(record_data, record_end, record.key);
+            if (record.operation == PUT){
+              if (!DecodeString(record_data, record_end, record.field) || !DecodeString(record_data, record_end, record.value)){
+                continue;
+              }
+            }else if (record.operation == DESTROY_FIELD){
+              if (!DecodeString(record_data, record_end, record.field)){
+                continue;
+              }
+            }else if (record.operation == EXPIRE){
+              if (record_end - record_data < 8){
+                continue;
+              }
+              record.deadline = (long long)DecodeNumber(record_data, 8);
+            }
+            apply(record);
+          }
+        }));
+      }
+      for (auto it = workers.begin(); it != workers.end(); ++it){
+        it->join();
+      }
+    }
+
+  }
+}
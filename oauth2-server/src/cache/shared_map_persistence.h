@@ -0,0 +1,324 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Append-only log and snapshots of a shared map cache driver.
+  *
+  */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace granada{
+  namespace cache{
+
+    /**
+     * Keeps a shared map cache driver on disk with a write-ahead
+     * append-only log of its mutations and compacted snapshots.
+     *
+     * Files, with <path> = <directory>/<name>:
+     *  <path>.snapshot       State of the cache when generation G started.
+     *  <path>.<G>.aof        Mutations of generation G.
+     * Recovery loads the snapshot and replays the logs of generation G,
+     * G + 1, ... until one is missing. A new generation is started at
+     * each start-up and each time the log is compacted, so a log
+     * truncated by a crash is never appended to.
+     *
+     * Each record is checksummed and only affects one key, so the
+     * records of different keys can be replayed in parallel.
+     * Records are idempotent (set field, remove key, absolute expiration
+     * time...), so records logged while a snapshot is written can be
+     * replayed over it.
+     *
+     * Records are written and synced to disk by a background thread.
+     * If sync is "always" writers wait until their records are on disk,
+     * all the records appended while a sync is in progress are synced
+     * together (group commit). Otherwise the log is synced every
+     * sync frequency milliseconds.
+     */
+    class SharedMapPersistence{
+
+      public:
+
+        /**
+         * Mutation stored in a record.
+         */
+        enum Operation{
+          PUT = 1,            // sets the value of a field of a key.
+          DESTROY = 2,        // removes a key.
+          DESTROY_FIELD = 3,  // removes a field of a key.
+          EXPIRE = 4,         // sets the expiration time of a key.
+          CREATE = 5          // creates a key without fields.
+        };
+
+
+        /**
+         * Decoded record.
+         */
+        struct Record{
+          Operation operation;
+          std::string key;
+          std::string field;
+          std::string value;
+
+          /**
+           * Expiration time in milliseconds since epoch,
+           * -1 if the key does not expire.
+           */
+          long long deadline = -1;
+        };
+
+
+        /**
+         * Constructor
+         * @param path            Path of the files without extension.
+         * @param sync_always     True if writers wait until their records are on disk.
+         * @param sync_frequency  Milliseconds between two syncs if sync_always is false.
+         * @param snapshot_bytes  Size of the log that triggers a snapshot.
+         */
+        SharedMapPersistence(const std::string& path, const bool& sync_always, const int& sync_frequency, const std::size_t& snapshot_bytes);
+
+
+        /**
+         * Destructor
+         * Syncs the pending records and stops the threads.
+         */
+        virtual ~SharedMapPersistence();
+
+
+        /**
+         * Loads the snapshot and replays the logs.
+         * Records are distributed in partitions by key, the records of
+         * a partition are applied in order by the same thread.
+         * @param partitions  Number of partitions.
+         * @param partition   Returns the partition of a key.
+         * @param apply       Applies a record, called concurrently for
+         *                    records of different partitions.
+         */
+        void Recover(const std::size_t& partitions, const std::function<std::size_t(const std::string&)>& partition, const std::function<void(const Record&)>& apply);
+
+
+        /**
+         * Starts a new generation of the log and the thread writing it.
+         * Must be called after Recover.
+         * @param dump  Writes all the cache as records, calling the given
+         *              function with batches of encoded records. Used to
+         *              write the snapshots.
+         */
+        void Start(const std::function<void(const std::function<void(const std::string&)>&)>& dump);
+
+
+        /**
+         * Appends encoded records to the log.
+         * @param records Encoded records.
+         * @return        Sequence number to pass to Sync.
+         */
+        const unsigned long long Append(const std::string& records);
+
+
+        /**
+         * Waits until the records with the given sequence number are on disk,
+         * returns immediately if sync is not "always".
+         * @param sequence  Sequence number returned by Append.
+         */
+        void Sync(const unsigned long long& sequence);
+
+
+        /**
+         * Writes a snapshot and removes the logs it includes.
+         * Called by the log thread when the log is bigger than
+         * snapshot_bytes.
+         */
+        void Compact();
+
+
+        /**
+         * Encode a record and append it to the given string.
+         */
+        static void EncodePut(std::string& records, const std::string& key, const std::string& field, const std::string& value);
+        static void EncodeDestroy(std::string& records, const std::string& key);
+        static void EncodeDestroyField(std::string& records, const std::string& key, const std::string& field);
+        static void EncodeExpire(std::string& records, const std::string& key, const long long& deadline);
+        static void EncodeCreate(std::string& records, const std::string& key);
+
+
+      protected:
+
+        /**
+         * Path of the files without extension.
+         */
+        std::string path_;
+
+
+        /**
+         * True if writers wait until their records are on disk.
+         */
+        bool sync_always_;
+
+
+        /**
+         * Milliseconds between two syncs if sync_always_ is false.
+         */
+        int sync_frequency_;
+
+
+        /**
+         * Size of the log that triggers a snapshot.
+         */
+        std::size_t snapshot_bytes_;
+
+
+        /**
+         * Writes the cache as records.
+         */
+        std::function<void(const std::function<void(const std::string&)>&)> dump_;
+
+
+        /**
+         * Log file of the current generation.
+         */
+        std::FILE* file_ = nullptr;
+
+
+        /**
+         * Current generation of the log.
+         */
+        unsigned long long generation_ = 1;
+
+
+        /**
+         * First generation of the log not included in the snapshot.
+         */
+        unsigned long long first_generation_ = 1;
+
+
+        /**
+         * Bytes written in the log of the current generation.
+         */
+        std::size_t file_bytes_ = 0;
+
+
+        /**
+         * Records appended but not written yet.
+         */
+        std::string buffer_;
+
+
+        /**
+         * Bytes appended and bytes on disk since start, used
+         * as sequence numbers.
+         */
+        unsigned long long appended_ = 0;
+        unsigned long long synced_ = 0;
+
+
+        /**
+         * Protects buffer_, appended_, synced_ and stop_.
+         */
+        std::mutex mtx_;
+
+
+        /**
+         * Protects file_, generation_ and file_bytes_.
+         */
+        std::mutex file_mtx_;
+
+
+        /**
+         * Notified when records are appended or the persistence is stopped.
+         */
+        std::condition_variable append_cv_;
+
+
+        /**
+         * Notified when records are synced.
+         */
+        std::condition_variable sync_cv_;
+
+
+        /**
+         * True when the threads have to stop.
+         */
+        bool stop_ = false;
+
+
+        /**
+         * True while a snapshot is being written.
+         */
+        std::atomic_bool compacting_;
+
+
+        /**
+         * Thread writing and syncing the log.
+         */
+        std::thread log_thread_;
+
+
+        /**
+         * Thread writing the snapshot.
+         */
+        std::thread compaction_thread_;
+
+
+        /**
+         * Writes the appended records in the log file and syncs it.
+         * file_mtx_ has to be locked.
+         */
+        void Flush();
+
+
+        /**
+         * Opens the log of the given generation and writes its header.
+         * file_mtx_ has to be locked.
+         * @param generation  Generation.
+         */
+        void Open(const unsigned long long& generation);
+
+
+        /**
+         * Returns the path of the log of a generation.
+         * @param generation  Generation.
+         * @return            Path of the log.
+         */
+        const std::string LogPath(const unsigned long long& generation);
+
+
+        /**
+         * Replays the records of a file.
+         * @param data        Content of the file after the header.
+         * @param size        Size of the content.
+         * @param partitions  Number of partitions.
+         * @param partition   Returns the partition of a key.
+         * @param apply       Applies a record.
+         */
+        void Replay(const char* data, const std::size_t& size, const std::size_t& partitions, const std::function<std::size_t(const std::string&)>& partition, const std::function<void(const Record&)>& apply);
+
+    };
+  }
+}
@@ -0,0 +1,600 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Manages a cache stored in a shared memory segment.
+  *
+  */
+
+#include "shared_memory_cache_driver.h"
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <boost/interprocess/sync/sharable_lock.hpp>
+#include "cache/shared_map_cache_driver.h"
+
+namespace granada{
+  namespace cache{
+
+    SharedMemoryIterator::SharedMemoryIterator(const std::string& expression, SharedMemoryCacheDriver* cache){
+      cache_ = cache;
+      set(expression);
+    }
+
+
+    void SharedMemoryIterator::set(const std::string& expression){
+      expression_ = expression;
+      pattern_.set(expression_);
+      shard_ = 0;
+      cursor_.clear();
+      started_ = false;
+      keys_.clear();
+    }
+
+
+    const bool SharedMemoryIterator::has_next(){
+      if (keys_.empty()){
+        Fetch();
+      }
+      return !keys_.empty();
+    }
+
+
+    const std::string SharedMemoryIterator::next(){
+      if (has_next()){
+        const std::string value(std::move(keys_.front()));
+        keys_.pop_front();
+        return value;
+      }
+      return std::string();
+    }
+
+
+    void SharedMemoryIterator::Fetch(){
+      while (keys_.empty() && shard_ < cache_->shards()){
+        if (cache_->Scan(shard_,pattern_,started_,cursor_,default_numbers::shared_map_cache_driver_scan_count,keys_)){
+          // shard finished, continue with the next one.
+          ++shard_;
+          cursor_.clear();
+          started_ = false;
+        }
+      }
+    }
+
+
+
+
+
+    SharedMemoryCacheDriver::SharedMemoryCacheDriver(const std::string& name){
+      std::string segment = granada::util::application::GetProperty(entity_keys::shared_memory_cache_driver_segment);
+      if (segment.empty()){
+        segment = default_strings::shared_memory_cache_driver_segment;
+      }
+
+      std::size_t size = default_numbers::shared_memory_cache_driver_size;
+      const std::string& size_str = granada::util::application::GetProperty(entity_keys::shared_memory_cache_driver_size);
+      if (!size_str.empty()){
+        try{
+          size = std::stoull(size_str);
+        }catch(const std::logic_error e){
+          size = default_numbers::shared_memory_cache_driver_size;
+        }
+      }
+
+      int shards = default_numbers::shared_map_cache_driver_shards;
+      const std::string& shards_str = granada::util::application::GetProperty(entity_keys::shared_map_cache_driver_shards);
+      if (!shards_str.empty()){
+        try{
+          shards = std::stoi(shards_str);
+        }catch(const std::logic_error e){
+          shards = default_numbers::shared_map_cache_driver_shards;
+        }
+      }
+
+      Open(segment + "." + name,size,shards);
+    }
+
+
+    SharedMemoryCacheDriver::SharedMemoryCacheDriver(const std::string& segment, const std::size_t& size, const int& shards){
+      Open(segment,size,shards);
+    }
+
+
+    const bool SharedMemoryCacheDriver::Remove(const std::string& segment){
+      return boost::interprocess::shared_memory_object::remove(segment.c_str());
+    }
+
+
+    void SharedMemoryCacheDriver::Open(const std::string& segment, const std::size_t& size, const int& shards){
+      segment_ = granada::util::memory::make_unique<boost::interprocess::managed_shared_memory>(boost::interprocess::open_or_create,segment.c_str(),size);
+
+      // find_or_construct is atomic, the first process creates the shards,
+      // the others use them with the number of shards they were created with.
+      const SharedMemoryAllocator allocator(segment_->get_segment_manager());
+      shards_ = segment_->find_or_construct<SharedMemoryShard>("shards")[shards < 1 ? 1 : shards](allocator);
+      shards_count_ = segment_->find<SharedMemoryShard>("shards").second;
+    }
+
+
+    const bool SharedMemoryCacheDriver::Exists(const std::string& key){
+      SharedMemoryShard& shard = this->shard(key);
+      boost::interprocess::sharable_lock<boost::interprocess::interprocess_sharable_mutex> sl(shard.mtx);
+      auto it = shard.data.find(key);
+      return it != shard.data.end() && !Expired(it->second,Now());
+    }
+
+
+    const bool SharedMemoryCacheDriver::Exists(const std::string& hash,const std::string& key){
+      SharedMemoryShard& shard = this->shard(hash);
+      boost::interprocess::sharable_lock<boost::interprocess::interprocess_sharable_mutex> sl(shard.mtx);
+      auto it = shard.data.find(hash);
+      if (it != shard.data.end() && !Expired(it->second,Now())){
+        return it->second.values.find(key) != it->second.values.end();
+      }
+      return false;
+    }
+
+
+    const std::string SharedMemoryCacheDriver::Read(const std::string& key){
+      return Read(key,"__");
+    }
+
+
+    const std::string SharedMemoryCacheDriver::Read(const std::string& hash, const std::string& key){
+      SharedMemoryShard& shard = this->shard(hash);
+      boost::interprocess::sharable_lock<boost::interprocess::interprocess_sharable_mutex> sl(shard.mtx);
+      auto it = shard.data.find(hash);
+      if (it != shard.data.end() && !Expired(it->second,Now())){
+        auto it2 = it->second.values.find(key);
+        if (it2 != it->second.values.end()){
+          return std::string(it2->second.data(),it2->second.size());
+        }
+      }
+      return std::string();
+    }
+
+
+    const bool SharedMemoryCacheDriver::ReadAll(const std::string& hash, std::map<std::string,std::string>& values){
+      values.clear();
+      SharedMemoryShard& shard = this->shard(hash);
+      boost::interprocess::sharable_lock<boost::interprocess::interprocess_sharable_mutex> sl(shard.mtx);
+      auto it = shard.data.find(hash);
+      if (it != shard.data.end() && !Expired(it->second,Now())){
+        for (auto it2 = it->second.values.begin(); it2 != it->second.values.end(); ++it2){
+          values.emplace_hint(values.end(),std::string(it2->first.data(),it2->first.size()),std::string(it2->second.data(),it2->second.size()));
+        }
+        return true;
+      }
+      return false;
+    }
+
+
+    const bool SharedMemoryCacheDriver::ReadMany(const std::string& hash, const std::vector<std::string>& keys, std::vector<std::string>& values){
+      values.clear();
+      SharedMemoryShard& shard = this->shard(hash);
+      boost::interprocess::sharable_lock<boost::interprocess::interprocess_sharable_mutex> sl(shard.mtx);
+      auto it = shard.data.find(hash);
+      if (it != shard.data.end() && !Expired(it->second,Now())){
+        values.reserve(keys.size());
+        for (auto it2 = keys.begin(); it2 != keys.end(); ++it2){
+          auto it3 = it->second.values.find(*it2);
+          if (it3 != it->second.values.end()){
+            values.push_back(std::string(it3->second.data(),it3->second.size()));
+          }else{
+            values.push_back(std::string());
+          }
+        }
+        return true;
+      }
+      return false;
+    }
+
+
+    void SharedMemoryCacheDriver::Write(const std::string& key,const std::string& value){
+      SharedMemoryShard& shard = this->shard(key);
+      boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(shard.mtx);
+      RemoveExpired(shard,default_numbers::shared_map_cache_driver_expire_count);
+      SharedMemoryEntry& entry = Put(shard,key,"__",value);
+      SetDeadline(shard,entry,-1);
+    }
+
+
+    void SharedMemoryCacheDriver::Write(const std::string& hash,const std::string& key,const std::string& value){
+      SharedMemoryShard& shard = this->shard(hash);
+      boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(shard.mtx);
+      RemoveExpired(shard,default_numbers::shared_map_cache_driver_expire_count);
+      Put(shard,hash,key,value);
+    }
+
+
+    void SharedMemoryCacheDriver::Destroy(const std::string& key){
+      if (key.find("*") != std::string::npos){
+        DestroyMatch(key);
+      }else{
+        SharedMemoryShard& shard = this->shard(key);
+        boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(shard.mtx);
+        auto it = shard.data.find(key);
+        if (it != shard.data.end()){
+          Erase(shard,it);
+        }
+      }
+    }
+
+
+    void SharedMemoryCacheDriver::Destroy(const std::string& hash,const std::string& key){
+      SharedMemoryShard& shard = this->shard(hash);
+      boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(shard.mtx);
+      auto it = Find(shard,hash);
+      if (it != shard.data.end()){
+        auto it2 = it->second.values.find(key);
+        if (it2 != it->second.values.end()){
+          it->second.values.erase(it2);
+        }
+      }
+    }
+
+
+    const std::size_t SharedMemoryCacheDriver::DestroyMatch(const std::string& expression){
+      const granada::cache::KeyPattern pattern(expression);
+      const long long now = Now();
+      std::size_t destroyed = 0;
+
+      // the shards are swept one at a time, so the other
+      // shards are still usable by all the processes.
+      std::string visited;
+      for (std::size_t i = 0; i < shards_count_; ++i){
+        SharedMemoryShard& shard = shards_[i];
+        boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(shard.mtx);
+        auto it = pattern.prefix().empty() ? shard.data.begin() : shard.data.lower_bound(pattern.prefix());
+        while (it != shard.data.end()){
+          visited.assign(it->first.data(),it->first.size());
+          if (visited.compare(0,pattern.prefix().size(),pattern.prefix()) != 0){
+            // ordered keys, no more keys with the prefix.
+            break;
+          }
+          const bool match = pattern.Match(visited);
+          if (match || Expired(it->second,now)){
+            if (match){
+              ++destroyed;
+            }
+            auto erased = it++;
+            Erase(shard,erased);
+          }else{
+            ++it;
+          }
+        }
+      }
+      return destroyed;
+    }
+
+
+    bool SharedMemoryCacheDriver::Rename(const std::string& old_key, const std::string& new_key){
+      if (old_key == new_key){
+        return false;
+      }
+      SharedMemoryShard& old_shard = this->shard(old_key);
+      SharedMemoryShard& new_shard = this->shard(new_key);
+
+      // lock both shards in address order, the same in all processes.
+      boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> first_lock(&old_shard < &new_shard ? old_shard.mtx : new_shard.mtx);
+      boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> second_lock;
+      if (&old_shard != &new_shard){
+        boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(&old_shard < &new_shard ? new_shard.mtx : old_shard.mtx);
+        second_lock.swap(lock);
+      }
+
+      auto it = Find(old_shard,old_key);
+      if (it == old_shard.data.end() || Find(new_shard,new_key) != new_shard.data.end()){
+        return false;
+      }
+
+      const SharedMemoryAllocator allocator(segment_->get_segment_manager());
+      auto inserted = new_shard.data.emplace(SharedMemoryString(new_key.data(),new_key.size(),allocator),SharedMemoryEntry(allocator));
+      SharedMemoryEntry& entry = inserted.first->second;
+      // all the shards use the segment allocator, values are
+      // moved to the new key without copying them.
+      entry.values.swap(it->second.values);
+      SetDeadline(new_shard,entry,it->second.deadline);
+      Erase(old_shard,it);
+      return true;
+    }
+
+
+    const bool SharedMemoryCacheDriver::Expire(const std::string& key, const long long& seconds){
+      SharedMemoryShard& shard = this->shard(key);
+      boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(shard.mtx);
+      auto it = Find(shard,key);
+      if (it == shard.data.end()){
+        return false;
+      }
+      SetDeadline(shard,it->second,seconds < 0 ? -1 : Now() + seconds * 1000);
+      return true;
+    }
+
+
+    const long long SharedMemoryCacheDriver::TTL(const std::string& key){
+      SharedMemoryShard& shard = this->shard(key);
+      boost::interprocess::sharable_lock<boost::interprocess::interprocess_sharable_mutex> sl(shard.mtx);
+      auto it = shard.data.find(key);
+      const long long now = Now();
+      if (it == shard.data.end() || Expired(it->second,now)){
+        return -2;
+      }
+      if (it->second.deadline < 0){
+        return -1;
+      }
+      // round up, a key about to expire still has 1 second.
+      return (it->second.deadline - now + 999) / 1000;
+    }
+
+
+    void SharedMemoryCacheDriver::WriteWithTTL(const std::string& key,const std::string& value,const long long& seconds){
+      WriteWithTTL(key,"__",value,seconds);
+    }
+
+
+    void SharedMemoryCacheDriver::WriteWithTTL(const std::string& hash,const std::string& key,const std::string& value,const long long& seconds){
+      SharedMemoryShard& shard = this->shard(hash);
+      boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(shard.mtx);
+      RemoveExpired(shard,default_numbers::shared_map_cache_driver_expire_count);
+      SharedMemoryEntry& entry = Put(shard,hash,key,value);
+      SetDeadline(shard,entry,seconds < 0 ? -1 : Now() + seconds * 1000);
+    }
+
+
+    void SharedMemoryCacheDriver::WriteMany(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values){
+      SharedMemoryShard& shard = this->shard(hash);
+      boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(shard.mtx);
+      RemoveExpired(shard,default_numbers::shared_map_cache_driver_expire_count);
+      for (auto it = values.begin(); it != values.end(); ++it){
+        Put(shard,hash,it->first,it->second);
+      }
+    }
+
+
+    void SharedMemoryCacheDriver::WriteManyWithTTL(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values,const long long& seconds){
+      SharedMemoryShard& shard = this->shard(hash);
+      boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(shard.mtx);
+      RemoveExpired(shard,default_numbers::shared_map_cache_driver_expire_count);
+      for (auto it = values.begin(); it != values.end(); ++it){
+        Put(shard,hash,it->first,it->second);
+      }
+      auto it = Find(shard,hash);
+      if (it != shard.data.end()){
+        SetDeadline(shard,it->second,seconds < 0 ? -1 : Now() + seconds * 1000);
+      }
+    }
+
+
+    const bool SharedMemoryCacheDriver::WriteIfNotExists(const std::string& key,const std::string& value){
+      SharedMemoryShard& shard = this->shard(key);
+      boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(shard.mtx);
+      RemoveExpired(shard,default_numbers::shared_map_cache_driver_expire_count);
+      if (Find(shard,key) != shard.data.end()){
+        return false;
+      }
+      Put(shard,key,"__",value);
+      return true;
+    }
+
+
+    const bool SharedMemoryCacheDriver::WriteIfNotExists(const std::string& hash,const std::string& key,const std::string& value){
+      SharedMemoryShard& shard = this->shard(hash);
+      boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(shard.mtx);
+      RemoveExpired(shard,default_numbers::shared_map_cache_driver_expire_count);
+      auto it = Find(shard,hash);
+      if (it != shard.data.end() && it->second.values.find(key) != it->second.values.end()){
+        return false;
+      }
+      Put(shard,hash,key,value);
+      return true;
+    }
+
+
+    const bool SharedMemoryCacheDriver::CompareAndSet(const std::string& hash,const std::string& key,const std::string& expected,const std::string& value){
+      SharedMemoryShard& shard = this->shard(hash);
+      boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(shard.mtx);
+      RemoveExpired(shard,default_numbers::shared_map_cache_driver_expire_count);
+      auto it = Find(shard,hash);
+      bool equal = expected.empty();
+      if (it != shard.data.end()){
+        auto it2 = it->second.values.find(key);
+        if (it2 != it->second.values.end()){
+          equal = expected.compare(0,expected.size(),it2->second.data(),it2->second.size()) == 0;
+        }
+      }
+      if (!equal){
+        return false;
+      }
+      Put(shard,hash,key,value);
+      return true;
+    }
+
+
+    const long long SharedMemoryCacheDriver::Increment(const std::string& key,const long long& increment){
+      return Increment(key,"__",increment);
+    }
+
+
+    const long long SharedMemoryCacheDriver::Increment(const std::string& hash,const std::string& key,const long long& increment){
+      SharedMemoryShard& shard = this->shard(hash);
+      boost::interprocess::scoped_lock<boost::interprocess::interprocess_sharable_mutex> lock(shard.mtx);
+      RemoveExpired(shard,default_numbers::shared_map_cache_driver_expire_count);
+      auto it = Find(shard,hash);
+      std::string current;
+      if (it != shard.data.end()){
+        // a key holding a value of the other kind, plain or map, is
+        // left as it is, as Redis refuses the operation.
+        static const std::string plain_field = "__";
+        const bool plain = it->second.values.find(plain_field) != it->second.values.end();
+        if (plain != (key == "__")){
+          return 0;
+        }
+        auto it2 = it->second.values.find(key);
+        if (it2 != it->second.values.end()){
+          current.assign(it2->second.data(),it2->second.size());
+        }
+      }
+      const long long result = granada::cache::SharedMapCacheDriver::Add(current,increment);
+      Put(shard,hash,key,std::to_string(result));
+      return result;
+    }
+
+
+    const bool SharedMemoryCacheDriver::Scan(const std::size_t& shard_number, const granada::cache::KeyPattern& pattern, bool& started, std::string& cursor, const std::size_t& count, std::deque<std::string>& keys){
+      SharedMemoryShard& shard = shards_[shard_number];
+      boost::interprocess::sharable_lock<boost::interprocess::interprocess_sharable_mutex> sl(shard.mtx);
+      const std::string& prefix = pattern.prefix();
+      SharedMemoryEntries::iterator it;
+      if (started){
+        it = shard.data.upper_bound(cursor);
+      }else{
+        it = prefix.empty() ? shard.data.begin() : shard.data.lower_bound(prefix);
+      }
+      const long long now = Now();
+      std::string visited;
+      for (std::size_t i = 0; i < count; ++i){
+        if (it == shard.data.end()){
+          return true;
+        }
+        visited.assign(it->first.data(),it->first.size());
+        if (visited.compare(0,prefix.size(),prefix) != 0){
+          // ordered keys, no more keys with the prefix.
+          return true;
+        }
+        if (!Expired(it->second,now) && pattern.Match(visited)){
+          keys.push_back(visited);
+        }
+        ++it;
+        cursor = std::move(visited);
+        started = true;
+      }
+      return it == shard.data.end();
+    }
+
+
+    SharedMemoryShard& SharedMemoryCacheDriver::shard(const std::string& key){
+      // FNV-1a
+      unsigned long long hash = 14695981039346656037ULL;
+      for (auto it = key.begin(); it != key.end(); ++it){
+        hash ^= (unsigned char)(*it);
+        hash *= 1099511628211ULL;
+      }
+      return shards_[hash % shards_count_];
+    }
+
+
+    const long long SharedMemoryCacheDriver::Now(){
+      return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+
+    SharedMemoryEntries::iterator SharedMemoryCacheDriver::Find(SharedMemoryShard& shard, const std::string& key){
+      auto it = shard.data.find(key);
+      if (it != shard.data.end() && Expired(it->second,Now())){
+        Erase(shard,it);
+        return shard.data.end();
+      }
+      return it;
+    }
+
+
+    SharedMemoryEntry& SharedMemoryCacheDriver::Put(SharedMemoryShard& shard, const std::string& key, const std::string& field, const std::string& value){
+      try{
+        return Insert(shard,key,field,value);
+      }catch(const boost::interprocess::bad_alloc e){
+        // segment full, free the expired keys of the shard and retry.
+        RemoveExpired(shard,shard.data.size());
+        return Insert(shard,key,field,value);
+      }
+    }
+
+
+    SharedMemoryEntry& SharedMemoryCacheDriver::Insert(SharedMemoryShard& shard, const std::string& key, const std::string& field, const std::string& value){
+      const SharedMemoryAllocator allocator(segment_->get_segment_manager());
+      auto it = Find(shard,key);
+      if (it == shard.data.end()){
+        it = shard.data.emplace(SharedMemoryString(key.data(),key.size(),allocator),SharedMemoryEntry(allocator)).first;
+      }
+      SharedMemoryEntry& entry = it->second;
+      auto it2 = entry.values.find(field);
+      if (it2 == entry.values.end()){
+        entry.values.emplace(SharedMemoryString(field.data(),field.size(),allocator),SharedMemoryString(value.data(),value.size(),allocator));
+      }else{
+        it2->second.assign(value.data(),value.size());
+      }
+      return entry;
+    }
+
+
+    void SharedMemoryCacheDriver::SetDeadline(SharedMemoryShard& shard, SharedMemoryEntry& entry, const long long& deadline){
+      if (entry.deadline < 0 && deadline > -1){
+        ++shard.expiring;
+      }else if (entry.deadline > -1 && deadline < 0){
+        --shard.expiring;
+      }
+      entry.deadline = deadline;
+    }
+
+
+    void SharedMemoryCacheDriver::Erase(SharedMemoryShard& shard, SharedMemoryEntries::iterator it){
+      if (it->second.deadline > -1){
+        --shard.expiring;
+      }
+      shard.data.erase(it);
+    }
+
+
+    void SharedMemoryCacheDriver::RemoveExpired(SharedMemoryShard& shard, const std::size_t& count){
+      if (shard.expiring == 0){
+        return;
+      }
+      const long long now = Now();
+      auto it = shard.data.lower_bound(shard.sweep);
+      for (std::size_t i = 0; i < count && !shard.data.empty(); ++i){
+        if (it == shard.data.end()){
+          it = shard.data.begin();
+        }
+        if (Expired(it->second,now)){
+          auto erased = it++;
+          Erase(shard,erased);
+        }else{
+          ++it;
+        }
+      }
+      if (it == shard.data.end()){
+        shard.sweep.clear();
+      }else{
+        shard.sweep.assign(it->first.data(),it->first.size());
+      }
+    }
+
+
+    std::unique_ptr<granada::cache::CacheHandler> MakeLocalCacheDriver(const std::string& name){
+      if (granada::util::application::GetProperty(entity_keys::shared_memory_cache_driver) == "on"){
+        return granada::util::memory::make_unique<granada::cache::SharedMemoryCacheDriver>(name);
+      }
+      return granada::util::memory::make_unique<granada::cache::SharedMapCacheDriver>(name);
+    }
+  }
+}
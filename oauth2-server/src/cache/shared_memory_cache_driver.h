@@ -0,0 +1,779 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Manages a cache stored in a shared memory segment, so all the
+  * processes of a host using the same segment name share the keys.
+  * ordered map in shared memory
+  * 	|_ hash1 => map
+  * 								|_ key1 => value1
+  * 							 	|_ key2 => value2
+  *
+  * Keys are distributed in shards by key hash, each shard
+  * has its own ordered map and its own interprocess mutex,
+  * both stored in the segment.
+  *
+  * This code is multi-thread and multi-process safe.
+  *
+  */
+
+#pragma once
+#include "cache_handler.h"
+#include <string>
+#include <deque>
+#include <memory>
+#include <boost/interprocess/managed_shared_memory.hpp>
+#include <boost/interprocess/allocators/allocator.hpp>
+#include <boost/interprocess/sync/interprocess_sharable_mutex.hpp>
+#include <boost/container/map.hpp>
+#include <boost/container/string.hpp>
+#include "util/application.h"
+#include "defaults.h"
+#include "cache/key_pattern.h"
+
+namespace granada{
+  namespace cache{
+
+    typedef boost::interprocess::managed_shared_memory::segment_manager SharedMemorySegmentManager;
+    typedef boost::interprocess::allocator<void,SharedMemorySegmentManager> SharedMemoryAllocator;
+    typedef boost::interprocess::allocator<char,SharedMemorySegmentManager> SharedMemoryCharAllocator;
+    typedef boost::container::basic_string<char,std::char_traits<char>,SharedMemoryCharAllocator> SharedMemoryString;
+
+
+    /**
+     * Orders shared memory strings, can compare them with
+     * std::string so keys are found without copying them
+     * into the segment.
+     */
+    struct SharedMemoryLess{
+      typedef void is_transparent;
+
+      template <typename A, typename B>
+      bool operator()(const A& a, const B& b) const {
+        const int compare = a.compare(0,a.size(),b.data(),b.size());
+        return compare < 0;
+      };
+    };
+
+
+    typedef boost::interprocess::allocator<std::pair<const SharedMemoryString,SharedMemoryString>,SharedMemorySegmentManager> SharedMemoryValuesAllocator;
+    typedef boost::container::map<SharedMemoryString,SharedMemoryString,SharedMemoryLess,SharedMemoryValuesAllocator> SharedMemoryValues;
+
+
+    /**
+     * Values of a key.
+     */
+    struct SharedMemoryEntry{
+
+      SharedMemoryEntry(const SharedMemoryAllocator& allocator) : values(allocator){};
+
+      /**
+       * Fields of the key and their values, a value
+       * written with Write(key,value) is stored in field "__".
+       */
+      SharedMemoryValues values;
+
+
+      /**
+       * Expiration time in milliseconds since epoch,
+       * -1 if the key does not expire. System clock is used
+       * so all processes agree on it.
+       */
+      long long deadline = -1;
+    };
+
+
+    typedef boost::interprocess::allocator<std::pair<const SharedMemoryString,SharedMemoryEntry>,SharedMemorySegmentManager> SharedMemoryEntriesAllocator;
+    typedef boost::container::map<SharedMemoryString,SharedMemoryEntry,SharedMemoryLess,SharedMemoryEntriesAllocator> SharedMemoryEntries;
+
+
+    /**
+     * Part of the cache protected by its own lock,
+     * stored in the shared memory segment.
+     */
+    struct SharedMemoryShard{
+
+      SharedMemoryShard(const SharedMemoryAllocator& allocator) : data(allocator), sweep(allocator){};
+
+      /**
+       * Mutex shared by all processes, exclusive for writing
+       * and sharable for reading.
+       */
+      boost::interprocess::interprocess_sharable_mutex mtx;
+
+
+      /**
+       * Keys of the shard ordered, so prefix patterns
+       * only visit the keys starting with the prefix.
+       */
+      SharedMemoryEntries data;
+
+
+      /**
+       * Number of keys of the shard with an expiration time.
+       */
+      std::size_t expiring = 0;
+
+
+      /**
+       * Next key to visit by the expiration sweep.
+       */
+      SharedMemoryString sweep;
+    };
+
+
+    class SharedMemoryCacheDriver;
+
+    /**
+     * Tool for iterate over cache keys with a given pattern.
+     * Like SharedMapIterator keys are retrieved in batches,
+     * each batch is read under the lock of one shard.
+     */
+    class SharedMemoryIterator : public CacheHandlerIterator{
+
+      public:
+
+        /**
+         * Constructor
+         */
+        SharedMemoryIterator(){};
+
+
+        /**
+         * Constructor
+         * @param   expression  Expression to search keys.
+         *                      Example: session:value:*
+         * @param   cache       Cache containing the keys.
+         */
+        SharedMemoryIterator(const std::string& expression, SharedMemoryCacheDriver* cache);
+
+
+        /**
+         * Destructor
+         */
+        virtual ~SharedMemoryIterator(){};
+
+
+        /**
+         * Set the iterator, useful to reuse it.
+         * @param expression Filter pattern/expression.
+         */
+        virtual void set(const std::string& expression) override;
+
+
+        /**
+         * Return true if there is another key matching the pattern,
+         * false if there is not.
+         * @return True | False
+         */
+        virtual const bool has_next();
+
+
+        /**
+         * Return the next key found with the given pattern.
+         * @return found Key
+         */
+        virtual const std::string next();
+
+
+      protected:
+
+        /**
+         * Cache containing the keys to iterate.
+         */
+        SharedMemoryCacheDriver* cache_;
+
+
+        /**
+         * Compiled expression.
+         */
+        granada::cache::KeyPattern pattern_;
+
+
+        /**
+         * Number of the shard being iterated.
+         */
+        std::size_t shard_ = 0;
+
+
+        /**
+         * Last key visited in the shard being iterated.
+         */
+        std::string cursor_;
+
+
+        /**
+         * True if cursor_ contains the last visited key.
+         */
+        bool started_ = false;
+
+
+        /**
+         * Found keys of the current batch not returned yet.
+         */
+        std::deque<std::string> keys_;
+
+
+        /**
+         * Retrieves batches until a key is found or
+         * there are no more keys to visit.
+         */
+        void Fetch();
+    };
+
+
+    /**
+     * Manages a cache shared by all the processes of the host
+     * opening a segment with the same name. The first process
+     * creates the segment, the others attach to it.
+     * The segment is not removed when the processes exit, so
+     * workers can be restarted without losing the keys. Use
+     * Remove to remove it.
+     *
+     * Shard locks are not robust: if a process dies holding one,
+     * the other processes block on that shard and the segment has
+     * to be removed.
+     *
+     * Keys with a time to live are removed when they are accessed
+     * or by a sweep over a few keys done on each write.
+     */
+    class SharedMemoryCacheDriver : public CacheHandler
+    {
+
+      public:
+
+        // operations with CacheKey keys of CacheHandler, otherwise
+        // hidden by the operations of the same name of this driver.
+        using CacheHandler::Exists;
+        using CacheHandler::Read;
+        using CacheHandler::ReadAll;
+        using CacheHandler::ReadMany;
+        using CacheHandler::Write;
+        using CacheHandler::WriteMany;
+        using CacheHandler::WriteIfNotExists;
+        using CacheHandler::CompareAndSet;
+        using CacheHandler::Increment;
+        using CacheHandler::Destroy;
+        using CacheHandler::DestroyMatch;
+        using CacheHandler::Expire;
+        using CacheHandler::WriteWithTTL;
+        using CacheHandler::WriteManyWithTTL;
+        using CacheHandler::IncrementWithTTL;
+        using CacheHandler::TakeTokens;
+        using CacheHandler::make_iterator;
+        using CacheHandler::ReadAsync;
+        using CacheHandler::ReadManyAsync;
+
+
+        /**
+         * Constructor
+         * Opens or creates the segment named after the
+         * "shared_memory_cache_driver_segment" property and the given name.
+         * @param name  Name of the cache, example: session.
+         */
+        SharedMemoryCacheDriver(const std::string& name);
+
+
+        /**
+         * Constructor
+         * Opens or creates the segment with the given name.
+         * @param segment Name of the shared memory segment.
+         * @param size    Size of the segment in bytes if it is created.
+         * @param shards  Number of shards if the segment is created.
+         */
+        SharedMemoryCacheDriver(const std::string& segment, const std::size_t& size, const int& shards);
+
+
+        /**
+         * Destructor
+         * Detaches from the segment, keys are not removed.
+         */
+        virtual ~SharedMemoryCacheDriver(){};
+
+
+        /**
+         * Removes a shared memory segment. Processes still attached
+         * to it keep using it until they detach.
+         * @param segment Name of the shared memory segment.
+         * @return        True if the segment was removed.
+         */
+        static const bool Remove(const std::string& segment);
+
+
+        /**
+         * Returns true if key exists, false if it does not.
+         * @param  key Key.
+         * @return     True if key exists, false if it does not.
+         */
+        virtual const bool Exists(const std::string& key) override;
+
+
+        /**
+         * Checks if a key exist in a set with given hash.
+         * @param  hash Name of the set of key-value.
+         * @param  key  Key of the value
+         * @return      True if exist, false if it does not.
+         */
+        virtual const bool Exists(const std::string& hash,const std::string& key) override;
+
+
+        /**
+         * Returns value from the cache.
+         * @param  key Key of the value.
+         * @return     Value
+         */
+        virtual const std::string Read(const std::string& key) override;
+
+
+        /**
+         * Returns the value stored in a set and associated with the given key.
+         * @param  hash Name of the set where the key-value pairs are stored.
+         * @param  key  Key associated with the value.
+         * @return      Value.
+         */
+        virtual const std::string Read(const std::string& hash, const std::string& key) override;
+
+
+        /**
+         * Fills a map with all the key-value pairs of a set, locking
+         * its shard once.
+         * @param  hash   Name of the set.
+         * @param  values Map filled with the key-value pairs.
+         * @return        True if the set exists, false if it does not.
+         */
+        virtual const bool ReadAll(const std::string& hash, std::map<std::string,std::string>& values) override;
+
+
+        /**
+         * Returns the values of several keys of a set, locking
+         * its shard once.
+         * @param  hash   Name of the set.
+         * @param  keys   Keys associated with the values.
+         * @param  values Vector filled with the value of each key.
+         * @return        True if the set exists, false if it does not.
+         */
+        virtual const bool ReadMany(const std::string& hash, const std::vector<std::string>& keys, std::vector<std::string>& values) override;
+
+
+        /**
+         * Sets a value in the cache associated with a given key.
+         * @param key   Key of the value.
+         * @param value Value.
+         */
+        virtual void Write(const std::string& key,const std::string& value) override;
+
+
+        /**
+         * Inserts or rewrite a key-value pair in a set with the given name.
+         * If the set does not exist, it creates it.
+         * @param hash  Name of the set.
+         * @param key   Key to identify the value inside the set.
+         * @param value Value
+         */
+        virtual void Write(const std::string& hash,const std::string& key,const std::string& value) override;
+
+
+        /**
+         * Inserts or rewrite several key-value pairs in a set,
+         * locking its shard once.
+         * @param hash    Name of the set.
+         * @param values  Key-value pairs.
+         */
+        virtual void WriteMany(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values) override;
+
+
+        /**
+         * Sets a value only if the key does not exist, checked
+         * and written under the lock of its shard.
+         * @param key   Key of the value.
+         * @param value Value.
+         * @return      True if the value has been written.
+         */
+        virtual const bool WriteIfNotExists(const std::string& key,const std::string& value) override;
+
+
+        /**
+         * Inserts a key-value pair in a set only if the key does not
+         * exist in the set, checked and written under the lock of its shard.
+         * @param hash  Name of the set.
+         * @param key   Key to identify the value inside the set.
+         * @param value Value
+         * @return      True if the value has been written.
+         */
+        virtual const bool WriteIfNotExists(const std::string& hash,const std::string& key,const std::string& value) override;
+
+
+        /**
+         * Replaces the value of a key in a set only if its current
+         * value is the expected one.
+         * @param hash      Name of the set.
+         * @param key       Key to identify the value inside the set.
+         * @param expected  Expected current value, empty if the key does not exist.
+         * @param value     New value.
+         * @return          True if the value has been replaced.
+         */
+        virtual const bool CompareAndSet(const std::string& hash,const std::string& key,const std::string& expected,const std::string& value) override;
+
+
+        /**
+         * Adds a number to the integer value of a key,
+         * a value that is not an integer counts as 0.
+         * @param key       Key of the value.
+         * @param increment Number to add, may be negative.
+         * @return          Value after the increment.
+         */
+        virtual const long long Increment(const std::string& key,const long long& increment) override;
+
+
+        /**
+         * Adds a number to the integer value of a key in a set,
+         * a value that is not an integer counts as 0.
+         * @param hash      Name of the set.
+         * @param key       Key to identify the value inside the set.
+         * @param increment Number to add, may be negative.
+         * @return          Value after the increment.
+         */
+        virtual const long long Increment(const std::string& hash,const std::string& key,const long long& increment) override;
+
+
+        /**
+         * Removes a key-value pair from the cache.
+         * @param key Key, can contain "*" to remove all the keys matching it.
+         */
+        virtual void Destroy(const std::string& key) override;
+
+
+        /**
+         * Destroys a key-value pair stored in a set.
+         * @param hash Name of the set where the key-value pair is stored.
+         * @param key  Key associated with the value.
+         */
+        virtual void Destroy(const std::string& hash,const std::string& key) override;
+
+
+        /**
+         * Destroys all the keys matching an expression, sweeping one
+         * shard at a time with only that shard locked, so the sweep is
+         * not atomic, as in SharedMapCacheDriver::DestroyMatch. Expired
+         * keys visited are removed too.
+         * @param expression  Expression, as in Match.
+         * @return            Number of keys destroyed, matching keys
+         *                    already expired included.
+         */
+        virtual const std::size_t DestroyMatch(const std::string& expression) override;
+
+
+        /**
+         * Renames a key if the new key does not already exist.
+         * @param old_key Old key to rename.
+         * @param new_key New key.
+         * @return        True if the key could be renamed, false if not.
+         */
+        virtual bool Rename(const std::string& old_key, const std::string& new_key) override;
+
+
+        /**
+         * Keys can expire.
+         * @return  True.
+         */
+        virtual const bool SupportsExpire() override {
+          return true;
+        };
+
+
+        /**
+         * Sets the time to live of a key.
+         * @param key     Key.
+         * @param seconds Seconds the key will live from now,
+         *                -1 to remove the time to live of the key.
+         * @return        True if the time to live was set, false if the
+         *                key does not exist.
+         */
+        virtual const bool Expire(const std::string& key, const long long& seconds) override;
+
+
+        /**
+         * Returns the remaining time to live of a key.
+         * @param key Key.
+         * @return    Remaining seconds, -1 if the key exists but
+         *            does not expire, -2 if the key does not exist.
+         */
+        virtual const long long TTL(const std::string& key) override;
+
+
+        /**
+         * Sets a value and the time to live of the key.
+         * @param key     Key of the value.
+         * @param value   Value.
+         * @param seconds Seconds the key will live from now.
+         */
+        virtual void WriteWithTTL(const std::string& key,const std::string& value,const long long& seconds) override;
+
+
+        /**
+         * Sets a value of a set and the time to live of the set.
+         * @param hash    Name of the set.
+         * @param key     Key to identify the value inside the set.
+         * @param value   Value
+         * @param seconds Seconds the set will live from now.
+         */
+        virtual void WriteWithTTL(const std::string& hash,const std::string& key,const std::string& value,const long long& seconds) override;
+
+
+        /**
+         * Sets several values of a set and the time to live of the set,
+         * locking its shard once.
+         * @param hash    Name of the set.
+         * @param values  Key-value pairs.
+         * @param seconds Seconds the set will live from now.
+         */
+        virtual void WriteManyWithTTL(const std::string& hash,const std::vector<std::pair<std::string,std::string>>& values,const long long& seconds) override;
+
+
+        /**
+         * Returns an iterator to iterate over keys with an expression.
+         */
+        virtual std::unique_ptr<granada::cache::CacheHandlerIterator> make_iterator(const std::string& expression) override {
+          return granada::util::memory::make_unique<granada::cache::SharedMemoryIterator>(expression,this);
+        };
+
+
+        /**
+         * Returns a completed task with the result of Exists,
+         * the shards are in memory so there is no I/O to wait for.
+         */
+        virtual pplx::task<bool> ExistsAsync(const std::string& key) override {
+          return pplx::task_from_result((bool)Exists(key));
+        };
+
+
+        /**
+         * Returns a completed task with the result of Exists.
+         */
+        virtual pplx::task<bool> ExistsAsync(const std::string& hash,const std::string& key) override {
+          return pplx::task_from_result((bool)Exists(hash,key));
+        };
+
+
+        /**
+         * Returns a completed task with the result of Read.
+         */
+        virtual pplx::task<std::string> ReadAsync(const std::string& key) override {
+          return pplx::task_from_result(std::string(Read(key)));
+        };
+
+
+        /**
+         * Returns a completed task with the result of Read.
+         */
+        virtual pplx::task<std::string> ReadAsync(const std::string& hash,const std::string& key) override {
+          return pplx::task_from_result(std::string(Read(hash,key)));
+        };
+
+
+        /**
+         * Returns a completed task with the result of ReadMany.
+         */
+        virtual pplx::task<std::vector<std::string>> ReadManyAsync(const std::string& hash,const std::vector<std::string>& keys) override {
+          std::vector<std::string> values;
+          ReadMany(hash,keys,values);
+          return pplx::task_from_result(values);
+        };
+
+
+        /**
+         * Writes the value and returns a completed task.
+         */
+        virtual pplx::task<void> WriteAsync(const std::string& key,const std::string& value) override {
+          Write(key,value);
+          return pplx::task_from_result();
+        };
+
+
+        /**
+         * Writes the value and returns a completed task.
+         */
+        virtual pplx::task<void> WriteAsync(const std::string& hash,const std::string& key,const std::string& value) override {
+          Write(hash,key,value);
+          return pplx::task_from_result();
+        };
+
+
+        /**
+         * Returns a completed task with the result of Match.
+         */
+        virtual pplx::task<std::vector<std::string>> MatchAsync(const std::string& expression) override {
+          std::vector<std::string> keys;
+          Match(expression,keys);
+          return pplx::task_from_result(keys);
+        };
+
+
+        /**
+         * Visits up to count keys of a shard in order, after the
+         * cursor, adding the keys that match the pattern.
+         * @param shard     Number of the shard.
+         * @param pattern   Compiled pattern.
+         * @param started   True if cursor contains the last visited key.
+         * @param cursor    Last visited key, updated by this call.
+         * @param count     Maximum number of keys to visit.
+         * @param keys      Deque where matching keys are added.
+         * @return          True if there are no more keys to visit in the shard.
+         */
+        const bool Scan(const std::size_t& shard, const granada::cache::KeyPattern& pattern, bool& started, std::string& cursor, const std::size_t& count, std::deque<std::string>& keys);
+
+
+        /**
+         * Returns the number of shards.
+         * @return  Number of shards.
+         */
+        const std::size_t shards(){
+          return shards_count_;
+        };
+
+
+      protected:
+
+        /**
+         * Shared memory segment.
+         */
+        std::unique_ptr<boost::interprocess::managed_shared_memory> segment_;
+
+
+        /**
+         * Shards stored in the segment.
+         */
+        SharedMemoryShard* shards_ = nullptr;
+
+
+        /**
+         * Number of shards, taken from the segment.
+         */
+        std::size_t shards_count_ = 0;
+
+
+        /**
+         * Opens or creates the segment and its shards.
+         * @param segment Name of the shared memory segment.
+         * @param size    Size of the segment in bytes if it is created.
+         * @param shards  Number of shards if the segment is created.
+         */
+        void Open(const std::string& segment, const std::size_t& size, const int& shards);
+
+
+        /**
+         * Returns the shard the given key belongs to.
+         * Keys are hashed with FNV-1a so all processes agree
+         * on the shard whatever their standard library.
+         * @param  key  Key.
+         * @return      Shard containing the key.
+         */
+        SharedMemoryShard& shard(const std::string& key);
+
+
+        /**
+         * Returns true if the entry has an expiration time in the past.
+         * @param entry Entry.
+         * @param now   Milliseconds since epoch.
+         */
+        static const bool Expired(const SharedMemoryEntry& entry, const long long& now){
+          return entry.deadline > -1 && entry.deadline <= now;
+        };
+
+
+        /**
+         * Returns the current time in milliseconds since epoch.
+         */
+        static const long long Now();
+
+
+        /**
+         * Finds a key of a shard, erasing it if it is expired.
+         * Shard has to be locked exclusively.
+         * @param  shard  Shard.
+         * @param  key    Key.
+         * @return        Iterator to the entry or end of the shard data.
+         */
+        SharedMemoryEntries::iterator Find(SharedMemoryShard& shard, const std::string& key);
+
+
+        /**
+         * Sets the value of a field of a key, inserting the key and the
+         * field if they do not exist. If the segment is full, expired keys
+         * of the shard are removed and the insertion is retried, a
+         * boost::interprocess::bad_alloc is thrown if it still does not fit.
+         * Shard has to be locked exclusively.
+         * @param  shard  Shard the key belongs to.
+         * @param  key    Key.
+         * @param  field  Field.
+         * @param  value  Value.
+         * @return        Entry of the key.
+         */
+        SharedMemoryEntry& Put(SharedMemoryShard& shard, const std::string& key, const std::string& field, const std::string& value);
+
+
+        /**
+         * Same as Put, without the retry.
+         */
+        SharedMemoryEntry& Insert(SharedMemoryShard& shard, const std::string& key, const std::string& field, const std::string& value);
+
+
+        /**
+         * Sets the expiration time of an entry.
+         * Shard has to be locked exclusively.
+         * @param shard     Shard the entry belongs to.
+         * @param entry     Entry.
+         * @param deadline  Milliseconds since epoch, -1 to remove it.
+         */
+        void SetDeadline(SharedMemoryShard& shard, SharedMemoryEntry& entry, const long long& deadline);
+
+
+        /**
+         * Removes an entry of a shard.
+         * Shard has to be locked exclusively.
+         * @param shard Shard the entry belongs to.
+         * @param it    Iterator to the entry.
+         */
+        void Erase(SharedMemoryShard& shard, SharedMemoryEntries::iterator it);
+
+
+        /**
+         * Visits up to count keys of a shard, starting where the
+         * previous sweep stopped, removing the expired ones.
+         * Shard has to be locked exclusively.
+         * @param shard Shard.
+         * @param count Maximum number of keys to visit.
+         */
+        void RemoveExpired(SharedMemoryShard& shard, const std::size_t& count);
+    };
+
+
+    /**
+     * Returns the cache driver for local caches: a SharedMemoryCacheDriver
+     * if the "shared_memory_cache_driver" property is "on", so the cache
+     * is shared by the processes of the host, a SharedMapCacheDriver if not.
+     * @param  name Name of the cache, example: session.
+     * @return      Cache driver.
+     */
+    std::unique_ptr<granada::cache::CacheHandler> MakeLocalCacheDriver(const std::string& name);
+  }
+}
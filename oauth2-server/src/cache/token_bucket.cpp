@@ -0,0 +1,80 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Token buckets stored in a cache, used to limit the rate of operations.
+  *
+  */
+
+#include "token_bucket.h"
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+namespace granada{
+  namespace cache{
+
+    const std::string TokenBucket::FIELD = "bucket";
+
+
+    const long long TokenBucket::Take(std::string& state, const long long& tokens, const long long& capacity, const double& rate, const long long& now, long long& seconds){
+      const long long full = capacity * 1000;
+      long long level = full;
+      long long time = now;
+      const std::size_t separator = state.find(' ');
+      if (separator != std::string::npos){
+        try{
+          level = std::stoll(state.substr(0,separator));
+          time = std::stoll(state.substr(separator + 1));
+          if (now > time){
+            // tokens per second are millitokens per millisecond.
+            level += (long long) std::floor((now - time) * rate);
+            time = now;
+          }
+          if (level > full){
+            level = full;
+          }
+        }catch(const std::logic_error e){
+          level = full;
+          time = now;
+        }
+      }
+
+      if (level < tokens * 1000){
+        return -1;
+      }
+      level -= tokens * 1000;
+      seconds = -1;
+      if (rate > 0){
+        seconds = (long long) std::ceil((full - level) / (rate * 1000)) + 1;
+      }
+      state.assign(std::to_string(level) + " " + std::to_string(time));
+      return level / 1000;
+    }
+
+
+    const long long TokenBucket::Now(){
+      return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+  }
+}
@@ -0,0 +1,79 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Token buckets stored in a cache, used to limit the rate of operations.
+  *
+  */
+
+#pragma once
+#include <string>
+
+namespace granada{
+  namespace cache{
+
+    /**
+     * State of a token bucket stored in a field of a cache key.
+     * The bucket holds up to capacity tokens and is refilled at
+     * a constant rate, a bucket that does not exist yet is full.
+     * The state is stored as "<millitokens> <milliseconds>", the
+     * tokens left in thousandths of a token and the time of the
+     * last change in milliseconds since epoch, so processes sharing
+     * the cache share the bucket.
+     * RedisCacheDriver runs the same computation in a script.
+     */
+    class TokenBucket{
+
+      public:
+
+        /**
+         * Field of the key where the state of the bucket is stored.
+         */
+        static const std::string FIELD;
+
+
+        /**
+         * Takes tokens from a bucket if it has enough of them.
+         * @param state    State of the bucket, empty if the bucket does not
+         *                 exist. Replaced by the new state if the tokens are taken.
+         * @param tokens   Number of tokens to take.
+         * @param capacity Maximum number of tokens of the bucket.
+         * @param rate     Tokens added to the bucket per second.
+         * @param now      Current time in milliseconds since epoch, see Now.
+         * @param seconds  Set to the seconds until the bucket is full again if
+         *                 the tokens are taken, the time to live of its key,
+         *                 -1 if the bucket is never refilled.
+         * @return         Number of tokens left, -1 if the bucket did not have
+         *                 enough tokens, then state is not changed.
+         */
+        static const long long Take(std::string& state, const long long& tokens, const long long& capacity, const double& rate, const long long& now, long long& seconds);
+
+
+        /**
+         * Returns the current time in milliseconds since epoch.
+         * @return  Milliseconds since epoch.
+         */
+        static const long long Now();
+
+    };
+  }
+}
@@ -34,10 +34,30 @@ using namespace web::http::oauth2::details;
 namespace granada{
   namespace http{
     namespace controller{
-      MessageController::MessageController(utility::string_t url, std::shared_ptr<granada::http::session::SessionFactory>& session_factory, std::shared_ptr<granada::cache::CacheHandler>& cache)
+      MessageController::MessageController(utility::string_t url, std::shared_ptr<granada::http::session::SessionFactory>& session_factory, std::shared_ptr<granada::cache::CacheHandler>& cache, std::shared_ptr<granada::cache::CacheHandler>& rate_limit_cache)
       {
 		  session_factory_ = session_factory;
 		  cache_ = cache;
+
+        // index the messages created before the indexes existed.
+        granada::Message::Index(cache_);
+
+        rate_limiter_ = std::unique_ptr<granada::cache::RateLimiter>(new granada::cache::RateLimiter("message",entity_keys::message_controller_rate_limits,rate_limit_cache));
+
+        list_limit_ = default_numbers::message_list_limit;
+        const std::string& list_limit_str = granada::util::application::GetProperty(entity_keys::message_list_limit);
+        if (!list_limit_str.empty()){
+          try{
+            list_limit_ = std::stoull(list_limit_str);
+          }catch(const std::logic_error e){}
+        }
+        list_max_limit_ = default_numbers::message_list_max_limit;
+        const std::string& list_max_limit_str = granada::util::application::GetProperty(entity_keys::message_list_max_limit);
+        if (!list_max_limit_str.empty()){
+          try{
+            list_max_limit_ = std::stoull(list_max_limit_str);
+          }catch(const std::logic_error e){}
+        }
         n_generator_ = std::unique_ptr<utility::nonce_generator>(new utility::nonce_generator(32));
         m_listener_ = std::unique_ptr<http_listener>(new http_listener(url));
         m_listener_->support(methods::PUT, std::bind(&MessageController::handle_put, this, std::placeholders::_1));
@@ -48,93 +68,87 @@ namespace granada{
 
       void MessageController::handle_put(web::http::http_request request)
       {
-        web::http::http_response response;
-
-        // extract message from HTTP request.
-		std::string body = utility::conversions::to_utf8string(request.extract_string().get());
-        std::unordered_map<std::string, std::string> parsed_data;
-        std::string token;
-        std::string message_str = "";
-        try{
-          // parse the body of the HTTP request and extract the client properties.
-          parsed_data = granada::http::parser::ParseQueryString(body);
-          token.assign(parsed_data["token"]);
-          message_str.assign(parsed_data["message"]);
-        }catch(const std::exception e){}
-
-        std::string json_str;
-
-        if (message_str.empty() || token.empty()){
-          json_str.assign("{\"error\":\"invalid_request\",\"error_description\":\"The request is missing a valid token or a valid message key.\"}");
-        }else{
+        // extract message from HTTP request and load the session in continuations,
+        // so the listener thread is not parked while the cache answers.
+        request.extract_string().then([this,request](const utility::string_t& data) mutable {
+          std::string body = utility::conversions::to_utf8string(data);
+          std::unordered_map<std::string, std::string> parsed_data;
+          std::string token;
+          std::string message_str = "";
+          try{
+            // parse the body of the HTTP request and extract the client properties.
+            parsed_data = granada::http::parser::ParseQueryString(body);
+            token.assign(parsed_data["token"]);
+            message_str.assign(parsed_data["message"]);
+          }catch(const std::exception e){}
+
+          if (message_str.empty() || token.empty()){
+            Reply(request,"{\"error\":\"invalid_request\",\"error_description\":\"The request is missing a valid token or a valid message key.\"}",token.empty());
+            return pplx::task_from_result();
+          }
 
           // retrieve session if it already exists.
-          std::unique_ptr<granada::http::session::Session> session = session_factory_->Session_unique_ptr(token);
+          return LoadSessionAsync(token).then([this,request,message_str](std::shared_ptr<granada::http::session::Session> session) mutable {
+            std::string json_str;
 
-          // insert the message if the user has the permission,
-          if(session->roles()->Is("msg.insert")){
-            granada::Message message(cache_);
+            // insert the message if the user has the permission,
+            if(session->roles()->Is("msg.insert")){
+              granada::Message message(cache_);
 
-            std::string username = session->roles()->GetProperty("msg.insert","username");
+              std::string username = session->roles()->GetProperty("msg.insert","username");
 
-            // insert message.
-            message.Create(username,message_str);
+              if (TakeWriteToken(session.get(),username)){
+                // insert message, the client lists the messages again if it needs them.
+                std::string message_key = message.Create(username,message_str);
+                json_str.assign("{\"description\":\"Success inserting message.\",\"key\":\"" + message_key + "\",\"data\":[]}");
+              }else{
+                json_str.assign("{\"error\":\"temporarily_unavailable\",\"error_description\":\"Error inserting message. Too many messages written, try again later.\"}");
+              }
 
-            // retrieve the actualized list of messages after insertion
-            // if the user has the permissions.
-            if(session->roles()->Is("msg.select")){
-              std::string message_list = message.List(username);
-              json_str.assign("{\"description\":\"Success inserting message.\",\"data\":" + message_list + "}");
             }else{
-              json_str.assign("{\"description\":\"Success inserting message.\",\"data\":[]}");
+              json_str.assign("{\"error\":\"access_denied\",\"error_description\":\"Error inserting message. Check if you have the permissions to create messages.\"}");
             }
-
-          }else{
-            json_str.assign("{\"error\":\"access_denied\",\"error_description\":\"Error inserting message. Check if you have the permissions to create messages.\"}");
+            Reply(request,json_str,false);
+          });
+        }).then([request](pplx::task<void> replied){
+          try{
+            replied.get();
+          }catch(const std::exception e){
+            request.reply(status_codes::InternalError);
           }
-        }
-
-		web::json::value json = web::json::value::parse(utility::conversions::to_string_t(json_str));
-        if (token.empty()){
-          response.set_body(json);
-          response.set_status_code(status_codes::OK);
-          response.headers().add(header_names::content_type, U("text/json; charset=utf-8"));
-          request.reply(response);
-        }else{
-          request.reply(status_codes::OK,json);
-        }
-
+        });
       }
 
       void MessageController::handle_post(web::http::http_request request)
       {
-
-        web::http::http_response response;
-
         auto paths = uri::split_path(uri::decode(request.relative_uri().path()));
 
-		std::string body = utility::conversions::to_utf8string(request.extract_string().get());
-        std::unordered_map<std::string, std::string> parsed_data;
-        std::string token;
-        try{
-          // parse the body of the HTTP request and extract the client properties.
-          parsed_data = granada::http::parser::ParseQueryString(body);
-          token.assign(parsed_data["token"]);
-        }catch(const std::exception e){}
-
-        std::string json_str;
-
-        if (!paths.empty()){
-
-		  std::string name = utility::conversions::to_utf8string(paths[0]);
-
+        request.extract_string().then([this,request,paths](const utility::string_t& data) mutable {
+          std::string body = utility::conversions::to_utf8string(data);
+          std::unordered_map<std::string, std::string> parsed_data;
+          std::string token;
+          try{
+            // parse the body of the HTTP request and extract the client properties.
+            parsed_data = granada::http::parser::ParseQueryString(body);
+            token.assign(parsed_data["token"]);
+          }catch(const std::exception e){}
+
+          if (paths.empty()){
+            Reply(request,"{\"error\":\"invalid_request\",\"error_description\":\"The request is missing a required parameter, includes an invalid parameter value, includes a parameter more than once, or is otherwise malformed.\"}",token.empty());
+            return pplx::task_from_result();
+          }
 
           // Retrieves session if it exists
           if (token.empty()){
-            json_str.assign("{\"error\":\"invalid_token\",\"error_description\":\"The request is missing a valid token.\"}");
-          }else{
-            // retrieve session if it already exists.
-            std::unique_ptr<granada::http::session::Session> session = session_factory_->Session_unique_ptr(token);
+            Reply(request,"{\"error\":\"invalid_token\",\"error_description\":\"The request is missing a valid token.\"}",true);
+            return pplx::task_from_result();
+          }
+
+          std::string name = utility::conversions::to_utf8string(paths[0]);
+
+          // retrieve session if it already exists.
+          return LoadSessionAsync(token).then([this,request,name,parsed_data](std::shared_ptr<granada::http::session::Session> session) mutable {
+            std::string json_str;
 
             if(name == "list"){
 
@@ -146,23 +160,34 @@ namespace granada{
 
                 std::string username = session->roles()->GetProperty("msg.select","username");
 
-                std::string message_list = message.List(username);
+                std::size_t limit = list_limit_;
+                try{
+                  const std::string& limit_str = parsed_data["limit"];
+                  if (!limit_str.empty()){
+                    limit = std::stoull(limit_str);
+                  }
+                }catch(const std::logic_error e){}
+                if (limit < 1){
+                  limit = list_limit_;
+                }
+                if (limit > list_max_limit_){
+                  limit = list_max_limit_;
+                }
+
+                std::string cursor;
+                std::string message_list = message.List(username,parsed_data["cursor"],limit,cursor);
 
-                json_str.assign("{\"description\":\"Success listing messages.\",\"data\":" + message_list + "}");
+                json_str.assign("{\"description\":\"Success listing messages.\",\"data\":" + message_list + ",\"cursor\":\"" + cursor + "\"}");
               }else{
                 json_str.assign("{\"error\":\"access_denied\",\"error_description\":\"Error listing messages. Check if you have the permissions to read messages.\"}");
               }
             }else if (name == "edit"){
 
               // Edit messages if user has the permission.
-
-              // extract data from the HTTP request.
-			  std::string body = utility::conversions::to_utf8string(request.extract_string().get());
               std::string message_key = "";
               std::string message_str = "";
               try{
-                // parse the body of the HTTP request and extract the username, password and scope.
-                // scope contains the roles we want to assign to the session.
+                // extract the key and the new text of the message.
                 message_key.assign(parsed_data["key"]);
                 message_str.assign(parsed_data["message"]);
               }catch(const std::exception e){}
@@ -172,13 +197,10 @@ namespace granada{
 
                 std::string username = session->roles()->GetProperty("msg.update","username");
 
-                if (message.Edit(username,message_key,message_str)){
-                  if(session->roles()->Is("msg.select")){
-                    std::string message_list = message.List(username);
-                    json_str.assign("{\"description\":\"Success editing message.\",\"data\":" + message_list + "}");
-                  }else{
-                    json_str.assign("{\"description\":\"Success editing message.\",\"data\":[]}");
-                  }
+                if (!TakeWriteToken(session.get(),username)){
+                  json_str.assign("{\"error\":\"temporarily_unavailable\",\"error_description\":\"Error editing message. Too many messages written, try again later.\"}");
+                }else if (message.Edit(username,message_key,message_str)){
+                  json_str.assign("{\"description\":\"Success editing message.\",\"data\":[]}");
                 }else{
                   json_str.assign("{\"error\":\"invalid_message_key\",\"error_description\":\"Error editing message. The message with given key does not exist.\"}");
                 }
@@ -188,67 +210,80 @@ namespace granada{
             }else{
               json_str.assign("{\"error\":\"invalid_request\",\"error_description\":\"The request is missing a required parameter, includes an invalid parameter value, includes a parameter more than once, or is otherwise malformed.\"}");
             }
+            Reply(request,json_str,false);
+          });
+        }).then([request](pplx::task<void> replied){
+          try{
+            replied.get();
+          }catch(const std::exception e){
+            request.reply(status_codes::InternalError);
           }
-        }else{
-          json_str.assign("{\"error\":\"invalid_request\",\"error_description\":\"The request is missing a required parameter, includes an invalid parameter value, includes a parameter more than once, or is otherwise malformed.\"}");
-        }
-		web::json::value json = web::json::value::parse(utility::conversions::to_string_t(json_str));
-        if (token.empty()){
-          response.set_body(json);
-          response.set_status_code(status_codes::OK);
-          response.headers().add(header_names::content_type, U("text/json; charset=utf-8"));
-          request.reply(response);
-        }else{
-          request.reply(status_codes::OK,json);
-        }
+        });
       }
 
       void MessageController::handle_delete(web::http::http_request request)
       {
-        web::http::http_response response;
-
         // extract message from HTTP request.
-		std::string body = utility::conversions::to_utf8string(request.extract_string().get());
-        std::unordered_map<std::string, std::string> parsed_data;
-        std::string token;
-        std::string message_key = "";
-        try{
-          // parse the body of the HTTP request and extract the client properties.
-          parsed_data = granada::http::parser::ParseQueryString(body);
-          token.assign(parsed_data["token"]);
-          message_key.assign(parsed_data["key"]);
-        }catch(const std::exception e){}
-
-        std::string json_str;
-
-        if (message_key.empty() || token.empty()){
-          json_str.assign("{\"error\":\"invalid_request\",\"error_description\":\"The request is missing a valid token or a valid message key.\"}");
-        }else{
+        request.extract_string().then([this,request](const utility::string_t& data) mutable {
+          std::string body = utility::conversions::to_utf8string(data);
+          std::unordered_map<std::string, std::string> parsed_data;
+          std::string token;
+          std::string message_key = "";
+          try{
+            // parse the body of the HTTP request and extract the client properties.
+            parsed_data = granada::http::parser::ParseQueryString(body);
+            token.assign(parsed_data["token"]);
+            message_key.assign(parsed_data["key"]);
+          }catch(const std::exception e){}
+
+          if (message_key.empty() || token.empty()){
+            Reply(request,"{\"error\":\"invalid_request\",\"error_description\":\"The request is missing a valid token or a valid message key.\"}",token.empty());
+            return pplx::task_from_result();
+          }
 
           // Retrieves session if it exists
-          std::unique_ptr<granada::http::session::Session> session = session_factory_->Session_unique_ptr(token);
-
-          // Delete message if the user has the permission.
-          if(session->roles()->Is("msg.delete")){
-            std::string username = session->roles()->GetProperty("msg.delete","username");
-            granada::Message message(cache_);
-            message.Delete(username,message_key);
-
-            // retrieve the actualized list of messages after deletion
-            // if the user has the permissions.
-            if(session->roles()->Is("msg.select")){
-              std::string message_list = message.List(username);
-              json_str.assign("{\"description\":\"Success deleting message.\",\"data\":" + message_list + "}");
+          return LoadSessionAsync(token).then([this,request,message_key](std::shared_ptr<granada::http::session::Session> session) mutable {
+            std::string json_str;
+
+            // Delete message if the user has the permission.
+            if(session->roles()->Is("msg.delete")){
+              std::string username = session->roles()->GetProperty("msg.delete","username");
+              if (TakeWriteToken(session.get(),username)){
+                granada::Message message(cache_);
+                message.Delete(username,message_key);
+                json_str.assign("{\"description\":\"Success deleting message.\",\"data\":[]}");
+              }else{
+                json_str.assign("{\"error\":\"temporarily_unavailable\",\"error_description\":\"Error deleting message. Too many messages written, try again later.\"}");
+              }
             }else{
-              json_str.assign("{\"description\":\"Success deleting message.\",\"data\":[]}");
+              json_str.assign("{\"error\":\"access_denied\",\"error_description\":\"Error deleting message. Check if you have the permissions to delete messages.\"}");
             }
-          }else{
-            json_str.assign("{\"error\":\"access_denied\",\"error_description\":\"Error deleting message. Check if you have the permissions to delete messages.\"}");
+            Reply(request,json_str,false);
+          });
+        }).then([request](pplx::task<void> replied){
+          try{
+            replied.get();
+          }catch(const std::exception e){
+            request.reply(status_codes::InternalError);
           }
-        }
+        });
+      }
 
-		web::json::value json = web::json::value::parse(utility::conversions::to_string_t(json_str));
-        if (token.empty()){
+
+      pplx::task<std::shared_ptr<granada::http::session::Session>> MessageController::LoadSessionAsync(const std::string& token){
+        // the session is shared with the continuation, which keeps it
+        // alive until the handler has used it.
+        std::shared_ptr<granada::http::session::Session> session = session_factory_->Session_unique_ptr();
+        return session->LoadSessionAsync(token).then([session](bool loaded){
+          return session;
+        });
+      }
+
+
+      void MessageController::Reply(web::http::http_request& request, const std::string& json_str, const bool token_empty){
+        web::json::value json = web::json::value::parse(utility::conversions::to_string_t(json_str));
+        if (token_empty){
+          web::http::http_response response;
           response.set_body(json);
           response.set_status_code(status_codes::OK);
           response.headers().add(header_names::content_type, U("text/json; charset=utf-8"));
@@ -259,6 +294,18 @@ namespace granada{
       }
 
 
+      const bool MessageController::TakeWriteToken(granada::http::session::Session* session, const std::string& username){
+        // the client is checked first, so writes refused because their client
+        // is over its limit do not spend the tokens of the user. The client
+        // is only read from the session when it is limited.
+        if (rate_limiter_->Limits(entity_keys::rate_limit_client)
+            && !rate_limiter_->Take(entity_keys::rate_limit_client,session->Read(entity_keys::oauth2_session_client_id))){
+          return false;
+        }
+        return rate_limiter_->Take(entity_keys::rate_limit_user,username);
+      }
+
+
       void MessageController::MessageApplicationSessionFactory(std::unique_ptr<granada::http::session::Session>& session, web::http::http_request request, web::http::http_response response){
         std::unordered_map<std::string, std::string> cookies = granada::http::parser::ParseCookies(request);
         const std::string token_label = "message_token";
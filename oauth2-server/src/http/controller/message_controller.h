@@ -32,6 +32,7 @@
 #include "cpprest/json.h"
 #include "cpprest/asyncrt_utils.h"
 #include "cache/cache_handler.h"
+#include "cache/rate_limiter.h"
 #include "cpprest/http_client.h"
 #include "http/parser.h"
 #include "http/oauth2/oauth2.h"
@@ -47,8 +48,10 @@ namespace granada{
 
           /**
            * Constructor
+           * @param rate_limit_cache  Cache storing the limits of the message writes,
+           *                          see the "message_controller_rate_limits" property.
            */
-          MessageController(utility::string_t url, std::shared_ptr<granada::http::session::SessionFactory>& session_factory, std::shared_ptr<granada::cache::CacheHandler>& cache);
+          MessageController(utility::string_t url, std::shared_ptr<granada::http::session::SessionFactory>& session_factory, std::shared_ptr<granada::cache::CacheHandler>& cache, std::shared_ptr<granada::cache::CacheHandler>& rate_limit_cache);
 
         private:
 
@@ -73,6 +76,26 @@ namespace granada{
           std::shared_ptr<granada::cache::CacheHandler> cache_;
 
 
+          /**
+           * Limits the message writes by user and by client.
+           */
+          std::unique_ptr<granada::cache::RateLimiter> rate_limiter_;
+
+
+          /**
+           * Number of messages listed when the request gives no limit,
+           * taken from the "message_list_limit" property.
+           */
+          std::size_t list_limit_;
+
+
+          /**
+           * Maximum number of messages listed at once,
+           * taken from the "message_list_max_limit" property.
+           */
+          std::size_t list_max_limit_;
+
+
           /**
            * Handles HTTP PUT requests.
            * @param request HTTP request.
@@ -82,6 +105,12 @@ namespace granada{
 
           /**
            * Handles HTTP POST requests.
+           * list: lists a page of the user's messages, from the newest
+           *       to the oldest. Takes an optional "limit", the number
+           *       of messages, and "cursor", the cursor returned with the
+           *       previous page. The cursor of the next page is returned
+           *       in "cursor", empty after the last page.
+           * edit: edits a message.
            * @param request HTTP request.
            */
           void handle_post(web::http::http_request request);
@@ -93,6 +122,37 @@ namespace granada{
           void handle_delete(web::http::http_request request);
 
 
+          /**
+           * Loads the session with the given token without blocking
+           * the calling thread.
+           * @param token Session token.
+           * @return      Task resolving to the session, its token is empty
+           *              if the session does not exist.
+           */
+          pplx::task<std::shared_ptr<granada::http::session::Session>> LoadSessionAsync(const std::string& token);
+
+
+          /**
+           * Replies to a request with a json.
+           * @param request     HTTP request.
+           * @param json_str    Json replied.
+           * @param token_empty True if the request has no token, the json
+           *                    is then replied with its content type.
+           */
+          void Reply(web::http::http_request& request, const std::string& json_str, const bool token_empty);
+
+
+          /**
+           * Takes a token from the write limits of the client the
+           * session was given to and of a user, the user is not
+           * charged if the client is over its limit.
+           * @param session   Session of the client.
+           * @param username  User writing.
+           * @return          True if the write is allowed.
+           */
+          const bool TakeWriteToken(granada::http::session::Session* session, const std::string& username);
+
+
           void MessageApplicationSessionFactory(std::unique_ptr<granada::http::session::Session>& session, web::http::http_request request, web::http::http_response response);
       };
     }
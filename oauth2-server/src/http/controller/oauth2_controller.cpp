@@ -46,7 +46,8 @@ namespace granada{
       OAuth2Controller::OAuth2Controller(
         utility::string_t url,
         std::shared_ptr<granada::http::session::SessionFactory>& session_factory,
-        std::shared_ptr<granada::http::oauth2::OAuth2Factory>& oauth2_factory)
+        std::shared_ptr<granada::http::oauth2::OAuth2Factory>& oauth2_factory,
+        std::shared_ptr<granada::cache::CacheHandler>& rate_limit_cache)
       {
         m_listener_ = std::unique_ptr<http_listener>(new http_listener(url));
         m_listener_->support(methods::GET, std::bind(&OAuth2Controller::handle_get, this, std::placeholders::_1));
@@ -54,6 +55,7 @@ namespace granada{
         m_listener_->support(methods::DEL, std::bind(&OAuth2Controller::handle_delete, this, std::placeholders::_1));
         session_factory_ = session_factory;
         oauth2_factory_ = oauth2_factory;
+        rate_limiter_ = std::unique_ptr<granada::cache::RateLimiter>(new granada::cache::RateLimiter("oauth2",entity_keys::oauth2_controller_rate_limits,rate_limit_cache));
         url_ = url;
         OAuth2Controller::load_properties_call_once_.call([this](){
           this->LoadProperties();
@@ -172,33 +174,59 @@ namespace granada{
 
         auto paths = uri::split_path(uri::decode(request.relative_uri().path()));
 
-        // oauth2 response parameters.
-        granada::http::oauth2::OAuth2Parameters oauth2_response;
-
 		if (!paths.empty() && paths.size() == 1 && utility::conversions::to_utf8string(paths[0]) == oauth2_authorize_uri_){
 
-          // extract data from the HTTP request.
-          const std::string& body = utility::conversions::to_utf8string(request.extract_string().get());
-
-          // oauth2 parameters obtained from HTTP request body.
-          granada::http::oauth2::OAuth2Parameters oauth2_parameters(body);
-
-          std::unique_ptr<granada::http::oauth2::OAuth2Authorization> oauth2_authorization = oauth2_factory_->OAuth2Authorization_unique_ptr(oauth2_parameters,session_factory_.get());
-          oauth2_response = oauth2_authorization->Grant(request,response);
+          // extract data from the HTTP request and grant in continuations,
+          // so the listener thread is not parked while the cache answers.
+          request.extract_string().then([this,request,response](const utility::string_t& data) mutable {
+
+            // oauth2 parameters obtained from HTTP request body.
+            granada::http::oauth2::OAuth2Parameters oauth2_parameters(utility::conversions::to_utf8string(data));
+
+            // password attempts are limited by client and by user. The client
+            // is checked first, so attempts refused because their client is
+            // over its limit do not spend the tokens of the user.
+            if (!oauth2_parameters.password.empty()
+                && (!rate_limiter_->Take(entity_keys::rate_limit_client,oauth2_parameters.client_id)
+                || !rate_limiter_->Take(entity_keys::rate_limit_user,oauth2_parameters.username))){
+              granada::http::oauth2::OAuth2Parameters oauth2_response;
+              oauth2_response.error = oauth2_errors::temporarily_unavailable;
+              oauth2_response.error_description = oauth2_errors_description::temporarily_unavailable;
+              ReplyGrant(oauth2_parameters.grant_type,oauth2_response,request,response);
+              return pplx::task_from_result();
+            }
 
-          if (oauth2_parameters.grant_type == utility::conversions::to_utf8string(oauth2_strings::authorization_code)){
-            // reply with a json to the client.
-            if (oauth2_response.redirect_uri.empty()){
-              oauth2_response.redirect_uri = granada::http::parser::ParseURIFromReferer(request);
+            std::shared_ptr<granada::http::oauth2::OAuth2Authorization> oauth2_authorization = oauth2_factory_->OAuth2Authorization_unique_ptr(oauth2_parameters,session_factory_.get());
+            return oauth2_authorization->GrantAsync(request,response).then([this,oauth2_authorization,oauth2_parameters,request,response](granada::http::oauth2::OAuth2Parameters oauth2_response) mutable {
+              ReplyGrant(oauth2_parameters.grant_type,oauth2_response,request,response);
+            });
+          }).then([request](pplx::task<void> replied){
+            try{
+              replied.get();
+            }catch(const std::exception e){
+              request.reply(status_codes::InternalError);
             }
-            response.set_status_code(status_codes::OK);
-            response.set_body(oauth2_response.to_json());
-            request.reply(response);
-            return;
-          }
+          });
         }else{
+          // oauth2 response parameters.
+          granada::http::oauth2::OAuth2Parameters oauth2_response;
           oauth2_response.error = oauth2_errors::invalid_request;
           oauth2_response.error_description = oauth2_errors_description::invalid_request;
+          ReplyGrant("",oauth2_response,request,response);
+        }
+      }
+
+
+      void OAuth2Controller::ReplyGrant(const std::string& grant_type, granada::http::oauth2::OAuth2Parameters& oauth2_response, web::http::http_request& request, web::http::http_response& response){
+        if (grant_type == utility::conversions::to_utf8string(oauth2_strings::authorization_code)){
+          // reply with a json to the client.
+          if (oauth2_response.redirect_uri.empty()){
+            oauth2_response.redirect_uri = granada::http::parser::ParseURIFromReferer(request);
+          }
+          response.set_status_code(status_codes::OK);
+          response.set_body(oauth2_response.to_json());
+          request.reply(response);
+          return;
         }
 
         // redirect user with oauth2 response parameters.
@@ -38,6 +38,7 @@
 #include "http/http_msg.h"
 #include "http/session/session.h"
 #include "http/oauth2/oauth2.h"
+#include "cache/rate_limiter.h"
 #include "http/controller/controller.h"
 
 namespace granada{
@@ -52,11 +53,14 @@ namespace granada{
            * @param session_factory    Allows to have a unique point for checking and setting sessions.
            *                              Can be used to create a new session if it does not exist.
            * @param oauth2_factory        Used to instanciate OAuth 2.0 clients, users and codes.
+           * @param rate_limit_cache      Cache storing the limits of the password attempts,
+           *                              see the "oauth2_controller_rate_limits" property.
            */
           OAuth2Controller(
             utility::string_t url,
             std::shared_ptr<granada::http::session::SessionFactory>& session_factory,
-            std::shared_ptr<granada::http::oauth2::OAuth2Factory>& oauth2_factory);
+            std::shared_ptr<granada::http::oauth2::OAuth2Factory>& oauth2_factory,
+            std::shared_ptr<granada::cache::CacheHandler>& rate_limit_cache);
 
 
           /**
@@ -140,6 +144,12 @@ namespace granada{
           std::shared_ptr<granada::http::oauth2::OAuth2Factory> oauth2_factory_;
 
 
+          /**
+           * Limits the password attempts by user and by client.
+           */
+          std::unique_ptr<granada::cache::RateLimiter> rate_limiter_;
+
+
           /**
           * Load the templates and URIs from the server configuration file, if properties are not in this
           * file then take default values from defaults.dat and http/oauth2/oauth2.templates.
@@ -218,6 +228,18 @@ namespace granada{
           void handle_post(http_request request);
 
 
+          /**
+           * Replies to a grant request: with a json if the grant type is
+           * authorization_code, otherwise redirecting the user with the
+           * OAuth 2.0 response parameters.
+           * @param grant_type      Grant type of the request.
+           * @param oauth2_response OAuth 2.0 response parameters.
+           * @param request         HTTP request.
+           * @param response        HTTP response.
+           */
+          void ReplyGrant(const std::string& grant_type, granada::http::oauth2::OAuth2Parameters& oauth2_response, http_request& request, http_response& response);
+
+
           /**
            * Handles HTTP DELETE requests.
            * @param request HTTP request.
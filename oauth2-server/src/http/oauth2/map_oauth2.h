@@ -32,6 +32,9 @@
 #include "util/mutex.h"
 #include "http/oauth2/oauth2.h"
 #include "cache/shared_map_cache_driver.h"
+#include "cache/shared_memory_cache_driver.h"
+#include "cache/compressed_cache_driver.h"
+#include "cache/cache_registry.h"
 #include "crypto/nonce_generator.h"
 #include "crypto/openssl_aes_cryptograph.h"
 
@@ -93,7 +96,7 @@ namespace granada{
           /**
            * Cache to insert, modify and delete client data.
            */
-          static std::unique_ptr<granada::cache::CacheHandler> cache_;
+          static std::shared_ptr<granada::cache::CacheHandler> cache_;
 
 
           /**
@@ -163,7 +166,7 @@ namespace granada{
           /**
            * Cache to insert, modify and delete client data.
            */
-          static std::unique_ptr<granada::cache::CacheHandler> cache_;
+          static std::shared_ptr<granada::cache::CacheHandler> cache_;
 
 
           /**
@@ -232,7 +235,7 @@ namespace granada{
           /**
            * Cache to insert, modify and delete client data.
            */
-          static std::unique_ptr<granada::cache::CacheHandler> cache_;
+          static std::shared_ptr<granada::cache::CacheHandler> cache_;
 
 
           /**
@@ -299,7 +302,7 @@ namespace granada{
           /**
            * Cache to insert, modify and delete client data.
            */
-          static std::unique_ptr<granada::cache::CacheHandler> cache_;
+          static std::shared_ptr<granada::cache::CacheHandler> cache_;
 
 
           
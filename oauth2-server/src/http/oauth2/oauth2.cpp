@@ -64,29 +64,28 @@ namespace granada{
       // OAuth2 Client
       ////
 
-      std::mutex OAuth2Client::oauth2_client_creation_mtx_;
       std::string OAuth2Client::cache_namespace_;
       int OAuth2Client::client_id_length_;
 
       void OAuth2Client::Load(){
 
-        if (!id_.empty() && Exists()){
+        std::vector<std::string> values;
+        if (!id_.empty() && cache()->ReadMany(hash(), {
+              entity_keys::oauth2_client_key,
+              entity_keys::oauth2_client_client_type,
+              entity_keys::oauth2_client_application_name,
+              entity_keys::oauth2_client_redirect_uris,
+              entity_keys::oauth2_client_roles,
+              entity_keys::oauth2_client_creation_time
+            }, values)){
 
-          const std::string& hash(this->hash());
-          
           // load client properties.
-          key_.assign(cache()->Read(hash, entity_keys::oauth2_client_key));
-          type_.assign(cache()->Read(hash, entity_keys::oauth2_client_client_type));
-          application_name_.assign(cache()->Read(hash,entity_keys::oauth2_client_application_name));
-
-          const std::string& redirect_uris_str(cache()->Read(hash, entity_keys::oauth2_client_redirect_uris));
-          granada::util::string::split(redirect_uris_str, ',', redirect_uris_);
-          
-          const std::string& roles_str(cache()->Read(hash, entity_keys::oauth2_client_roles));
-          granada::util::string::split(roles_str, ',', roles_);
-
-          const std::string& creation_time_str(cache()->Read(hash, entity_keys::oauth2_client_creation_time));
-          creation_time_ = granada::util::time::parse(creation_time_str);
+          key_.assign(values[0]);
+          type_.assign(values[1]);
+          application_name_.assign(values[2]);
+          granada::util::string::split(values[3], ',', redirect_uris_);
+          granada::util::string::split(values[4], ',', roles_);
+          creation_time_ = granada::util::time::parse(values[5]);
 
         }else{
           id_.assign("");
@@ -102,43 +101,58 @@ namespace granada{
       }
 
 
-      void OAuth2Client::Create(const std::string& type, const std::vector<std::string>& redirect_uris, const std::string& application_name, const std::vector<std::string>& roles, std::string& secret){
-        
-        id_.assign(nonce_generator()->generate(client_id_length_));
-
-        const std::string& hash(this->hash());
-
-        // save with unique id,
-        // check if it does not already exist one client with the same id.
-        oauth2_client_creation_mtx_.lock();
-
-        if (Exists()){
-
-          oauth2_client_creation_mtx_.unlock();
-          Create(type,redirect_uris,application_name,roles,secret);
-        }else{
-
-          // client with that id does not already exist,
-          // save it.
-          cache()->Write(hash, entity_keys::oauth2_client_id, id_);
-
-          oauth2_client_creation_mtx_.unlock();
-
-          // save the client's properties.
-          key_.assign(cryptograph()->Encrypt(id_,secret));
-          type_.assign(type);
-          redirect_uris_ = redirect_uris;
-          roles_ = roles;
-          application_name_ = application_name;
+      pplx::task<void> OAuth2Client::LoadAsync(const std::string& identifier){
+        if (identifier.empty()){
+          return pplx::task_from_result();
+        }
+        id_.assign(identifier);
+        return cache()->ReadManyAsync(hash(), {
+            entity_keys::oauth2_client_key,
+            entity_keys::oauth2_client_client_type,
+            entity_keys::oauth2_client_application_name,
+            entity_keys::oauth2_client_redirect_uris,
+            entity_keys::oauth2_client_roles,
+            entity_keys::oauth2_client_creation_time
+          }).then([this](const std::vector<std::string>& values){
+            if (values.empty()){
+              id_.assign("");
+            }else{
+              key_.assign(values[0]);
+              type_.assign(values[1]);
+              application_name_.assign(values[2]);
+              granada::util::string::split(values[3], ',', redirect_uris_);
+              granada::util::string::split(values[4], ',', roles_);
+              creation_time_ = granada::util::time::parse(values[5]);
+            }
+          });
+      }
 
-          cache()->Write(hash, entity_keys::oauth2_client_key, key_);
-          cache()->Write(hash, entity_keys::oauth2_client_client_type, type_);
-          cache()->Write(hash, entity_keys::oauth2_client_application_name, application_name_);
-          cache()->Write(hash, entity_keys::oauth2_client_redirect_uris, granada::util::vector::stringify(redirect_uris,","));
-          cache()->Write(hash, entity_keys::oauth2_client_roles, granada::util::vector::stringify(roles,","));
-          cache()->Write(hash, entity_keys::oauth2_client_creation_time, granada::util::time::stringify(std::time(nullptr)));
 
-        }
+      void OAuth2Client::Create(const std::string& type, const std::vector<std::string>& redirect_uris, const std::string& application_name, const std::vector<std::string>& roles, std::string& secret){
+        
+        // save with unique id, the id is only written if no
+        // client has it, otherwise try with another id.
+        do{
+          id_.assign(nonce_generator()->generate(client_id_length_));
+        }while(!cache()->WriteIfNotExists(hash(), entity_keys::oauth2_client_id, id_));
+
+        const granada::cache::CacheKey hash(this->hash());
+
+        // save the client's properties.
+        key_.assign(cryptograph()->Encrypt(id_,secret));
+        type_.assign(type);
+        redirect_uris_ = redirect_uris;
+        roles_ = roles;
+        application_name_ = application_name;
+
+        cache()->WriteMany(hash, {
+          { entity_keys::oauth2_client_key, key_ },
+          { entity_keys::oauth2_client_client_type, type_ },
+          { entity_keys::oauth2_client_application_name, application_name_ },
+          { entity_keys::oauth2_client_redirect_uris, granada::util::vector::stringify(redirect_uris,",") },
+          { entity_keys::oauth2_client_roles, granada::util::vector::stringify(roles,",") },
+          { entity_keys::oauth2_client_creation_time, granada::util::time::stringify(std::time(nullptr)) }
+        });
       }
 
 
@@ -195,30 +209,21 @@ namespace granada{
       // OAuth2 User
       ////
 
-      std::mutex OAuth2User::oauth2_user_creation_mtx_;
       std::string OAuth2User::cache_namespace_;
 
       bool OAuth2User::Create(const std::string& username, std::string& password, const web::json::value& roles){
         username_.assign(username);
         
-        const std::string& hash(this->hash());
+        const granada::cache::CacheKey hash(this->hash());
 
-        // save with unique username,
-        // check if it does not already exist one user with the same username.
-        oauth2_user_creation_mtx_.lock();
-        if (Exists()){
-          oauth2_user_creation_mtx_.unlock();
+        // save with unique username, the username is only
+        // written if no user has it.
+        if (!cache()->WriteIfNotExists(hash, entity_keys::oauth2_user_username, username)){
           return false;
         }else{
-          // user with that username does not already exist,
-          // save it.
-          cache()->Write(hash, entity_keys::oauth2_user_username, username);
-          oauth2_user_creation_mtx_.unlock();
-
           // save user properties.
           const std::string& key = cryptograph()->Encrypt(username,password);
           key_.assign(key);
-          cache()->Write(hash, entity_keys::oauth2_user_key, key);
           std::string roles_str;
           try{
             roles_str = utility::conversions::to_utf8string(roles.serialize());
@@ -227,19 +232,26 @@ namespace granada{
             roles_str = "{}";
 			roles_ = web::json::value::parse(utility::conversions::to_string_t(roles_str));
           }
-          cache()->Write(hash, entity_keys::oauth2_user_roles, roles_str);
-          cache()->Write(hash, entity_keys::oauth2_user_creation_time, granada::util::time::stringify(std::time(nullptr)));
+          cache()->WriteMany(hash, {
+            { entity_keys::oauth2_user_key, key },
+            { entity_keys::oauth2_user_roles, roles_str },
+            { entity_keys::oauth2_user_creation_time, granada::util::time::stringify(std::time(nullptr)) }
+          });
           return true;
         }
       }
 
       void OAuth2User::Load(){
-        if (!username_.empty() && Exists()){
-          const std::string& hash(this->hash());
+        std::vector<std::string> values;
+        if (!username_.empty() && cache()->ReadMany(hash(), {
+              entity_keys::oauth2_user_key,
+              entity_keys::oauth2_user_roles,
+              entity_keys::oauth2_user_creation_time
+            }, values)){
 
           // load user's properties.
-          key_.assign(cache()->Read(hash, entity_keys::oauth2_user_key));
-          std::string roles_str(cache()->Read(hash, entity_keys::oauth2_user_roles));
+          key_.assign(values[0]);
+          std::string roles_str(values[1]);
 
           try{
 			  roles_ = web::json::value::parse(utility::conversions::to_string_t(roles_str));
@@ -248,8 +260,7 @@ namespace granada{
 			roles_ = web::json::value::parse(utility::conversions::to_string_t(roles_str));
           }
 
-          const std::string& creation_time_str(cache()->Read(hash, entity_keys::oauth2_user_creation_time));
-          creation_time_ = granada::util::time::parse(creation_time_str);
+          creation_time_ = granada::util::time::parse(values[2]);
         }else{
           username_.assign("");
         }
@@ -263,6 +274,33 @@ namespace granada{
       }
 
 
+      pplx::task<void> OAuth2User::LoadAsync(const std::string& identifier){
+        if (identifier.empty()){
+          return pplx::task_from_result();
+        }
+        username_.assign(identifier);
+        return cache()->ReadManyAsync(hash(), {
+            entity_keys::oauth2_user_key,
+            entity_keys::oauth2_user_roles,
+            entity_keys::oauth2_user_creation_time
+          }).then([this](const std::vector<std::string>& values){
+            if (values.empty()){
+              username_.assign("");
+            }else{
+              key_.assign(values[0]);
+              std::string roles_str(values[1]);
+              try{
+                roles_ = web::json::value::parse(utility::conversions::to_string_t(roles_str));
+              }catch(const web::json::json_exception e){
+                roles_str = "{}";
+                roles_ = web::json::value::parse(utility::conversions::to_string_t(roles_str));
+              }
+              creation_time_ = granada::util::time::parse(values[2]);
+            }
+          });
+      }
+
+
       bool OAuth2User::CorrectCredentials(std::string password){
         std::string decrypted_key = cryptograph()->Decrypt(key_,password);
         if (decrypted_key.length()>username_.length()){
@@ -298,21 +336,30 @@ namespace granada{
       // OAuth2 Code
       ////
 
-      std::mutex OAuth2Code::oauth2_code_creation_mtx_;
       std::string OAuth2Code::cache_namespace_;
       int OAuth2Code::code_length_;
+      long OAuth2Code::code_timeout_ = default_numbers::oauth2_code_timeout;
 
       void OAuth2Code::Load(){
-        if (!code_.empty() && Exists()){
-          std::string hash = this->hash();
+        std::vector<std::string> values;
+        if (!code_.empty() && cache()->ReadMany(hash(), {
+              entity_keys::oauth2_code_client_id,
+              entity_keys::oauth2_code_username,
+              entity_keys::oauth2_code_roles,
+              entity_keys::oauth2_code_creation_time
+            }, values)){
 
           // load code's properties.
-          client_id_.assign(cache()->Read(hash, entity_keys::oauth2_code_client_id));
-          username_.assign(cache()->Read(hash, entity_keys::oauth2_code_username));
-          std::string roles_str(cache()->Read(hash, entity_keys::oauth2_code_roles));
-          granada::util::string::split(roles_str, '+', roles_);
-          std::string creation_time_str(cache()->Read(hash, entity_keys::oauth2_code_creation_time));
-          creation_time_ = granada::util::time::parse(creation_time_str);
+          client_id_.assign(values[0]);
+          username_.assign(values[1]);
+          granada::util::string::split(values[2], '+', roles_);
+          creation_time_ = granada::util::time::parse(values[3]);
+
+          // the cache may not support expiration.
+          if (granada::util::time::is_timedout(creation_time_,code_timeout_)){
+            Delete();
+            code_.assign("");
+          }
         }else{
           code_.assign("");
         }
@@ -325,31 +372,58 @@ namespace granada{
         }
       };
 
-      void OAuth2Code::Create(const std::string& client_id, const std::string& roles, const std::string& username){
-        code_ = nonce_generator()->generate(code_length_);
-        std::string hash = this->hash();
-
-        // save with unique code,
-        // check if it does not already exist one code with the same code.
-        oauth2_code_creation_mtx_.lock();
-        if (Exists()){
-          oauth2_code_creation_mtx_.unlock();
-          Create(client_id,roles,username);
-        }else{
-
-          // code does not exists, store it.
-          cache()->Write(hash, entity_keys::oauth2_code_code, code_);
-          oauth2_code_creation_mtx_.unlock();
 
-          client_id_.assign(client_id);
-          username_.assign(username);
-          granada::util::string::split(roles,',',roles_);
+      pplx::task<void> OAuth2Code::LoadAsync(const std::string& identifier){
+        if (identifier.empty()){
+          return pplx::task_from_result();
+        }
+        code_.assign(identifier);
+        return cache()->ReadManyAsync(hash(), {
+            entity_keys::oauth2_code_client_id,
+            entity_keys::oauth2_code_username,
+            entity_keys::oauth2_code_roles,
+            entity_keys::oauth2_code_creation_time
+          }).then([this](const std::vector<std::string>& values){
+            if (values.empty()){
+              code_.assign("");
+            }else{
+              client_id_.assign(values[0]);
+              username_.assign(values[1]);
+              granada::util::string::split(values[2], '+', roles_);
+              creation_time_ = granada::util::time::parse(values[3]);
+
+              // the cache may not support expiration.
+              if (granada::util::time::is_timedout(creation_time_,code_timeout_)){
+                Delete();
+                code_.assign("");
+              }
+            }
+          });
+      }
 
-          // store other useful values associated to code.
-          cache()->Write(hash, entity_keys::oauth2_code_username, username_);
-          cache()->Write(hash, entity_keys::oauth2_code_roles, roles);
-          cache()->Write(hash, entity_keys::oauth2_code_client_id, client_id_);
-          cache()->Write(hash, entity_keys::oauth2_code_creation_time, granada::util::time::stringify(std::time(nullptr)));
+      void OAuth2Code::Create(const std::string& client_id, const std::string& roles, const std::string& username){
+        // save with unique code, the code is only written
+        // if it does not already exist, otherwise try with another code.
+        do{
+          code_ = nonce_generator()->generate(code_length_);
+        }while(!cache()->WriteIfNotExists(this->hash(), entity_keys::oauth2_code_code, code_));
+        const granada::cache::CacheKey hash(this->hash());
+
+        client_id_.assign(client_id);
+        username_.assign(username);
+        granada::util::string::split(roles,',',roles_);
+
+        // store other useful values associated to code.
+        const std::vector<std::pair<std::string,std::string>> values = {
+          { entity_keys::oauth2_code_username, username_ },
+          { entity_keys::oauth2_code_roles, roles },
+          { entity_keys::oauth2_code_client_id, client_id_ },
+          { entity_keys::oauth2_code_creation_time, granada::util::time::stringify(std::time(nullptr)) }
+        };
+        if (code_timeout_ > -1){
+          cache()->WriteManyWithTTL(hash, values, code_timeout_);
+        }else{
+          cache()->WriteMany(hash, values);
         }
       }
 
@@ -377,6 +451,18 @@ namespace granada{
         if (cache_namespace_.empty()){
           cache_namespace_.assign(cache_namespaces::oauth2_code_value);
         }
+
+        // get the seconds the code can be used.
+        std::string oauth2_code_timeout_str = granada::util::application::GetProperty(entity_keys::oauth2_code_timeout);
+        if (oauth2_code_timeout_str.empty()){
+          code_timeout_ = default_numbers::oauth2_code_timeout;
+        }else{
+          try{
+            code_timeout_ = std::stol(oauth2_code_timeout_str);
+          }catch(const std::logic_error e){
+            code_timeout_ = default_numbers::oauth2_code_timeout;
+          }
+        }
       }
 
 
@@ -410,6 +496,90 @@ namespace granada{
 
 
       granada::http::oauth2::OAuth2Parameters OAuth2Authorization::Grant(web::http::http_request &request, web::http::http_response& response){
+        std::unique_ptr<granada::http::oauth2::OAuth2Client> oauth2_client;
+        try{
+          // check if client is registered
+          oauth2_client = factory()->OAuth2Client_unique_ptr(oauth2_parameters_.client_id);
+        }catch(const std::exception e){
+          // server error.
+          granada::http::oauth2::OAuth2Parameters oauth2_response;
+          oauth2_response.error = oauth2_errors::server_error;
+          oauth2_response.error_description = oauth2_errors_description::server_error;
+          return oauth2_response;
+        }
+        return Grant(oauth2_client.get(),request,response);
+      }
+
+
+      pplx::task<granada::http::oauth2::OAuth2Parameters> OAuth2Authorization::GrantAsync(web::http::http_request &request, web::http::http_response& response){
+        // the client and then the credentials are loaded without blocking,
+        // the rest of the grant runs as a continuation once their values are there.
+        std::shared_ptr<granada::http::oauth2::OAuth2Client> oauth2_client = factory()->OAuth2Client_unique_ptr();
+        return oauth2_client->LoadAsync(oauth2_parameters_.client_id).then([this,oauth2_client,request,response]() mutable {
+          if (oauth2_client->GetId().empty()){
+            return pplx::task_from_result();
+          }
+          return LoadCredentialsAsync(oauth2_client.get(),request,response);
+        }).then([this,oauth2_client,request,response](pplx::task<void> loaded) mutable {
+          try{
+            loaded.get();
+          }catch(const std::exception e){
+            // server error.
+            granada::http::oauth2::OAuth2Parameters oauth2_response;
+            oauth2_response.error = oauth2_errors::server_error;
+            oauth2_response.error_description = oauth2_errors_description::server_error;
+            return oauth2_response;
+          }
+          return Grant(oauth2_client.get(),request,response);
+        });
+      }
+
+
+      pplx::task<void> OAuth2Authorization::LoadCredentialsAsync(granada::http::oauth2::OAuth2Client* oauth2_client, web::http::http_request& request, web::http::http_response& response){
+        // same cases as CheckCredentials, which checks what is loaded here.
+        if (oauth2_parameters_.grant_type == utility::conversions::to_utf8string(oauth2_strings::authorization_code)){
+          // the code and then the user the code was given to.
+          if (oauth2_parameters_.code.empty()){
+            return pplx::task_from_result();
+          }
+          oauth2_code_ = factory()->OAuth2Code_unique_ptr();
+          return oauth2_code_->LoadAsync(oauth2_parameters_.code).then([this](){
+            if (oauth2_code_->GetCode().empty()){
+              return pplx::task_from_result();
+            }
+            oauth2_user_ = factory()->OAuth2User_unique_ptr();
+            return oauth2_user_->LoadAsync(oauth2_code_->GetUsername());
+          });
+        }
+
+        if (!oauth2_parameters_.client_secret.empty() && !oauth2_client->CorrectCredentials(oauth2_parameters_.client_secret)){
+          return pplx::task_from_result();
+        }
+
+        if (!oauth2_parameters_.authorize.empty() && oauth2_parameters_.authorize == oauth2_strings_2::authorize){
+          // the session of the user, then the user logged in the session.
+          oauth2_user_session_ = session_factory()->Session_unique_ptr();
+          return oauth2_user_session_->LoadSessionAsync(request,response).then([this](bool loaded){
+            return oauth2_user_session_->roles()->GetPropertyAsync(entity_keys::oauth2_session_role,entity_keys::oauth2_session_role_username);
+          }).then([this](const std::string& username){
+            oauth2_parameters_.username = username;
+            if (username.empty()){
+              return pplx::task_from_result();
+            }
+            oauth2_user_ = factory()->OAuth2User_unique_ptr();
+            return oauth2_user_->LoadAsync(username);
+          });
+        }
+
+        if (!oauth2_parameters_.password.empty() && !oauth2_parameters_.username.empty()){
+          oauth2_user_ = factory()->OAuth2User_unique_ptr();
+          return oauth2_user_->LoadAsync(oauth2_parameters_.username);
+        }
+        return pplx::task_from_result();
+      }
+
+
+      granada::http::oauth2::OAuth2Parameters OAuth2Authorization::Grant(granada::http::oauth2::OAuth2Client* oauth2_client, web::http::http_request &request, web::http::http_response& response){
         granada::http::oauth2::OAuth2Parameters oauth2_response;
         try{
           // if grant_type=refresh_token use grant type code as we will use the same resources and
@@ -420,7 +590,6 @@ namespace granada{
           }
 
           // check client application validity.
-          std::unique_ptr<granada::http::oauth2::OAuth2Client> oauth2_client;
           CheckClient(oauth2_client,oauth2_response);
 
           if (oauth2_response.error.empty()){
@@ -438,14 +607,17 @@ namespace granada{
             // or user credentials, depending on the grant type and the
             // provided credentials.
 
+            // the ones loaded by GrantAsync are taken, the
+            // others are loaded when checking the credentials.
+
             // user, owner of the resources.
-            std::unique_ptr<granada::http::oauth2::OAuth2User> oauth2_user;
+            std::unique_ptr<granada::http::oauth2::OAuth2User> oauth2_user(std::move(oauth2_user_));
             // used in case the user provided a code as grant.
-            std::unique_ptr<granada::http::oauth2::OAuth2Code> oauth2_code;
+            std::unique_ptr<granada::http::oauth2::OAuth2Code> oauth2_code(std::move(oauth2_code_));
             // session of the user in the authorization server.
-            std::unique_ptr<granada::http::session::Session> oauth2_user_session;
+            std::unique_ptr<granada::http::session::Session> oauth2_user_session(std::move(oauth2_user_session_));
 
-            CheckCredentials(oauth2_client.get(),oauth2_user,oauth2_code,oauth2_user_session,oauth2_response,request,response);
+            CheckCredentials(oauth2_client,oauth2_user,oauth2_code,oauth2_user_session,oauth2_response,request,response);
 
             if (oauth2_response.error.empty()){
 
@@ -468,7 +640,7 @@ namespace granada{
               }
 
               // check if client is allowed to have the demanded scope/roles.
-              if (CheckRoleAllowance(roles, oauth2_client.get(), oauth2_user.get())){
+              if (CheckRoleAllowance(roles, oauth2_client, oauth2_user.get())){
 				  if (oauth2_parameters_.response_type == utility::conversions::to_utf8string(oauth2_strings::code)){
                   // respond with the requested code.
                   CreateCode(oauth2_user_session, oauth2_code, oauth2_user.get(),oauth2_response,request,response);
@@ -498,11 +670,9 @@ namespace granada{
       }
 
 
-      void OAuth2Authorization::CheckClient(std::unique_ptr<granada::http::oauth2::OAuth2Client>& oauth2_client,
+      void OAuth2Authorization::CheckClient(granada::http::oauth2::OAuth2Client* oauth2_client,
                                             granada::http::oauth2::OAuth2Parameters& oauth2_response){
 
-        // check if client is registered
-        oauth2_client = factory()->OAuth2Client_unique_ptr(oauth2_parameters_.client_id);
         if (oauth2_client->GetId().empty()){
           // Authorization error client is not valid.
           // Take the uri in the referer as the redirect uri.
@@ -556,13 +726,17 @@ namespace granada{
             oauth2_response.error_description = oauth2_errors_description::access_denied;
             return;
           }
-          oauth2_code = factory()->OAuth2Code_unique_ptr(oauth2_parameters_.code);
+          if (!oauth2_code){
+            oauth2_code = factory()->OAuth2Code_unique_ptr(oauth2_parameters_.code);
+          }
           if (oauth2_code->GetCode().empty()){
             oauth2_response.error = oauth2_errors::access_denied;
             oauth2_response.error_description = oauth2_errors_description::access_denied;
             return;
           }
-          oauth2_user = factory()->OAuth2User_unique_ptr(oauth2_code->GetUsername());
+          if (!oauth2_user){
+            oauth2_user = factory()->OAuth2User_unique_ptr(oauth2_code->GetUsername());
+          }
           if (oauth2_user->GetUsername().empty()){
             oauth2_response.error = oauth2_errors::access_denied;
             oauth2_response.error_description = oauth2_errors_description::access_denied;
@@ -577,9 +751,11 @@ namespace granada{
           }else{
             // check auth session credentials.
             if (!oauth2_parameters_.authorize.empty() && oauth2_parameters_.authorize == oauth2_strings_2::authorize){
-              oauth2_user_session = session_factory()->Session_unique_ptr(request,response);
-              // a session will only be retrieved if it's valid.
-              oauth2_parameters_.username = oauth2_user_session->roles()->GetProperty(entity_keys::oauth2_session_role,entity_keys::oauth2_session_role_username);
+              if (!oauth2_user_session){
+                oauth2_user_session = session_factory()->Session_unique_ptr(request,response);
+                // a session will only be retrieved if it's valid.
+                oauth2_parameters_.username = oauth2_user_session->roles()->GetProperty(entity_keys::oauth2_session_role,entity_keys::oauth2_session_role_username);
+              }
               if (oauth2_parameters_.username.empty()){
                 oauth2_user_session->Close();
                 oauth2_response.error = oauth2_errors::access_denied;
@@ -587,7 +763,9 @@ namespace granada{
                 return;
               }else{
                 // if user provided check if it exists.
-                oauth2_user = factory()->OAuth2User_unique_ptr(oauth2_parameters_.username);
+                if (!oauth2_user){
+                  oauth2_user = factory()->OAuth2User_unique_ptr(oauth2_parameters_.username);
+                }
                 if (oauth2_user->GetUsername().empty()){
                   // the user provided a username but the
                   // user with that username does not exists, do not continue.
@@ -604,7 +782,9 @@ namespace granada{
                 return;
               }else{
                 // if user provided check if it exists.
-                oauth2_user = factory()->OAuth2User_unique_ptr(oauth2_parameters_.username);
+                if (!oauth2_user){
+                  oauth2_user = factory()->OAuth2User_unique_ptr(oauth2_parameters_.username);
+                }
                 if (oauth2_user->GetUsername().empty() || !oauth2_user->CorrectCredentials(oauth2_parameters_.password)){
                   // the user provided a username but the
                   // user with that username does not exists, do not continue.
@@ -653,6 +833,8 @@ namespace granada{
 
         // set session roles
         AssignRolesToClientSession(roles,oauth2_user->GetRoles(),oauth2_client_session.get());
+        // client the session is given to, used to limit its requests.
+        oauth2_client_session->Write(entity_keys::oauth2_session_client_id,oauth2_parameters_.client_id);
         oauth2_response.access_token = oauth2_client_session->GetToken();
 		oauth2_response.token_type = utility::conversions::to_utf8string(oauth2_strings::bearer);
         oauth2_response.scope = oauth2_parameters_.scope;
@@ -348,10 +348,12 @@ namespace granada{
 
           /**
            * Returns the key of the data : that is the namespace and the identifier
+           * The key refers to the members of the entity, use it in the expression
+           * it is returned in, or keep it only while those members do not change.
            * @return Key of the entity values.
            */
-          virtual const std::string hash(){
-            return std::string();
+          virtual const granada::cache::CacheKey hash(){
+            return granada::cache::CacheKey();
           };
 
 
@@ -403,6 +405,17 @@ namespace granada{
           virtual void Load(const std::string& identifier) override;
 
 
+          /**
+           * Asynchronous version of Load(identifier), the values of the client
+           * are read from the cache without blocking the calling thread.
+           * The client must outlive the returned task.
+           * @param identifier Client id.
+           * @return           Task completed once the client is loaded, if it
+           *                   does not exist its id is empty.
+           */
+          virtual pplx::task<void> LoadAsync(const std::string& identifier);
+
+
           /**
            * Creates a new client and store it using the cache.
            * Client values will be stored with a key like: oauth2.client:value:myfNv849Z1GNuPAN.
@@ -505,12 +518,6 @@ namespace granada{
         protected:
 
 
-          /**
-           * Mutex for multithread safety.
-           */
-          static std::mutex oauth2_client_creation_mtx_;
-
-
           /**
            * Namespace of the key of the entity data in the cache.
            * Example:
@@ -597,10 +604,11 @@ namespace granada{
            * 			oauth2.client:value:myfNv849Z1GNuPAN
            * This is the key to retrieve the client values, such as its key, type, redirect URIs,
            * roles, creation time.
+           * The key refers to the client id, use it while the id does not change.
            * @return Key of the client values.
            */
-          virtual const std::string hash() override {
-            return cache_namespace_ + id_;
+          virtual const granada::cache::CacheKey hash() override {
+            return granada::cache::CacheKey(cache_namespace_, id_);
           };
 
       };
@@ -647,6 +655,17 @@ namespace granada{
           virtual void Load(const std::string& identifier) override;
 
 
+          /**
+           * Asynchronous version of Load(identifier), the values of the user
+           * are read from the cache without blocking the calling thread.
+           * The user must outlive the returned task.
+           * @param identifier Username.
+           * @return           Task completed once the user is loaded, if it
+           *                   does not exist its username is empty.
+           */
+          virtual pplx::task<void> LoadAsync(const std::string& identifier);
+
+
           /**
            * Creates an OAuth 2.0 user. This user should not be used for accessing resources,
            * this is used for authorization and authentication purposes.
@@ -708,11 +727,6 @@ namespace granada{
 
         protected:
 
-          /**
-           * Mutex for multithread safety.
-           */
-          static std::mutex oauth2_user_creation_mtx_;
-
 
           /**
            * Namespace of the key of the entity data in the cache.
@@ -764,10 +778,11 @@ namespace granada{
            * Example:
            * 			oauth2.user:value:johndoe
            * This is the key to retrieve the user values, such as its key, roles, creation time.
+           * The key refers to the username, use it while the username does not change.
            * @return Key of the OAuth 2.0 user values.
            */
-          virtual const std::string hash() override {
-            return cache_namespace_ + username_;
+          virtual const granada::cache::CacheKey hash() override {
+            return granada::cache::CacheKey(cache_namespace_, username_);
           };
 
       };
@@ -830,6 +845,17 @@ namespace granada{
           virtual void Load(const std::string& identifier) override;
 
 
+          /**
+           * Asynchronous version of Load(identifier), the values of the code
+           * are read from the cache without blocking the calling thread.
+           * The code must outlive the returned task.
+           * @param identifier Unique alphanumeric code.
+           * @return           Task completed once the code is loaded, if it
+           *                   does not exist or has timed out its code is empty.
+           */
+          virtual pplx::task<void> LoadAsync(const std::string& identifier);
+
+
           /**
            * Creates an OAuth 2.0 user. This user should not be used for accessing resources,
            * this is used for authorization and authentication purposes.
@@ -878,11 +904,6 @@ namespace granada{
 
         protected:
 
-          /**
-           * Mutex for multithread safety.
-           */
-          static std::mutex oauth2_code_creation_mtx_;
-
 
           /**
            * Namespace of the key of the entity data in the cache.
@@ -899,6 +920,14 @@ namespace granada{
           static int code_length_;
 
 
+          /**
+           * Seconds the code can be used after its creation,
+           * -1 if it never expires. It is taken from the "oauth2_code_timeout"
+           * property, if not found default_numbers::oauth2_code_timeout is taken.
+           */
+          static long code_timeout_;
+
+
           /**
            * Alphanumeric unique code.
            */
@@ -946,10 +975,11 @@ namespace granada{
            * 			oauth2.code:value:RQlUIgDxgCaTO8CLhAxNzveNtCHPQFrf
            * This is the key to retrieve the code values, such as its client_id, username,
            * roles, creation time.
+           * The key refers to the code, use it while the code does not change.
            * @return Key of the OAuth 2.0 code values.
            */
-          virtual const std::string hash() override {
-            return cache_namespace_ + code_;
+          virtual const granada::cache::CacheKey hash() override {
+            return granada::cache::CacheKey(cache_namespace_, code_);
           };
 
       };
@@ -984,6 +1014,19 @@ namespace granada{
           virtual granada::http::oauth2::OAuth2Parameters Grant(web::http::http_request &request, web::http::http_response& response);
 
 
+          /**
+           * Asynchronous version of Grant, the client, the code, the user and
+           * the session of the user are loaded without blocking and the grant
+           * is processed in a continuation. The code or the access token are
+           * written by that continuation.
+           * The authorization must outlive the returned task.
+           * @param  request  HTTP request.
+           * @param  response HTTP response;
+           * @return          Task resolving to the OAuth 2.0 parameters containing the response.
+           */
+          virtual pplx::task<granada::http::oauth2::OAuth2Parameters> GrantAsync(web::http::http_request &request, web::http::http_response& response);
+
+
           /**
            * Returns information about the clients authorized by a given user
            * or the codes used by a client to obtain access_tokens. The username and
@@ -1039,6 +1082,16 @@ namespace granada{
           granada::http::oauth2::OAuth2Parameters oauth2_parameters_;
 
 
+          /**
+           * User, code and session of the user loaded without blocking by
+           * GrantAsync, the grant uses them instead of loading them again.
+           * Empty when they are not needed or the grant is synchronous.
+           */
+          std::unique_ptr<granada::http::oauth2::OAuth2User> oauth2_user_;
+          std::unique_ptr<granada::http::oauth2::OAuth2Code> oauth2_code_;
+          std::unique_ptr<granada::http::session::Session> oauth2_user_session_;
+
+
           /**
            * @override
            * Loads properties given in the configuration file, if properties
@@ -1059,22 +1112,50 @@ namespace granada{
            * 			oauth2.authorization:johndoe:gida8fZEFh9abpkg:Gkt2DkEv94jXLhOV7ezd8tdTro2qwOnjNM30hAAJrNPDllUBnzk9cxsIfMA1ecsY:
            * 		Implicit Grant:
            * 			oauth2.authorization:johndoe:gida8fZEFh9abpkg::Gkt2DkEv94jXLhOV7ezd8tdTro2qwOnjNM30hAAJrNPDllUBnzk9cxsIfMA1ecs52
+           * The key refers to the OAuth 2.0 parameters, use it while they do not change.
            * @return Key made with the user, the client, the code and the session identifiers.
            */
-          virtual const std::string hash() override {
-            return cache_namespace_ + oauth2_parameters_.username + ":" + oauth2_parameters_.client_id + ":" + oauth2_parameters_.code + ":" + oauth2_parameters_.access_token;
+          virtual const granada::cache::CacheKey hash() override {
+            return granada::cache::CacheKey(cache_namespace_, oauth2_parameters_.username, oauth2_parameters_.client_id, oauth2_parameters_.code, oauth2_parameters_.access_token);
           };
 
 
+          /**
+           * Process Grant code authorization, Implicit grant, access token request
+           * with an already loaded client.
+           * @param  oauth2_client OAuth 2.0 client with the client_id of the parameters.
+           * @param  request       HTTP request.
+           * @param  response      HTTP response;
+           * @return               OAuth 2.0 parameters containing the response: error, code or access token.
+           */
+          virtual granada::http::oauth2::OAuth2Parameters Grant(granada::http::oauth2::OAuth2Client* oauth2_client, web::http::http_request &request, web::http::http_response& response);
+
+
+          /**
+           * Loads without blocking the code, the user and the session of the
+           * user that CheckCredentials checks for the grant type and the
+           * provided credentials, in oauth2_code_, oauth2_user_ and
+           * oauth2_user_session_. The username read from the session is set
+           * in the parameters.
+           * The authorization must outlive the returned task.
+           * @param  oauth2_client  Loaded OAuth 2.0 client, nothing is loaded
+           *                        if its credentials are wrong.
+           * @param  request        HTTP request.
+           * @param  response       HTTP response.
+           * @return                Task completed once the credentials are loaded.
+           */
+          virtual pplx::task<void> LoadCredentialsAsync(granada::http::oauth2::OAuth2Client* oauth2_client, web::http::http_request& request, web::http::http_response& response);
+
+
           /**
            * Checks the validity of a client based on the client URI and the client id.
            * If something is wrong explicit it in oauth2_response filling the error and
            * the error_description members.
            *
-           * @param oauth2_client     OAuth 2.0 client.
+           * @param oauth2_client     Loaded OAuth 2.0 client.
            * @param oauth2_response   OAuth 2.0 parameters.
            */
-          virtual void CheckClient(std::unique_ptr<granada::http::oauth2::OAuth2Client>& oauth2_client,
+          virtual void CheckClient(granada::http::oauth2::OAuth2Client* oauth2_client,
                                     granada::http::oauth2::OAuth2Parameters& oauth2_response);
 
 
@@ -1087,12 +1168,14 @@ namespace granada{
            *
            * @param oauth2_client       OAuth 2.0 client. Used in case we need to check client credentials.
            * @param oauth2_user         OAuth 2.0 user. Used in case we need to check user credential.
+           *                            Loaded here unless it is already loaded.
            * @param oauth2_code         OAuth 2.0 code. Used in case a code has been provided and we need to
-           *                            check its validity.
+           *                            check its validity. Loaded here unless it is already loaded.
            * @param oauth2_user_session Session. In case the user has already provided his credentials before,
            *                            he is already "logged" in our system, we don't try to validate his credentials,
            *                            instead we check that his session is valid and retrieve the username from the
-           *                            session properties.
+           *                            session properties. Loaded here unless it is already loaded, the username
+           *                            of the parameters is then the one of the session.
            * @param oauth2_response     OAuth 2.0 parameters containing the response: error, code or access token.
            * @param request             HTTP request.
            * @param response            HTTP response.
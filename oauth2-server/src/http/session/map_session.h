@@ -29,6 +29,8 @@
 #include "util/mutex.h"
 #include "session.h"
 #include "cache/shared_map_cache_driver.h"
+#include "cache/shared_memory_cache_driver.h"
+#include "cache/cache_registry.h"
 
 namespace granada{
   namespace http{
@@ -252,7 +254,7 @@ namespace granada{
           /**
            * Pointer to the cache used to store the sessions' values.
            */
-          static std::unique_ptr<granada::cache::CacheHandler> cache_;
+          static std::shared_ptr<granada::cache::CacheHandler> cache_;
 
 
           /**
@@ -28,6 +28,10 @@ namespace granada{
   namespace http{
     namespace session{
 
+      // expression matching all the roles or values of the sessions,
+      // the keys refer to it so it cannot be a temporary.
+      static const std::string ALL_KEYS = "*";
+
 
 ////
 // static membesr of Session
@@ -37,7 +41,6 @@ namespace granada{
       std::string Session::application_session_token_support_;
       long Session::application_session_timeout_ = -1;
       long Session::session_garbage_extra_timeout_ = 0;
-      std::mutex Session::session_exists_mtx_;
 //
 ////
 
@@ -47,22 +50,17 @@ namespace granada{
         // from where it is stored, so its not used again.
         Close();
 
-        // generate token
-        token_.assign(session_handler()->GenerateToken());
-        Session::session_exists_mtx_.lock();
-        // check if session do not already exist.
-        if (session_handler()->SessionExists(token_)){
-          Session::session_exists_mtx_.unlock();
+        // generate a token no other session has,
+        // if a session with the token already exists try with another one.
+        do{
+          token_.assign(session_handler()->GenerateToken());
+        }while(!session_handler()->ReserveToken(token_));
 
-          // a session with this token already exist!
-          // repeat the process of opening a new session.
-          Open();
-        }else{
+        // a new session has no data nor roles to refresh.
+        refresh_time_ = std::time(nullptr);
 
-          // session is created, update it, for example the sesison update time.
-          Update();
-          Session::session_exists_mtx_.unlock();
-        }
+        // session is created, update it, for example the sesison update time.
+        Update();
       }
 
 
@@ -83,8 +81,32 @@ namespace granada{
         // set the update time to now.
         update_time_ = std::time(nullptr);
 
+        // the session data and roles expire with the session, they live
+        // half the session expiration longer so they only have to be
+        // refreshed when that half has passed.
+        const long expiration = session_handler()->SessionExpiration(this);
+        const bool refresh = expiration > -1 && !token_.empty() && update_time_ - refresh_time_ >= expiration / 2;
+        if (refresh){
+          refresh_time_ = update_time_;
+        }
+
         // save the session wherever all the sessions are stored.
         session_handler()->SaveSession(this);
+
+        if (refresh){
+          session_handler()->cache()->Expire(session_data_hash(), expiration + expiration / 2);
+          roles()->Expire(expiration + expiration / 2);
+        }
+      }
+
+
+      const long Session::ValuesTimeToLive(){
+        const long expiration = session_handler()->SessionExpiration(this);
+        if (expiration < 0){
+          return -1;
+        }
+        // as long as the values refreshed last.
+        return (long)(refresh_time_ + expiration + expiration / 2 - std::time(nullptr));
       }
 
 
@@ -134,6 +156,18 @@ namespace granada{
       }
 
 
+      const long Session::GetGarbageTimeout(){
+        if (application_session_timeout() < 0){
+          return -1;
+        }
+        const long garbage_timeout = GetSessionTimeout() + session_garbage_extra_timeout();
+        if (garbage_timeout < 0){
+          return 0;
+        }
+        return garbage_timeout;
+      }
+
+
       const std::string Session::Read(const std::string& key){
         if (!key.empty() && !token_.empty()){
           Update();
@@ -144,8 +178,13 @@ namespace granada{
 
       void Session::Write(const std::string& key, const std::string& value){
         if (!key.empty() && !token_.empty()){
-          session_handler()->cache()->Write(session_data_hash(),key, value);
           Update();
+          const long ttl = ValuesTimeToLive();
+          if (ttl > -1){
+            session_handler()->cache()->WriteWithTTL(session_data_hash(),key, value, ttl);
+          }else{
+            session_handler()->cache()->Write(session_data_hash(),key, value);
+          }
         }
       }
 
@@ -278,6 +317,71 @@ namespace granada{
       }
 
 
+      pplx::task<bool> Session::LoadSessionAsync(const std::string& token){
+        if (token.empty()){
+          return pplx::task_from_result(false);
+        }
+        return session_handler()->LoadSessionAsync(token,this).then([this](){
+          if (!token_.empty()){
+            Update();
+            return true;
+          }
+          return false;
+        });
+      }
+
+
+      pplx::task<bool> Session::LoadSessionAsync(const web::http::http_request &request,web::http::http_response &response){
+        if (session_token_support_.empty()){
+          if (application_session_token_support().empty()){
+            // request token by default
+            session_token_support_ = Session::DEFAULT_SESSIONS_TOKEN_SUPPORT[0];
+          }else{
+            session_token_support_ = application_session_token_support();
+          }
+        }
+
+        // search and retrieve token from cookies.
+        if (session_token_support_ == entity_keys::session_cookie){
+          std::string token;
+          const std::unordered_map<std::string, std::string>& cookies = granada::http::parser::ParseCookies(request);
+          auto it = cookies.find(token_label());
+          if (it != cookies.end()){
+            token = it->second;
+          }
+          // http_response shares its content between copies,
+          // the cookie of an opened session reaches the reply.
+          return LoadSessionAsync(token).then([this,response](bool session_exists) mutable {
+            if(!session_exists){
+              Open(response);
+            }
+            return true;
+          });
+        }
+
+        // retrieve token from body json.
+        if (session_token_support_ == entity_keys::session_json){
+          return request.extract_json().then([this](pplx::task<web::json::value> extracted){
+            std::string token;
+            try{
+              token = granada::util::json::as_string(extracted.get(),token_label());
+            }catch(const std::exception e){}
+            return LoadSessionAsync(token);
+          });
+        }
+
+        // retrieve token from query string.
+        if (session_token_support_ == entity_keys::session_query){
+          const std::string& query_string = utility::conversions::to_utf8string(request.request_uri().query());
+          try{
+            std::unordered_map<std::string, std::string> parsed_query = granada::http::parser::ParseQueryString(query_string);
+            return LoadSessionAsync(parsed_query[token_label()]);
+          }catch(const std::exception e){}
+        }
+        return pplx::task_from_result(false);
+      }
+
+
 
 
       const bool SessionRoles::Is(const std::string& role_name){
@@ -288,8 +392,13 @@ namespace granada{
       const bool SessionRoles::Add(const std::string& role_name){
         // add only if role is not already added.
         if (!Is(role_name)){
-          session_->session_handler()->cache()->Write(session_roles_hash(role_name), "0", "0");
           session_->Update();
+          const long ttl = session_->ValuesTimeToLive();
+          if (ttl > -1){
+            session_->session_handler()->cache()->WriteWithTTL(session_roles_hash(role_name), "0", "0", ttl);
+          }else{
+            session_->session_handler()->cache()->Write(session_roles_hash(role_name), "0", "0");
+          }
           return true;
         }
         return false;
@@ -303,14 +412,21 @@ namespace granada{
 
 
       void SessionRoles::RemoveAll(){
-        Remove("*");
+        // one pass over the roles of the session instead of
+        // matching them first and removing them one by one.
+        session_->session_handler()->cache()->DestroyMatch(session_roles_hash(ALL_KEYS));
         session_->Update();
       }
 
 
       void SessionRoles::SetProperty(const std::string& role_name, const std::string& key, const std::string& value){
-        session_->session_handler()->cache()->Write(session_roles_hash(role_name), key, value);
         session_->Update();
+        const long ttl = session_->ValuesTimeToLive();
+        if (ttl > -1){
+          session_->session_handler()->cache()->WriteWithTTL(session_roles_hash(role_name), key, value, ttl);
+        }else{
+          session_->session_handler()->cache()->Write(session_roles_hash(role_name), key, value);
+        }
       }
 
 
@@ -319,12 +435,26 @@ namespace granada{
       }
 
 
+      pplx::task<std::string> SessionRoles::GetPropertyAsync(const std::string& role_name, const std::string& key){
+        return session_->session_handler()->cache()->ReadAsync(session_roles_hash(role_name), key);
+      }
+
+
       void SessionRoles::DestroyProperty(const std::string& role_name, const std::string& key){
         session_->session_handler()->cache()->Destroy(session_roles_hash(role_name), key);
         session_->Update();
       }
 
 
+      void SessionRoles::Expire(const long& seconds){
+        granada::cache::CacheHandler* cache = session_->session_handler()->cache();
+        std::unique_ptr<granada::cache::CacheHandlerIterator> cache_iterator = cache->make_iterator(session_roles_hash(ALL_KEYS));
+        while (cache_iterator->has_next()){
+          cache->Expire(cache_iterator->next(), seconds);
+        }
+      }
+
+
 
 
       int SessionHandler::token_length_ = 32;
@@ -339,6 +469,30 @@ namespace granada{
       }
 
 
+      pplx::task<void> SessionHandler::LoadSessionAsync(const std::string& token, granada::http::session::Session* virgin){
+        if (token.empty()){
+          return pplx::task_from_result();
+        }
+        return cache()->ReadManyAsync(session_value_hash(token), { entity_keys::session_update_time, entity_keys::session_refresh_time }).then([token,virgin](const std::vector<std::string>& values){
+          std::vector<std::string> session_values(values);
+          session_values.resize(2);
+          virgin->set(token,granada::util::time::parse(session_values[0]));
+          virgin->SetRefreshTime(granada::util::time::parse(session_values[1]));
+          if (!virgin->IsValid()){
+            virgin->set("",0);
+          }
+        });
+      }
+
+
+      const bool SessionHandler::ReserveToken(const std::string& token){
+        if (!token.empty()){
+          return cache()->WriteIfNotExists(session_value_hash(token), entity_keys::session_token, token);
+        }
+        return false;
+      }
+
+
       const std::string SessionHandler::GenerateToken(){
         return nonce_generator()->generate(token_length());
       }
@@ -346,8 +500,11 @@ namespace granada{
 
       void SessionHandler::LoadSession(const std::string& token, granada::http::session::Session* virgin){
         if (!token.empty()){
-          const time_t& update_time = granada::util::time::parse(cache()->Read(session_value_hash(token), entity_keys::session_update_time));
-          virgin->set(token,update_time);
+          std::vector<std::string> values;
+          cache()->ReadMany(session_value_hash(token), { entity_keys::session_update_time, entity_keys::session_refresh_time }, values);
+          values.resize(2);
+          virgin->set(token,granada::util::time::parse(values[0]));
+          virgin->SetRefreshTime(granada::util::time::parse(values[1]));
           if (!virgin->IsValid()){
             virgin->set("",0);
           }
@@ -358,9 +515,17 @@ namespace granada{
       void SessionHandler::SaveSession(granada::http::session::Session* session){
         const std::string& token = session->GetToken();
         if (!token.empty()){
-          const std::string& hash = session_value_hash(token);
-          cache()->Write(hash, entity_keys::session_token, token);
-          cache()->Write(hash, entity_keys::session_update_time, granada::util::time::stringify(session->GetUpdateTime()));
+          const std::vector<std::pair<std::string,std::string>> values = {
+            { entity_keys::session_token, token },
+            { entity_keys::session_update_time, granada::util::time::stringify(session->GetUpdateTime()) },
+            { entity_keys::session_refresh_time, granada::util::time::stringify(session->GetRefreshTime()) }
+          };
+          const long expiration = SessionExpiration(session);
+          if (expiration > -1){
+            cache()->WriteManyWithTTL(session_value_hash(token), values, expiration);
+          }else{
+            cache()->WriteMany(session_value_hash(token), values);
+          }
         }
       }
 
@@ -374,13 +539,24 @@ namespace granada{
 
 
       void SessionHandler::CleanSessions(){
-        const std::unique_ptr<granada::cache::CacheHandlerIterator>& cache_iterator = cache()->make_iterator(session_value_hash("*"));
+        if (cache()->SupportsExpire()){
+          // garbage sessions are removed by the cache, they only
+          // need to be closed here if there are close callbacks to call.
+          const std::unique_ptr<granada::http::session::Session>& session = factory()->Session_unique_ptr();
+          granada::Functions* close_callbacks = session->close_callbacks();
+          if (close_callbacks == nullptr || !close_callbacks->make_iterator()->has_next()){
+            return;
+          }
+        }
+        const std::unique_ptr<granada::cache::CacheHandlerIterator>& cache_iterator = cache()->make_iterator(session_value_hash(ALL_KEYS));
         while(cache_iterator->has_next()){
           const std::string& key = cache_iterator->next();
-          const std::string& token = cache()->Read(key, entity_keys::session_token);
+          std::vector<std::string> values;
+          if (!cache()->ReadMany(key, { entity_keys::session_token, entity_keys::session_update_time }, values)){
+            continue;
+          }
           const std::unique_ptr<granada::http::session::Session>& session = factory()->Session_unique_ptr();
-          const time_t& update_time = granada::util::time::parse(cache()->Read(key, entity_keys::session_update_time));
-          session->set(token,update_time);
+          session->set(values[0],granada::util::time::parse(values[1]));
           if (session->IsGarbage()){
             session->Close();
           }
@@ -388,6 +564,21 @@ namespace granada{
       }
 
 
+      const long SessionHandler::SessionExpiration(granada::http::session::Session* session){
+        if (!cache()->SupportsExpire()){
+          return -1;
+        }
+        long expiration = session->GetGarbageTimeout();
+        if (expiration > -1 && clean_sessions_frequency() > -1){
+          granada::Functions* close_callbacks = session->close_callbacks();
+          if (close_callbacks != nullptr && close_callbacks->make_iterator()->has_next()){
+            expiration += (long)clean_sessions_frequency();
+          }
+        }
+        return expiration;
+      }
+
+
       void SessionHandler::LoadProperties(){
         const std::string& clean_sessions_frequency_str(granada::util::application::GetProperty(entity_keys::session_clean_frequency));
         if (clean_sessions_frequency_str.empty()){
@@ -205,6 +205,15 @@ namespace granada{
           virtual const long GetSessionTimeout();
 
 
+          /**
+           * Returns the number of seconds until the session is
+           * considered garbage if it is not used.
+           * @return Seconds until the session is garbage, -1 if
+           *         the session never times out.
+           */
+          virtual const long GetGarbageTimeout();
+
+
           /**
            * Write session data.
            * @param key   Key or name of the data.
@@ -275,6 +284,35 @@ namespace granada{
           };
 
 
+          /**
+           * Returns the last time the time to live of the session
+           * data and roles was refreshed.
+           * @return Last refresh time, 0 if never refreshed.
+           */
+          virtual const std::time_t& GetRefreshTime(){
+            return refresh_time_;
+          };
+
+
+          /**
+           * Sets the last time the time to live of the session
+           * data and roles was refreshed.
+           */
+          virtual void SetRefreshTime(const std::time_t& refresh_time){
+            refresh_time_ = refresh_time;
+          };
+
+
+          /**
+           * Returns the seconds a set of the session data or roles has
+           * to live in the cache when it is written, so it does not
+           * expire before the session. The set is written with this
+           * time to live in the same operation, after Update.
+           * @return  Seconds to live, -1 if the values never expire.
+           */
+          virtual const long ValuesTimeToLive();
+
+
           /**
            * Returns a pointer to the roles of a session.
            * @return Pointer to the roles of the session.
@@ -305,6 +343,33 @@ namespace granada{
           };
 
 
+          /**
+           * Asynchronous version of LoadSession(request,response), the token
+           * is retrieved from the HTTP request and the session is read from
+           * the cache without blocking the calling thread. If session does not
+           * exist and the token is stored in a cookie, a new session is opened.
+           * The session must outlive the returned task.
+           *
+           * @param  request  Http request.
+           * @param  response Http response.
+           * @return          Task resolving to true if session has been retrieved
+           *                  or created successfuly.
+           */
+          virtual pplx::task<bool> LoadSessionAsync(const web::http::http_request &request,web::http::http_response &response);
+
+
+          /**
+           * Asynchronous version of LoadSession(token), the session
+           * is read from the cache without blocking the calling thread.
+           * The session must outlive the returned task.
+           * Use it on a session returned by SessionFactory::Session_unique_ptr().
+           *
+           * @param token Session token.
+           * @return      Task resolving to true if session has been retrieved successfuly.
+           */
+          virtual pplx::task<bool> LoadSessionAsync(const std::string& token);
+
+
         protected:
 
           /**
@@ -315,14 +380,6 @@ namespace granada{
           static std::vector<std::string> DEFAULT_SESSIONS_TOKEN_SUPPORT;
 
 
-          /**
-           * Mutex used when performing an action after 
-           * checking that a session exists, for example when opening
-           * a session.
-           */
-          static std::mutex session_exists_mtx_;
-
-
           /**
            * The name of the cookie or the key where the token value
            * is stored. This value is taken from the "session_token_label"
@@ -383,6 +440,14 @@ namespace granada{
           std::time_t update_time_;
 
 
+          /**
+           * Last time the time to live of the session data and roles
+           * was refreshed, they are only refreshed once half of it has
+           * passed instead of on each use of the session.
+           */
+          std::time_t refresh_time_ = 0;
+
+
           /**
            * Method that loads the session properties: token label,
            * token support, session timout...
@@ -431,10 +496,12 @@ namespace granada{
 
           /**
            * Returns the key to identify the session data
-           * in the cache.
+           * in the cache. The key refers to the token of the session,
+           * use it in the expression it is returned in, as in
+           * cache()->Read(session_data_hash(),key), do not keep it.
            */
-          virtual const std::string session_data_hash(){
-            return cache_namespaces::session_data + token_;
+          virtual const granada::cache::CacheKey session_data_hash(){
+            return granada::cache::CacheKey(cache_namespaces::session_data, token_);
           };
 
 
@@ -566,6 +633,17 @@ namespace granada{
           virtual const std::string GetProperty(const std::string& role_name, const std::string& key);
 
 
+          /**
+           * Asynchronous version of GetProperty, the property is read
+           * from the cache without blocking the calling thread.
+           * The session must outlive the returned task.
+           * @param  role_name Role name.
+           * @param  key       Key or name of the property.
+           * @return           Task resolving to the value of the property.
+           */
+          virtual pplx::task<std::string> GetPropertyAsync(const std::string& role_name, const std::string& key);
+
+
           /**
            * Remove a role property.
            * @param role_name Role name.
@@ -574,6 +652,14 @@ namespace granada{
           virtual void DestroyProperty(const std::string& role_name, const std::string& key);
 
 
+          /**
+           * Sets the time to live of all the roles in the cache,
+           * so they are removed with the session.
+           * @param seconds Seconds the roles will live from now.
+           */
+          virtual void Expire(const long& seconds);
+
+
         protected:
 
           /**
@@ -584,13 +670,20 @@ namespace granada{
 
           /**
            * Returns the key to access a role data.
+           * The key refers to the token and to role_name, use it in
+           * the expression it is returned in, do not keep it.
+           * Temporary role names are not accepted.
            * 
            * @param role_name Name of the role.
            * @return          Returns the key to access a role data.
            */
-          virtual const std::string session_roles_hash(const std::string& role_name){
-            return cache_namespaces::session_roles + session_->GetToken() + ":" + role_name;
+          virtual const granada::cache::CacheKey session_roles_hash(const std::string& role_name){
+            return granada::cache::CacheKey(cache_namespaces::session_roles, session_->GetToken(), role_name);
           };
+
+          const granada::cache::CacheKey session_roles_hash(std::string&& role_name) = delete;
+
+          const granada::cache::CacheKey session_roles_hash(const std::string&& role_name) = delete;
       };
 
 
@@ -617,6 +710,17 @@ namespace granada{
           virtual const bool SessionExists(const std::string& token);
 
 
+          /**
+           * Reserves a token for a new session wherever sessions are stored,
+           * checking and writing it as one operation so two sessions
+           * never get the same token.
+           * @param  token Token of the new session.
+           * @return       true if the token has been reserved, false if a
+           *               session with this token already exists.
+           */
+          virtual const bool ReserveToken(const std::string& token);
+
+
           /**
            * Generate a new unique token.
            * @return Generated Token.
@@ -633,6 +737,15 @@ namespace granada{
           virtual void LoadSession(const std::string& token, granada::http::session::Session* virgin);
 
 
+          /**
+           * Asynchronous version of LoadSession, the returned task
+           * completes once the value has been assigned to the virgin session.
+           * @param token  Token of the session to search.
+           * @param virgin Pointer of the virgin session, must outlive the task.
+           */
+          virtual pplx::task<void> LoadSessionAsync(const std::string& token, granada::http::session::Session* virgin);
+
+
           /**
            * Insert or replace a session wherever the sessions are stored.
            * @param session Pointer to Session to save.
@@ -655,6 +768,19 @@ namespace granada{
           virtual void CleanSessions();
 
 
+          /**
+           * Returns the seconds the values of a session have to live in the cache
+           * from now, so the cache removes them by itself when the session is garbage.
+           * If the session has close callbacks and the sessions are cleaned, the
+           * cleaning frequency is added, so the session is closed by CleanSessions
+           * and its close callbacks are called before the cache removes it.
+           * @param session Session.
+           * @return        Seconds to live, -1 if the values never expire or if the
+           *                cache does not support expiration.
+           */
+          virtual const long SessionExpiration(granada::http::session::Session* session);
+
+
           /**
            * Returns a pointer to the cache handler used to store the sessions data.
            * @return Pointer to the cache handler used to store the sessions data.
@@ -732,13 +858,19 @@ namespace granada{
 
           /**
            * Returns the key used to identify the session data in the cache.
+           * The key refers to token, use it in the expression it is
+           * returned in, do not keep it. Temporary tokens are not accepted.
            * 
            * @param token Session token.
            * @return      Key used to identify the session data in the cache.
            */
-          virtual const std::string session_value_hash(const std::string& token){
-            return cache_namespaces::session_value + token;
+          virtual const granada::cache::CacheKey session_value_hash(const std::string& token){
+            return granada::cache::CacheKey(cache_namespaces::session_value, token);
           }
+
+          const granada::cache::CacheKey session_value_hash(std::string&& token) = delete;
+
+          const granada::cache::CacheKey session_value_hash(const std::string&& token) = delete;
       };
 
 
@@ -0,0 +1,124 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Checks that writing, reading and destroying a field of a hash of the
+  * shared map cache allocates the same whatever the number of fields
+  * of the hash, the field being changed in place.
+  *
+  *   build/cache_allocation_test
+  *
+  */
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include "harness.h"
+#include "cache/shared_map_cache_driver.h"
+
+static std::atomic<long long> allocations(0);
+
+void* operator new(std::size_t size){
+  ++allocations;
+  void* pointer = std::malloc(size == 0 ? 1 : size);
+  if (pointer == nullptr){
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void operator delete(void* pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+
+
+/**
+ * Allocations of each operation on a field of a hash.
+ */
+struct FieldAllocations{
+  long long write;
+  long long write_moved;
+  long long read;
+  long long destroy;
+};
+
+
+/**
+ * Returns the allocations of the operations on one field
+ * of a hash with the given number of fields.
+ * @param fields  Number of fields of the hash.
+ */
+static FieldAllocations Measure(const int& fields){
+  granada::cache::SharedMapCacheDriver cache(1);
+  const std::string hash = "session:roles:token:admin";
+  for (int i = 0; i < fields; ++i){
+    cache.Write(hash, "property." + std::to_string(i), "value of the property " + std::to_string(i));
+  }
+  const std::string field = "property." + std::to_string(fields / 2);
+  const std::string value = "a value longer than the small string buffer";
+  std::string moved;
+  FieldAllocations measured;
+
+  // the second write of each operation is measured,
+  // the first one leaves the field as it is later.
+  cache.Write(hash, field, value);
+  long long before = allocations;
+  cache.Write(hash, field, value);
+  measured.write = allocations - before;
+
+  moved = value;
+  before = allocations;
+  cache.Write(hash, field, std::move(moved));
+  measured.write_moved = allocations - before;
+
+  before = allocations;
+  GRANADA_CHECK(cache.Read(hash, field) == value);
+  measured.read = allocations - before;
+
+  cache.Destroy(hash, field);
+  cache.Write(hash, field, value);
+  before = allocations;
+  cache.Destroy(hash, field);
+  measured.destroy = allocations - before;
+  return measured;
+}
+
+
+int main(){
+  const FieldAllocations base = Measure(5);
+  std::cout << "fields  write  write moved  read  destroy" << std::endl;
+  for (int fields = 5; fields <= 500; fields *= 10){
+    const FieldAllocations measured = Measure(fields);
+    std::cout << fields << "  " << measured.write << "  " << measured.write_moved << "  " << measured.read << "  " << measured.destroy << std::endl;
+    GRANADA_CHECK(measured.write == base.write);
+    GRANADA_CHECK(measured.write_moved == base.write_moved);
+    GRANADA_CHECK(measured.read == base.read);
+    GRANADA_CHECK(measured.destroy == base.destroy);
+  }
+  std::cout << "ok" << std::endl;
+  return 0;
+}
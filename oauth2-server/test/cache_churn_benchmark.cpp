@@ -0,0 +1,105 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Churn benchmark of the allocators of the shared map cache: rounds
+  * replacing every live session by a new one with a random number of
+  * fields of random sizes, with the containers allocating from the
+  * heap and from the slab arenas of the shards. The resident memory
+  * and the statistics of the arenas are printed after each round;
+  * each allocator is measured in its own process.
+  *
+  *   build/cache_churn_benchmark [rounds] [sessions]
+  *
+  */
+
+#include <iomanip>
+#include <random>
+#include <string>
+#include <sys/wait.h>
+#include <vector>
+#include "harness.h"
+#include "cache/shared_map_cache_driver.h"
+
+// fields a session can have.
+static const std::vector<std::string> FIELDS = {
+  "session.token", "session.update.time", "username", "client_id", "scope",
+  "state", "redirect_uri", "roles", "lang", "ip"
+};
+
+
+/**
+ * Runs the churn rounds and prints the memory after each one.
+ * @param slab      Use the slab arenas.
+ * @param rounds    Number of rounds.
+ * @param sessions  Number of live sessions.
+ */
+static void Churn(const bool& slab, const int& rounds, const int& sessions){
+  granada::cache::SharedMapCacheDriver cache(16, slab);
+  std::mt19937 generator(7);
+  std::vector<std::string> live(sessions);
+  std::vector<std::pair<std::string,std::string>> values;
+  long long id = 0;
+
+  std::cout << (slab ? "slab" : "heap") << std::endl;
+  std::cout << "round  rss (MB)  allocated (MB)  reserved (MB)  fragmentation  occupancy" << std::endl;
+  for (int round = 0; round < rounds; ++round){
+    for (int i = 0; i < sessions; ++i){
+      if (!live[i].empty()){
+        cache.Destroy(live[i]);
+      }
+      live[i] = "session:value:" + std::to_string(id++);
+      values.clear();
+      const int fields = 2 + generator() % 9;
+      for (int field = 0; field < fields; ++field){
+        values.push_back(std::make_pair(FIELDS[field], std::string(generator() % 40, 'v')));
+      }
+      cache.WriteMany(live[i], values);
+    }
+    const granada::cache::SharedMapCacheStats stats = cache.Stats();
+    GRANADA_CHECK(stats.keys == (std::size_t)sessions);
+    std::cout << std::setw(5) << round
+              << std::setw(10) << granada::test::Rss() / 1048576
+              << std::setw(16) << stats.allocated_bytes / 1048576
+              << std::setw(15) << stats.reserved_bytes / 1048576
+              << std::setw(15) << std::fixed << std::setprecision(3) << stats.fragmentation
+              << std::setw(11) << stats.slab_occupancy << std::endl;
+  }
+}
+
+
+int main(int argc, char* argv[]){
+  const int rounds = argc > 1 ? std::atoi(argv[1]) : 20;
+  const int sessions = argc > 2 ? std::atoi(argv[2]) : 100000;
+
+  for (const bool slab : { false, true }){
+    const pid_t pid = fork();
+    if (pid == 0){
+      Churn(slab, rounds, sessions);
+      return 0;
+    }
+    int status = 0;
+    GRANADA_CHECK(pid > 0 && waitpid(pid, &status, 0) == pid);
+    GRANADA_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+  return 0;
+}
@@ -0,0 +1,136 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Benchmark of the compression of the cache values: resident memory
+  * and CPU time of writing and reading long messages through the
+  * compressed cache driver, without compression, with the LZ codec
+  * and with zlib. Each codec is measured in its own process.
+  *
+  *   build/cache_compression_benchmark [messages] [bytes per message]
+  *
+  */
+
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <string>
+#include <sys/wait.h>
+#include <vector>
+#include "harness.h"
+#include "cache/compressed_cache_driver.h"
+#include "cache/shared_map_cache_driver.h"
+
+// words of the messages.
+static const std::vector<std::string> WORDS = {
+  "the", "session", "token", "was", "refreshed", "after", "user", "client",
+  "message", "scope", "read", "write", "admin", "roles", "expired", "request",
+  "\"id\":", "\"text\":", "{", "},", "and", "of", "to", "in", "granada"
+};
+
+
+/**
+ * Returns a message of about the given length made of random words and numbers.
+ * @param generator Random generator.
+ * @param length    Length of the message.
+ */
+static std::string Text(std::mt19937& generator, const std::size_t& length){
+  std::string text;
+  while (text.length() < length){
+    text += WORDS[generator() % WORDS.size()];
+    text += generator() % 5 == 0 ? std::to_string(generator() % 100000) + " " : " ";
+  }
+  text.resize(length);
+  return text;
+}
+
+
+/**
+ * Writes and reads the messages with a codec and prints the results.
+ * @param codec     Codec.
+ * @param name      Name of the codec.
+ * @param messages  Number of messages.
+ * @param length    Bytes per message.
+ */
+static void Run(const granada::cache::CacheCodec::Type& codec, const std::string& name, const int& messages, const std::size_t& length){
+  std::mt19937 generator(7);
+  std::vector<std::string> texts;
+  for (int i = 0; i < 100; ++i){
+    texts.push_back(Text(generator, length));
+  }
+
+  const long long before = granada::test::Rss();
+  std::map<std::string,granada::cache::CacheCodec::Type> namespaces;
+  if (codec != granada::cache::CacheCodec::NONE){
+    namespaces["message:"] = codec;
+  }
+  granada::cache::CompressedCacheDriver cache(std::unique_ptr<granada::cache::CacheHandler>(new granada::cache::SharedMapCacheDriver()), namespaces, 256);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < messages; ++i){
+    cache.Write("message:user:" + std::to_string(i), "text", texts[i % texts.size()]);
+  }
+  const double write_seconds = granada::test::Seconds(start);
+  const long long bytes = granada::test::Rss() - before;
+
+  std::size_t read = 0;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < messages; ++i){
+    read += cache.Read("message:user:" + std::to_string(i), "text").size();
+  }
+  const double read_seconds = granada::test::Seconds(start);
+  GRANADA_CHECK(read == messages * length);
+
+  const granada::cache::CompressedCacheStats stats = cache.Stats();
+  const double ratio = stats.bytes == 0 ? 1 : (double)stats.compressed_bytes / stats.bytes;
+  std::cout << std::left << std::setw(6) << name << std::right
+            << std::setw(10) << bytes / 1048576
+            << std::setw(8) << std::fixed << std::setprecision(2) << ratio
+            << std::setw(12) << std::setprecision(0) << write_seconds * 1e9 / messages
+            << std::setw(11) << read_seconds * 1e9 / messages << std::endl;
+}
+
+
+int main(int argc, char* argv[]){
+  const int messages = argc > 1 ? std::atoi(argv[1]) : 200000;
+  const std::size_t length = argc > 2 ? std::atoi(argv[2]) : 2048;
+
+  std::cout << messages << " messages of " << length << " bytes" << std::endl;
+  std::cout << "codec  rss (MB)   ratio  write (ns)  read (ns)" << std::endl;
+  const std::vector<std::pair<granada::cache::CacheCodec::Type,std::string>> codecs = {
+    { granada::cache::CacheCodec::NONE, "none" },
+    { granada::cache::CacheCodec::LZ, "lz" },
+    { granada::cache::CacheCodec::ZLIB, "zlib" }
+  };
+  for (auto it = codecs.begin(); it != codecs.end(); ++it){
+    std::cout.flush();
+    const pid_t pid = fork();
+    if (pid == 0){
+      Run(it->first, it->second, messages, length);
+      return 0;
+    }
+    int status = 0;
+    GRANADA_CHECK(pid > 0 && waitpid(pid, &status, 0) == pid);
+    GRANADA_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+  return 0;
+}
@@ -0,0 +1,120 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Contention benchmark of the shared map cache reads.
+  * Threads read fields of the same hashes, with the shard locks
+  * shared by readers, as the driver does, and with every read
+  * serialized by one exclusive mutex, as before readers shared them.
+  * A writer thread keeps writing to the same hashes in both cases.
+  *
+  *   build/cache_contention_benchmark [reads per thread]
+  *
+  */
+
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "harness.h"
+#include "cache/shared_map_cache_driver.h"
+
+// hashes read, few enough to be in a few shards.
+static const int HASHES = 16;
+
+
+/**
+ * Returns the reads per second of the given threads.
+ * @param cache     Cache.
+ * @param threads   Number of reader threads.
+ * @param reads     Reads per thread.
+ * @param exclusive Serialize the reads with one mutex.
+ */
+static double Run(granada::cache::SharedMapCacheDriver& cache, const int& threads, const int& reads, const bool& exclusive){
+  std::mutex mtx;
+  std::atomic<bool> done(false);
+  std::thread writer([&]{
+    int i = 0;
+    while (!done){
+      const std::string hash = "session:roles:" + std::to_string(i % HASHES);
+      if (exclusive){
+        std::lock_guard<std::mutex> lg(mtx);
+        cache.Write(hash, "update.time", std::to_string(i));
+      }else{
+        cache.Write(hash, "update.time", std::to_string(i));
+      }
+      ++i;
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  });
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> readers;
+  for (int t = 0; t < threads; ++t){
+    readers.push_back(std::thread([&,t]{
+      std::vector<std::string> hashes;
+      for (int i = 0; i < HASHES; ++i){
+        hashes.push_back("session:roles:" + std::to_string(i));
+      }
+      std::size_t found = 0;
+      for (int i = 0; i < reads; ++i){
+        const std::string& hash = hashes[(i + t) % HASHES];
+        if (exclusive){
+          std::lock_guard<std::mutex> lg(mtx);
+          found += cache.Read(hash, "username").size();
+        }else{
+          found += cache.Read(hash, "username").size();
+        }
+      }
+      GRANADA_CHECK(found > 0);
+    }));
+  }
+  for (auto it = readers.begin(); it != readers.end(); ++it){
+    it->join();
+  }
+  const double seconds = granada::test::Seconds(start);
+  done = true;
+  writer.join();
+  return threads * reads / seconds;
+}
+
+
+int main(int argc, char* argv[]){
+  const int reads = argc > 1 ? std::atoi(argv[1]) : 200000;
+  granada::cache::SharedMapCacheDriver cache(4);
+  for (int i = 0; i < HASHES; ++i){
+    const std::string hash = "session:roles:" + std::to_string(i);
+    cache.Write(hash, "username", "user" + std::to_string(i));
+    cache.Write(hash, "update.time", "0");
+  }
+
+  std::cout << "hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+  std::cout << "threads  shared (reads/s)  exclusive (reads/s)" << std::endl;
+  for (int threads = 1; threads <= 8; threads *= 2){
+    const double shared = Run(cache, threads, reads, false);
+    const double exclusive = Run(cache, threads, reads, true);
+    std::cout << std::setw(7) << threads << std::setw(18) << (long long)shared << std::setw(21) << (long long)exclusive << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,210 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Allocations per request of the cache calls of the authorization
+  * code grant and of the message flow, with the keys concatenated in
+  * a std::string at each call site, as they were built before, and
+  * with CacheKey. The calls are replayed on the shared map cache with
+  * the keys and fields the server uses. The test fails if CacheKey
+  * does not allocate less.
+  *
+  *   build/cache_key_allocation_test [requests]
+  *
+  */
+
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <string>
+#include <vector>
+#include "harness.h"
+#include "cache/shared_map_cache_driver.h"
+
+static std::atomic<long long> allocations(0);
+
+void* operator new(std::size_t size){
+  ++allocations;
+  void* pointer = std::malloc(size == 0 ? 1 : size);
+  if (pointer == nullptr){
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void operator delete(void* pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+  std::free(pointer);
+}
+
+static const std::string SESSION_VALUE = "session:value:";
+static const std::string SESSION_ROLES = "session:roles:";
+static const std::string CLIENT_VALUE = "oauth2.client:value:";
+static const std::string USER_VALUE = "oauth2.user:value:";
+static const std::string CODE_VALUE = "oauth2.code:value:";
+static const std::string MESSAGE = "message:";
+static const std::string MESSAGE_INDEX = "message.index:";
+
+static const std::vector<std::string> SESSION_FIELDS = { "session.token", "session.update.time" };
+static const std::vector<std::string> CLIENT_FIELDS = { "key", "client.type", "application.name", "redirect.uris", "roles", "creation.time" };
+static const std::vector<std::string> USER_FIELDS = { "key", "roles", "creation.time" };
+static const std::vector<std::string> MESSAGE_FIELDS = { "key", "text" };
+
+
+/**
+ * Keys concatenated in a std::string, as they were built before.
+ */
+struct StringKeys{
+  template <typename... Parts>
+  std::string operator()(const std::string& name_space, const std::string& part, const Parts&... parts) const {
+    return Append(name_space + part, parts...);
+  };
+
+  std::string Append(std::string&& key) const {
+    return std::move(key);
+  };
+
+  template <typename... Parts>
+  std::string Append(std::string&& key, const std::string& part, const Parts&... parts) const {
+    return Append(std::move(key) + ":" + part, parts...);
+  };
+};
+
+
+/**
+ * Keys made of a namespace and parts.
+ */
+struct CacheKeys{
+  template <typename... Parts>
+  granada::cache::CacheKey operator()(const std::string& name_space, const Parts&... parts) const {
+    return granada::cache::CacheKey(name_space, parts...);
+  };
+};
+
+
+/**
+ * Values of a request.
+ */
+struct Request{
+  std::string token;
+  std::string role;
+  std::string client_id;
+  std::string username;
+  std::string code;
+  std::string message_id;
+  std::string position;
+  std::string text;
+};
+
+
+/**
+ * Cache calls of an authorization code grant: the session and its
+ * role are loaded, then the client and the user, and the code is
+ * written.
+ * @param cache   Cache.
+ * @param keys    Builds the keys.
+ * @param request Request.
+ */
+template <typename Keys>
+static void Grant(granada::cache::SharedMapCacheDriver& cache, const Keys& keys, const Request& request){
+  std::vector<std::string> values;
+  cache.ReadMany(keys(SESSION_VALUE, request.token), SESSION_FIELDS, values);
+  cache.Exists(keys(SESSION_ROLES, request.token, request.role));
+  cache.ReadMany(keys(CLIENT_VALUE, request.client_id), CLIENT_FIELDS, values);
+  cache.ReadMany(keys(USER_VALUE, request.username), USER_FIELDS, values);
+  cache.WriteIfNotExists(keys(CODE_VALUE, request.code), "code", request.code);
+  cache.WriteManyWithTTL(keys(CODE_VALUE, request.code), {
+    { "username", request.username },
+    { "client.id", request.client_id }
+  }, 600);
+}
+
+
+/**
+ * Cache calls of the message flow: a message is created
+ * and indexed, then read.
+ * @param cache   Cache.
+ * @param keys    Builds the keys.
+ * @param request Request.
+ */
+template <typename Keys>
+static void Message(granada::cache::SharedMapCacheDriver& cache, const Keys& keys, const Request& request){
+  std::vector<std::string> values;
+  cache.Increment(keys(MESSAGE_INDEX, request.username), "next", 1);
+  cache.WriteMany(keys(MESSAGE, request.username, request.message_id), {
+    { "key", request.message_id },
+    { "position", request.position },
+    { "text", request.text }
+  });
+  cache.Write(keys(MESSAGE_INDEX, request.username), request.position, request.message_id);
+  cache.ReadMany(keys(MESSAGE, request.username, request.message_id), MESSAGE_FIELDS, values);
+}
+
+
+/**
+ * Returns the allocations per request of a flow.
+ * @param flow      Flow.
+ * @param requests  Requests.
+ */
+template <typename Flow>
+static double Measure(const Flow& flow, const std::vector<Request>& requests){
+  granada::cache::SharedMapCacheDriver cache(1);
+  // the first request sizes the buffers of the thread.
+  flow(cache, requests.front());
+  const long long before = allocations;
+  for (auto it = requests.begin() + 1; it != requests.end(); ++it){
+    flow(cache, *it);
+  }
+  return (double)(allocations - before) / (requests.size() - 1);
+}
+
+
+int main(int argc, char* argv[]){
+  const int count = argc > 1 ? std::atoi(argv[1]) : 1000;
+  std::vector<Request> requests;
+  for (int i = 0; i < count; ++i){
+    const std::string number = std::to_string(i);
+    requests.push_back(Request{
+      "3fa1c2d9e8b7a6f5" + number, "msg.create", "c1d2e3f4a5b6c7d8", "user" + number + "@example.com",
+      "9a8b7c6d5e4f3a2b" + number, "m0a1b2c3d4e5f6a7" + number, "0000000000" + number, "a message longer than the small string buffer"
+    });
+  }
+
+  StringKeys string_keys;
+  CacheKeys cache_keys;
+  const double grant_string = Measure([&](granada::cache::SharedMapCacheDriver& cache, const Request& request){ Grant(cache, string_keys, request); }, requests);
+  const double grant_key = Measure([&](granada::cache::SharedMapCacheDriver& cache, const Request& request){ Grant(cache, cache_keys, request); }, requests);
+  const double message_string = Measure([&](granada::cache::SharedMapCacheDriver& cache, const Request& request){ Message(cache, string_keys, request); }, requests);
+  const double message_key = Measure([&](granada::cache::SharedMapCacheDriver& cache, const Request& request){ Message(cache, cache_keys, request); }, requests);
+
+  std::cout << "flow     std::string  CacheKey" << std::endl << std::fixed << std::setprecision(1);
+  std::cout << "grant    " << grant_string << "  " << grant_key << std::endl;
+  std::cout << "message  " << message_string << "  " << message_key << std::endl;
+  GRANADA_CHECK(grant_key < grant_string);
+  GRANADA_CHECK(message_key < message_string);
+  std::cout << "ok" << std::endl;
+  return 0;
+}
@@ -0,0 +1,173 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Benchmark of the layout of the shared map cache: memory used per
+  * session and latency of the reads of random session fields, with
+  * the flat fields and plain values of the driver and with the
+  * std::unordered_map of std::map the driver used before, where plain
+  * values were stored in a "__" field.
+  *
+  *   build/cache_layout_benchmark [sessions]
+  *
+  */
+
+#include <iomanip>
+#include <malloc.h>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "harness.h"
+#include "cache/shared_map_cache_driver.h"
+
+// fields of a session.
+static const std::vector<std::string> FIELDS = {
+  "session.token", "session.update.time", "username", "client_id", "scope",
+  "state", "redirect_uri", "roles", "lang", "ip"
+};
+
+// random reads measured.
+static const int READS = 1000000;
+
+
+/**
+ * Previous layout of the driver.
+ */
+typedef std::unordered_map<std::string, std::map<std::string,std::string>> PreviousLayout;
+
+
+/**
+ * Returns the key of a session hash.
+ * @param i Number of the session.
+ */
+static std::string SessionKey(const int& i){
+  return "session:value:" + std::to_string(i * 7919);
+}
+
+
+/**
+ * Returns the key of a plain value of a session.
+ * @param i Number of the session.
+ */
+static std::string PlainKey(const int& i){
+  return "session:plain:" + std::to_string(i * 7919);
+}
+
+
+/**
+ * Returns the value of a session field.
+ * @param i Number of the session.
+ */
+static std::string FieldValue(const int& i){
+  return "v" + std::to_string(i % 1000) + "x";
+}
+
+
+/**
+ * Prints bytes per session and nanoseconds per read.
+ * @param name     Name of the layout.
+ * @param bytes    Resident bytes used by the sessions.
+ * @param sessions Number of sessions.
+ * @param seconds  Seconds of the reads.
+ */
+static void Print(const std::string& name, const long long& bytes, const int& sessions, const double& seconds){
+  std::cout << std::left << std::setw(10) << name << std::right
+            << std::setw(16) << bytes / sessions
+            << std::setw(12) << std::fixed << std::setprecision(0) << seconds * 1e9 / READS << std::endl;
+}
+
+
+int main(int argc, char* argv[]){
+  const int sessions = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+  // same random reads for both layouts.
+  std::mt19937 generator(1);
+  std::uniform_int_distribution<int> session(0, sessions - 1);
+  std::uniform_int_distribution<int> field(0, (int)FIELDS.size() - 1);
+  std::vector<std::pair<std::string,int>> reads;
+  reads.reserve(READS);
+  for (int i = 0; i < READS; ++i){
+    reads.push_back(std::make_pair(SessionKey(session(generator)), field(generator)));
+  }
+
+  std::cout << sessions << " sessions of " << FIELDS.size() << " fields and a plain value" << std::endl;
+  std::cout << "layout    bytes/session  ns/read" << std::endl;
+
+  {
+    malloc_trim(0);
+    const long long before = granada::test::Rss();
+    granada::cache::SharedMapCacheDriver cache;
+    std::vector<std::pair<std::string,std::string>> values;
+    for (int i = 0; i < sessions; ++i){
+      values.clear();
+      const std::string value = FieldValue(i);
+      for (auto it = FIELDS.begin(); it != FIELDS.end(); ++it){
+        values.push_back(std::make_pair(*it, value));
+      }
+      cache.WriteMany(SessionKey(i), values);
+      cache.Write(PlainKey(i), "1");
+    }
+    const long long bytes = granada::test::Rss() - before;
+
+    std::size_t read = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (auto it = reads.begin(); it != reads.end(); ++it){
+      read += cache.Read(it->first, FIELDS[it->second]).size();
+    }
+    const double seconds = granada::test::Seconds(start);
+    GRANADA_CHECK(read > 0);
+    Print("flat", bytes, sessions, seconds);
+  }
+
+  {
+    malloc_trim(0);
+    const long long before = granada::test::Rss();
+    PreviousLayout cache;
+    for (int i = 0; i < sessions; ++i){
+      std::map<std::string,std::string>& fields = cache[SessionKey(i)];
+      const std::string value = FieldValue(i);
+      for (auto it = FIELDS.begin(); it != FIELDS.end(); ++it){
+        fields[*it] = value;
+      }
+      cache[PlainKey(i)]["__"] = "1";
+    }
+    const long long bytes = granada::test::Rss() - before;
+
+    std::size_t read = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (auto it = reads.begin(); it != reads.end(); ++it){
+      auto hash = cache.find(it->first);
+      if (hash != cache.end()){
+        auto value = hash->second.find(FIELDS[it->second]);
+        if (value != hash->second.end()){
+          read += std::string(value->second).size();
+        }
+      }
+    }
+    const double seconds = granada::test::Seconds(start);
+    GRANADA_CHECK(read > 0);
+    Print("previous", bytes, sessions, seconds);
+  }
+  return 0;
+}
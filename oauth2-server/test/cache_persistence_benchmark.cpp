@@ -0,0 +1,142 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Benchmark of the persistence of the shared map cache: cost of the
+  * writes without persistence, with a log synced periodically and with
+  * a log synced on each write, then time to recover the cache from its
+  * snapshot and log.
+  *
+  *   build/cache_persistence_benchmark [keys] [directory]
+  *
+  * The files are written in the directory, /tmp by default, and removed.
+  */
+
+#include <cstdio>
+#include <iomanip>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "harness.h"
+#include "cache/shared_map_cache_driver.h"
+
+// writes per thread with a sync on each write, made by up to
+// SYNC_THREADS threads to show the writers sharing the syncs.
+static const int SYNC_THREADS = 8;
+static const int SYNC_WRITES = 500;
+
+
+/**
+ * Writes a session: a hash with a token and an update time.
+ * @param cache Cache.
+ * @param i     Number of the session.
+ */
+static void WriteSession(granada::cache::SharedMapCacheDriver& cache, const int& i){
+  const std::string number = std::to_string(i);
+  cache.WriteMany("session:value:" + number, {
+    { "token", number },
+    { "update.time", "1700000000" }
+  });
+}
+
+
+/**
+ * Removes the files of a persisted cache.
+ * @param directory Directory.
+ * @param name      Name of the cache.
+ */
+static void RemoveFiles(const std::string& directory, const std::string& name){
+  const std::string path = directory + "/" + name;
+  std::remove((path + ".snapshot").c_str());
+  for (int generation = 0; generation < 100000; ++generation){
+    if (std::remove((path + "." + std::to_string(generation) + ".aof").c_str()) != 0 && generation > 1000){
+      break;
+    }
+  }
+}
+
+
+int main(int argc, char* argv[]){
+  const int keys = argc > 1 ? std::atoi(argv[1]) : 1000000;
+  const std::string directory = argc > 2 ? argv[2] : "/tmp";
+  const std::string name = "granada_persistence_benchmark";
+  RemoveFiles(directory, name);
+
+  std::cout << keys << " sessions" << std::endl;
+
+  // writes without persistence.
+  double memory_seconds;
+  {
+    granada::cache::SharedMapCacheDriver cache(name, std::map<std::string,std::string>{ { "persistence_directory", "" } });
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < keys; ++i){
+      WriteSession(cache, i);
+    }
+    memory_seconds = granada::test::Seconds(start);
+  }
+  std::cout << "no persistence:   " << std::fixed << std::setprecision(0) << keys / memory_seconds << " writes/s" << std::endl;
+
+  // writes logged, synced periodically, and recovery.
+  const std::map<std::string,std::string> periodic = { { "persistence_directory", directory }, { "persistence_sync", "periodic" } };
+  double periodic_seconds;
+  {
+    granada::cache::SharedMapCacheDriver cache(name, periodic);
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < keys; ++i){
+      WriteSession(cache, i);
+    }
+    periodic_seconds = granada::test::Seconds(start);
+  }
+  std::cout << "periodic sync:    " << keys / periodic_seconds << " writes/s" << std::endl;
+  {
+    const auto start = std::chrono::steady_clock::now();
+    granada::cache::SharedMapCacheDriver cache(name, periodic);
+    const double recovery_seconds = granada::test::Seconds(start);
+    GRANADA_CHECK(cache.Read("session:value:" + std::to_string(keys - 1), "token") == std::to_string(keys - 1));
+    GRANADA_CHECK(cache.Stats().keys == (std::size_t)keys);
+    std::cout << "recovery:         " << std::setprecision(2) << recovery_seconds << " s, "
+              << std::setprecision(0) << keys / recovery_seconds << " keys/s" << std::endl;
+  }
+  RemoveFiles(directory, name);
+
+  // writes synced on each write, concurrent writers share the syncs.
+  for (int threads = 1; threads <= SYNC_THREADS; threads *= 2){
+    granada::cache::SharedMapCacheDriver cache(name, std::map<std::string,std::string>{ { "persistence_directory", directory }, { "persistence_sync", "always" } });
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> writers;
+    for (int t = 0; t < threads; ++t){
+      writers.push_back(std::thread([&cache,t]{
+        for (int i = 0; i < SYNC_WRITES; ++i){
+          WriteSession(cache, t * SYNC_WRITES + i);
+        }
+      }));
+    }
+    for (auto it = writers.begin(); it != writers.end(); ++it){
+      it->join();
+    }
+    const double seconds = granada::test::Seconds(start);
+    std::cout << "sync always:      " << threads * SYNC_WRITES / seconds << " writes/s, " << threads << " threads" << std::endl;
+    RemoveFiles(directory, name);
+  }
+  return 0;
+}
@@ -0,0 +1,70 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Helpers shared by the tests and benchmarks of the cache layer.
+  *
+  */
+
+#pragma once
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+/**
+ * Ends the test with an error if the condition is false.
+ */
+#define GRANADA_CHECK(condition) \
+  if (!(condition)){ \
+    std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " << #condition << std::endl; \
+    std::exit(1); \
+  }
+
+namespace granada{
+  namespace test{
+
+    /**
+     * Returns the seconds elapsed since a time point.
+     * @param start Time point.
+     */
+    inline double Seconds(const std::chrono::steady_clock::time_point& start){
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+
+    /**
+     * Returns the resident set size of the process in bytes,
+     * 0 where /proc is not available.
+     */
+    inline long long Rss(){
+      std::ifstream statm("/proc/self/statm");
+      long long pages = 0;
+      long long resident = 0;
+      if (!(statm >> pages >> resident)){
+        return 0;
+      }
+      return resident * sysconf(_SC_PAGESIZE);
+    };
+  }
+}
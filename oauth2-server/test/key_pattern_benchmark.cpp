@@ -0,0 +1,107 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Benchmark of the key patterns of the cache, matching keys with
+  * KeyPattern against std::regex compiled for each key, as the shared
+  * map cache did, and compiled once per pattern.
+  *
+  *   build/key_pattern_benchmark [keys]
+  *
+  */
+
+#include <iomanip>
+#include <regex>
+#include <string>
+#include <vector>
+#include "harness.h"
+#include "cache/key_pattern.h"
+
+
+/**
+ * Returns the regular expression of a glob expression,
+ * "*" replaced by ".*" as the shared map cache did.
+ * @param expression  Glob expression.
+ */
+static std::string ToRegex(const std::string& expression){
+  std::string regex;
+  for (auto it = expression.begin(); it != expression.end(); ++it){
+    if (*it == '*'){
+      regex += ".*";
+    }else{
+      regex += *it;
+    }
+  }
+  return regex;
+}
+
+
+int main(int argc, char* argv[]){
+  const int count = argc > 1 ? std::atoi(argv[1]) : 100000;
+  std::vector<std::string> keys;
+  keys.reserve(count);
+  for (int i = 0; i < count; ++i){
+    switch (i % 4){
+      case 0: keys.push_back("session:value:" + std::to_string(i)); break;
+      case 1: keys.push_back("session:roles:" + std::to_string(i) + ":admin"); break;
+      case 2: keys.push_back("oauth2.client:value:" + std::to_string(i)); break;
+      default: keys.push_back("message:user" + std::to_string(i % 100) + ":" + std::to_string(i)); break;
+    }
+  }
+
+  const std::vector<std::string> expressions = { "session:value:*", "*:admin", "*client*", "session:*:admin" };
+  std::cout << count << " keys, milliseconds per pass" << std::endl;
+  std::cout << "pattern            regex per key  regex once  KeyPattern" << std::endl;
+  for (auto it = expressions.begin(); it != expressions.end(); ++it){
+    const std::string regex = ToRegex(*it);
+
+    // regex compiled for each key, on a tenth of the keys.
+    std::size_t per_key_matches = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i += 10){
+      per_key_matches += std::regex_match(keys[i], std::regex(regex)) ? 1 : 0;
+    }
+    const double per_key = granada::test::Seconds(start) * 10;
+
+    std::size_t regex_matches = 0;
+    start = std::chrono::steady_clock::now();
+    const std::regex compiled(regex);
+    for (auto key = keys.begin(); key != keys.end(); ++key){
+      regex_matches += std::regex_match(*key, compiled) ? 1 : 0;
+    }
+    const double once = granada::test::Seconds(start);
+
+    std::size_t pattern_matches = 0;
+    start = std::chrono::steady_clock::now();
+    const granada::cache::KeyPattern pattern(*it);
+    for (auto key = keys.begin(); key != keys.end(); ++key){
+      pattern_matches += pattern.Match(*key) ? 1 : 0;
+    }
+    const double glob = granada::test::Seconds(start);
+
+    GRANADA_CHECK(pattern_matches == regex_matches);
+    GRANADA_CHECK(per_key_matches <= regex_matches);
+    std::cout << std::left << std::setw(19) << *it << std::right << std::fixed << std::setprecision(2)
+              << std::setw(13) << per_key * 1000 << std::setw(12) << once * 1000 << std::setw(12) << glob * 1000 << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,162 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Tests of the pages of the messages of a user: order, cursors,
+  * pages shortened by deleted messages, cursors not moved by messages
+  * created after them, and indexing of the messages created before
+  * the indexes existed.
+  *
+  *   build/message_list_test
+  *
+  */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "harness.h"
+#include "business/message.h"
+#include "cache/shared_map_cache_driver.h"
+
+// positions read by List in one window are the page size, it reads
+// up to 8 windows before returning a shortened page.
+static const std::size_t LIMIT = 10;
+
+
+/**
+ * Returns the texts of a stringified list of messages.
+ * @param list  List returned by Message::List.
+ */
+static std::vector<std::string> Texts(const std::string& list){
+  static const std::string field = "\"text\":\"";
+  std::vector<std::string> texts;
+  std::size_t start = 0;
+  while ((start = list.find(field, start)) != std::string::npos){
+    start += field.length();
+    const std::size_t end = list.find('"', start);
+    texts.push_back(list.substr(start, end - start));
+    start = end;
+  }
+  return texts;
+}
+
+
+/**
+ * Returns the texts of all the pages of a user's messages.
+ * @param message   Messages.
+ * @param username  User.
+ * @param pages     Set to the number of pages read.
+ */
+static std::vector<std::string> All(granada::Message& message, const std::string& username, int& pages){
+  std::vector<std::string> texts;
+  std::string cursor;
+  std::string next_cursor;
+  pages = 0;
+  do{
+    const std::vector<std::string> page = Texts(message.List(username, cursor, LIMIT, next_cursor));
+    GRANADA_CHECK(page.size() <= LIMIT);
+    texts.insert(texts.end(), page.begin(), page.end());
+    cursor = next_cursor;
+    ++pages;
+  }while (!cursor.empty());
+  return texts;
+}
+
+
+int main(){
+  std::shared_ptr<granada::cache::CacheHandler> cache(new granada::cache::SharedMapCacheDriver());
+  granada::Message message(cache);
+
+  // pages from the newest message to the oldest, other users not listed.
+  std::vector<std::string> ids;
+  for (int i = 0; i < 25; ++i){
+    ids.push_back(message.Create("ana", "a" + std::to_string(i)));
+  }
+  message.Create("bob", "b0");
+  std::string next_cursor;
+  std::vector<std::string> page = Texts(message.List("ana", "", LIMIT, next_cursor));
+  GRANADA_CHECK(page.size() == LIMIT && page.front() == "a24" && page.back() == "a15");
+  GRANADA_CHECK(!next_cursor.empty());
+  int pages;
+  std::vector<std::string> texts = All(message, "ana", pages);
+  GRANADA_CHECK(texts.size() == 25 && texts.back() == "a0" && pages == 3);
+  texts = All(message, "bob", pages);
+  GRANADA_CHECK(texts.size() == 1 && texts.front() == "b0");
+  GRANADA_CHECK(Texts(message.List("nobody", "", LIMIT, next_cursor)).empty() && next_cursor.empty());
+
+  // a message created after a cursor was given does not move the next pages.
+  Texts(message.List("ana", "", LIMIT, next_cursor));
+  ids.push_back(message.Create("ana", "a25"));
+  page = Texts(message.List("ana", next_cursor, LIMIT, next_cursor));
+  GRANADA_CHECK(page.size() == LIMIT && page.front() == "a14" && page.back() == "a5");
+
+  // deleted messages are skipped, the page is filled from the next windows.
+  for (int i = 16; i < 24; ++i){
+    message.Delete("ana", ids[i]);
+  }
+  page = Texts(message.List("ana", "", LIMIT, next_cursor));
+  GRANADA_CHECK(page.size() == LIMIT && page[0] == "a25" && page[1] == "a24" && page[2] == "a15" && page.back() == "a8");
+  texts = All(message, "ana", pages);
+  GRANADA_CHECK(texts.size() == 18 && texts.back() == "a0");
+
+  // more deleted messages than the windows read, a shortened page
+  // is returned with a cursor to continue.
+  for (int i = 0; i < 100; ++i){
+    ids.push_back(message.Create("carl", "c" + std::to_string(i)));
+  }
+  for (int i = 1; i < 99; ++i){
+    message.Delete("carl", ids[26 + i]);
+  }
+  page = Texts(message.List("carl", "", LIMIT, next_cursor));
+  GRANADA_CHECK(page.size() == 1 && page.front() == "c99" && !next_cursor.empty());
+  texts = All(message, "carl", pages);
+  GRANADA_CHECK(texts.size() == 2 && texts.back() == "c0" && pages == 2);
+
+  // edited messages keep their position.
+  GRANADA_CHECK(message.Edit("carl", ids[26], "c0 edited"));
+  texts = All(message, "carl", pages);
+  GRANADA_CHECK(texts.back() == "c0 edited");
+
+  // messages created before the indexes existed are indexed once,
+  // then the version of the indexes is kept.
+  std::shared_ptr<granada::cache::CacheHandler> legacy(new granada::cache::SharedMapCacheDriver());
+  for (int i = 0; i < 3; ++i){
+    const std::string id = "legacy" + std::to_string(i);
+    legacy->WriteMany("message:dan:" + id, { { "key", id }, { "text", "d" + std::to_string(i) } });
+  }
+  legacy->WriteMany("message:eve:x:legacy", { { "key", "legacy" }, { "text", "e0" } });
+  granada::Message::Index(legacy);
+  granada::Message indexed(legacy);
+  texts = All(indexed, "dan", pages);
+  GRANADA_CHECK(texts.size() == 3);
+  texts = All(indexed, "eve:x", pages);
+  GRANADA_CHECK(texts.size() == 1 && texts.front() == "e0");
+  indexed.Create("dan", "d3");
+  texts = All(indexed, "dan", pages);
+  GRANADA_CHECK(texts.size() == 4 && texts.front() == "d3");
+  legacy->WriteMany("message:dan:late", { { "key", "late" }, { "text", "late" } });
+  granada::Message::Index(legacy);
+  GRANADA_CHECK(All(indexed, "dan", pages).size() == 4);
+
+  std::cout << "ok" << std::endl;
+  return 0;
+}
@@ -0,0 +1,190 @@
+/**
+  * Copyright (c) <2016> granada <afernandez@cookinapps.io>
+  *
+  * This source code is licensed under the MIT license.
+  *
+  * Permission is hereby granted, free of charge, to any person obtaining a copy
+  * of this software and associated documentation files (the "Software"), to deal
+  * in the Software without restriction, including without limitation the rights
+  * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  * copies of the Software, and to permit persons to whom the Software is
+  * furnished to do so, subject to the following conditions:
+  *
+  * The above copyright notice and this permission notice shall be included in
+  * all copies or substantial portions of the Software.
+  *
+  * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  * SOFTWARE.
+  *
+  * Allocations per request of the cache calls of the authorization
+  * Checks the operations of RedisCacheDriver run by a script or
+  * sent pipelined against a running Redis server: WriteIfNotExists,
+  * CompareAndSet, IncrementWithTTL, TakeTokens, ReadMany and
+  * WriteManyWithTTL, alone and from concurrent threads. Only keys
+  * starting with "granada.test.redis:" are written, they are removed
+  * at the start and at the end.
+  *
+  *   build/redis_cache_driver_test [address=127.0.0.1] [port=6379]
+  *
+  */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include "harness.h"
+#include "cache/redis_cache_driver.h"
+
+static const std::string PREFIX = "granada.test.redis:";
+
+static const int THREADS = 8;
+
+
+/**
+ * Runs a function in concurrent threads and waits for them.
+ * @param function  Function, receives the number of the thread.
+ */
+template <typename F>
+static void Concurrently(F function){
+  std::vector<std::thread> threads;
+  for (int t = 0; t < THREADS; ++t){
+    threads.emplace_back(function, t);
+  }
+  for (auto it = threads.begin(); it != threads.end(); ++it){
+    it->join();
+  }
+}
+
+
+int main(int argc, char* argv[]){
+  const std::string address = argc > 1 ? argv[1] : "127.0.0.1";
+  const unsigned short port = (unsigned short)(argc > 2 ? std::atoi(argv[2]) : 6379);
+  granada::cache::RedisCacheDriver cache(address, port, THREADS);
+
+  cache.Write(PREFIX + "ping", "1");
+  if (cache.Read(PREFIX + "ping") != "1"){
+    std::cerr << "no Redis server at " << address << ":" << port << std::endl;
+    return 1;
+  }
+  cache.DestroyMatch(PREFIX + "*");
+
+  // values and fields are only written if they do not exist.
+  GRANADA_CHECK(cache.WriteIfNotExists(PREFIX + "string", "a"));
+  GRANADA_CHECK(!cache.WriteIfNotExists(PREFIX + "string", "b"));
+  GRANADA_CHECK(cache.Read(PREFIX + "string") == "a");
+  GRANADA_CHECK(cache.WriteIfNotExists(PREFIX + "hash", "field", "a"));
+  GRANADA_CHECK(!cache.WriteIfNotExists(PREFIX + "hash", "field", "b"));
+  GRANADA_CHECK(cache.Read(PREFIX + "hash", "field") == "a");
+
+  // a field is replaced only if it has the expected value,
+  // an empty expected value is a field that does not exist.
+  GRANADA_CHECK(cache.CompareAndSet(PREFIX + "hash", "other", "", "1"));
+  GRANADA_CHECK(!cache.CompareAndSet(PREFIX + "hash", "other", "", "2"));
+  GRANADA_CHECK(!cache.CompareAndSet(PREFIX + "hash", "other", "2", "3"));
+  GRANADA_CHECK(cache.CompareAndSet(PREFIX + "hash", "other", "1", "3"));
+  GRANADA_CHECK(cache.Read(PREFIX + "hash", "other") == "3");
+  // a value that is not a set is left unchanged.
+  GRANADA_CHECK(!cache.CompareAndSet(PREFIX + "string", "field", "", "1"));
+  GRANADA_CHECK(cache.Read(PREFIX + "string") == "a");
+
+  // the time to live is set by the first increment only.
+  GRANADA_CHECK(cache.IncrementWithTTL(PREFIX + "counter", 5, 60) == 5);
+  long long ttl = cache.TTL(PREFIX + "counter");
+  GRANADA_CHECK(ttl > 0 && ttl <= 60);
+  GRANADA_CHECK(cache.Expire(PREFIX + "counter", 600));
+  GRANADA_CHECK(cache.IncrementWithTTL(PREFIX + "counter", -2, 60) == 3);
+  GRANADA_CHECK(cache.TTL(PREFIX + "counter") > 60);
+  // a counter without time to live gets one.
+  GRANADA_CHECK(cache.Increment(PREFIX + "persistent", 1) == 1);
+  GRANADA_CHECK(cache.TTL(PREFIX + "persistent") == -1);
+  GRANADA_CHECK(cache.IncrementWithTTL(PREFIX + "persistent", 1, 60) == 2);
+  GRANADA_CHECK(cache.TTL(PREFIX + "persistent") > 0);
+  // a set is left unchanged.
+  GRANADA_CHECK(cache.IncrementWithTTL(PREFIX + "hash", 1, 60) == 0);
+  GRANADA_CHECK(cache.Read(PREFIX + "hash", "field") == "a" && cache.TTL(PREFIX + "hash") == -1);
+
+  // a bucket is full when it does not exist, the tokens are only taken
+  // if there are enough of them, a bucket that is not refilled does not expire.
+  GRANADA_CHECK(cache.TakeTokens(PREFIX + "bucket", 1, 3, 0) == 2);
+  GRANADA_CHECK(cache.TakeTokens(PREFIX + "bucket", 2, 3, 0) == 0);
+  GRANADA_CHECK(cache.TakeTokens(PREFIX + "bucket", 1, 3, 0) == -1);
+  GRANADA_CHECK(cache.TTL(PREFIX + "bucket") == -1);
+  // the state has the format of TokenBucket, so the default implementation
+  // of the other drivers reads the same buckets.
+  std::string state = cache.Read(PREFIX + "bucket", granada::cache::TokenBucket::FIELD);
+  long long seconds;
+  GRANADA_CHECK(state.compare(0, 2, "0 ") == 0);
+  GRANADA_CHECK(granada::cache::TokenBucket::Take(state, 1, 3, 0, granada::cache::TokenBucket::Now(), seconds) == -1);
+  // a refilled bucket expires once it is full again.
+  GRANADA_CHECK(cache.TakeTokens(PREFIX + "refilled", 5, 5, 100) == 0);
+  ttl = cache.TTL(PREFIX + "refilled");
+  GRANADA_CHECK(ttl > 0 && ttl <= 2);
+  GRANADA_CHECK(cache.TakeTokens(PREFIX + "refilled", 1, 5, 100) == -1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  GRANADA_CHECK(cache.TakeTokens(PREFIX + "refilled", 1, 5, 100) >= 0);
+  // a bucket with a state it cannot read is full.
+  cache.Write(PREFIX + "broken", granada::cache::TokenBucket::FIELD, "broken");
+  GRANADA_CHECK(cache.TakeTokens(PREFIX + "broken", 1, 3, 0) == 2);
+
+  // the fields are written with their time to live in one transaction,
+  // read with the existence of the set in one pipeline.
+  cache.WriteManyWithTTL(PREFIX + "many", {{"a", "1"}, {"b", "2"}}, 60);
+  std::vector<std::string> values;
+  GRANADA_CHECK(cache.ReadMany(PREFIX + "many", {"a", "missing", "b"}, values));
+  GRANADA_CHECK(values.size() == 3 && values[0] == "1" && values[1].empty() && values[2] == "2");
+  ttl = cache.TTL(PREFIX + "many");
+  GRANADA_CHECK(ttl > 0 && ttl <= 60);
+  cache.WriteWithTTL(PREFIX + "many", "c", "3", 120);
+  GRANADA_CHECK(cache.TTL(PREFIX + "many") > 60 && cache.Read(PREFIX + "many", "c") == "3");
+  GRANADA_CHECK(!cache.ReadMany(PREFIX + "missing", {"a"}, values));
+
+  // concurrent calls are not lost nor taken twice.
+  const int calls = 500;
+  Concurrently([&](int t){
+    for (int i = 0; i < calls; ++i){
+      cache.IncrementWithTTL(PREFIX + "concurrent.counter", 1, 60);
+    }
+  });
+  GRANADA_CHECK(cache.Read(PREFIX + "concurrent.counter") == std::to_string(THREADS * calls));
+
+  std::atomic<int> taken(0);
+  Concurrently([&](int t){
+    for (int i = 0; i < calls; ++i){
+      if (cache.TakeTokens(PREFIX + "concurrent.bucket", 1, calls, 0) >= 0){
+        ++taken;
+      }
+    }
+  });
+  GRANADA_CHECK(taken == calls);
+
+  std::atomic<int> written(0);
+  Concurrently([&](int t){
+    for (int i = 0; i < calls; ++i){
+      if (cache.WriteIfNotExists(PREFIX + "concurrent.once", std::to_string(i), std::to_string(t))){
+        ++written;
+      }
+    }
+  });
+  GRANADA_CHECK(written == calls);
+
+  Concurrently([&](int t){
+    for (int i = 0; i < calls; ++i){
+      std::string current;
+      do{
+        current = cache.Read(PREFIX + "concurrent.cas", "value");
+      }while (!cache.CompareAndSet(PREFIX + "concurrent.cas", "value", current, std::to_string(current.empty() ? 1 : std::stoll(current) + 1)));
+    }
+  });
+  GRANADA_CHECK(cache.Read(PREFIX + "concurrent.cas", "value") == std::to_string(THREADS * calls));
+
+  GRANADA_CHECK(cache.DestroyMatch(PREFIX + "*") > 0 && !cache.Exists(PREFIX + "hash"));
+  std::cout << "ok" << std::endl;
+  return 0;
+}